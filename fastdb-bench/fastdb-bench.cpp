@@ -0,0 +1,608 @@
+#include "fastdb.h"
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace std;
+using namespace wx;
+
+//fastdb-bench times the core read, build and tile paths on seeded synthetic data,
+//so runs of two releases on the same machine can be compared case by case.
+//the report goes to stderr, --json writes the results in the Google Benchmark layout.
+
+struct bench_options_t
+{
+    const char* filter;     //substring of the case names to run
+    const char* json;
+    u32         features;
+    u32         seed;
+    double      min_time;   //seconds per case
+    u32         repetitions;
+};
+
+struct bench_result_t
+{
+    string      name;
+    u64         iterations;     //of every repetition
+    u64         items;          //per iteration
+    double      ns_min;         //per item
+    double      ns_median;
+    double      bytes_per_item;
+};
+
+static volatile double g_sink;
+
+static double now_seconds()
+{
+    return chrono::duration<double>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+class Bench
+{
+public:
+    Bench(const bench_options_t& options) : m_options(options) {}
+    //fn runs one iteration over items items
+    template <typename fn_t>
+    void run(const string& name, u64 items, fn_t fn, double bytesPerItem = 0)
+    {
+        if (m_options.filter && name.find(m_options.filter) == string::npos)
+            return;
+        if (items == 0)
+            return;
+        double t0 = now_seconds();
+        fn();
+        double once = std::max(now_seconds() - t0, 1e-9);
+        double per_rep = m_options.min_time / m_options.repetitions;
+        u64 iterations = std::max<u64>(1, (u64)(per_rep / once));
+        vector<double> samples;
+        for (u32 r = 0; r < m_options.repetitions; r++)
+        {
+            t0 = now_seconds();
+            for (u64 i = 0; i < iterations; i++)
+                fn();
+            samples.push_back((now_seconds() - t0) * 1e9 / (iterations * items));
+        }
+        sort(samples.begin(), samples.end());
+        bench_result_t result;
+        result.name = name;
+        result.iterations = iterations;
+        result.items = items;
+        result.ns_min = samples.front();
+        result.ns_median = samples[samples.size() / 2];
+        result.bytes_per_item = bytesPerItem;
+        m_results.push_back(result);
+        fprintf(stderr, "%-36s %12.2f ns/item %14.0f items/s %10llu x %llu\n", name.c_str(), result.ns_median,
+                1e9 / result.ns_median, (unsigned long long)iterations, (unsigned long long)items);
+    }
+    bool writeJson(const char* path)
+    {
+        FILE* fp = fopen(path, "w");
+        if (!fp)
+        {
+            printf("Can't create %s\n", path);
+            return false;
+        }
+        char host[256] = "unknown";
+        gethostname(host, sizeof(host) - 1);
+        char date[64];
+        time_t t = time(NULL);
+        strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", localtime(&t));
+        fprintf(fp, "{\n  \"context\": {\n");
+        fprintf(fp, "    \"date\": \"%s\",\n    \"host_name\": \"%s\",\n", date, host);
+        fprintf(fp, "    \"executable\": \"fastdb-bench\",\n    \"compiler\": \"%s\",\n", __VERSION__);
+#ifdef NDEBUG
+        fprintf(fp, "    \"build_type\": \"release\",\n");
+#else
+        fprintf(fp, "    \"build_type\": \"debug\",\n");
+#endif
+        fprintf(fp, "    \"features\": %u,\n    \"seed\": %u,\n    \"repetitions\": %u\n  },\n",
+                m_options.features, m_options.seed, m_options.repetitions);
+        fprintf(fp, "  \"benchmarks\": [\n");
+        for (size_t i = 0; i < m_results.size(); i++)
+        {
+            auto& r = m_results[i];
+            fprintf(fp, "    {\"name\": \"%s\", \"run_type\": \"iteration\", \"iterations\": %llu, \"items\": %llu, "
+                        "\"real_time\": %.3f, \"cpu_time\": %.3f, \"min_time\": %.3f, \"time_unit\": \"ns\", "
+                        "\"items_per_second\": %.1f",
+                    r.name.c_str(), (unsigned long long)r.iterations, (unsigned long long)r.items,
+                    r.ns_median, r.ns_median, r.ns_min, 1e9 / r.ns_median);
+            if (r.bytes_per_item > 0)
+                fprintf(fp, ", \"bytes_per_second\": %.1f", r.bytes_per_item * 1e9 / r.ns_median);
+            fprintf(fp, "}%s\n", i + 1 < m_results.size() ? "," : "");
+        }
+        fprintf(fp, "  ]\n}\n");
+        return fclose(fp) == 0;
+    }
+private:
+    bench_options_t         m_options;
+    vector<bench_result_t>  m_results;
+};
+
+//splitmix64, the same sequence on every platform
+class BenchRandom
+{
+public:
+    BenchRandom(u64 seed) : m_state(seed) {}
+    u64 next()
+    {
+        u64 z = (m_state += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+    double uniform(double lo, double hi)
+    {
+        return lo + (hi - lo) * (next() >> 11) * (1.0 / 9007199254740992.0);
+    }
+private:
+    u64 m_state;
+};
+
+class StringStream : public WriteStream
+{
+public:
+    string data;
+    void write(void* pdata, size_t size) override
+    {
+        data.append((const char*)pdata, size);
+    }
+};
+
+class NullStream : public WriteStream
+{
+public:
+    size_t size = 0;
+    void write(void*, size_t n) override
+    {
+        size += n;
+    }
+};
+
+class PointCounter : public GeometryReturn
+{
+public:
+    u64 points = 0;
+    bool begin(const double[4]) override
+    {
+        return true;
+    }
+    void returnGeomrtryPart(GeometryPartEnum, point2_t* pts, int np) override
+    {
+        points += np;
+        if (np)
+            g_sink = pts[np - 1].x;
+    }
+    void end() override
+    {
+    }
+};
+
+static const double BENCH_EXTENT = 1000;
+static const u32 BENCH_VERTICES = 8;
+
+struct bench_field_t
+{
+    const char*     name;
+    FieldTypeEnum   type;
+};
+static const bench_field_t BENCH_FIELDS[] = {
+    {"u8", ftU8}, {"u16", ftU16}, {"u32", ftU32}, {"i32", ftI32}, {"u8n", ftU8n},
+    {"u16n", ftU16n}, {"f32", ftF32}, {"f64", ftF64}, {"str", ftSTR},
+};
+static const u32 BENCH_FIELD_COUNT = sizeof(BENCH_FIELDS) / sizeof(BENCH_FIELDS[0]);
+
+//vertices of feature i, a small random walk (closed for polygons)
+static void make_shape(BenchRandom& rnd, GeometryLikeEnum gt, vector<point2_t>& points)
+{
+    points.clear();
+    double x = rnd.uniform(10, BENCH_EXTENT - 10), y = rnd.uniform(10, BENCH_EXTENT - 10);
+    if (gt == gtPoint)
+    {
+        points.push_back(point2_t::make(x, y));
+        return;
+    }
+    if (gt == gtPolygon)
+    {
+        for (u32 i = 0; i < BENCH_VERTICES - 1; i++)
+        {
+            double a = 2 * M_PI * i / (BENCH_VERTICES - 1);
+            double r = rnd.uniform(2, 8);
+            points.push_back(point2_t::make(x + r * cos(a), y + r * sin(a)));
+        }
+        points.push_back(points.front());
+        return;
+    }
+    for (u32 i = 0; i < BENCH_VERTICES; i++)
+    {
+        points.push_back(point2_t::make(x, y));
+        x += rnd.uniform(-5, 5);
+        y += rnd.uniform(-5, 5);
+    }
+}
+
+static string make_wkt(GeometryLikeEnum gt, const vector<point2_t>& points)
+{
+    string wkt = gt == gtPoint ? "POINT(" : gt == gtLineString ? "LINESTRING(" : "POLYGON((";
+    char text[64];
+    for (size_t i = 0; i < points.size(); i++)
+    {
+        snprintf(text, sizeof(text), "%s%.6f %.6f", i ? "," : "", points[i].x, points[i].y);
+        wkt += text;
+    }
+    wkt += gt == gtPolygon ? "))" : ")";
+    return wkt;
+}
+
+//little endian WKB of a line string
+static void make_wkb(const vector<point2_t>& points, vector<u8>& wkb)
+{
+    wkb.clear();
+    wkb.push_back(1);
+    u32 type = 2, count = points.size();
+    wkb.insert(wkb.end(), (u8*)&type, (u8*)&type + 4);
+    wkb.insert(wkb.end(), (u8*)&count, (u8*)&count + 4);
+    wkb.insert(wkb.end(), (u8*)points.data(), (u8*)(points.data() + points.size()));
+}
+
+static void set_fields(FastVectorDbBuild& build, u32 i)
+{
+    build.setField(0, (int)(i & 0xFF));
+    build.setField(1, (int)(i & 0xFFFF));
+    build.setField(2, (int)i);
+    build.setField(3, (int)i - 1000);
+    build.setField(4, (i % 100) / 100.0);
+    build.setField(5, (i % 1000) / 1000.0);
+    build.setField(6, i * 0.5);
+    build.setField(7, i * 0.25);
+    char text[32];
+    snprintf(text, sizeof(text), "name-%u", i % 997);
+    build.setField(8, text);
+}
+
+//one layer of count features, points from ginPoint2, lines from ginLineString, polygons from WKT
+static string make_image(GeometryLikeEnum gt, CoordinateFormatEnum cf, u32 count, u32 seed)
+{
+    BenchRandom rnd(seed);
+    FastVectorDbBuild build;
+    build.begin("");
+    build.createLayerBegin("bench");
+    build.setGeometryType(gt, cf);
+    build.setExtent(0, 0, BENCH_EXTENT, BENCH_EXTENT);
+    for (auto& field : BENCH_FIELDS)
+        build.addField(field.name, field.type);
+    vector<point2_t> points;
+    for (u32 i = 0; i < count; i++)
+    {
+        make_shape(rnd, gt, points);
+        build.addFeatureBegin();
+        if (gt == gtPoint)
+            build.setGeometry(points.data(), sizeof(point2_t), ginPoint2);
+        else if (gt == gtLineString)
+            build.setGeometry(points.data(), points.size(), ginLineString);
+        else
+            build.setGeometryWKT(make_wkt(gt, points).c_str());
+        set_fields(build, i);
+        build.addFeatureEnd();
+    }
+    build.createLayerEnd();
+    StringStream stream;
+    build.post(&stream);
+    return stream.data;
+}
+
+static FastVectorDb* load_image(string& image)
+{
+    return FastVectorDb::load((void*)image.data(), image.size(), NULL, NULL);
+}
+
+static const char* cf_name(CoordinateFormatEnum cf)
+{
+    switch (cf)
+    {
+    case cfF32: return "f32";
+    case cfF64: return "f64";
+    case cfTx16: return "tx16";
+    case cfTx24: return "tx24";
+    case cfTx32: return "tx32";
+    }
+    return "?";
+}
+static const char* gt_name(GeometryLikeEnum gt)
+{
+    return gt == gtPoint ? "point" : gt == gtLineString ? "line" : "polygon";
+}
+
+static void bench_open(Bench& bench, const bench_options_t& options)
+{
+    string image = make_image(gtLineString, cfF32, options.features, options.seed);
+    char path[] = "/tmp/fastdb-bench-XXXXXX";
+    int fd = mkstemp(path);
+    if (fd == -1 || write(fd, image.data(), image.size()) != (ssize_t)image.size())
+    {
+        printf("Can't write the open benchmark file\n");
+        if (fd != -1)
+            close(fd);
+        return;
+    }
+    close(fd);
+    bench.run("open/malloc", 1, [&] {
+        delete FastVectorDb::load(path);
+    }, image.size());
+    bench.run("open/mmap", 1, [&] {
+        int fd = open(path, O_RDONLY);
+        delete FastVectorDb::load_fd(fd);
+        close(fd);
+    }, image.size());
+    unlink(path);
+}
+
+static void bench_scan(Bench& bench, const bench_options_t& options)
+{
+    for (auto gt : {gtPoint, gtLineString, gtPolygon})
+    {
+        string image = make_image(gt, cfF32, options.features, options.seed);
+        auto db = load_image(image);
+        auto layer = db->getLayer(0);
+        bench.run(string("scan/next/") + gt_name(gt), layer->getFeatureCount(), [&] {
+            u32 n = 0;
+            layer->rewind();
+            while (layer->next())
+                n++;
+            g_sink = n;
+        });
+        delete db;
+    }
+}
+
+//ns per coordinate of fetchGeometry for every coordinate format
+static void bench_geometry(Bench& bench, const bench_options_t& options)
+{
+    for (auto gt : {gtLineString, gtPolygon})
+    {
+        for (auto cf : {cfF32, cfF64, cfTx16, cfTx24, cfTx32})
+        {
+            string image = make_image(gt, cf, options.features, options.seed);
+            auto db = load_image(image);
+            auto layer = db->getLayer(0);
+            PointCounter counter;
+            layer->rewind();
+            while (layer->next())
+                layer->fetchGeometry(&counter);
+            bench.run(string("geometry/fetch/") + gt_name(gt) + "/" + cf_name(cf), counter.points, [&] {
+                PointCounter cb;
+                layer->rewind();
+                while (layer->next())
+                    layer->fetchGeometry(&cb);
+            });
+            delete db;
+        }
+    }
+}
+
+static void bench_fields(Bench& bench, const bench_options_t& options)
+{
+    string image = make_image(gtPoint, cfF32, options.features, options.seed);
+    auto db = load_image(image);
+    auto layer = db->getLayer(0);
+    u32 count = layer->getFeatureCount();
+    for (u32 ix = 0; ix < BENCH_FIELD_COUNT; ix++)
+    {
+        auto type = BENCH_FIELDS[ix].type;
+        string name = string("field/") + BENCH_FIELDS[ix].name;
+        if (type == ftSTR)
+        {
+            bench.run(name + "/string", count, [&] {
+                size_t n = 0;
+                layer->rewind();
+                while (layer->next())
+                    n += layer->getFieldAsString(ix)[0];
+                g_sink = n;
+            });
+            continue;
+        }
+        bench.run(name + "/float", count, [&] {
+            double sum = 0;
+            layer->rewind();
+            while (layer->next())
+                sum += layer->getFieldAsFloat(ix);
+            g_sink = sum;
+        });
+        if (type == ftU8 || type == ftU16 || type == ftU32 || type == ftI32)
+        {
+            bench.run(name + "/int", count, [&] {
+                long long sum = 0;
+                layer->rewind();
+                while (layer->next())
+                    sum += layer->getFieldAsInt(ix);
+                g_sink = sum;
+            });
+        }
+    }
+    delete db;
+}
+
+static void bench_random_access(Bench& bench, const bench_options_t& options)
+{
+    string image = make_image(gtLineString, cfF32, options.features, options.seed);
+    auto db = load_image(image);
+    auto layer = db->getLayer(0);
+    u32 count = layer->getFeatureCount();
+    BenchRandom rnd(options.seed + 1);
+    vector<u32> rows(count);
+    for (auto& row : rows)
+        row = rnd.next() % count;
+    //the first call builds the row table, it is not part of the case
+    layer->tryGetFeatureAt(0);
+    bench.run("random/tryGetFeatureAt", rows.size(), [&] {
+        double sum = 0;
+        for (u32 row : rows)
+            sum += layer->tryGetFeatureAt(row)->getFieldAsFloat(7);
+        g_sink = sum;
+    });
+    delete db;
+}
+
+//features per second of one layer build by geometry input format, the image is posted to a null stream
+static void bench_build(Bench& bench, const bench_options_t& options)
+{
+    u32 count = std::max(options.features / 10, 1u);
+    BenchRandom rnd(options.seed);
+    vector<vector<point2_t>> lines(count), points(count);
+    vector<string> wkts(count);
+    vector<vector<u8>> wkbs(count);
+    for (u32 i = 0; i < count; i++)
+    {
+        make_shape(rnd, gtLineString, lines[i]);
+        make_shape(rnd, gtPoint, points[i]);
+        wkts[i] = make_wkt(gtLineString, lines[i]);
+        make_wkb(lines[i], wkbs[i]);
+    }
+    auto build_layer = [&](GeometryLikeEnum gt, GeometryLikeFormat fmt) {
+        FastVectorDbBuild build;
+        build.begin("");
+        build.createLayerBegin("bench");
+        build.setGeometryType(gt, cfF32);
+        build.setExtent(0, 0, BENCH_EXTENT, BENCH_EXTENT);
+        for (auto& field : BENCH_FIELDS)
+            build.addField(field.name, field.type);
+        for (u32 i = 0; i < count; i++)
+        {
+            build.addFeatureBegin();
+            if (fmt == ginPoint2)
+                build.setGeometry(points[i].data(), sizeof(point2_t), ginPoint2);
+            else if (fmt == ginLineString)
+                build.setGeometry(lines[i].data(), lines[i].size(), ginLineString);
+            else if (fmt == ginWKT)
+                build.setGeometryWKT(wkts[i].c_str());
+            else
+                build.setGeometryWKB(wkbs[i].data(), wkbs[i].size());
+            set_fields(build, i);
+            build.addFeatureEnd();
+        }
+        build.createLayerEnd();
+        NullStream stream;
+        build.post(&stream);
+        g_sink = stream.size;
+    };
+    bench.run("build/point/point2", count, [&] { build_layer(gtPoint, ginPoint2); });
+    bench.run("build/line/linestring", count, [&] { build_layer(gtLineString, ginLineString); });
+    bench.run("build/line/wkt", count, [&] { build_layer(gtLineString, ginWKT); });
+    bench.run("build/line/wkb", count, [&] { build_layer(gtLineString, ginWKB); });
+}
+
+//every tile gets its own copy of a small image, loaded synchronously on the first take
+class BenchTileDb : public FastVectorTileDb
+{
+public:
+    string image;
+protected:
+    TileData* loadTileDataInternal(TileDataHandle*) override
+    {
+        void* pdata = malloc(image.size());
+        memcpy(pdata, image.data(), image.size());
+        return FastVectorDb::load(pdata, image.size(), [](void* p, size_t, void*) { free(p); }, NULL);
+    }
+};
+
+static void bench_tiles(Bench& bench, const bench_options_t& options)
+{
+    const u32 maxLevel = 7;
+    BenchTileDb tiles;
+    tiles.image = make_image(gtPoint, cfF32, 16, options.seed);
+    char path[64];
+    for (u32 l = 0; l <= maxLevel; l++)
+    {
+        u32 k = 1 << l;
+        double s = 360.0 / k;
+        for (u32 y = 0; y < std::max(k / 2, 1u); y++)
+        {
+            for (u32 x = 0; x < k; x++)
+            {
+                snprintf(path, sizeof(path), "%u/%u/%u", l, x, y);
+                tiles.registerTile(path, l, 0, -180 + x * s, -90 + y * s, -180 + (x + 1) * s, -90 + (y + 1) * s);
+            }
+        }
+    }
+    BenchRandom rnd(options.seed + 2);
+    vector<double> views;
+    for (u32 i = 0; i < 64; i++)
+    {
+        double x = rnd.uniform(-170, 140), y = rnd.uniform(-80, 50), w = rnd.uniform(5, 30);
+        views.insert(views.end(), {x, y, x + w, y + w * 0.6});
+    }
+    //loads every tile the views show
+    for (size_t i = 0; i < views.size(); i += 4)
+        tiles.freeResult(tiles.take(maxLevel, views[i], views[i + 1], views[i + 2], views[i + 3]));
+    bench.run("tile/take", views.size() / 4, [&] {
+        for (size_t i = 0; i < views.size(); i += 4)
+            tiles.freeResult(tiles.take(maxLevel, views[i], views[i + 1], views[i + 2], views[i + 3]));
+    });
+    //a viewport panning a little every frame
+    const u32 frames = 256;
+    auto cursor = tiles.createCursor();
+    auto pan = [&] {
+        for (u32 f = 0; f < frames; f++)
+            tiles.takeIncremental(cursor, maxLevel, -20 + f * 0.05, 10, f * 0.05, 22);
+    };
+    pan();
+    bench.run("tile/take_incremental", frames, pan);
+    bench.run("tile/take_panning", frames, [&] {
+        for (u32 f = 0; f < frames; f++)
+            tiles.freeResult(tiles.take(maxLevel, -20 + f * 0.05, 10, f * 0.05, 22));
+    });
+    tiles.freeCursor(cursor);
+}
+
+static void usage()
+{
+    fprintf(stderr, "usage: fastdb-bench [--filter text] [--json file] [--features n] [--seed n]\n"
+                    "                    [--min-time seconds] [--repetitions n]\n");
+}
+
+int main(int argc, char** argv)
+{
+    bench_options_t options;
+    options.filter = NULL;
+    options.json = NULL;
+    options.features = 100000;
+    options.seed = 1;
+    options.min_time = 0.5;
+    options.repetitions = 5;
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--filter" && has_value)
+            options.filter = argv[++i];
+        else if (arg == "--json" && has_value)
+            options.json = argv[++i];
+        else if (arg == "--features" && has_value)
+            options.features = std::max(atoi(argv[++i]), 1);
+        else if (arg == "--seed" && has_value)
+            options.seed = atoi(argv[++i]);
+        else if (arg == "--min-time" && has_value)
+            options.min_time = atof(argv[++i]);
+        else if (arg == "--repetitions" && has_value)
+            options.repetitions = std::max(atoi(argv[++i]), 1);
+        else
+        {
+            usage();
+            return arg == "--help" ? 0 : 1;
+        }
+    }
+    Bench bench(options);
+    bench_open(bench, options);
+    bench_scan(bench, options);
+    bench_geometry(bench, options);
+    bench_fields(bench, options);
+    bench_random_access(bench, options);
+    bench_build(bench, options);
+    bench_tiles(bench, options);
+    if (options.json && !bench.writeJson(options.json))
+        return 1;
+    return 0;
+}
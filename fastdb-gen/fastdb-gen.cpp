@@ -0,0 +1,156 @@
+#include "fastdb.h"
+#include <vector>
+#include <string>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace std;
+using namespace wx;
+
+//fastdb-gen writes seeded synthetic databases or tile pyramids with FastVectorDbGen,
+//so scale tests run on a bare build machine without GDAL or source data.
+//options after a --layer describe that layer.
+
+static void usage()
+{
+    fprintf(stderr,
+            "usage: fastdb-gen [--seed n] [--extent minx,miny,maxx,maxy]\n"
+            "                  --layer name:point|line|polygon:count[:f32|f64|tx16|tx24|tx32]\n"
+            "                      [--vertices min,max[,step[,log]]] [--holes n]\n"
+            "                      [--field name:type[:vmin,vmax]] [--field name:str|wstr[:cardinality]]\n"
+            "                      [--ref name:layer] ...\n"
+            "                  (-o file.fdb | --pyramid dir --levels n [--threads n])\n"
+            "field types: u8 u16 u32 i32 u8n u16n f32 f64 str wstr\n");
+}
+
+static vector<string> split(const string &text, char sep)
+{
+    vector<string> parts;
+    size_t start = 0;
+    while (true)
+    {
+        size_t end = text.find(sep, start);
+        parts.push_back(text.substr(start, end == string::npos ? string::npos : end - start));
+        if (end == string::npos)
+            break;
+        start = end + 1;
+    }
+    return parts;
+}
+
+static int lookup(const char *name, const char *const *names, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        if (strcmp(name, names[i]) == 0)
+            return i;
+    }
+    return -1;
+}
+
+int main(int argc, char **argv)
+{
+    static const char *geometry_names[] = {"point", "line", "polygon"};
+    static const GeometryLikeEnum geometry_types[] = {gtPoint, gtLineString, gtPolygon};
+    static const char *coord_names[] = {"f32", "f64", "tx16", "tx24", "tx32"};
+    static const CoordinateFormatEnum coord_formats[] = {cfF32, cfF64, cfTx16, cfTx24, cfTx32};
+    static const char *field_names[] = {"u8", "u16", "u32", "i32", "u8n", "u16n", "f32", "f64", "str", "wstr"};
+    static const FieldTypeEnum field_types[] = {ftU8, ftU16, ftU32, ftI32, ftU8n, ftU16n, ftF32, ftF64, ftSTR, ftWSTR};
+
+    u64 seed = 1;
+    for (int i = 1; i + 1 < argc; i++)
+    {
+        if (strcmp(argv[i], "--seed") == 0)
+            seed = strtoull(argv[i + 1], NULL, 10);
+    }
+    FastVectorDbGen gen(seed);
+    vector<string> layers;
+    const char *output = NULL;
+    const char *pyramid = NULL;
+    int levels = -1;
+    u32 threads = 0;
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        if (arg == "--help")
+        {
+            usage();
+            return 0;
+        }
+        if (i + 1 >= argc)
+        {
+            usage();
+            return 1;
+        }
+        string value = argv[++i];
+        auto parts = split(value, arg == "--extent" || arg == "--vertices" ? ',' : ':');
+        bool ok = true;
+        if (arg == "--seed")
+            continue;
+        else if (arg == "--extent" && parts.size() == 4)
+            gen.setExtent(atof(parts[0].c_str()), atof(parts[1].c_str()), atof(parts[2].c_str()), atof(parts[3].c_str()));
+        else if (arg == "--layer" && (parts.size() == 3 || parts.size() == 4))
+        {
+            int gt = lookup(parts[1].c_str(), geometry_names, 3);
+            int cf = parts.size() == 4 ? lookup(parts[3].c_str(), coord_names, 5) : 0;
+            ok = gt != -1 && cf != -1 &&
+                 gen.addLayer(parts[0].c_str(), geometry_types[gt], strtoul(parts[2].c_str(), NULL, 10), coord_formats[cf]) != -1;
+            layers.push_back(parts[0]);
+        }
+        else if (arg == "--vertices" && parts.size() >= 2 && parts.size() <= 4 && !layers.empty())
+        {
+            double step = parts.size() >= 3 ? atof(parts[2].c_str()) : 0.001;
+            bool log_uniform = parts.size() == 4 && parts[3] == "log";
+            gen.setVertices(atoi(parts[0].c_str()), atoi(parts[1].c_str()), step, log_uniform);
+        }
+        else if (arg == "--holes" && !layers.empty())
+            gen.setHoles(atoi(value.c_str()));
+        else if (arg == "--field" && (parts.size() == 2 || parts.size() == 3) && !layers.empty())
+        {
+            int ft = lookup(parts[1].c_str(), field_names, 10);
+            ok = ft != -1;
+            if (ok)
+            {
+                auto range = parts.size() == 3 ? split(parts[2], ',') : vector<string>();
+                double vmin = range.size() == 2 ? atof(range[0].c_str()) : 0;
+                double vmax = range.size() == 2 ? atof(range[1].c_str()) : 1.0;
+                u32 cardinality = range.size() == 1 ? strtoul(range[0].c_str(), NULL, 10) : 0;
+                ok = gen.addField(parts[0].c_str(), field_types[ft], vmin, vmax, cardinality) != -1;
+            }
+        }
+        else if (arg == "--ref" && parts.size() == 2 && !layers.empty())
+        {
+            int target = -1;
+            for (size_t k = 0; k < layers.size(); k++)
+            {
+                if (layers[k] == parts[1])
+                    target = (int)k;
+            }
+            ok = gen.addRefField(parts[0].c_str(), target) != -1;
+        }
+        else if (arg == "-o")
+            output = argv[i];
+        else if (arg == "--pyramid")
+            pyramid = argv[i];
+        else if (arg == "--levels")
+            levels = atoi(value.c_str());
+        else if (arg == "--threads")
+            threads = atoi(value.c_str());
+        else
+            ok = false;
+        if (!ok)
+        {
+            fprintf(stderr, "fastdb-gen: invalid %s %s\n", arg.c_str(), value.c_str());
+            usage();
+            return 1;
+        }
+    }
+    if (layers.empty() || (output == NULL) == (pyramid == NULL) || (pyramid && levels < 0))
+    {
+        usage();
+        return 1;
+    }
+    bool ok = output ? gen.save(output) : gen.savePyramid(pyramid, levels, threads);
+    return ok ? 0 : 1;
+}
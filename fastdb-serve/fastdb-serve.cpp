@@ -0,0 +1,746 @@
+#include "fastdb.h"
+#include "fastdb-serve.h"
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <cmath>
+#include <signal.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+using namespace std;
+using namespace wx;
+
+//fastdb-serve keeps databases mapped and indexed for many small bbox/attribute lookups,
+//so worker processes do not each pay the open cost and string table memory.
+
+static volatile sig_atomic_t g_stop = 0;
+static void on_signal(int)
+{
+    g_stop = 1;
+}
+
+//collects the bounding box of a feature geometry
+class BoxCollector : public GeometryReturn
+{
+public:
+    double minx, miny, maxx, maxy;
+    void reset()
+    {
+        minx = miny = HUGE_VAL;
+        maxx = maxy = -HUGE_VAL;
+    }
+    bool begin(const double aabox[4]) override
+    {
+        if (aabox)
+        {
+            //stored aabbox, no need to walk the parts
+            minx = aabox[0]; miny = aabox[1];
+            maxx = aabox[2]; maxy = aabox[3];
+            return false;
+        }
+        return true;
+    }
+    void returnGeomrtryPart(GeometryPartEnum, point2_t *points, int np) override
+    {
+        for (int i = 0; i < np; i++)
+        {
+            minx = min(minx, points[i].x); maxx = max(maxx, points[i].x);
+            miny = min(miny, points[i].y); maxy = max(maxy, points[i].y);
+        }
+    }
+    void end() override
+    {
+    }
+};
+
+//uniform grid over the feature boxes of one layer, cells are stored as CSR lists,
+//features covering too many cells are kept in a separate list scanned on every query.
+struct serve_layer_t
+{
+    FastVectorDbLayer*  layer;
+    string              name;
+    u32                 feature_count;
+    vector<FieldTypeEnum> field_types;
+    vector<string>      field_names;
+    bool                indexed;
+    double              minx, miny, maxx, maxy;
+    u32                 nx, ny;
+    double              cell_w, cell_h;
+    vector<double>      boxes;          //4 per feature
+    vector<u32>         cell_start;     //nx*ny+1
+    vector<u32>         cell_rows;
+    vector<u32>         large_rows;
+    vector<u32>         stamps;         //dedup of rows found in several cells
+    u32                 stamp;
+
+    inline void cell_range(double x0, double y0, double x1, double y1, u32 &cx0, u32 &cy0, u32 &cx1, u32 &cy1)
+    {
+        auto clampi = [](double v, u32 n) -> u32 {
+            if (!(v > 0)) return 0;
+            if (v >= n) return n - 1;
+            return (u32)v;
+        };
+        cx0 = clampi((x0 - minx) / cell_w, nx);
+        cx1 = clampi((x1 - minx) / cell_w, nx);
+        cy0 = clampi((y0 - miny) / cell_h, ny);
+        cy1 = clampi((y1 - miny) / cell_h, ny);
+    }
+};
+
+struct serve_database_t
+{
+    string                  name;
+    FastVectorDb*           db;
+    vector<serve_layer_t*>  layers;
+};
+
+static const u32 MAX_CELLS_PER_FEATURE = 64;
+static const size_t MAX_PENDING_OUTPUT = 64 << 20;
+
+static void build_index(serve_layer_t *sl)
+{
+    auto gt = sl->layer->getGeometryType();
+    sl->indexed = false;
+    if (gt != gtPoint && gt != gtLineString && gt != gtPolygon)
+        return;
+    u32 n = sl->feature_count;
+    sl->boxes.resize(n * 4);
+    BoxCollector box;
+    sl->minx = sl->miny = HUGE_VAL;
+    sl->maxx = sl->maxy = -HUGE_VAL;
+    sl->layer->rewind();
+    u32 ix = 0;
+    while (sl->layer->next() && ix < n)
+    {
+        box.reset();
+        sl->layer->fetchGeometry(&box);
+        double *b = &sl->boxes[ix * 4];
+        b[0] = box.minx; b[1] = box.miny; b[2] = box.maxx; b[3] = box.maxy;
+        if (box.minx <= box.maxx)
+        {
+            sl->minx = min(sl->minx, box.minx); sl->miny = min(sl->miny, box.miny);
+            sl->maxx = max(sl->maxx, box.maxx); sl->maxy = max(sl->maxy, box.maxy);
+        }
+        ix++;
+    }
+    if (!(sl->minx <= sl->maxx))
+    {
+        sl->minx = sl->miny = 0;
+        sl->maxx = sl->maxy = 1;
+    }
+    u32 side = (u32)sqrt((double)n / 4.0);
+    side = max(1u, min(side, 1024u));
+    sl->nx = sl->ny = side;
+    sl->cell_w = max((sl->maxx - sl->minx) / side, 1e-12);
+    sl->cell_h = max((sl->maxy - sl->miny) / side, 1e-12);
+
+    //two passes, count then fill
+    sl->cell_start.assign(side * side + 1, 0);
+    auto for_each_cell = [&](u32 i, bool fill) {
+        double *b = &sl->boxes[i * 4];
+        if (!(b[0] <= b[2]))
+            return;
+        u32 cx0, cy0, cx1, cy1;
+        sl->cell_range(b[0], b[1], b[2], b[3], cx0, cy0, cx1, cy1);
+        if ((cx1 - cx0 + 1) * (cy1 - cy0 + 1) > MAX_CELLS_PER_FEATURE)
+        {
+            if (fill)
+                sl->large_rows.push_back(i);
+            return;
+        }
+        for (u32 cy = cy0; cy <= cy1; cy++)
+            for (u32 cx = cx0; cx <= cx1; cx++)
+            {
+                if (fill)
+                    sl->cell_rows[sl->cell_start[cy * side + cx]++] = i;
+                else
+                    sl->cell_start[cy * side + cx + 1]++;
+            }
+    };
+    for (u32 i = 0; i < n; i++)
+        for_each_cell(i, false);
+    for (u32 c = 0; c < side * side; c++)
+        sl->cell_start[c + 1] += sl->cell_start[c];
+    sl->cell_rows.resize(sl->cell_start[side * side]);
+    for (u32 i = 0; i < n; i++)
+        for_each_cell(i, true);
+    //the fill pass advanced every start to the next cell start
+    for (u32 c = side * side; c > 0; c--)
+        sl->cell_start[c] = sl->cell_start[c - 1];
+    sl->cell_start[0] = 0;
+    sl->stamps.assign(n, 0);
+    sl->stamp = 0;
+    sl->indexed = true;
+}
+
+static serve_database_t *open_database(const char *name, const char *path)
+{
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+    {
+        printf("fastdb-serve can not open %s: %s\n", path, strerror(errno));
+        return NULL;
+    }
+    //mapped copy-on-write, pages come from the page cache shared with every other reader
+    FastVectorDb *db = FastVectorDb::load_fd(fd, false);
+    close(fd);
+    if (!db)
+    {
+        printf("fastdb-serve can not load %s\n", path);
+        return NULL;
+    }
+    auto sdb = new serve_database_t();
+    sdb->name = name;
+    sdb->db = db;
+    for (u32 i = 0; i < db->getLayerCount(); i++)
+    {
+        auto sl = new serve_layer_t();
+        sl->layer = db->getLayer(i);
+        sl->name = sl->layer->name();
+        sl->feature_count = sl->layer->getFeatureCount();
+        for (u32 f = 0; f < sl->layer->getFieldCount(); f++)
+        {
+            FieldTypeEnum ft;
+            double vmin, vmax;
+            sl->field_names.push_back(sl->layer->getFieldDefn(f, ft, vmin, vmax));
+            sl->field_types.push_back(ft);
+        }
+        build_index(sl);
+        printf("  layer[%s] features:%u %s\n", sl->name.c_str(), sl->feature_count,
+               sl->indexed ? "indexed" : "no geometry index");
+        sdb->layers.push_back(sl);
+    }
+    return sdb;
+}
+
+static void append(vector<u8> &out, const void *pdata, size_t size)
+{
+    out.insert(out.end(), (const u8 *)pdata, (const u8 *)pdata + size);
+}
+static void align(vector<u8> &out, size_t base, size_t a)
+{
+    while ((out.size() - base) % a)
+        out.push_back(0);
+}
+
+static void append_utf8(string &text, const uchar_t *ws)
+{
+    for (; ws && *ws; ws++)
+    {
+        u32 c = *ws;
+        if (c < 0x80)
+            text.push_back((char)c);
+        else if (c < 0x800)
+        {
+            text.push_back((char)(0xC0 | (c >> 6)));
+            text.push_back((char)(0x80 | (c & 0x3F)));
+        }
+        else
+        {
+            text.push_back((char)(0xE0 | (c >> 12)));
+            text.push_back((char)(0x80 | ((c >> 6) & 0x3F)));
+            text.push_back((char)(0x80 | (c & 0x3F)));
+        }
+    }
+}
+
+static bool is_numeric(FieldTypeEnum ft)
+{
+    return ft >= ftU8 && ft <= ftF64;
+}
+
+static bool pass_filter(double v, const serve_request_t &rq)
+{
+    switch (rq.filter_op)
+    {
+    case sfoEq: return v == rq.filter_value[0];
+    case sfoNe: return v != rq.filter_value[0];
+    case sfoLt: return v < rq.filter_value[0];
+    case sfoLe: return v <= rq.filter_value[0];
+    case sfoGt: return v > rq.filter_value[0];
+    case sfoGe: return v >= rq.filter_value[0];
+    case sfoBetween: return v >= rq.filter_value[0] && v <= rq.filter_value[1];
+    }
+    return false;
+}
+
+//text filters compare utf8 bytes, which orders like the code points
+static bool pass_filter(const char *v, size_t size, const string &text, const serve_request_t &rq)
+{
+    int c = memcmp(v, text.data(), min(size, text.size()));
+    if (c == 0)
+        c = size < text.size() ? -1 : size > text.size() ? 1 : 0;
+    switch (rq.filter_op)
+    {
+    case sfoEq: return c == 0;
+    case sfoNe: return c != 0;
+    case sfoLt: return c < 0;
+    case sfoLe: return c <= 0;
+    case sfoGt: return c > 0;
+    case sfoGe: return c >= 0;
+    }
+    return false;
+}
+
+class Server
+{
+public:
+    vector<serve_database_t *> databases;
+
+    serve_layer_t *find_layer(u32 db, u32 layer)
+    {
+        if (db >= databases.size() || layer >= databases[db]->layers.size())
+            return NULL;
+        return databases[db]->layers[layer];
+    }
+
+    void reply_header(vector<u8> &out, const serve_request_t &rq, int status, u32 rows, u32 columns, size_t &header_at)
+    {
+        serve_reply_t reply;
+        memset(&reply, 0, sizeof(reply));
+        reply.magic = SERVE_REPLY_MAGIC;
+        reply.id = rq.id;
+        reply.status = status;
+        reply.row_count = rows;
+        reply.column_count = columns;
+        reply.op = rq.op;
+        header_at = out.size();
+        append(out, &reply, sizeof(reply));
+    }
+    void reply_error(vector<u8> &out, const serve_request_t &rq, int status)
+    {
+        size_t at;
+        reply_header(out, rq, status, 0, 0, at);
+    }
+
+    void lookup(vector<u8> &out, const serve_request_t &rq, const u8 *payload)
+    {
+        string name((const char *)payload, rq.payload_size);
+        string dbname, lname = name;
+        auto slash = name.find('/');
+        if (slash != string::npos)
+        {
+            dbname = name.substr(0, slash);
+            lname = name.substr(slash + 1);
+        }
+        for (u32 d = 0; d < databases.size(); d++)
+        {
+            if (!dbname.empty() && databases[d]->name != dbname)
+                continue;
+            for (u32 l = 0; l < databases[d]->layers.size(); l++)
+            {
+                auto sl = databases[d]->layers[l];
+                if (sl->name != lname)
+                    continue;
+                size_t at;
+                reply_header(out, rq, ssOk, 0, 0, at);
+                size_t base = out.size();
+                u32 info[4] = {d, l, sl->feature_count, (u32)sl->field_names.size()};
+                append(out, info, sizeof(info));
+                for (size_t f = 0; f < sl->field_names.size(); f++)
+                {
+                    u32 fd[2] = {(u32)sl->field_types[f], (u32)sl->field_names[f].size()};
+                    append(out, fd, sizeof(fd));
+                    append(out, sl->field_names[f].data(), fd[1]);
+                    align(out, base, 4);
+                }
+                align(out, base, 8);
+                ((serve_reply_t *)(out.data() + at))->payload_size = out.size() - base;
+                return;
+            }
+        }
+        reply_error(out, rq, ssNoLayer);
+    }
+
+    void query(vector<u8> &out, const serve_request_t &rq, const u8 *payload)
+    {
+        auto sl = find_layer(rq.db, rq.layer);
+        if (!sl)
+            return reply_error(out, rq, ssNoLayer);
+        if ((rq.flags & sfBBox) && !sl->indexed)
+            return reply_error(out, rq, ssNoIndex);
+        //the filter text comes first: u32 size, utf8 bytes padded to 4
+        bool text_filter = (rq.flags & sfFilter) && (rq.flags & sfFilterText);
+        u32 skip = 0;
+        if (text_filter)
+        {
+            u32 text_size = rq.payload_size >= sizeof(u32) ? *(const u32 *)payload : 0;
+            skip = sizeof(u32) + ((text_size + 3) & ~3u);
+            if (rq.payload_size < sizeof(u32) || text_size > rq.payload_size - sizeof(u32) || skip > rq.payload_size ||
+                rq.filter_op == sfoBetween)
+                return reply_error(out, rq, ssBadRequest);
+            m_filter_text.assign((const char *)payload + sizeof(u32), text_size);
+        }
+        u32 nfield = (rq.payload_size - skip) / sizeof(u32);
+        const u32 *fields = (const u32 *)(payload + skip);
+        for (u32 i = 0; i < nfield; i++)
+        {
+            if (fields[i] >= sl->field_types.size() ||
+                !(is_numeric(sl->field_types[fields[i]]) || sl->field_types[fields[i]] == ftSTR || sl->field_types[fields[i]] == ftWSTR))
+                return reply_error(out, rq, ssNoField);
+        }
+        if (rq.flags & sfFilter)
+        {
+            if (rq.filter_field >= sl->field_types.size())
+                return reply_error(out, rq, ssNoField);
+            FieldTypeEnum ft = sl->field_types[rq.filter_field];
+            if (text_filter ? (ft != ftSTR && ft != ftWSTR) : !is_numeric(ft))
+                return reply_error(out, rq, ssNoField);
+        }
+
+        //candidate rows
+        vector<u32> &rows = m_rows;
+        rows.clear();
+        if (rq.flags & sfBBox)
+        {
+            const double *q = rq.bbox;
+            if (++sl->stamp == 0)
+            {
+                fill(sl->stamps.begin(), sl->stamps.end(), 0);
+                sl->stamp = 1;
+            }
+            auto test = [&](u32 r) {
+                if (sl->stamps[r] == sl->stamp)
+                    return;
+                sl->stamps[r] = sl->stamp;
+                const double *b = &sl->boxes[r * 4];
+                if (b[0] <= q[2] && b[2] >= q[0] && b[1] <= q[3] && b[3] >= q[1])
+                    rows.push_back(r);
+            };
+            if (q[0] <= sl->maxx && q[2] >= sl->minx && q[1] <= sl->maxy && q[3] >= sl->miny)
+            {
+                u32 cx0, cy0, cx1, cy1;
+                sl->cell_range(q[0], q[1], q[2], q[3], cx0, cy0, cx1, cy1);
+                for (u32 cy = cy0; cy <= cy1; cy++)
+                    for (u32 cx = cx0; cx <= cx1; cx++)
+                    {
+                        u32 c = cy * sl->nx + cx;
+                        for (u32 k = sl->cell_start[c]; k < sl->cell_start[c + 1]; k++)
+                            test(sl->cell_rows[k]);
+                    }
+            }
+            for (auto r : sl->large_rows)
+                test(r);
+            sort(rows.begin(), rows.end());
+        }
+        else
+        {
+            rows.resize(sl->feature_count);
+            for (u32 i = 0; i < sl->feature_count; i++)
+                rows[i] = i;
+        }
+        //rows are read through handles and bulk gathers, nothing is allocated per feature
+        if ((rq.flags & sfFilter) && !text_filter)
+        {
+            vector<double> &values = m_values;
+            values.resize(rows.size());
+            sl->layer->gatherFloat(&rq.filter_field, 1, rows.data(), (u32)rows.size(), values.data());
+            size_t k = 0;
+            for (size_t i = 0; i < rows.size(); i++)
+            {
+                if (pass_filter(values[i], rq))
+                    rows[k++] = rows[i];
+            }
+            rows.resize(k);
+        }
+        else if (text_filter)
+        {
+            u32 ix = rq.filter_field;
+            bool wide = sl->field_types[ix] == ftWSTR;
+            size_t k = 0;
+            for (auto r : rows)
+            {
+                auto feature = sl->layer->getFeatureHandle(r);
+                const char *v;
+                size_t size;
+                if (wide)
+                {
+                    m_text.clear();
+                    append_utf8(m_text, feature.getFieldAsWString(ix));
+                    v = m_text.data();
+                    size = m_text.size();
+                }
+                else
+                {
+                    v = feature.getFieldAsString(ix);
+                    if (!v)
+                        v = "";
+                    size = strlen(v);
+                }
+                if (pass_filter(v, size, m_filter_text, rq))
+                    rows[k++] = r;
+            }
+            rows.resize(k);
+        }
+        if (rq.max_rows && rows.size() > rq.max_rows)
+            rows.resize(rq.max_rows);
+
+        //row ids followed by the packed projected columns
+        u32 count = (u32)rows.size();
+        size_t at;
+        reply_header(out, rq, ssOk, count, nfield, at);
+        size_t base = out.size();
+        append(out, rows.data(), count * sizeof(u32));
+        align(out, base, 8);
+        for (u32 i = 0; i < nfield; i++)
+        {
+            u32 ix = fields[i];
+            FieldTypeEnum ft = sl->field_types[ix];
+            u32 column[2] = {is_numeric(ft) ? (u32)scF64 : (u32)scSTR, 0};
+            append(out, column, sizeof(column));
+            if (is_numeric(ft))
+            {
+                size_t start = out.size();
+                out.resize(start + count * sizeof(double));
+                sl->layer->gatherFloat(&ix, 1, rows.data(), count, (double *)(out.data() + start));
+            }
+            else
+            {
+                string &text = m_text;
+                text.clear();
+                vector<u32> &offsets = m_offsets;
+                offsets.resize(count + 1);
+                for (u32 r = 0; r < count; r++)
+                {
+                    offsets[r] = (u32)text.size();
+                    auto feature = sl->layer->getFeatureHandle(rows[r]);
+                    if (ft == ftSTR)
+                    {
+                        const char *s = feature.getFieldAsString(ix);
+                        if (s)
+                            text += s;
+                    }
+                    else
+                        append_utf8(text, feature.getFieldAsWString(ix));
+                }
+                offsets[count] = (u32)text.size();
+                append(out, offsets.data(), offsets.size() * sizeof(u32));
+                append(out, text.data(), text.size());
+            }
+            align(out, base, 8);
+        }
+        ((serve_reply_t *)(out.data() + at))->payload_size = out.size() - base;
+    }
+
+    //handles every complete request in the buffer, returns the number of bytes consumed or -1 on a protocol error
+    long handle(const u8 *pdata, size_t size, vector<u8> &out)
+    {
+        size_t used = 0;
+        while (size - used >= sizeof(serve_request_t))
+        {
+            serve_request_t rq;
+            memcpy(&rq, pdata + used, sizeof(rq));
+            if (rq.magic != SERVE_REQUEST_MAGIC || rq.payload_size > SERVE_MAX_PAYLOAD)
+                return -1;
+            if (size - used < sizeof(rq) + rq.payload_size)
+                break;
+            //payload copied so the u32/double reads are aligned
+            m_payload.assign(pdata + used + sizeof(rq), pdata + used + sizeof(rq) + rq.payload_size);
+            m_payload.resize(m_payload.size() + 4, 0);
+            if (rq.op == soLookup)
+                lookup(out, rq, m_payload.data());
+            else if (rq.op == soQuery)
+                query(out, rq, m_payload.data());
+            else
+                reply_error(out, rq, ssBadRequest);
+            used += sizeof(rq) + rq.payload_size;
+        }
+        return (long)used;
+    }
+
+private:
+    vector<u32> m_rows;
+    vector<double> m_values;
+    vector<u32> m_offsets;
+    string      m_text;
+    string      m_filter_text;
+    vector<u8>  m_payload;
+};
+
+struct connection_t
+{
+    int         fd;
+    vector<u8>  in;
+    vector<u8>  out;
+    size_t      out_sent;
+    bool        eof;        //the peer has shut down its side, pending replies are still flushed
+};
+
+static int listen_unix(const char *path)
+{
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path))
+    {
+        printf("socket path too long: %s\n", path);
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+    unlink(path);
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if (fd == -1 || bind(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1 || listen(fd, 64) == -1)
+    {
+        printf("can not listen on %s: %s\n", path, strerror(errno));
+        if (fd != -1)
+            close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int main(int argc, char **argv)
+{
+    printf("\n\
+****************************************************\n\
+            fastdb query server\n\
+****************************************************\n");
+    if (argc < 3)
+    {
+        printf("usage: fastdb-serve <socket path> <name=database file> [name=database file ...]\n");
+        return 1;
+    }
+    Server server;
+    for (int i = 2; i < argc; i++)
+    {
+        string arg = argv[i];
+        auto eq = arg.find('=');
+        string name = eq == string::npos ? arg : arg.substr(0, eq);
+        string path = eq == string::npos ? arg : arg.substr(eq + 1);
+        printf("database[%s] %s\n", name.c_str(), path.c_str());
+        auto sdb = open_database(name.c_str(), path.c_str());
+        if (!sdb)
+            return 1;
+        server.databases.push_back(sdb);
+    }
+    int lfd = listen_unix(argv[1]);
+    if (lfd == -1)
+        return 1;
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+    signal(SIGPIPE, SIG_IGN);
+    printf("listening on %s\n", argv[1]);
+    fflush(stdout);
+
+    vector<connection_t *> conns;
+    vector<struct pollfd> pfds;
+    vector<u8> chunk(64 * 1024);
+    while (!g_stop)
+    {
+        pfds.clear();
+        pfds.push_back({lfd, POLLIN, 0});
+        for (auto c : conns)
+        {
+            //keep reading while replies are pending so a client pipelining without reading can not deadlock,
+            //up to MAX_PENDING_OUTPUT bytes of unsent replies
+            short events = !c->eof && c->out.size() - c->out_sent < MAX_PENDING_OUTPUT ? POLLIN : 0;
+            if (c->out_sent < c->out.size())
+                events |= POLLOUT;
+            pfds.push_back({c->fd, events, 0});
+        }
+        int n = poll(pfds.data(), pfds.size(), 1000);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        if (pfds[0].revents & POLLIN)
+        {
+            int cfd;
+            while ((cfd = accept4(lfd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) != -1)
+            {
+                auto c = new connection_t();
+                c->fd = cfd;
+                c->out_sent = 0;
+                c->eof = false;
+                conns.push_back(c);
+            }
+        }
+        for (size_t i = 1; i < pfds.size(); i++)
+        {
+            auto c = conns[i - 1];
+            bool dead = (pfds[i].revents & (POLLERR | POLLNVAL)) != 0;
+            if (!dead && !c->eof && (pfds[i].revents & (POLLIN | POLLHUP)))
+            {
+                //drain what has arrived, all complete requests are answered as one batch
+                while (true)
+                {
+                    ssize_t r = recv(c->fd, chunk.data(), chunk.size(), 0);
+                    if (r > 0)
+                    {
+                        c->in.insert(c->in.end(), chunk.data(), chunk.data() + r);
+                        continue;
+                    }
+                    if (r == 0)
+                        c->eof = true;
+                    else if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+                        dead = true;
+                    if (r < 0 && errno == EINTR)
+                        continue;
+                    break;
+                }
+                long used = server.handle(c->in.data(), c->in.size(), c->out);
+                if (used < 0)
+                    dead = true;
+                else
+                    c->in.erase(c->in.begin(), c->in.begin() + used);
+            }
+            while (!dead && c->out_sent < c->out.size())
+            {
+                ssize_t w = send(c->fd, c->out.data() + c->out_sent, c->out.size() - c->out_sent, MSG_NOSIGNAL);
+                if (w > 0)
+                {
+                    c->out_sent += w;
+                    continue;
+                }
+                if (w < 0 && errno == EINTR)
+                    continue;
+                if (w < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+                    break;
+                dead = true;
+            }
+            if (c->out_sent == c->out.size())
+            {
+                c->out.clear();
+                c->out_sent = 0;
+                //half closed and every reply sent
+                if (c->eof)
+                    dead = true;
+            }
+            else if (c->out_sent > (1 << 20))
+            {
+                c->out.erase(c->out.begin(), c->out.begin() + c->out_sent);
+                c->out_sent = 0;
+            }
+            if (dead)
+            {
+                close(c->fd);
+                delete c;
+                conns[i - 1] = NULL;
+            }
+        }
+        conns.erase(remove(conns.begin(), conns.end(), (connection_t *)NULL), conns.end());
+    }
+    for (auto c : conns)
+    {
+        close(c->fd);
+        delete c;
+    }
+    close(lfd);
+    unlink(argv[1]);
+    for (auto sdb : server.databases)
+    {
+        for (auto sl : sdb->layers)
+            delete sl;
+        delete sdb->db;
+        delete sdb;
+    }
+    printf("fastdb-serve stopped\n");
+    return 0;
+}
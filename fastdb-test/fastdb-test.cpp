@@ -0,0 +1,146 @@
+#include "fastdb-test.h"
+#include <stdlib.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+struct test_case_t
+{
+    const char* name;
+    fnTestCase  fn;
+};
+
+static vector<test_case_t>& test_cases()
+{
+    static vector<test_case_t> cases;
+    return cases;
+}
+
+static string           g_temp_dir;
+static vector<string>   g_arguments;
+
+int register_test_case(const char* name, fnTestCase fn)
+{
+    test_cases().push_back({name, fn});
+    return (int)test_cases().size();
+}
+
+const char* test_argument(u32 ix)
+{
+    return ix < g_arguments.size() ? g_arguments[ix].c_str() : NULL;
+}
+
+string test_path(const string& name)
+{
+    return g_temp_dir + "/" + name;
+}
+
+bool save_test_tile(const string& path, u32 seed, double x, double y, u32 featureCount)
+{
+    FastVectorDbGen gen(seed);
+    gen.setExtent(x, y, x + 1, y + 1);
+    gen.addLayer("points", gtPoint, featureCount);
+    gen.addField("value", ftF64, 0, 100);
+    return gen.save(path.c_str());
+}
+
+bool read_file(const string& path, vector<u8>& data)
+{
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file)
+        return false;
+    fseek(file, 0, SEEK_END);
+    data.resize(ftell(file));
+    fseek(file, 0, SEEK_SET);
+    bool ok = fread(data.data(), 1, data.size(), file) == data.size();
+    fclose(file);
+    return ok;
+}
+
+bool write_file(const string& path, const u8* data, size_t size)
+{
+    FILE* file = fopen(path.c_str(), "wb");
+    if (!file)
+        return false;
+    bool ok = fwrite(data, 1, size, file) == size;
+    fclose(file);
+    return ok;
+}
+
+pid_t spawn_tool(const vector<string>& args)
+{
+    vector<char*> argv;
+    for (auto& arg : args)
+        argv.push_back((char*)arg.c_str());
+    argv.push_back(NULL);
+    fflush(stdout);
+    fflush(stderr);
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        int null_fd = open("/dev/null", O_WRONLY);
+        if (null_fd >= 0)
+            dup2(null_fd, STDOUT_FILENO);
+        execv(argv[0], argv.data());
+        _exit(127);
+    }
+    return pid;
+}
+
+int wait_tool(pid_t pid)
+{
+    int status = 0;
+    if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status))
+        return -1;
+    return WEXITSTATUS(status);
+}
+
+static int remove_entry(const char* path, const struct stat*, int, struct FTW*)
+{
+    return remove(path);
+}
+
+static bool run_case(const test_case_t& test)
+{
+    fprintf(stderr, "[ RUN  ] %s\n", test.name);
+    bool passed = test.fn();
+    fprintf(stderr, "[ %s ] %s\n", passed ? " OK " : "FAIL", test.name);
+    return passed;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc > 1 && strcmp(argv[1], "--list") == 0)
+    {
+        for (auto& test : test_cases())
+            printf("%s\n", test.name);
+        return 0;
+    }
+    for (int i = 2; i < argc; i++)
+        g_arguments.push_back(argv[i]);
+    char temp_dir[] = "/tmp/fastdb-test-XXXXXX";
+    if (!mkdtemp(temp_dir))
+    {
+        fprintf(stderr, "can't create a temporary directory\n");
+        return 1;
+    }
+    g_temp_dir = temp_dir;
+    int failed = 0, ran = 0;
+    for (auto& test : test_cases())
+    {
+        if (argc > 1 && strcmp(argv[1], test.name) != 0)
+            continue;
+        ran++;
+        if (!run_case(test))
+            failed++;
+    }
+    nftw(temp_dir, remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+    if (ran == 0)
+    {
+        fprintf(stderr, "no test case named %s\n", argv[1]);
+        return 1;
+    }
+    fprintf(stderr, "%d of %d cases passed\n", ran - failed, ran);
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,69 @@
+#pragma once
+#ifndef __FASTDB_TEST_H__
+#define __FASTDB_TEST_H__
+#include "fastdb.h"
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <sys/types.h>
+
+using namespace std;
+using namespace wx;
+
+//fastdb-test runs behaviour cases of the library, fastdb-test <case> [arguments] runs one of them,
+//no argument runs all. a case returns false on the first failed CHECK, the failure goes to stderr
+
+typedef bool (*fnTestCase)();
+
+int     register_test_case(const char* name, fnTestCase fn);
+//arguments after the case name, NULL past the last one or when every case runs
+const char* test_argument(u32 ix);
+//path of a file in the temporary directory of the run, removed when the run ends
+string  test_path(const string& name);
+//seeded point tiles of featureCount features over [x,x+1]x[y,y+1]
+bool    save_test_tile(const string& path, u32 seed, double x, double y, u32 featureCount = 64);
+bool    read_file(const string& path, vector<u8>& data);
+bool    write_file(const string& path, const u8* data, size_t size);
+//start a tool with its stdout sent to /dev/null, -1 when it can't be started
+pid_t   spawn_tool(const vector<string>& args);
+//exit code of a spawned tool, -1 when it was killed
+int     wait_tool(pid_t pid);
+
+class MemoryStream : public WriteStream
+{
+public:
+    vector<u8> data;
+    void write(void* pdata, size_t size) override
+    {
+        data.insert(data.end(), (const u8*)pdata, (const u8*)pdata + size);
+    }
+};
+
+inline FastVectorDb* load_image(MemoryStream& image)
+{
+    return FastVectorDb::load_xbuffer(image.data.data(), image.data.size());
+}
+
+inline bool same_image(FastVectorDb* db, const vector<u8>& image)
+{
+    chunk_data_t buffer = db->buffer();
+    return buffer.size == image.size() && memcmp(buffer.pdata, image.data(), image.size()) == 0;
+}
+
+#define TEST_CASE(name)                                                             \
+    static bool test_##name();                                                      \
+    static int  s_register_##name = register_test_case(#name, test_##name);         \
+    static bool test_##name()
+
+#define CHECK(cond)                                                                 \
+    do                                                                              \
+    {                                                                               \
+        if (!(cond))                                                                \
+        {                                                                           \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            return false;                                                           \
+        }                                                                           \
+    } while (0)
+
+#endif
@@ -0,0 +1,64 @@
+#include "fastdb-test.h"
+#include <atomic>
+#include <unistd.h>
+
+class CountingTileDb : public FastVectorTileDb
+{
+public:
+    CountingTileDb() : FastVectorTileDb(true, 2) {}
+    atomic<u32> calls{0};
+protected:
+    TileData* loadTileDataInternal(TileDataHandle* loading) override
+    {
+        calls++;
+        return FastVectorTileDb::loadTileDataInternal(loading);
+    }
+};
+
+//tiles read through io_uring are loaded through loadTileDataInternal and hold the bytes of their own file,
+//a tile whose read fails fails to load without a blocking load of its own
+TEST_CASE(async_io_loads)
+{
+    const u32 TILES = 100;
+    vector<string> paths;
+    for (u32 i = 0; i < TILES; i++)
+    {
+        paths.push_back(test_path("async" + to_string(i) + ".fdb"));
+        CHECK(save_test_tile(paths.back(), i + 1, i % 10, i / 10, 16 + i % 32));
+    }
+    CountingTileDb db;
+    if (!db.enableAsyncIO(16))
+    {
+        fprintf(stderr, "io_uring is unavailable, skipped\n");
+        return true;
+    }
+    for (u32 i = 0; i < TILES; i++)
+        db.registerTile(paths[i].c_str(), 0, 0, i % 10, i / 10, i % 10 + 1, i / 10 + 1);
+    db.registerTile(test_path("missing.fdb").c_str(), 0, 0, 10, 0, 11, 1);
+    bool loaded = false;
+    for (u32 round = 0; round < 10000 && !loaded; round++)
+    {
+        auto result = db.take(0, 0, 0, 11, 10);
+        CHECK(result && result->count == TILES + 1);
+        u32 resident = 0;
+        for (u32 i = 0; i < result->count; i++)
+        {
+            auto box = result->tiles[i];
+            FastVectorDb* data = box->handle->tileData;
+            if (!data)
+                continue;
+            u32 ix = (u32)box->miny * 10 + (u32)box->minx;
+            CHECK(ix < TILES);
+            CHECK(data->getLayer(0)->getFeatureCount() == 16 + ix % 32);
+            resident++;
+        }
+        db.freeResult(result);
+        loaded = resident == TILES && db.getCacheStats().loadFailures > 0;
+        if (!loaded)
+            usleep(1000);
+    }
+    CHECK(loaded);
+    CHECK(db.calls == TILES);
+    CHECK(db.getCacheStats().count == TILES);
+    return true;
+}
@@ -0,0 +1,124 @@
+#include "fastdb-test.h"
+#include <algorithm>
+#include <map>
+#include <tuple>
+
+typedef tuple<u32, u32, u32> back_link_t;     //layer, feature and field of the referencing feature
+
+//two layers referencing points and each other, expected holds the links by target as they are set
+static void build_links(MemoryStream& image, map<pair<u32, u32>, vector<back_link_t>>& expected)
+{
+    FastVectorDbBuild build;
+    build.enableBackLinks();
+    FastVectorDbLayerBuild* points = build.createLayerBegin("points");
+    points->setGeometryType(gtPoint, cfF64);
+    points->addField("value", ftU32);
+    for (u32 i = 0; i < 100; i++)
+    {
+        points->addFeatureBegin();
+        point2_t point = {double(i), double(i)};
+        points->setGeometry(&point, sizeof(point), ginPoint2);
+        points->setField(0, (int)i);
+        points->addFeatureEnd();
+    }
+    build.createLayerEnd();
+    FastVectorDbLayerBuild* triangles = build.createLayerBegin("triangles");
+    triangles->setGeometryType(gtPoint, cfF64);
+    triangles->addField("a", ftFeatureRef);
+    triangles->addField("b", ftFeatureRef);
+    triangles->addField("c", ftFeatureRef);
+    triangles->addField("parent", ftFeatureRef);
+    auto set_ref = [&](u32 ifeature, u32 ifield, FastVectorDbLayerBuild* layer, u32 ilayer, u32 target) {
+        FastVectorDbFeatureRef* ref = layer->createFeatureRef(target);
+        triangles->setField(ifield, ref);
+        expected[{ilayer, target}].push_back(back_link_t(1, ifeature, ifield));
+    };
+    for (u32 i = 0; i < 50; i++)
+    {
+        triangles->addFeatureBegin();
+        point2_t point = {0, 0};
+        triangles->setGeometry(&point, sizeof(point), ginPoint2);
+        set_ref(i, 0, points, 0, (i * 7) % 100);
+        set_ref(i, 1, points, 0, (i * 3) % 100);
+        if (i % 3)
+            set_ref(i, 2, points, 0, (i * 11) % 100);
+        if (i > 0)
+            set_ref(i, 3, triangles, 1, i / 2);
+        triangles->addFeatureEnd();
+    }
+    build.createLayerEnd();
+    build.post(&image);
+}
+
+//the back-links read from the image list every ref to a feature, ordered by layer, feature and field,
+//an image with damaged link offsets has none
+TEST_CASE(back_links)
+{
+    MemoryStream image;
+    map<pair<u32, u32>, vector<back_link_t>> expected;
+    build_links(image, expected);
+    for (auto& links : expected)
+        sort(links.second.begin(), links.second.end());
+    FastVectorDb* db = load_image(image);
+    CHECK(db);
+    u32 total = 0;
+    for (u32 ilayer = 0; ilayer < db->getLayerCount(); ilayer++)
+    {
+        FastVectorDbLayer* layer = db->getLayer(ilayer);
+        CHECK(layer->hasBackLinks());
+        for (u32 ifeature = 0; ifeature < layer->getFeatureCount(); ifeature++)
+        {
+            u32 count = 0;
+            const FastVectorDbBackLink* links = layer->getBackLinks(ifeature, count);
+            auto& expect = expected[{ilayer, ifeature}];
+            CHECK(count == expect.size());
+            for (u32 i = 0; i < count; i++)
+                CHECK(back_link_t(links[i].ilayer, links[i].ifeature, links[i].ifield) == expect[i]);
+            total += count;
+        }
+    }
+    CHECK(total == 50 * 2 + 33 + 49);
+    delete db;
+
+    //the offsets of the points follow their feature and link count: 100, links, 0 ... links
+    u32 links = total - 49;
+    size_t at = 0;
+    for (size_t i = 0; i + 8 + 101 * 4 <= image.data.size() && !at; i += 4)
+    {
+        u32 header[2], first, last;
+        memcpy(header, &image.data[i], 8);
+        memcpy(&first, &image.data[i + 8], 4);
+        memcpy(&last, &image.data[i + 8 + 100 * 4], 4);
+        if (header[0] == 100 && header[1] == links && first == 0 && last == links)
+            at = i + 8;
+    }
+    CHECK(at);
+    u32 count = 0;
+    vector<u8> damaged = image.data;
+    u32 value = links + 1000;
+    memcpy(&damaged[at + 50 * 4], &value, 4);
+    db = FastVectorDb::load_xbuffer(damaged.data(), damaged.size());
+    CHECK(db);
+    CHECK(!db->getLayer(0)->hasBackLinks());
+    CHECK(db->getLayer(0)->getBackLinks(0, count) == NULL);
+    delete db;
+
+    //an image built without back-links has none
+    FastVectorDbBuild plain;
+    plain.begin("");
+    plain.createLayerBegin("rows");
+    plain.setGeometryType(gtNone, cfF64);
+    plain.addField("value", ftF64);
+    plain.addFeatureBegin();
+    plain.setField(0, 1.0);
+    plain.addFeatureEnd();
+    plain.createLayerEnd();
+    MemoryStream without;
+    plain.post(&without);
+    db = load_image(without);
+    CHECK(db);
+    CHECK(!db->getLayer(0)->hasBackLinks());
+    CHECK(db->getLayer(0)->getBackLinks(0, count) == NULL);
+    delete db;
+    return true;
+}
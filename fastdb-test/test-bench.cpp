@@ -0,0 +1,47 @@
+#include "fastdb-test.h"
+
+static u32 count_of(const string& text, const string& what)
+{
+    u32 count = 0;
+    for (size_t at = text.find(what); at != string::npos; at = text.find(what, at + 1))
+        count++;
+    return count;
+}
+
+//a short fastdb-bench run writes every case group to the JSON report, a filter narrows it down and
+//bad options fail. the case needs the path of fastdb-bench as its argument
+TEST_CASE(bench_report)
+{
+    const char* bench = test_argument(0);
+    if (!bench)
+    {
+        fprintf(stderr, "no fastdb-bench path given, skipped\n");
+        return true;
+    }
+    string json = test_path("bench.json");
+    pid_t pid = spawn_tool({bench, "--features", "1000", "--min-time", "0.01", "--repetitions", "1", "--json", json});
+    CHECK(pid > 0);
+    CHECK(wait_tool(pid) == 0);
+    vector<u8> data;
+    CHECK(read_file(json, data));
+    string report(data.begin(), data.end());
+    CHECK(report.find("\"context\"") != string::npos);
+    CHECK(report.find("\"benchmarks\": [") != string::npos);
+    CHECK(report.size() > 4 && report.compare(report.size() - 4, 4, "]\n}\n") == 0);
+    for (const char* group : {"\"open/", "\"scan/", "\"geometry/", "\"field/", "\"random/", "\"build/", "\"tile/"})
+        CHECK(count_of(report, group) > 0);
+    CHECK(count_of(report, "\"name\"") == count_of(report, "\"items_per_second\""));
+
+    pid = spawn_tool({bench, "--filter", "scan/", "--features", "1000", "--min-time", "0.01", "--repetitions", "1", "--json", json});
+    CHECK(pid > 0);
+    CHECK(wait_tool(pid) == 0);
+    CHECK(read_file(json, data));
+    report.assign(data.begin(), data.end());
+    CHECK(count_of(report, "\"name\"") == count_of(report, "\"scan/"));
+    CHECK(count_of(report, "\"scan/") > 0);
+
+    pid = spawn_tool({bench, "--nope"});
+    CHECK(pid > 0);
+    CHECK(wait_tool(pid) == 1);
+    return true;
+}
@@ -0,0 +1,109 @@
+#include "fastdb-test.h"
+#include <unistd.h>
+
+class NoLoadTileDb : public FastVectorTileDb
+{
+protected:
+    TileData* loadTileDataInternal(TileDataHandle*) override
+    {
+        return NULL;
+    }
+};
+
+static void register_grid(FastVectorTileDb& db)
+{
+    char path[64];
+    for (u32 level = 0; level <= 4; level++)
+    {
+        int n = 1 << level;
+        double size = 16.0 / n;
+        for (int y = 0; y < n; y++)
+            for (int x = 0; x < n; x++)
+            {
+                snprintf(path, sizeof(path), "tiles/%u/%d/%d.fdb", level, x, y);
+                db.registerTile(path, level, level * 0.5, x * size, y * size, (x + 1) * size, (y + 1) * size);
+            }
+    }
+}
+
+static string take_paths(FastVectorTileDb& db, double x, double y, double w, double h)
+{
+    string paths;
+    auto result = db.take(4, x, y, x + w, y + h);
+    if (!result)
+        return paths;
+    for (u32 i = 0; i < result->count; i++)
+    {
+        auto box = result->tiles[i];
+        paths += box->handle->path;
+        paths += "@" + to_string(box->level) + ";";
+    }
+    db.freeResult(result);
+    return paths;
+}
+
+//a saved catalog opens to the same takes, damaged catalogs are refused or stay in bounds
+TEST_CASE(catalog_round_trip)
+{
+    string path = test_path("grid.fdbc");
+    NoLoadTileDb registered;
+    register_grid(registered);
+    CHECK(registered.saveCatalog(path.c_str()));
+    CHECK(access((path + ".tmp").c_str(), F_OK) != 0);
+    NoLoadTileDb opened;
+    CHECK(opened.openCatalog(path.c_str()));
+    for (int i = 0; i < 40; i++)
+    {
+        double x = (i * 37 % 160) / 10.0, y = (i * 53 % 160) / 10.0, w = 0.5 + i % 7;
+        string expect = take_paths(registered, x, y, w, w * 0.7);
+        CHECK(!expect.empty());
+        CHECK(take_paths(opened, x, y, w, w * 0.7) == expect);
+    }
+    NoLoadTileDb late;
+    late.registerTile("x.fdb", 0, 0, 0, 0, 1, 1);
+    CHECK(!late.openCatalog(path.c_str()));
+
+    vector<u8> image;
+    CHECK(read_file(path, image));
+    string damaged = test_path("damaged.fdbc");
+    CHECK(write_file(damaged, image.data(), image.size() / 2));
+    NoLoadTileDb truncated;
+    CHECK(!truncated.openCatalog(damaged.c_str()));
+    //a large value in every word of the catalog in turn
+    u32 refused = 0;
+    for (size_t at = 0; at + 4 <= image.size(); at += 4)
+    {
+        vector<u8> copy = image;
+        u32 value = 0xFFFFFF;
+        memcpy(&copy[at], &value, 4);
+        CHECK(write_file(damaged, copy.data(), copy.size()));
+        NoLoadTileDb db;
+        if (!db.openCatalog(damaged.c_str()))
+        {
+            refused++;
+            continue;
+        }
+        auto result = db.take(4, 0, 0, 16, 16);
+        if (result)
+        {
+            for (u32 i = 0; i < result->count; i++)
+                CHECK(result->tiles[i]->handle->path);
+        }
+        db.freeResult(result);
+    }
+    CHECK(refused > 0);
+    //sizes that wrap around behind their offsets: paths_offset and paths_size at 16 and 24,
+    //boxes_offset and boxes_size at 32 and 40
+    for (size_t at : {16, 32})
+    {
+        vector<u8> copy = image;
+        u64 offset, size;
+        memcpy(&offset, &copy[at], 8);
+        size = ~offset + 1;
+        memcpy(&copy[at + 8], &size, 8);
+        CHECK(write_file(damaged, copy.data(), copy.size()));
+        NoLoadTileDb db;
+        CHECK(!db.openCatalog(damaged.c_str()));
+    }
+    return true;
+}
@@ -0,0 +1,119 @@
+#include "fastdb-test.h"
+
+//lines of version v: every 7th line gets v more vertices, every 13th value and the names change with v
+static void build_lines(MemoryStream& image, int version, u32 count)
+{
+    FastVectorDbBuild build;
+    FastVectorDbLayerBuild* lines = build.createLayerBegin("lines");
+    lines->setGeometryType(gtLineString, cfF64);
+    lines->addField("value", ftF64);
+    lines->addField("name", ftSTR);
+    vector<point2_t> points;
+    for (u32 i = 0; i < count; i++)
+    {
+        lines->addFeatureBegin();
+        points.clear();
+        u32 np = 2 + (i % 7 == 0 ? version : 0);
+        for (u32 k = 0; k < np; k++)
+            points.push_back({double(i), double(k)});
+        lines->setGeometry(points.data(), points.size() * sizeof(point2_t), ginLineString);
+        lines->setField(0, double(i * (i % 13 == 0 ? version + 1 : 1)));
+        string name = "n" + to_string(i % 50 + version);
+        lines->setField(1, name.c_str());
+        lines->addFeatureEnd();
+    }
+    build.createLayerEnd();
+    build.post(&image);
+}
+
+//a patch turns the base into the target byte for byte, in place when the size stays, through
+//loadPatched when it changes. damaged patches are refused
+TEST_CASE(diff_patch)
+{
+    MemoryStream base;
+    build_lines(base, 0, 5000);
+    FastVectorDb* db = FastVectorDb::load_xbuffer(base.data.data(), base.data.size());
+    CHECK(db);
+
+    //same size: a copy of the base with a few rows changed
+    vector<u8> target_image = base.data;
+    FastVectorDb* target = FastVectorDb::load_xbuffer(target_image.data(), target_image.size());
+    CHECK(target);
+    for (u32 i : {10u, 11u, 2500u, 4999u})
+        target->getLayer(0)->getFeatureHandle(i).setField(0, 1000.0 + i);
+    MemoryStream signature, patch;
+    CHECK(db->signature(&signature));
+    CHECK(target->diff(signature.data.data(), signature.data.size(), &patch));
+    CHECK(patch.data.size() < base.data.size() / 10);
+    FastVectorDb* patched = FastVectorDb::loadPatched(db, patch.data.data(), patch.data.size());
+    CHECK(patched);
+    CHECK(same_image(patched, target_image));
+    delete patched;
+    CHECK(db->getLayer(0)->getFeatureHandle(10).getFieldAsFloat(0) == 10.0);
+    vector<u8> damaged = patch.data;
+    for (size_t i = damaged.size() - 64; i < damaged.size(); i++)
+        damaged[i] ^= 1;
+    CHECK(!db->applyPatch(damaged.data(), damaged.size()));
+    CHECK(same_image(db, base.data));
+    CHECK(db->applyPatch(patch.data.data(), patch.data.size()));
+    CHECK(same_image(db, target_image));
+    CHECK(db->getLayer(0)->getFeatureHandle(4999).getFieldAsFloat(0) == 5999.0);
+    delete target;
+
+    //the layer header follows the 16 byte magic and the u32 layer count, the 144 byte header is followed
+    //by the 56 byte field definitions: a new layer name is patched in place, a new field type changes
+    //the layout the layer was opened with and is only loaded from a patched copy
+    const size_t layer0 = 16 + sizeof(u32), fields0 = layer0 + 144;
+    vector<u8> renamed = target_image;
+    renamed[layer0 + 4] = 'z';
+    vector<u8> retyped = target_image;
+    CHECK(retyped[fields0 + 16] == ftF64);
+    retyped[fields0 + 16] = ftI32;
+    for (auto* edited : {&retyped, &renamed})
+    {
+        target = FastVectorDb::load_xbuffer(edited->data(), edited->size());
+        CHECK(target);
+        MemoryStream signature, patch;
+        CHECK(db->signature(&signature));
+        CHECK(target->diff(signature.data.data(), signature.data.size(), &patch));
+        delete target;
+        patched = FastVectorDb::loadPatched(db, patch.data.data(), patch.data.size());
+        CHECK(patched && same_image(patched, *edited));
+        delete patched;
+        bool applied = db->applyPatch(patch.data.data(), patch.data.size());
+        CHECK(applied == (edited == &renamed));
+        CHECK(same_image(db, applied ? *edited : target_image));
+    }
+    CHECK(strcmp(db->getLayer(0)->name(), "linez") == 0);
+    CHECK(db->getLayer(0)->getFeatureCount() == 5000);
+    delete db;
+
+    //resized: geometries and names of another version, more features
+    db = FastVectorDb::load_xbuffer(base.data.data(), base.data.size());
+    for (u32 count : {5000u, 5100u})
+    {
+        MemoryStream next;
+        build_lines(next, 3, count);
+        target = FastVectorDb::load_xbuffer(next.data.data(), next.data.size());
+        CHECK(target);
+        MemoryStream patch;
+        CHECK(FastVectorDb::diff(db, target, &patch));
+        CHECK(!db->applyPatch(patch.data.data(), patch.data.size()));
+        patched = FastVectorDb::loadPatched(db, patch.data.data(), patch.data.size());
+        CHECK(patched);
+        CHECK(same_image(patched, next.data));
+        CHECK(patched->getLayer(0)->getFeatureCount() == count);
+        CHECK(strcmp(patched->getLayer(0)->getFeatureHandle(49).getFieldAsString(1), "n52") == 0);
+        delete patched;
+        //a run longer than the padding of any chunk
+        for (size_t i = patch.data.size() / 2; i < patch.data.size() / 2 + 64; i++)
+            patch.data[i] ^= 1;
+        CHECK(FastVectorDb::loadPatched(db, patch.data.data(), patch.data.size()) == NULL);
+        patch.data.resize(patch.data.size() / 2);
+        CHECK(FastVectorDb::loadPatched(db, patch.data.data(), patch.data.size()) == NULL);
+        delete target;
+    }
+    CHECK(same_image(db, base.data));
+    delete db;
+    return true;
+}
@@ -0,0 +1,103 @@
+#include "fastdb-test.h"
+#include <functional>
+
+static const char* WATER_KINDS[] = {"river", "lake", "canal", "sea"};
+
+static void build_water(MemoryStream& image, u32 count)
+{
+    FastVectorDbBuild build;
+    FastVectorDbLayerBuild* water = build.createLayerBegin("water");
+    water->setGeometryType(gtPoint, cfF64);
+    water->addField("depth", ftF64);
+    water->addField("kind", ftSTR);
+    water->addField("level", ftU8n, -1, 1);
+    water->addField("k", ftI32);
+    water->addField("other", ftSTR);
+    water->addField("u", ftU16);
+    point2_t point = {0, 0};
+    u32 seed = 3;
+    for (u32 i = 0; i < count; i++)
+    {
+        water->addFeatureBegin();
+        water->setGeometry(&point, sizeof(point), ginPoint2);
+        seed = seed * 1103515245 + 12345;
+        water->setField(0, (seed >> 8) % 1000 / 10.0);
+        water->setField(1, WATER_KINDS[(seed >> 4) % 3]);
+        water->setField(2, ((seed >> 12) % 256) / 127.5 - 1);
+        water->setField(3, (int)((seed >> 16) % 200) - 100);
+        water->setField(4, WATER_KINDS[(seed >> 20) % 4]);
+        water->setField(5, (int)(i % 60000));
+        water->addFeatureEnd();
+    }
+    build.createLayerEnd();
+    build.post(&image);
+}
+
+typedef function<bool(const FastVectorDbFeatureHandle&)> row_predicate_t;
+
+static bool check_filter(FastVectorDbLayer* layer, const char* expr, row_predicate_t predicate)
+{
+    FastVectorDbSelection* selection = layer->filter(expr);
+    if (!selection)
+        fprintf(stderr, "refused: %s\n", expr);
+    CHECK(selection);
+    CHECK(selection->layer() == layer);
+    vector<u32> expect;
+    for (u32 i = 0; i < layer->getFeatureCount(); i++)
+        if (predicate(layer->getFeatureHandle(i)))
+            expect.push_back(i);
+    bool same = selection->getCount() == expect.size() && equal(expect.begin(), expect.end(), selection->rows());
+    delete selection;
+    if (!same)
+        fprintf(stderr, "wrong rows: %s\n", expr);
+    return same;
+}
+
+//filters select the rows a row by row evaluation selects, across batch boundaries, invalid ones are refused
+TEST_CASE(filter)
+{
+    MemoryStream image;
+    build_water(image, 20003);
+    FastVectorDb* db = FastVectorDb::load_xbuffer(image.data.data(), image.data.size());
+    CHECK(db);
+    FastVectorDbLayer* layer = db->getLayer(0);
+    auto text = [](const FastVectorDbFeatureHandle& f, u32 ix) { return string(f.getFieldAsString(ix)); };
+    CHECK(check_filter(layer, "depth > 10 and kind == 'river'", [&](const FastVectorDbFeatureHandle& f) {
+        return f.getFieldAsFloat(0) > 10 && text(f, 1) == "river";
+    }));
+    CHECK(check_filter(layer, "depth*2-1 >= 50 or not (k < 0)", [&](const FastVectorDbFeatureHandle& f) {
+        return f.getFieldAsFloat(0) * 2 - 1 >= 50 || !(f.getFieldAsInt(3) < 0);
+    }));
+    CHECK(check_filter(layer, "10 < depth && kind != \"lake\"", [&](const FastVectorDbFeatureHandle& f) {
+        return 10 < f.getFieldAsFloat(0) && text(f, 1) != "lake";
+    }));
+    CHECK(check_filter(layer, "kind == other", [&](const FastVectorDbFeatureHandle& f) {
+        return text(f, 1) == text(f, 4);
+    }));
+    CHECK(check_filter(layer, "kind = 'sea'", [&](const FastVectorDbFeatureHandle&) {
+        return false;
+    }));
+    CHECK(check_filter(layer, "other <> 'sea' AND level > 0.5", [&](const FastVectorDbFeatureHandle& f) {
+        return text(f, 4) != "sea" && f.getFieldAsFloat(2) > 0.5;
+    }));
+    CHECK(check_filter(layer, "-k > 50 or u / 2 == 7", [&](const FastVectorDbFeatureHandle& f) {
+        return -(double)f.getFieldAsInt(3) > 50 || f.getFieldAsInt(5) / 2.0 == 7;
+    }));
+    CHECK(check_filter(layer, "1 + 1 == 2", [&](const FastVectorDbFeatureHandle&) {
+        return true;
+    }));
+    CHECK(check_filter(layer, "!(depth <= 99.8) || false", [&](const FastVectorDbFeatureHandle& f) {
+        return !(f.getFieldAsFloat(0) <= 99.8);
+    }));
+    const char* invalid[] = {"", "depth >", "depth", "nope > 1", "kind > 'a'", "kind == 1", "depth > 1 and",
+                             "(depth > 1", "kind == 'x", "depth > 1 )", "depth + kind > 1", "and > 1"};
+    for (const char* expr : invalid)
+    {
+        FastVectorDbSelection* selection = layer->filter(expr);
+        if (selection)
+            fprintf(stderr, "accepted: %s\n", expr);
+        CHECK(selection == NULL);
+    }
+    delete db;
+    return true;
+}
@@ -0,0 +1,121 @@
+#include "fastdb-test.h"
+#include <math.h>
+
+static const u32 GATHER_STATIONS = 300;
+static const u32 GATHER_SAMPLES = 1000;
+
+//samples referencing stations, every 7th sample references an earlier sample instead
+static void build_samples(MemoryStream& image, vector<u32>& targets)
+{
+    FastVectorDbBuild build;
+    FastVectorDbLayerBuild* stations = build.createLayerBegin("stations");
+    stations->setGeometryType(gtPoint, cfF64);
+    stations->addField("kind", ftU8);
+    stations->addField("level", ftU16n, 0, 10);
+    stations->addField("temp", ftF32);
+    stations->addField("depth", ftF64);
+    stations->addField("id", ftI32);
+    for (u32 i = 0; i < GATHER_STATIONS; i++)
+    {
+        stations->addFeatureBegin();
+        point2_t point = {double(i), 0};
+        stations->setGeometry(&point, sizeof(point), ginPoint2);
+        stations->setField(0, int(i % 200));
+        stations->setField(1, (i % 11) * 1.0);
+        stations->setField(2, i * 0.25);
+        stations->setField(3, i * 1.5 - 100);
+        stations->setField(4, int(i) - 150);
+        stations->addFeatureEnd();
+    }
+    build.createLayerEnd();
+    FastVectorDbLayerBuild* samples = build.createLayerBegin("samples");
+    samples->setGeometryType(gtNone, cfF64);
+    samples->addField("value", ftF64);
+    samples->addField("station", ftFeatureRef);
+    for (u32 i = 0; i < GATHER_SAMPLES; i++)
+    {
+        samples->addFeatureBegin();
+        samples->setField(0, i * 1.0);
+        bool self = i % 7 == 0 && i > 0;
+        u32 target = self ? i / 2 : (i * 37) % GATHER_STATIONS;
+        FastVectorDbFeatureRef* ref = (self ? samples : stations)->createFeatureRef(target);
+        samples->setField(1, ref);
+        targets.push_back(self ? FASTDB_NO_ROW : target);
+        samples->addFeatureEnd();
+    }
+    build.createLayerEnd();
+    build.post(&image);
+}
+
+//refs resolve to the rows of their target layer, gather copies the raw values and gatherFloat converts
+//them as the field accessors do, rows past the end read as zeros / NaN
+TEST_CASE(gather_rows)
+{
+    MemoryStream image;
+    vector<u32> targets;
+    build_samples(image, targets);
+    FastVectorDb* db = load_image(image);
+    CHECK(db);
+    auto stations = db->getLayer(0), samples = db->getLayer(1);
+
+    vector<u32> rows(GATHER_SAMPLES + 10);
+    u32 resolved = samples->resolveRefs(1, 0, (u32)rows.size(), 0, rows.data());
+    u32 expect_resolved = 0;
+    for (u32 i = 0; i < GATHER_SAMPLES; i++)
+    {
+        CHECK(rows[i] == targets[i]);
+        expect_resolved += targets[i] != FASTDB_NO_ROW;
+    }
+    for (u32 i = GATHER_SAMPLES; i < rows.size(); i++)
+        CHECK(rows[i] == FASTDB_NO_ROW);
+    CHECK(resolved == expect_resolved);
+    CHECK(samples->resolveRefs(0, 0, 10, 0, rows.data()) == 0);
+    vector<u32> strided(GATHER_SAMPLES);
+    auto first = samples->getFeatureHandle(0).getFieldAsFeatureRef(1);
+    CHECK(FastVectorDb::resolveRefs(first, samples->getFeatureByteSize(), GATHER_SAMPLES, 0, strided.data()) == resolved);
+    CHECK(memcmp(strided.data(), rows.data(), GATHER_SAMPLES * sizeof(u32)) == 0);
+
+    rows.resize(GATHER_SAMPLES);
+    rows.push_back(GATHER_STATIONS);
+    u32 count = (u32)rows.size();
+    for (u32 ix = 0; ix < stations->getFieldCount(); ix++)
+    {
+        vector<u8> values(count * 8);
+        u32 size = stations->gather(ix, rows.data(), count, values.data());
+        CHECK(size > 0 && size <= 8);
+        u32 offset = (u32)stations->getFieldOffset(ix);
+        for (u32 i = 0; i < count; i++)
+        {
+            auto station = stations->getFeatureHandle(rows[i]);
+            if (station.valid())
+                CHECK(memcmp(&values[i * size], (const u8*)station.getAddress() + offset, size) == 0);
+            else
+                for (u32 k = 0; k < size; k++)
+                    CHECK(values[i * size + k] == 0);
+        }
+    }
+    CHECK(stations->gather(9, rows.data(), count, NULL) == 0);
+
+    u32 fields[] = {4, 0, 1, 2, 3};
+    vector<double> out(5 * count);
+    CHECK(stations->gatherFloat(fields, 5, rows.data(), count, out.data()));
+    for (u32 i = 0; i < count; i++)
+    {
+        auto station = stations->getFeatureHandle(rows[i]);
+        for (u32 k = 0; k < 5; k++)
+        {
+            double value = out[k * count + i];
+            if (!station.valid())
+                CHECK(isnan(value));
+            else if (k < 2)
+                CHECK(value == station.getFieldAsInt(fields[k]));
+            else
+                CHECK(value == station.getFieldAsFloat(fields[k]));
+        }
+    }
+    CHECK(out[0 * count + 5] == double(rows[5]) - 150);
+    fields[1] = 9;
+    CHECK(!stations->gatherFloat(fields, 2, rows.data(), count, out.data()));
+    delete db;
+    return true;
+}
@@ -0,0 +1,89 @@
+#include "fastdb-test.h"
+#include <algorithm>
+
+static void add_layers(FastVectorDbGen& gen)
+{
+    gen.setExtent(0, 0, 10, 10);
+    int points = gen.addLayer("points", gtPoint, 300);
+    gen.addField("depth", ftF64, 5, 50);
+    gen.addField("kind", ftSTR, 0, 0, 4);
+    gen.addLayer("lines", gtLineString, 100);
+    gen.setVertices(2, 40, 0.01, true);
+    gen.addField("id", ftI32, 0, 1000);
+    gen.addRefField("station", points);
+    gen.addLayer("areas", gtPolygon, 50);
+    gen.setVertices(5, 20, 0.01);
+    gen.setHoles(2);
+}
+
+//the same seed gives the same bytes, layers get the requested types, counts and ranges,
+//refs point into their target layer and a pyramid does not depend on the writer threads
+TEST_CASE(gen_seeded)
+{
+    MemoryStream first, second, other;
+    FastVectorDbGen a(7), b(7), c(8);
+    add_layers(a);
+    add_layers(b);
+    add_layers(c);
+    a.post(&first);
+    b.post(&second);
+    c.post(&other);
+    CHECK(!first.data.empty());
+    CHECK(first.data == second.data);
+    CHECK(first.data != other.data);
+
+    FastVectorDb* db = load_image(first);
+    CHECK(db);
+    CHECK(db->getLayerCount() == 3);
+    auto points = db->getLayer(0), lines = db->getLayer(1), areas = db->getLayer(2);
+    CHECK(strcmp(points->name(), "points") == 0 && points->getGeometryType() == gtPoint);
+    CHECK(lines->getGeometryType() == gtLineString && areas->getGeometryType() == gtPolygon);
+    CHECK(points->getFeatureCount() == 300 && lines->getFeatureCount() == 100 && areas->getFeatureCount() == 50);
+    CHECK(points->getFieldCount() == 2 && lines->getFieldCount() == 2 && areas->getFieldCount() == 0);
+    vector<string> kinds;
+    points->rewind();
+    while (points->next())
+    {
+        double depth = points->getFieldAsFloat(0);
+        CHECK(depth >= 5 && depth <= 50);
+        string kind = points->getFieldAsString(1);
+        if (find(kinds.begin(), kinds.end(), kind) == kinds.end())
+            kinds.push_back(kind);
+    }
+    CHECK(kinds.size() <= 4);
+    vector<u32> rows(lines->getFeatureCount());
+    CHECK(lines->resolveRefs(1, 0, (u32)rows.size(), 0, rows.data()) == rows.size());
+    for (u32 row : rows)
+        CHECK(row < points->getFeatureCount());
+    delete db;
+
+    string serial = test_path("pyramid1"), parallel = test_path("pyramid4");
+    FastVectorDbGen one(3), four(3);
+    for (auto gen : {&one, &four})
+    {
+        gen->setExtent(0, 0, 4, 4);
+        gen->addLayer("points", gtPoint, 20);
+        gen->addField("value", ftF64, 0, 1);
+    }
+    CHECK(one.savePyramid(serial.c_str(), 2, 1));
+    CHECK(four.savePyramid(parallel.c_str(), 2, 4));
+    u32 tiles = 0;
+    for (u32 level = 0; level <= 2; level++)
+        for (u32 x = 0; x < (1u << level); x++)
+            for (u32 y = 0; y < (1u << level); y++)
+            {
+                string tile = "/" + to_string(level) + "/" + to_string(x) + "/" + to_string(y) + ".fdb";
+                vector<u8> left, right;
+                CHECK(read_file(serial + tile, left));
+                CHECK(read_file(parallel + tile, right));
+                CHECK(!left.empty() && left == right);
+                tiles++;
+            }
+    CHECK(tiles == 21);
+    FastVectorTileDb catalog;
+    CHECK(catalog.openCatalog((parallel + "/catalog.fdbc").c_str()));
+    auto result = catalog.take(2, 0, 0, 4, 4);
+    CHECK(result && result->count > 0);
+    catalog.freeResult(result);
+    return true;
+}
@@ -0,0 +1,110 @@
+#include "fastdb-test.h"
+#include <atomic>
+#include <thread>
+
+class CountVertices : public GeometryReturn
+{
+public:
+    u32 vertices = 0;
+    bool begin(const double*) override { return true; }
+    void returnGeomrtryPart(GeometryPartEnum, point2_t*, int np) override { vertices += np; }
+    void end() override {}
+};
+
+struct expected_feature_t
+{
+    chunk_data_t    geometry;
+    u32             vertices;
+    double          depth;
+    int             id;
+};
+
+static void save_lines(MemoryStream& image)
+{
+    FastVectorDbGen gen(11);
+    gen.setExtent(0, 0, 10, 10);
+    gen.addLayer("stations", gtPoint, 100);
+    gen.addField("name", ftSTR, 0, 0, 10);
+    gen.addLayer("lines", gtLineString, 2000);
+    gen.setVertices(2, 50);
+    gen.addField("depth", ftF64, 0, 100);
+    gen.addField("id", ftI32, 0, 1000000);
+    gen.addRefField("station", 0);
+    gen.post(&image);
+}
+
+//handles read what a scan reads, refs to missing features give invalid handles that read nothing,
+//and threads reading handles of a fresh layer build its geometry map once without moving the scan
+TEST_CASE(feature_handles)
+{
+    MemoryStream image;
+    save_lines(image);
+    FastVectorDb* scan_db = load_image(image);
+    CHECK(scan_db);
+    auto scan = scan_db->getLayer(1);
+    vector<expected_feature_t> expect;
+    scan->rewind();
+    while (scan->next())
+    {
+        CountVertices count;
+        scan->fetchGeometry(&count);
+        expect.push_back({scan->getGeometryLikeChunk(), count.vertices, scan->getFieldAsFloat(0), scan->getFieldAsInt(1)});
+    }
+    CHECK(expect.size() == 2000);
+
+    FastVectorDb* db = load_image(image);
+    CHECK(db);
+    auto lines = db->getLayer(1);
+    lines->rewind();
+    for (int i = 0; i < 3; i++)
+        CHECK(lines->next());
+    u64 scanned = FastVectorDb::getStats().featuresScanned;
+    atomic<u32> bad{0};
+    vector<thread> threads;
+    for (u32 t = 0; t < 8; t++)
+    {
+        threads.emplace_back([&, t]() {
+            for (u32 i = t; i < expect.size(); i += 3)
+            {
+                auto handle = lines->getFeatureHandle(i);
+                CountVertices count;
+                handle.fetchGeometry(&count);
+                chunk_data_t chunk = handle.getGeometryLikeChunk();
+                auto& e = expect[i];
+                if (!handle.valid() || count.vertices != e.vertices || chunk.size != e.geometry.size ||
+                    chunk.pdata != e.geometry.pdata || handle.getFieldAsFloat(0) != e.depth || handle.getFieldAsInt(1) != e.id)
+                    bad++;
+            }
+        });
+    }
+    for (auto& thread : threads)
+        thread.join();
+    CHECK(bad == 0);
+    CHECK(FastVectorDb::getStats().featuresScanned == scanned);
+    CHECK(lines->row() == 2);
+    CHECK(lines->next() && lines->getFieldAsInt(1) == expect[3].id);
+    CHECK(lines->tryGetFeatureAt(7)->getFieldAsInt(1) == expect[7].id);
+
+    auto stations = db->getLayer(0);
+    auto station = db->getFeatureHandle(lines->getFeatureHandle(5).getFieldAsFeatureRef(2));
+    CHECK(station.valid() && station.layer() == stations && station.ifeature < 100);
+    CHECK(station.getFieldAsString(0) != NULL);
+
+    //a feature past the end of the stations and a missing ref
+    FastVectorDbFeatureHandle missing[] = {stations->getFeatureHandle(100), db->getFeatureHandle(NULL)};
+    for (auto& handle : missing)
+    {
+        CHECK(!handle.valid() && handle.layer() == NULL);
+        CountVertices count;
+        handle.fetchGeometry(&count);
+        CHECK(count.vertices == 0);
+        CHECK(handle.getGeometryLikeChunk().pdata == NULL);
+        CHECK(handle.getFieldAsFloat(0) == 0 && handle.getFieldAsInt(0) == 0);
+        CHECK(handle.getFieldAsString(0) == NULL && handle.getFieldAsWString(0) == NULL);
+        CHECK(handle.getFieldAsFeatureRef(0) == NULL && handle.getAddress() == NULL);
+        handle.setField(0, 1.0);
+    }
+    delete db;
+    delete scan_db;
+    return true;
+}
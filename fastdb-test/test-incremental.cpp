@@ -0,0 +1,104 @@
+#include "fastdb-test.h"
+#include <set>
+#include <random>
+
+static void register_pyramid(TileBoxTake& take, u32 maxLevel, int& id)
+{
+    for (u32 level = 0; level <= maxLevel; level++)
+    {
+        int n = 1 << level;
+        double size = 360.0 / n;
+        for (int y = 0; y < (n == 1 ? 1 : n / 2); y++)
+            for (int x = 0; x < n; x++)
+                take.registerTileBox(id++, level, 0, -180 + x * size, -90 + y * size, -180 + (x + 1) * size, -90 + (y + 1) * size, NULL);
+    }
+}
+
+class SomeTilesLoaded : public TileBoxTake::HandleTileAction
+{
+public:
+    bool isTileLoaded(const TileBoxTake::TileBox* box) override
+    {
+        return (box->id * 2654435761u >> 7) % 5 != 0;
+    }
+};
+
+//an incremental take over a moving, zooming and jumping viewport returns what a full take returns,
+//its entered and left boxes are the difference to the previous frame
+TEST_CASE(incremental_take)
+{
+    TileBoxTake take(32);
+    int id = 0;
+    register_pyramid(take, 7, id);
+    SomeTilesLoaded action;
+    TileBoxTake::TakeCursor* cursor = take.createCursor();
+    std::mt19937 rng(1);
+    set<int> previous;
+    double cx = 0, cy = 0, w = 20, h = 12;
+    for (int frame = 0; frame < 1200; frame++)
+    {
+        if (frame % 300 == 0)
+        {
+            cx = (int)(rng() % 300) - 150;
+            cy = (int)(rng() % 120) - 60;
+        }
+        cx += 0.05 + (rng() % 100) * 0.001;
+        cy += 0.02;
+        if (frame % 100 < 50)
+            w *= 1.004, h *= 1.004;
+        else
+            w /= 1.004, h /= 1.004;
+        if (frame == 500)
+            take.registerTileBox(id++, 7, 1, cx - 1, cy - 1, cx + 1, cy + 1, NULL);
+        double xmin = cx - w / 2, ymin = cy - h / 2, xmax = cx + w / 2, ymax = cy + h / 2;
+        auto full = take.take(7, xmin, ymin, xmax, ymax, &action);
+        auto incremental = take.takeIncremental(cursor, 7, xmin, ymin, xmax, ymax, &action);
+        CHECK(incremental);
+        u32 count = full ? full->count : 0;
+        CHECK(count == (incremental->result ? incremental->result->count : 0));
+        set<int> current;
+        for (u32 i = 0; i < count; i++)
+        {
+            CHECK(full->tiles[i]->id == incremental->result->tiles[i]->id);
+            current.insert(full->tiles[i]->id);
+        }
+        take.freeResult(full);
+        set<int> entered, left, expect_entered, expect_left;
+        for (u32 i = 0; i < incremental->enteredCount; i++)
+            entered.insert(incremental->entered[i]->id);
+        for (u32 i = 0; i < incremental->leftCount; i++)
+            left.insert(incremental->left[i]->id);
+        for (int box : current)
+            if (!previous.count(box))
+                expect_entered.insert(box);
+        for (int box : previous)
+            if (!current.count(box))
+                expect_left.insert(box);
+        CHECK(entered == expect_entered);
+        CHECK(left == expect_left);
+        previous = current;
+    }
+    CHECK(!previous.empty());
+    auto outside = take.takeIncremental(cursor, 7, 1000, 1000, 1001, 1001, &action);
+    CHECK(outside->result == NULL);
+    CHECK(outside->enteredCount == 0);
+    CHECK(outside->leftCount == previous.size());
+    take.freeCursor(cursor);
+
+    //the tiles of a tile database frame stay pinned until the next frame or freeCursor
+    string path = test_path("incremental.fdb");
+    CHECK(save_test_tile(path, 1, 0, 0));
+    FastVectorTileDb db(false);
+    for (int i = 0; i < 100; i++)
+        db.registerTile(path.c_str(), 0, 0, i % 10, i / 10, i % 10 + 1, i / 10 + 1);
+    FastVectorTileDb::TakeCursor* tiles = db.createCursor();
+    for (int frame = 0; frame < 20; frame++)
+    {
+        auto result = db.takeIncremental(tiles, 0, frame * 0.1, 0, frame * 0.1 + 3, 3);
+        CHECK(result && result->result);
+        CHECK(db.getCacheStats().pinned == result->result->count);
+    }
+    db.freeCursor(tiles);
+    CHECK(db.getCacheStats().pinned == 0);
+    return true;
+}
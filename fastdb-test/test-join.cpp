@@ -0,0 +1,108 @@
+#include "fastdb-test.h"
+#include <algorithm>
+#include <map>
+
+//stations with unique-ish ids and repeated names, observations referencing them with keys partly out of range
+static void build_stations(MemoryStream& image, u32 stations, u32 observations)
+{
+    FastVectorDbBuild build;
+    FastVectorDbLayerBuild* st = build.createLayerBegin("stations");
+    st->setGeometryType(gtPoint, cfF64);
+    st->addField("id", ftU32);
+    st->addField("name", ftSTR);
+    st->addField("height", ftF64);
+    point2_t point = {0, 0};
+    for (u32 i = 0; i < stations; i++)
+    {
+        st->addFeatureBegin();
+        st->setGeometry(&point, sizeof(point), ginPoint2);
+        st->setField(0, (int)((i * 7) % (stations + 100)));
+        string name = "s" + to_string((i * 13) % (stations / 2));
+        st->setField(1, name.c_str());
+        st->setField(2, i * 1.5);
+        st->addFeatureEnd();
+    }
+    build.createLayerEnd();
+    FastVectorDbLayerBuild* ob = build.createLayerBegin("observations");
+    ob->setGeometryType(gtPoint, cfF64);
+    ob->addField("station", ftI32);
+    ob->addField("name", ftSTR);
+    u32 seed = 7;
+    for (u32 i = 0; i < observations; i++)
+    {
+        ob->addFeatureBegin();
+        ob->setGeometry(&point, sizeof(point), ginPoint2);
+        seed = seed * 1103515245 + 12345;
+        ob->setField(0, (int)((seed >> 8) % (stations + 200)) - 50);
+        string name = "s" + to_string((seed >> 4) % stations);
+        ob->setField(1, name.c_str());
+        ob->addFeatureEnd();
+    }
+    build.createLayerEnd();
+    build.post(&image);
+}
+
+static string join_key(FastVectorDbLayer* layer, u32 row, u32 field, bool text)
+{
+    FastVectorDbFeatureHandle feature = layer->getFeatureHandle(row);
+    return text ? string(feature.getFieldAsString(field)) : to_string((long long)feature.getFieldAsInt(field));
+}
+
+//pairs of a nested loop join, ordered by left row then right row
+static bool check_join(FastVectorDbLayer* left, u32 leftField, FastVectorDbLayer* right, u32 rightField, bool text, u32 threads)
+{
+    FastVectorDbJoin join;
+    CHECK(join.join(left, leftField, right, rightField, threads));
+    multimap<string, u32> index;
+    for (u32 i = 0; i < right->getFeatureCount(); i++)
+        index.insert({join_key(right, i, rightField, text), i});
+    vector<pair<u32, u32>> expect;
+    for (u32 i = 0; i < left->getFeatureCount(); i++)
+    {
+        auto range = index.equal_range(join_key(left, i, leftField, text));
+        vector<u32> rows;
+        for (auto it = range.first; it != range.second; ++it)
+            rows.push_back(it->second);
+        sort(rows.begin(), rows.end());
+        for (u32 row : rows)
+            expect.push_back({i, row});
+    }
+    CHECK(!expect.empty());
+    CHECK(join.getCount() == expect.size());
+    for (u32 i = 0; i < join.getCount(); i++)
+    {
+        CHECK(join.leftRows()[i] == expect[i].first);
+        CHECK(join.rightRows()[i] == expect[i].second);
+    }
+    return true;
+}
+
+//integer and string joins from either side and with any thread count match a nested loop join
+TEST_CASE(join)
+{
+    MemoryStream image;
+    build_stations(image, 500, 40000);
+    FastVectorDb* db = FastVectorDb::load_xbuffer(image.data.data(), image.data.size());
+    CHECK(db);
+    FastVectorDbLayer* stations = db->getLayer(0);
+    FastVectorDbLayer* observations = db->getLayer(1);
+    CHECK(check_join(observations, 0, stations, 0, false, 0));
+    CHECK(check_join(stations, 0, observations, 0, false, 0));
+    CHECK(check_join(stations, 0, observations, 0, false, 1));
+    CHECK(check_join(observations, 1, stations, 1, true, 0));
+    CHECK(check_join(stations, 1, observations, 1, true, 3));
+    CHECK(check_join(stations, 1, stations, 1, true, 0));
+
+    FastVectorDbJoin join;
+    CHECK(!join.join(stations, 0, observations, 1));
+    CHECK(join.getCount() == 0);
+    CHECK(!join.join(stations, 9, observations, 0));
+    CHECK(join.join(observations, 0, stations, 0));
+    u32 field = 2;
+    vector<double> heights(join.getCount());
+    CHECK(join.gatherFloat(1, &field, 1, heights.data()));
+    for (u32 i = 0; i < join.getCount(); i++)
+        CHECK(heights[i] == stations->getFeatureHandle(join.rightRows()[i]).getFieldAsFloat(2));
+    delete db;
+    return true;
+}
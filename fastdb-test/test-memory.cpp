@@ -0,0 +1,84 @@
+#include "fastdb-test.h"
+
+static bool check_sums(const FastVectorDbMemory& report)
+{
+    CHECK(report.auxiliary == report.stringTables + report.geometryMap + report.cookieMap + report.featureCache + report.objects);
+    CHECK(report.total == report.resident + report.auxiliary);
+    return true;
+}
+
+//the image sections add up to the buffer, the layers' shares add up to the database, and the
+//maps built on first use show up once they are built
+TEST_CASE(memory_report)
+{
+    FastVectorDbGen gen(5);
+    gen.setExtent(0, 0, 10, 10);
+    gen.addLayer("points", gtPoint, 200);
+    gen.addField("name", ftSTR, 0, 0, 20);
+    gen.addLayer("lines", gtLineString, 100);
+    gen.setVertices(2, 30);
+    gen.addField("depth", ftF64);
+    MemoryStream image;
+    gen.post(&image);
+    FastVectorDb* db = load_image(image);
+    CHECK(db);
+
+    auto report = db->memoryReport();
+    CHECK(report.buffer == image.data.size());
+    CHECK(report.headers + report.geometry + report.attributes + report.strings + report.sections == report.buffer);
+    CHECK(report.geometry > 0 && report.attributes > 0 && report.strings > 0);
+    CHECK(report.resident <= report.buffer);
+    CHECK(report.stringTables > 0 && report.objects > 0);
+    CHECK(report.geometryMap == 0 && report.cookieMap == 0 && report.featureObjects == 0);
+    CHECK(check_sums(report));
+
+    auto lines = db->getLayer(1);
+    CHECK(lines->tryGetFeatureAt(50));
+    lines->rewind();
+    lines->next();
+    lines->setFeatureCookie(db);
+    auto grown = db->memoryReport();
+    CHECK(grown.geometryMap > 0 && grown.cookieMap > 0);
+    CHECK(grown.featureCache > report.featureCache && grown.featureObjects > 0);
+    CHECK(grown.buffer == report.buffer && grown.geometry == report.geometry);
+    CHECK(check_sums(grown));
+
+    FastVectorDbMemory layers;
+    memset(&layers, 0, sizeof(layers));
+    for (u32 i = 0; i < db->getLayerCount(); i++)
+    {
+        auto share = db->getLayer(i)->memoryReport();
+        CHECK(share.sections == 0);
+        CHECK(check_sums(share));
+        layers.geometry += share.geometry;
+        layers.attributes += share.attributes;
+        layers.strings += share.strings;
+        layers.geometryMap += share.geometryMap;
+        layers.cookieMap += share.cookieMap;
+        layers.objects += share.objects;
+    }
+    CHECK(layers.geometry == grown.geometry && layers.attributes == grown.attributes && layers.strings == grown.strings);
+    CHECK(layers.geometryMap == grown.geometryMap && layers.cookieMap == grown.cookieMap);
+    CHECK(layers.objects < grown.objects);
+    delete db;
+
+    string path = test_path("memory.fdb");
+    CHECK(save_test_tile(path, 1, 0, 0));
+    vector<u8> tile;
+    CHECK(read_file(path, tile));
+    FastVectorTileDb tiles;
+    tiles.registerTile(path.c_str(), 0, 0, 0, 0, 1, 1);
+    tiles.registerTile(path.c_str(), 0, 0, 1, 0, 2, 1);
+    auto empty = tiles.memoryReport();
+    CHECK(empty.residentTiles == 0 && empty.tiles.total == 0);
+    CHECK(empty.handles > 0 && empty.index > 0);
+    tiles.freeResult(tiles.take(0, 0, 0, 2, 1));
+    auto cache = tiles.memoryReport();
+    CHECK(cache.residentTiles == 2);
+    CHECK(cache.tiles.buffer == 2 * tile.size());
+    CHECK(cache.packs == 0 && cache.catalog == 0);
+    CHECK(cache.total == cache.tiles.total + cache.handles + cache.index + cache.queue);
+    tiles.shrink(0);
+    CHECK(tiles.memoryReport().residentTiles == 0);
+    return true;
+}
@@ -0,0 +1,103 @@
+#include "fastdb-test.h"
+#include <unistd.h>
+
+//tiles packed into one file load from the pack after their files are gone,
+//whether the pack is opened after or before the tiles are registered
+TEST_CASE(pack_round_trip)
+{
+    const u32 TILES = 8;
+    vector<string> paths;
+    for (u32 i = 0; i < TILES; i++)
+    {
+        paths.push_back(test_path("packed" + to_string(i) + ".fdb"));
+        CHECK(save_test_tile(paths.back(), i + 1, i, 0, 10 + i));
+    }
+    string pack = test_path("tiles.fdbp");
+    {
+        FastVectorTileDb db;
+        for (u32 i = 0; i < TILES; i++)
+            db.registerTile(paths[i].c_str(), 0, 0, i, 0, i + 1, 1);
+        CHECK(db.writePack(pack.c_str()));
+        CHECK(access((pack + ".tmp").c_str(), F_OK) != 0);
+    }
+    for (auto& path : paths)
+        unlink(path.c_str());
+    for (int before = 0; before < 2; before++)
+    {
+        FastVectorTileDb db(before != 0, 2);
+        if (before)
+            CHECK(db.openPack(pack.c_str()));
+        for (u32 i = 0; i < TILES; i++)
+            db.registerTile(paths[i].c_str(), 0, 0, i, 0, i + 1, 1);
+        if (!before)
+            CHECK(db.openPack(pack.c_str()));
+        u32 resident = 0;
+        for (u32 round = 0; round < 5000 && resident < TILES; round++)
+        {
+            auto result = db.take(0, 0, 0, TILES, 1);
+            CHECK(result && result->count == TILES);
+            resident = 0;
+            for (u32 i = 0; i < result->count; i++)
+            {
+                auto box = result->tiles[i];
+                FastVectorDb* data = box->handle->tileData;
+                if (!data)
+                    continue;
+                CHECK(data->getLayer(0)->getFeatureCount() == 10 + (u32)box->minx);
+                resident++;
+            }
+            db.freeResult(result);
+            if (resident < TILES)
+                usleep(1000);
+        }
+        CHECK(resident == TILES);
+        CHECK(db.getCacheStats().loadFailures == 0);
+    }
+    FastVectorTileDb garbage;
+    CHECK(!garbage.openPack(test_path("missing.fdbp").c_str()));
+    string image = test_path("image.fdb");
+    CHECK(save_test_tile(image, 1, 0, 0));
+    CHECK(!garbage.openPack(image.c_str()));
+    FastVectorTileDb missing;
+    missing.registerTile(paths[0].c_str(), 0, 0, 0, 0, 1, 1);
+    string partial = test_path("partial.fdbp");
+    CHECK(!missing.writePack(partial.c_str()));
+    CHECK(access(partial.c_str(), F_OK) != 0);
+    //a failed write leaves the pack it was meant to replace as it was
+    vector<u8> packed, kept;
+    CHECK(read_file(pack, packed));
+    CHECK(!missing.writePack(pack.c_str()));
+    CHECK(read_file(pack, kept) && kept == packed);
+    CHECK(access((pack + ".tmp").c_str(), F_OK) != 0);
+
+    //the header holds tile_count at 8, directory_offset, paths_offset and paths_size at 16, 24 and 32,
+    //entries are 24 bytes. forged: a paths_size and an entry size that wrap around behind their offsets,
+    //a tile count whose directory runs past the file
+    u64 directory, paths_offset;
+    memcpy(&directory, &packed[16], 8);
+    memcpy(&paths_offset, &packed[24], 8);
+    string forged = test_path("forged.fdbp");
+    for (int kind = 0; kind < 3; kind++)
+    {
+        vector<u8> copy = packed;
+        u64 offset = kind == 0 ? paths_offset : 0, size = 0;
+        if (kind == 1)
+            memcpy(&offset, &copy[directory], 8);
+        size = ~offset + 1;
+        if (kind == 0)
+            memcpy(&copy[32], &size, 8);
+        else if (kind == 1)
+            memcpy(&copy[directory + 8], &size, 8);
+        else
+        {
+            u32 count = 0x7FFFFFFF;
+            memcpy(&copy[8], &count, 4);
+            u64 wrapped = directory + sizeof(u64) * 3 * (u64)count;
+            memcpy(&copy[24], &wrapped, 8);
+        }
+        CHECK(write_file(forged, copy.data(), copy.size()));
+        FastVectorTileDb db;
+        CHECK(!db.openPack(forged.c_str()));
+    }
+    return true;
+}
@@ -0,0 +1,47 @@
+#include "fastdb-test.h"
+#include <unistd.h>
+
+static void register_strip(FastVectorTileDb& db, const string& path)
+{
+    for (u32 y = 0; y < 4; y++)
+        for (u32 x = 0; x < 60; x++)
+            db.registerTile(path.c_str(), 0, 0, x, y, x + 1, y + 1);
+}
+
+//a viewport panning at a steady speed gets the tiles ahead of it queued and later takes hit them,
+//a viewport that stops and a database without loader threads prefetch nothing
+TEST_CASE(prefetch_ahead)
+{
+    string path = test_path("prefetch.fdb");
+    CHECK(save_test_tile(path, 1, 0, 0));
+    FastVectorTileDb db(true, 2);
+    register_strip(db, path);
+    db.enablePrefetch(16, 4);
+    double x = 0;
+    for (int frame = 0; frame < 80; frame++, x += 0.5)
+    {
+        db.freeResult(db.take(0, x, 0, x + 3, 3));
+        usleep(5000);
+    }
+    auto stats = db.getCacheStats();
+    CHECK(stats.prefetchRequests > 0);
+    CHECK(stats.prefetchLoads > 0);
+    CHECK(stats.prefetchHits > 0);
+    CHECK(stats.loadFailures == 0);
+    //the estimated speed halves per take, the prediction falls under the threshold after a few takes
+    for (int frame = 0; frame < 6; frame++)
+        db.freeResult(db.take(0, x, 0, x + 3, 3));
+    u64 requests = db.getCacheStats().prefetchRequests;
+    for (int frame = 0; frame < 6; frame++)
+        db.freeResult(db.take(0, x, 0, x + 3, 3));
+    CHECK(db.getCacheStats().prefetchRequests == requests);
+
+    FastVectorTileDb single(false);
+    register_strip(single, path);
+    single.enablePrefetch(16, 4);
+    x = 0;
+    for (int frame = 0; frame < 20; frame++, x += 0.5)
+        single.freeResult(single.take(0, x, 0, x + 3, 3));
+    CHECK(single.getCacheStats().prefetchRequests == 0);
+    return true;
+}
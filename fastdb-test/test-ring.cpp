@@ -0,0 +1,155 @@
+#include "fastdb-test.h"
+#include <atomic>
+#include <thread>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+//the u64 header fields image_size, slot_size and slot_offset follow the magic and the slot count
+static bool open_forged(const string& name)
+{
+    int fd = shm_open(("/" + name).c_str(), O_RDWR, 0600);
+    CHECK(fd >= 0);
+    u64* sizes = (u64*)mmap(NULL, 64, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    CHECK(sizes != MAP_FAILED);
+    u64* image_size = sizes + 3;
+    u64* slot_size = sizes + 4;
+    u64* slot_offset = sizes + 5;
+    u64 saved[3] = {*image_size, *slot_size, *slot_offset};
+    bool refused = true;
+    u64 forged[][3] = {
+        {saved[0], u64(1) << 62, saved[2]},                 //slots past the mapping, wrapping when multiplied
+        {saved[1] + 1, saved[1], saved[2]},                 //images larger than their slots
+        {saved[0], saved[1], u64(0) - saved[1]},            //first image past the mapping
+        {saved[0], saved[1], 16},                           //images over the slot table
+    };
+    for (auto& header : forged)
+    {
+        *image_size = header[0];
+        *slot_size = header[1];
+        *slot_offset = header[2];
+        FastVectorDbRing* reader = FastVectorDbRing::open(name.c_str());
+        refused = refused && reader == NULL;
+        delete reader;
+    }
+    *image_size = saved[0];
+    *slot_size = saved[1];
+    *slot_offset = saved[2];
+    munmap(sizes, 64);
+    CHECK(refused);
+    FastVectorDbRing* reader = FastVectorDbRing::open(name.c_str());
+    CHECK(reader);
+    delete reader;
+    return true;
+}
+
+//steps written many times round a ring of three slots are read whole and in order,
+//headers pointing outside the segment are refused
+TEST_CASE(ring_wrap_around)
+{
+    const u64 STEPS = 600;
+    MemoryStream image;
+    {
+        FastVectorDbBuild build;
+        build.begin("");
+        build.createLayerBegin("rows");
+        build.setGeometryType(gtNone, cfF64);
+        build.addField("step", ftF64);
+        build.addField("twice", ftF64);
+        for (u32 i = 0; i < 2000; i++)
+        {
+            build.addFeatureBegin();
+            build.addFeatureEnd();
+        }
+        build.createLayerEnd();
+        build.post(&image);
+    }
+    FastVectorDb* layout = load_image(image);
+    CHECK(layout);
+    string name = "fastdb-test-ring-" + to_string(getpid());
+    FastVectorDbRing::unlink(name.c_str());
+    FastVectorDbRing* ring = FastVectorDbRing::create(name.c_str(), layout, 3);
+    delete layout;
+    CHECK(ring);
+    CHECK(ring->getSlotCount() == 3);
+    atomic<u64> bad{0}, reads{0};
+    vector<thread> readers;
+    for (u32 t = 0; t < 2; t++)
+    {
+        readers.emplace_back([&]() {
+            FastVectorDbRing* reader = FastVectorDbRing::open(name.c_str());
+            if (!reader)
+            {
+                bad++;
+                return;
+            }
+            u64 step = 0;
+            while (step < STEPS)
+            {
+                reader->waitStep(step, 1000);
+                u64 seen = 0;
+                FastVectorDb* db = reader->beginRead(&seen);
+                if (!db)
+                    continue;
+                if (seen < step)
+                    bad++;
+                FastVectorDbLayer* layer = db->getLayer(0);
+                for (u32 i = 0; i < layer->getFeatureCount(); i += 37)
+                {
+                    FastVectorDbFeatureHandle feature = layer->getFeatureHandle(i);
+                    if (feature.getFieldAsFloat(0) != (double)seen || feature.getFieldAsFloat(1) != 2.0 * seen)
+                        bad++;
+                }
+                reader->endRead(db);
+                reads++;
+                step = seen;
+            }
+            delete reader;
+        });
+    }
+    for (u64 k = 1; k <= STEPS; k++)
+    {
+        FastVectorDb* db = ring->beginWrite(false, -1);
+        CHECK(db);
+        FastVectorDbLayer* layer = db->getLayer(0);
+        for (u32 i = 0; i < layer->getFeatureCount(); i++)
+        {
+            FastVectorDbFeatureHandle feature = layer->getFeatureHandle(i);
+            feature.setField(0, (double)k);
+            feature.setField(1, 2.0 * k);
+        }
+        CHECK(ring->endWrite(db) == k);
+    }
+    for (auto& reader : readers)
+        reader.join();
+    CHECK(bad == 0);
+    CHECK(reads > 0);
+    CHECK(ring->getLatestStep() == STEPS);
+    delete ring;
+
+    //two slots: the writer can't take the slot a reader holds
+    FastVectorDbRing::unlink(name.c_str());
+    layout = load_image(image);
+    ring = FastVectorDbRing::create(name.c_str(), layout, 2);
+    delete layout;
+    CHECK(ring);
+    CHECK(open_forged(name));
+    FastVectorDb* slot = ring->beginWrite();
+    CHECK(slot);
+    CHECK(ring->endWrite(slot) == 1);
+    FastVectorDb* held = ring->beginRead();
+    CHECK(held);
+    slot = ring->beginWrite();
+    CHECK(slot);
+    CHECK(ring->endWrite(slot) == 2);
+    CHECK(ring->beginWrite(false, 0) == NULL);
+    ring->endRead(held);
+    slot = ring->beginWrite(false, 0);
+    CHECK(slot);
+    ring->abortWrite(slot);
+    CHECK(ring->getLatestStep() == 2);
+    delete ring;
+    CHECK(FastVectorDbRing::unlink(name.c_str()));
+    return true;
+}
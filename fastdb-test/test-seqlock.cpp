@@ -0,0 +1,83 @@
+#include "fastdb-test.h"
+#include <atomic>
+#include <thread>
+
+//readers never see a row of two fields written as (k,-k) half updated
+TEST_CASE(seqlock_readers)
+{
+    const u32 FEATURES = 1000, WRITES = 100000;
+    MemoryStream image;
+    {
+        FastVectorDbBuild build;
+        build.begin("");
+        build.createLayerBegin("rows");
+        build.setGeometryType(gtNone, cfF64);
+        build.enableSeqlock(16);
+        build.addField("a", ftF64);
+        build.addField("b", ftF64);
+        for (u32 i = 0; i < FEATURES; i++)
+        {
+            build.addFeatureBegin();
+            build.setField(0, (double)i);
+            build.setField(1, -(double)i);
+            build.addFeatureEnd();
+        }
+        build.createLayerEnd();
+        build.post(&image);
+    }
+    FastVectorDb* db = load_image(image);
+    CHECK(db);
+    FastVectorDbLayer* layer = db->getLayer(0);
+    CHECK(layer->hasSeqlock());
+    CHECK(layer->getSeqlockChunkRows() == 16);
+    u64 version = layer->getVersion();
+    size_t a = layer->getFieldOffset(0), b = layer->getFieldOffset(1);
+    atomic<bool> stop{false};
+    atomic<u64> torn{0}, failed{0}, reads{0};
+    vector<thread> readers;
+    for (u32 t = 0; t < 3; t++)
+    {
+        readers.emplace_back([&, t]() {
+            vector<u8> row(layer->getFeatureByteSize());
+            u32 ifeature = 5 + t * 17;
+            while (!stop.load(memory_order_relaxed))
+            {
+                if (!layer->readFeature(ifeature, row.data()))
+                    failed++;
+                double va, vb;
+                memcpy(&va, &row[a], sizeof(va));
+                memcpy(&vb, &row[b], sizeof(vb));
+                if (va != -vb)
+                    torn++;
+                reads++;
+            }
+        });
+    }
+    for (u32 k = 0; k < WRITES; k++)
+    {
+        u32 ifeature = 5 + (k % 3) * 17;
+        FastVectorDbFeatureHandle feature = layer->getFeatureHandle(ifeature);
+        layer->beginUpdate(ifeature);
+        feature.setField(0, (double)k);
+        feature.setField(1, -(double)k);
+        layer->endUpdate(ifeature);
+    }
+    stop = true;
+    for (auto& reader : readers)
+        reader.join();
+    CHECK(reads > 0);
+    CHECK(failed == 0);
+    CHECK(torn == 0);
+    CHECK(layer->getVersion() > version);
+    //only the chunks of the written rows changed
+    u32 chunks[8];
+    u32 count = layer->changedSince(version, chunks, 8);
+    CHECK(count == 3);
+    CHECK(chunks[0] == 0 && chunks[1] == 1 && chunks[2] == 2);
+    version = layer->getVersion();
+    layer->updateField(FEATURES - 1, 0, 3.0);
+    CHECK(layer->changedSince(version, chunks, 8) == 1);
+    CHECK(chunks[0] == (FEATURES - 1) / 16);
+    delete db;
+    return true;
+}
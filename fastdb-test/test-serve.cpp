@@ -0,0 +1,185 @@
+#include "fastdb-test.h"
+#include "fastdb-serve.h"
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+static const u32 SERVE_FEATURES = 2000;
+static const char* SERVE_NAMES[] = {"alpha", "beta", "gamma"};
+
+//points on a 100 x 20 grid with a number, a depth and a name
+static bool save_grid(const string& path)
+{
+    FastVectorDbBuild build;
+    build.begin("");
+    build.createLayerBegin("grid");
+    build.setGeometryType(gtPoint, cfF64);
+    build.addField("id", ftI32);
+    build.addField("depth", ftF64);
+    build.addField("name", ftSTR);
+    for (u32 i = 0; i < SERVE_FEATURES; i++)
+    {
+        build.addFeatureBegin();
+        point2_t point = {double(i % 100), double(i / 100)};
+        build.setGeometry(&point, sizeof(point), ginPoint2);
+        build.setField(0, (int)i);
+        build.setField(1, (i * 37 % 100) * 1.0);
+        build.setField(2, SERVE_NAMES[i % 3]);
+        build.addFeatureEnd();
+    }
+    build.createLayerEnd();
+    build.save(path.c_str());
+    return access(path.c_str(), R_OK) == 0;
+}
+
+static bool check_rows(const FastVectorDbClient::QueryResult* result, const vector<u32>& expect)
+{
+    CHECK(result);
+    CHECK(result->status == ssOk);
+    CHECK(result->count == expect.size());
+    for (u32 i = 0; i < result->count; i++)
+        CHECK(result->rows[i] == expect[i]);
+    return true;
+}
+
+//bbox, numeric and text filters, projections, row limits and pipelined requests of a running fastdb-serve
+//match a scan of the same database. the case needs the path of fastdb-serve as its argument
+TEST_CASE(serve_queries)
+{
+    const char* serve = test_argument(0);
+    if (!serve)
+    {
+        fprintf(stderr, "no fastdb-serve path given, skipped\n");
+        return true;
+    }
+    string path = test_path("grid.fdb"), socket_path = test_path("serve.sock");
+    CHECK(save_grid(path));
+    pid_t pid = spawn_tool({serve, socket_path, "w=" + path});
+    CHECK(pid > 0);
+    FastVectorDbClient* client = NULL;
+    for (int i = 0; i < 500 && !client; i++)
+    {
+        client = FastVectorDbClient::connect(socket_path.c_str());
+        if (!client)
+            usleep(10000);
+    }
+    bool passed = false;
+    if (client)
+    {
+        passed = [&]() {
+            u32 db, layer;
+            CHECK(client->lookup("w/grid", db, layer));
+            CHECK(!client->lookup("w/nope", db, layer));
+            CHECK(client->getFieldIndex(db, layer, "depth") == 1);
+            CHECK(client->getFieldIndex(db, layer, "nope") < 0);
+
+            u32 fields[] = {1, 2};
+            auto query = FastVectorDbClient::Query::make(db, layer);
+            query.bbox(9.5, 4.5, 20.5, 8.5).filter(1, sfoGt, 50).project(fields, 2);
+            vector<u32> expect;
+            for (u32 i = 0; i < SERVE_FEATURES; i++)
+            {
+                double x = i % 100, y = i / 100;
+                if (x >= 9.5 && x <= 20.5 && y >= 4.5 && y <= 8.5 && i * 37 % 100 > 50)
+                    expect.push_back(i);
+            }
+            auto result = client->query(query);
+            CHECK(check_rows(result, expect));
+            CHECK(result->columnCount == 2);
+            CHECK(result->columns[0].type == scF64 && result->columns[1].type == scSTR);
+            for (u32 i = 0; i < result->count; i++)
+            {
+                u32 row = result->rows[i];
+                CHECK(result->columns[0].values[i] == (row * 37 % 100) * 1.0);
+                const char* name = result->columns[1].text + result->columns[1].offsets[i];
+                u32 size = result->columns[1].offsets[i + 1] - result->columns[1].offsets[i];
+                CHECK(string(name, size) == SERVE_NAMES[row % 3]);
+            }
+            client->freeResult(result);
+
+            //pipelined: a text filter, a limited scan and a bad field come back in request order
+            auto text = FastVectorDbClient::Query::make(db, layer);
+            text.filter(2, sfoEq, "beta");
+            auto limited = FastVectorDbClient::Query::make(db, layer);
+            limited.maxRows = 7;
+            auto bad = FastVectorDbClient::Query::make(db, layer);
+            bad.filter(9, sfoEq, 1.0);
+            u32 ids[3] = {client->send(text), client->send(limited), client->send(bad)};
+            CHECK(ids[0] && ids[1] && ids[2]);
+            expect.clear();
+            for (u32 i = 1; i < SERVE_FEATURES; i += 3)
+                expect.push_back(i);
+            result = client->receive();
+            CHECK(result && result->id == ids[0]);
+            CHECK(check_rows(result, expect));
+            client->freeResult(result);
+            expect = {0, 1, 2, 3, 4, 5, 6};
+            result = client->receive();
+            CHECK(result && result->id == ids[1]);
+            CHECK(check_rows(result, expect));
+            client->freeResult(result);
+            result = client->receive();
+            CHECK(result && result->id == ids[2]);
+            CHECK(result->status == ssNoField);
+            client->freeResult(result);
+            return true;
+        }();
+        delete client;
+    }
+    kill(pid, SIGTERM);
+    CHECK(wait_tool(pid) == 0);
+    CHECK(client);
+    CHECK(access(socket_path.c_str(), F_OK) != 0);
+    return passed;
+}
+
+//a reply whose columns run past its payload is dropped, one announcing more than SERVE_MAX_REPLY
+//bytes closes the connection instead of being allocated
+TEST_CASE(serve_forged_reply)
+{
+    string socket_path = test_path("forged.sock");
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    CHECK(listener >= 0);
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, socket_path.c_str(), sizeof(addr.sun_path) - 1);
+    CHECK(bind(listener, (sockaddr*)&addr, sizeof(addr)) == 0 && listen(listener, 1) == 0);
+    FastVectorDbClient* client = FastVectorDbClient::connect(socket_path.c_str());
+    int server = accept(listener, NULL, NULL);
+    close(listener);
+    CHECK(client && server >= 0);
+    bool passed = [&]() {
+        auto query = FastVectorDbClient::Query::make(0, 0);
+        u32 id = client->send(query);
+        CHECK(id);
+        serve_request_t request;
+        CHECK(recv(server, &request, sizeof(request), MSG_WAITALL) == sizeof(request));
+        serve_reply_t reply;
+        memset(&reply, 0, sizeof(reply));
+        reply.magic = SERVE_REPLY_MAGIC;
+        reply.id = id;
+        reply.op = soQuery;
+        reply.row_count = 1000;
+        reply.column_count = 1;
+        reply.payload_size = 16;
+        u8 payload[16] = {0};
+        CHECK(write(server, &reply, sizeof(reply)) == sizeof(reply));
+        CHECK(write(server, payload, sizeof(payload)) == sizeof(payload));
+        CHECK(client->receive() == NULL);
+
+        id = client->send(query);
+        CHECK(id);
+        CHECK(recv(server, &request, sizeof(request), MSG_WAITALL) == sizeof(request));
+        reply.id = id;
+        reply.payload_size = SERVE_MAX_REPLY + 1;
+        CHECK(write(server, &reply, sizeof(reply)) == sizeof(reply));
+        CHECK(client->receive() == NULL);
+        CHECK(client->send(query) == 0);
+        return true;
+    }();
+    delete client;
+    close(server);
+    return passed;
+}
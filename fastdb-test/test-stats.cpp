@@ -0,0 +1,89 @@
+#include "fastdb-test.h"
+
+class CountGeometry : public GeometryReturn
+{
+public:
+    u32 parts = 0;
+    bool begin(const double*) override { return true; }
+    void returnGeomrtryPart(GeometryPartEnum, point2_t*, int) override { parts++; }
+    void end() override {}
+};
+
+//the counters of builds, loads, scans, geometry fetches and tile takes count what was done since resetStats
+TEST_CASE(stats_counters)
+{
+    FastVectorDb::resetStats();
+    FastVectorDbStats stats = FastVectorDb::getStats();
+    CHECK(stats.dbLoads == 0 && stats.featuresScanned == 0 && stats.featuresBuilt == 0 && stats.tileLoads == 0);
+
+    FastVectorDbBuild build;
+    build.begin("");
+    build.createLayerBegin("points");
+    build.setGeometryType(gtPoint, cfF64);
+    build.addField("value", ftI32);
+    for (int i = 0; i < 10; i++)
+    {
+        build.addFeatureBegin();
+        point2_t point = {double(i), 0};
+        build.setGeometry(&point, sizeof(point), ginPoint2);
+        build.setField(0, i);
+        build.addFeatureEnd();
+    }
+    build.createLayerEnd();
+    MemoryStream image;
+    build.post(&image);
+    stats = FastVectorDb::getStats();
+    if (stats.featuresBuilt == 0)
+    {
+        fprintf(stderr, "statistics compiled out, skipped\n");
+        return true;
+    }
+    CHECK(stats.featuresBuilt == 10);
+    CHECK(stats.layersBuilt == 1);
+    CHECK(stats.geometryBytesBuilt > 0);
+
+    FastVectorDb* db = load_image(image);
+    CHECK(db);
+    stats = FastVectorDb::getStats();
+    CHECK(stats.dbLoads == 1);
+    CHECK(stats.dbBytesLoaded == image.data.size());
+    auto layer = db->getLayer(0);
+    CountGeometry geometry;
+    layer->rewind();
+    for (int i = 0; i < 3 && layer->next(); i++)
+        layer->fetchGeometry(&geometry);
+    while (layer->next())
+        ;
+    stats = FastVectorDb::getStats();
+    CHECK(stats.featuresScanned == 10);
+    CHECK(stats.geometriesFetched == 3 && geometry.parts == 3);
+    CHECK(stats.verticesDecoded == 3);
+    CHECK(stats.geometryBytes == 3 * sizeof(point2_t));
+    CHECK(layer->tryGetFeatureAt(4));
+    CHECK(FastVectorDb::getStats().featureAllocations >= 1);
+    delete db;
+
+    string path = test_path("stats.fdb");
+    CHECK(save_test_tile(path, 1, 0, 0));
+    FastVectorDb::resetStats();
+    FastVectorTileDb tiles;
+    tiles.registerTile(path.c_str(), 0, 0, 0, 0, 1, 1);
+    tiles.registerTile(path.c_str(), 0, 0, 1, 0, 2, 1);
+    tiles.registerTile(test_path("missing.fdb").c_str(), 0, 0, 2, 0, 3, 1);
+    auto result = tiles.take(0, 0, 0, 3, 1);
+    CHECK(result && result->count == 3);
+    tiles.freeResult(result);
+    stats = FastVectorDb::getStats();
+    CHECK(stats.tileMisses == 3);
+    CHECK(stats.tileLoads == 2);
+    CHECK(stats.tileLoadFailures == 1);
+    CHECK(stats.tileBytesLoaded > 0);
+    CHECK(stats.dbLoads == 2);
+    result = tiles.take(0, 0, 0, 2, 1);
+    tiles.freeResult(result);
+    tiles.shrink(0);
+    stats = FastVectorDb::getStats();
+    CHECK(stats.tileHits == 2);
+    CHECK(stats.tileEvictions == 2);
+    return true;
+}
@@ -0,0 +1,131 @@
+#include "fastdb-test.h"
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <thread>
+
+//threads taking random viewports while the cache evicts over a budget only see whole tiles
+TEST_CASE(take_with_eviction)
+{
+    string path = test_path("eviction.fdb");
+    CHECK(save_test_tile(path, 1, 0, 0));
+    FastVectorDb* tile = FastVectorDb::load(path.c_str());
+    CHECK(tile);
+    u64 tile_bytes = tile->buffer().size;
+    delete tile;
+    for (int mt = 0; mt < 2; mt++)
+    {
+        FastVectorTileDb db(mt != 0, 3);
+        for (u32 level = 0; level <= 3; level++)
+        {
+            u32 n = 1 << level;
+            double size = 16.0 / n;
+            for (u32 y = 0; y < n; y++)
+                for (u32 x = 0; x < n; x++)
+                    db.registerTile(path.c_str(), level, 0, x * size, y * size, (x + 1) * size, (y + 1) * size);
+        }
+        u64 budget = tile_bytes * 6;
+        db.setCacheBudget(budget);
+        atomic<bool> stop{false};
+        atomic<u64> takes{0}, bad{0};
+        vector<thread> threads;
+        for (u32 t = 0; t < 6; t++)
+        {
+            threads.emplace_back([&, t]() {
+                u32 seed = t + 1;
+                while (!stop.load(memory_order_relaxed))
+                {
+                    seed = seed * 1103515245 + 12345;
+                    double x = (seed >> 8) % 1200 / 100.0, y = (seed >> 4) % 1200 / 100.0;
+                    auto result = db.take(3, x, y, x + 3, y + 3);
+                    if (!result)
+                        continue;
+                    for (u32 i = 0; i < result->count; i++)
+                    {
+                        FastVectorDb* data = result->tiles[i]->handle->tileData;
+                        if (data && (data->getLayerCount() != 1 || data->getLayer(0)->getFeatureCount() != 64))
+                            bad++;
+                    }
+                    db.freeResult(result);
+                    if (t == 0 && ++takes % 50 == 0)
+                        db.shrink(1);
+                }
+            });
+        }
+        this_thread::sleep_for(chrono::milliseconds(1000));
+        stop = true;
+        for (auto& thread : threads)
+            thread.join();
+        CHECK(bad == 0);
+        auto stats = db.getCacheStats();
+        CHECK(stats.pinned == 0);
+        CHECK(stats.evictions > 0);
+        CHECK(stats.loadFailures == 0);
+        //a take outside every tile pins nothing, the budget holds afterwards
+        db.freeResult(db.take(3, 100, 100, 101, 101));
+        stats = db.getCacheStats();
+        CHECK(stats.bytes <= budget);
+    }
+    return true;
+}
+
+//loads wait for the gate to open, at most two seconds
+class GatedTileDb : public FastVectorTileDb
+{
+public:
+    GatedTileDb(bool mt, u32 loaderThreads) : FastVectorTileDb(mt, loaderThreads) {}
+    atomic<bool> open{false};
+    atomic<u32> loads{0};
+protected:
+    TileData* loadTileDataInternal(TileDataHandle* loading) override
+    {
+        loads++;
+        for (int i = 0; i < 2000 && !open; i++)
+            this_thread::sleep_for(chrono::milliseconds(1));
+        return FastVectorTileDb::loadTileDataInternal(loading);
+    }
+};
+
+static bool wait_for(const function<bool()>& done)
+{
+    for (int i = 0; i < 2000 && !done(); i++)
+        this_thread::sleep_for(chrono::milliseconds(1));
+    return done();
+}
+
+//a taker without loader threads loads outside the cache lock: other takers and the stats go on and the
+//tile is loaded once. a queued tile is kept while other takers take other viewports
+TEST_CASE(load_while_taking)
+{
+    string path = test_path("gated.fdb");
+    CHECK(save_test_tile(path, 1, 0, 0));
+    {
+        GatedTileDb db(false, 0);
+        db.registerTile(path.c_str(), 0, 0, 0, 0, 1, 1);
+        thread taker([&]() { db.freeResult(db.take(0, 0, 0, 1, 1)); });
+        CHECK(wait_for([&]() { return db.loads == 1; }));
+        auto start = chrono::steady_clock::now();
+        CHECK(db.getCacheStats().count == 0);
+        auto result = db.take(0, 0, 0, 1, 1);
+        CHECK(result && result->count == 1);
+        db.freeResult(result);
+        CHECK(chrono::steady_clock::now() - start < chrono::milliseconds(500));
+        db.open = true;
+        taker.join();
+        CHECK(db.loads == 1 && db.getCacheStats().count == 1);
+    }
+    {
+        GatedTileDb db(true, 1);
+        for (u32 i = 0; i < 3; i++)
+            db.registerTile(path.c_str(), 0, 0, i * 10, 0, i * 10 + 1, 1);
+        db.freeResult(db.take(0, 0, 0, 1, 1));
+        CHECK(wait_for([&]() { return db.loads == 1; }));
+        db.freeResult(db.take(0, 10, 0, 11, 1));
+        for (int i = 0; i < 20; i++)
+            db.freeResult(db.take(0, 20, 0, 21, 1));
+        db.open = true;
+        CHECK(wait_for([&]() { return db.getCacheStats().count == 3; }));
+        CHECK(db.loads == 3);
+    }
+    return true;
+}
@@ -0,0 +1,70 @@
+#include "fastdb-test.h"
+#include <unistd.h>
+
+static u32 count_of(const string& text, const string& what)
+{
+    u32 count = 0;
+    for (size_t at = text.find(what); at != string::npos; at = text.find(what, at + 1))
+        count++;
+    return count;
+}
+
+static string post_trace()
+{
+    MemoryStream stream;
+    FastVectorDb::postTrace(&stream);
+    return string(stream.data.begin(), stream.data.end());
+}
+
+//spans of loads, takes and loader threads go to the trace of the current session, a wrapped ring keeps
+//its latest events, nothing is recorded while tracing is off and a new session starts empty
+TEST_CASE(trace_spans)
+{
+    string path = test_path("trace.fdb");
+    CHECK(save_test_tile(path, 1, 0, 0));
+    FastVectorDb::enableTrace(16);
+    {
+        FastVectorTileDb tiles(true, 1);
+        tiles.registerTile(path.c_str(), 0, 0, 0, 0, 1, 1);
+        for (int i = 0; i < 200 && tiles.getCacheStats().count == 0; i++)
+        {
+            tiles.freeResult(tiles.take(0, 0, 0, 1, 1));
+            usleep(1000);
+        }
+        CHECK(tiles.getCacheStats().count == 1);
+    }
+    string trace = post_trace();
+    CHECK(trace.compare(0, 39, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[") == 0);
+    CHECK(trace.size() > 3 && trace.compare(trace.size() - 3, 3, "]}\n") == 0);
+    CHECK(count_of(trace, "\"name\":\"TileBoxTake::take\"") > 0);
+    //the loader thread has exited, its events are posted once
+    CHECK(count_of(trace, "\"name\":\"FastVectorTileDb::loadTile\"") == 1);
+    //the tile load span and the file load under it carry the path
+    CHECK(count_of(trace, "\"path\":\"" + path + "\"") == 2);
+    CHECK(count_of(trace, "\"name\":\"FastVectorDb::load(file)\"") == 1);
+    CHECK(count_of(post_trace(), "FastVectorTileDb::loadTile") == 0);
+
+    vector<u8> image;
+    CHECK(read_file(path, image));
+    for (int i = 0; i < 40; i++)
+        delete FastVectorDb::load_xbuffer(image.data(), image.size());
+    trace = post_trace();
+    u32 loads = count_of(trace, "\"name\":\"FastVectorDb::load\"");
+    CHECK(loads > 0 && loads <= 16);
+
+    FastVectorDb::disableTrace();
+    delete FastVectorDb::load_xbuffer(image.data(), image.size());
+    CHECK(count_of(post_trace(), "\"name\":\"FastVectorDb::load\"") == loads);
+
+    FastVectorDb::enableTrace(16);
+    CHECK(count_of(post_trace(), "\"name\"") == 0);
+    delete FastVectorDb::load_xbuffer(image.data(), image.size());
+    FastVectorDb::disableTrace();
+    string saved = test_path("trace.json");
+    CHECK(FastVectorDb::saveTrace(saved.c_str()));
+    CHECK(read_file(saved, image));
+    trace.assign(image.begin(), image.end());
+    CHECK(count_of(trace, "\"name\":\"FastVectorDb::load\"") == 1);
+    CHECK(!FastVectorDb::saveTrace(test_path("missing/trace.json").c_str()));
+    return true;
+}
@@ -0,0 +1,67 @@
+#include "fastdb-test.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+static void build_rows(FastVectorDbBuild& build, u32 count)
+{
+    build.begin("");
+    build.createLayerBegin("rows");
+    build.setGeometryType(gtNone, cfF64);
+    build.addField("value", ftF64);
+    for (u32 i = 0; i < count; i++)
+    {
+        build.addFeatureBegin();
+        build.setField(0, (double)i);
+        build.addFeatureEnd();
+    }
+    build.createLayerEnd();
+}
+
+//images handed over as memfds arrive whole, sealed memfds can't be mapped shared, memfds the sender
+//could still shrink or write are refused
+TEST_CASE(fd_transport)
+{
+    FastVectorDbBuild build;
+    build_rows(build, 1000);
+    MemoryStream image;
+    build.post(&image);
+    int sealed = build.postMemfd("fastdb-test");
+    CHECK(sealed >= 0);
+    CHECK(FastVectorDb::load_fd(sealed, true) == NULL);
+    FastVectorDb* db = FastVectorDb::load_fd(sealed, false);
+    CHECK(db);
+    CHECK(same_image(db, image.data));
+    int unsealed = build.postMemfd("fastdb-test", false);
+    CHECK(unsealed >= 0);
+    FastVectorDb* shared = FastVectorDb::load_fd(unsealed, true);
+    CHECK(shared);
+    CHECK(same_image(shared, image.data));
+
+    int sockets[2];
+    CHECK(socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) == 0);
+    int copied = db->toMemfd("fastdb-test-copy");
+    CHECK(copied >= 0);
+    CHECK(FastVectorDb::sendFd(sockets[0], copied));
+    int received = FastVectorDb::recvFd(sockets[1]);
+    CHECK(received >= 0);
+    FastVectorDb* remote = FastVectorDb::load_fd(received, false);
+    CHECK(remote);
+    CHECK(same_image(remote, image.data));
+    CHECK(remote->getLayer(0)->getFeatureHandle(999).getFieldAsFloat(0) == 999.0);
+    //the sender could still shrink or write these
+    CHECK(FastVectorDb::sendFd(sockets[0], unsealed));
+    CHECK(FastVectorDb::recvFd(sockets[1]) == -1);
+    int forged = memfd_create("fastdb-test-forged", MFD_ALLOW_SEALING);
+    CHECK(forged >= 0 && ftruncate(forged, 100) == 0);
+    CHECK(fcntl(forged, F_ADD_SEALS, F_SEAL_WRITE) == 0);
+    CHECK(FastVectorDb::sendFd(sockets[0], forged));
+    CHECK(FastVectorDb::recvFd(sockets[1]) == -1);
+    delete remote;
+    delete shared;
+    delete db;
+    for (int fd : {sealed, unsealed, copied, received, forged, sockets[0], sockets[1]})
+        close(fd);
+    return true;
+}
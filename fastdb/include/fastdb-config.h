@@ -11,6 +11,8 @@ namespace wx{
     typedef unsigned int    u32;
     typedef          short  i16;
     typedef unsigned short  u16;
+    typedef unsigned long long u64;
+    typedef          long long i64;
     typedef float           f32;
     typedef double          f64;
     typedef u16             uchar_t;
@@ -0,0 +1,168 @@
+#pragma once
+//wire protocol and client of fastdb-serve,
+//a local daemon keeping databases mapped and indexed, answering bbox/attribute queries over a unix socket.
+//all integers are little endian, requests and replies may be pipelined, replies come back in request order.
+#include "fastdb.h"
+
+namespace wx
+{
+    enum ServeOpEnum
+    {
+        soLookup = 1,   //payload: layer name, "layer" or "database/layer"
+        soQuery         //payload: u32 projected field indices, after the filter text with sfFilterText
+    };
+
+    enum ServeFlagEnum
+    {
+        sfBBox       = 1,   //keep rows whose geometry box intersects bbox
+        sfFilter     = 2,   //keep rows passing filter_field filter_op filter_value
+        sfFilterText = 4    //with sfFilter: ftSTR/ftWSTR filter_field compared to a utf8 text instead,
+                            //the payload starts with u32 text size and the text padded to 4, no sfoBetween
+    };
+
+    enum ServeFilterOpEnum
+    {
+        sfoEq = 1,
+        sfoNe,
+        sfoLt,
+        sfoLe,
+        sfoGt,
+        sfoGe,
+        sfoBetween      //filter_value[0] <= v <= filter_value[1]
+    };
+
+    enum ServeColumnEnum
+    {
+        scF64 = 1,      //double[row_count]
+        scSTR           //u32 offsets[row_count+1], utf8 bytes
+    };
+
+    enum ServeStatusEnum
+    {
+        ssOk         = 0,
+        ssBadRequest = -1,
+        ssNoLayer    = -2,
+        ssNoField    = -3,
+        ssNoIndex    = -4   //bbox query on a layer without geometries
+    };
+
+    static const u32 SERVE_REQUEST_MAGIC = 0x51424446;//'FDBQ'
+    static const u32 SERVE_REPLY_MAGIC   = 0x52424446;//'FDBR'
+    static const u32 SERVE_MAX_PAYLOAD   = 1 << 20;
+    static const u64 SERVE_MAX_REPLY     = u64(1) << 32;//replies announcing more are refused by the client
+
+    struct serve_request_t
+    {
+        u32     magic;
+        u32     id;             //echoed in the reply
+        u16     op;             //ServeOpEnum
+        u16     flags;          //ServeFlagEnum
+        u16     db;
+        u16     layer;
+        double  bbox[4];        //minx,miny,maxx,maxy
+        u32     filter_field;
+        u32     filter_op;      //ServeFilterOpEnum
+        double  filter_value[2];
+        u32     max_rows;       //0 means no limit
+        u32     payload_size;
+    };
+
+    //followed by payload_size bytes:
+    //soQuery  : u32 rows[row_count] (padded to 8), then per column u32 type,u32 reserved and its data (padded to 8)
+    //soLookup : u32 db,layer,feature_count,field_count, then per field u32 type,u32 name_size,name (padded to 4)
+    struct serve_reply_t
+    {
+        u32     magic;
+        u32     id;
+        int     status;         //ServeStatusEnum
+        u32     row_count;
+        u32     column_count;
+        u32     op;             //echoed ServeOpEnum
+        u64     payload_size;
+    };
+
+    class /*fastdb_api*/ FastVectorDbClient
+    {
+    public:
+        class Impl;
+    public:
+        struct Query
+        {
+            u16         db;
+            u16         layer;
+            u16         flags;
+            double      minx, miny, maxx, maxy;
+            u32         filterField;
+            u32         filterOp;
+            double      filterValue[2];
+            const char* filterText;
+            u32         maxRows;
+            u32         fieldCount;
+            const u32*  fields;
+            static Query make(u32 db, u32 layer)
+            {
+                Query q;
+                memset(&q, 0, sizeof(q));
+                q.db = db;
+                q.layer = layer;
+                return q;
+            }
+            inline Query& bbox(double xmin, double ymin, double xmax, double ymax)
+            {
+                flags |= sfBBox;
+                minx = xmin; miny = ymin; maxx = xmax; maxy = ymax;
+                return *this;
+            }
+            inline Query& filter(u32 field, ServeFilterOpEnum op, double v0, double v1 = 0)
+            {
+                flags |= sfFilter;
+                filterField = field; filterOp = op;
+                filterValue[0] = v0; filterValue[1] = v1;
+                return *this;
+            }
+            inline Query& filter(u32 field, ServeFilterOpEnum op, const char* text)
+            {
+                flags |= sfFilter | sfFilterText;
+                filterField = field; filterOp = op;
+                filterText = text;
+                return *this;
+            }
+            inline Query& project(const u32* ixs, u32 count)
+            {
+                fields = ixs;
+                fieldCount = count;
+                return *this;
+            }
+        };
+        struct QueryColumn
+        {
+            u32             type;   //ServeColumnEnum
+            const double*   values; //scF64
+            const u32*      offsets;//scSTR
+            const char*     text;   //scSTR
+        };
+        struct QueryResult
+        {
+        public:
+            u32             id;
+            int             status;
+            u32             count;
+            u32             columnCount;
+            const u32*      rows;
+            QueryColumn*    columns;
+        };
+    public:
+       ~FastVectorDbClient();
+        bool                lookup(const char* name, u32& db, u32& layer);
+        int                 getFieldIndex(u32 db, u32 layer, const char* field);
+        u32                 send(const Query& q);   //pipelined, returns the request id or 0
+        const QueryResult*  receive();              //next reply in request order
+        const QueryResult*  query(const Query& q);
+        void                freeResult(const QueryResult* result);
+    public:
+        static FastVectorDbClient* connect(const char* path);
+    private:
+        FastVectorDbClient(Impl* impl);
+        Impl* impl;
+    };
+}
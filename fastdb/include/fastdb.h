@@ -1,6 +1,7 @@
 #ifndef __FASTDB_H__
 #define __FASTDB_H__
 #include "fastdb-config.h"
+#include <atomic>
 namespace wx
 {
     enum GeometryLikeEnum
@@ -75,7 +76,9 @@ namespace wx
     class  FastVectorDb;
     class  FastVectorDbLayer;
     class  FastVectorDbFeature;
+    struct FastVectorDbFeatureHandle;
     struct FastVectorDbFeatureRef;
+    class  FastVectorDbSelection;
 
     class /*fastdb_api*/ FastVectorDbBuild
     {
@@ -91,6 +94,9 @@ namespace wx
         void setGeometryType(GeometryLikeEnum gt, CoordinateFormatEnum ct=cfDefault, bool aabboxEnabled = false);
         void enableStringTableU32(bool b = true);
         void setExtent(double minx, double miny, double maxx, double maxy);
+        void enableSeqlock(u32 chunkRows = 64);//0 disables the seqlock area
+        void enableControlHeader(bool b = true);//reserve the epoch/ready flags header for wait/publish
+        void enableBackLinks(bool b = true);//index the refs set by setField by target, before adding features
         void addFeatureBegin();
         void setGeometry(void *data, size_t size, GeometryLikeFormat fmt);
         void setField(unsigned ix, double value);
@@ -101,6 +107,7 @@ namespace wx
         void createLayerEnd();
         void post(WriteStream *stream);
         void save(const char *filename);
+        int  postMemfd(const char *name, bool seal = true);//returns the memfd or -1
 
     public:
         inline void setGeometryWKT(const char *data)
@@ -139,6 +146,7 @@ namespace wx
         void setGeometryType(GeometryLikeEnum gt, CoordinateFormatEnum ct, bool aabboxEnabled = false);
         void enableStringTableU32(bool b = true);
         void setExtent(double minx, double miny, double maxx, double maxy);
+        void enableSeqlock(u32 chunkRows = 64);
         void setDbIndex(int ix);
         void addFeatureBegin();
         void setGeometry(void *data, size_t size, GeometryLikeFormat fmt);
@@ -195,7 +203,61 @@ namespace wx
     };
 
     typedef void (*fnFreeDbBuffer)(void *pdata, size_t size, void *pcookie);
+
+    const u32 FASTDB_NO_ROW = 0xFFFFFFFF;
+
+    //a ftFeatureRef field value pointing at a feature, see FastVectorDbLayer::getBackLinks
+    struct FastVectorDbBackLink
+    {
+        u16     ilayer;     //layer of the referencing feature
+        u16     ifield;
+        u32     ifeature;
+    };
     
+    //process wide runtime counters, FastVectorDb::getStats sums them over all threads.
+    //building with FASTDB_NO_STATS compiles the counting out
+    struct FastVectorDbStats
+    {
+        u64     dbLoads;            //images loaded from memory, files, fds or packs
+        u64     dbBytesLoaded;
+        u64     featuresScanned;    //next() steps
+        u64     geometriesFetched;  //geometries decoded by fetchGeometry
+        u64     verticesDecoded;
+        u64     geometryBytes;      //geometry bytes decoded by fetchGeometry or returned by getGeometryLikeChunk
+        u64     featureAllocations; //feature objects created by tryGetFeature/tryGetFeatureAt
+        u64     tileHits;           //tiles of a take found resident
+        u64     tileMisses;         //tiles of a take loaded or queued
+        u64     tileLoads;
+        u64     tileLoadFailures;
+        u64     tileBytesLoaded;
+        u64     tileEvictions;
+        u64     tileQueueDepth;     //tiles waiting for a loader now, not affected by resetStats
+        u64     featuresBuilt;
+        u64     layersBuilt;
+        u64     geometryBytesBuilt;
+    };
+
+    //bytes held by a loaded database, see FastVectorDb::memoryReport. the image sections add up to buffer,
+    //the auxiliary structures are heap allocations made over the image while it is used
+    struct FastVectorDbMemory
+    {
+        u64     buffer;             //image bytes
+        u64     resident;           //image bytes in memory now, a mapped image may be partly paged out
+        u64     headers;            //file and layer headers, field definitions
+        u64     geometry;
+        u64     attributes;         //fixed size feature rows
+        u64     strings;            //string and wide string pools
+        u64     sections;           //seqlock, control and back-link sections behind the layers
+        u64     stringTables;       //pointers into the string pools, built at load
+        u64     geometryMap;        //geometry pointer per feature, built by the first tryGetFeatureAt
+        u64     cookieMap;          //cookie per feature, built by the first setFeatureCookie
+        u64     featureCache;       //feature slots and feature objects of tryGetFeatureAt
+        u64     featureObjects;     //feature objects allocated
+        u64     objects;            //database and layer objects, scratch buffers
+        u64     auxiliary;          //stringTables+geometryMap+cookieMap+featureCache+objects
+        u64     total;              //resident+auxiliary
+    };
+
     class /*fastdb_api*/ FastVectorDb
     {
     public:
@@ -205,7 +267,22 @@ namespace wx
         unsigned                getLayerCount();
         FastVectorDbLayer*      getLayer(unsigned ix);
         FastVectorDbFeature*    tryGetFeature(FastVectorDbFeatureRef* ref);
+        FastVectorDbFeatureHandle getFeatureHandle(FastVectorDbFeatureRef* ref);
         chunk_data_t            buffer();
+        //FastVectorDbLayer::resolveRefs over count refs stride bytes apart, e.g. a ref column
+        static u32              resolveRefs(const void *refs, size_t stride, u32 count, u32 targetLayer, u32 *rows);
+    public:
+        //futex based notification for images shared between processes,
+        //only usable when the image has been built with enableControlHeader().
+        //timeoutMs<0 waits forever, the wait calls return the current epoch/flags.
+        bool                    hasControlHeader();
+        u32                     getEpoch();
+        u32                     publish();
+        u32                     wait(u32 epoch, int timeoutMs = -1);
+        u32                     getReadyFlags();
+        u32                     setReadyFlags(u32 mask);
+        u32                     clearReadyFlags(u32 mask);
+        u32                     waitReadyFlags(u32 mask, int timeoutMs = -1);
     public:
         static FastVectorDb *load(void *pdata, size_t size, fnFreeDbBuffer fnFreeBuffer, void *cookie);
         static FastVectorDb *load(const char *filename);
@@ -213,6 +290,45 @@ namespace wx
         {
             return load((void*)pdata,size,NULL,NULL);
         }
+        //map the whole fd, shared=false maps copy-on-write so sealed memfds stay untouched,
+        //shared=true fails on write sealed memfds. the caller keeps the ownership of fd and may close it after loading.
+        static FastVectorDb *load_fd(int fd, bool shared = false);
+    public:
+        //zero copy handoff of database images between processes of the same machine,
+        //recvFd accepts only memfds sealed against shrinking and writing (toMemfd with seal=true)
+        int                  toMemfd(const char *name, bool seal = true);
+        static bool          sendFd(int sock, int fd);
+        static int           recvFd(int sock);
+    public:
+        //row level synchronization between two versions of the same layout,
+        //a signature holds one CRC32C per chunkRows rows (and per 4KB of meta/string data),
+        //a patch carries only the changed chunks and is applied in place,
+        //rows of seqlock protected layers are patched through the seqlock.
+        //when the image size changes (e.g. geometries replaced by ones of another size) the patch
+        //describes the new image as moved base chunks and new bytes: applyPatch refuses it,
+        //as it refuses patches of headers or field definitions beyond names, extents and value ranges.
+        //loadPatched builds a new database from the base and either kind of patch
+        bool                 signature(WriteStream *stream, u32 chunkRows = 64);
+        bool                 diff(const void *signature, size_t size, WriteStream *patch);
+        bool                 applyPatch(const void *patch, size_t size);
+        static bool          diff(FastVectorDb *base, FastVectorDb *target, WriteStream *patch, u32 chunkRows = 64);
+        static FastVectorDb* loadPatched(FastVectorDb *base, const void *patch, size_t size);
+    public:
+        //counters since the process started or the last resetStats, cheap enough to poll
+        static FastVectorDbStats getStats();
+        static void          resetStats();
+        //spans of the load, build, take and tile load phases, kept in a ring of eventsPerThread events per
+        //thread (resized when a thread first traces in a session) and written as Chrome trace JSON for
+        //chrome://tracing or ui.perfetto.dev. enableTrace starts a new session, a span costs one load while
+        //tracing is off. the events of exited threads are posted once, then their rings are freed
+        static void          enableTrace(u32 eventsPerThread = 16384);
+        static void          disableTrace();
+        static void          postTrace(WriteStream *stream);
+        static bool          saveTrace(const char *path);
+    public:
+        //breakdown of the bytes held by the image and the structures built over it,
+        //heap blocks are counted with the allocator overhead
+        FastVectorDbMemory   memoryReport();
     private:
         FastVectorDb(Impl *impl);
         Impl *impl;
@@ -246,7 +362,49 @@ namespace wx
         FastVectorDbFeatureRef* getFieldAsFeatureRef(u32 ix);
         void*                   setFeatureCookie(void *cookie);
         void*                   getFeatureCookie();
+        //tryGetFeatureAt keeps a feature object per touched feature for the life of the layer,
+        //use it only where a stable pointer is needed, getFeatureHandle allocates nothing
         FastVectorDbFeature*    tryGetFeatureAt(u32 ix);
+        FastVectorDbFeatureHandle getFeatureHandle(u32 ix);
+        //features whose ftFeatureRef fields point at ifeature, ordered by layer, feature and field.
+        //read in place from images built with FastVectorDbBuild::enableBackLinks, NULL otherwise
+        bool                    hasBackLinks();
+        const FastVectorDbBackLink* getBackLinks(u32 ifeature, u32 &count);
+    public:
+        //bulk ref following. resolveRefs writes the rows of layer targetLayer referenced by field refField of
+        //features [first,first+count), FASTDB_NO_ROW where the ref points at another layer or the feature
+        //is past the end, and returns the number of rows resolved (0: not a ref field).
+        //gather copies the raw values of field ix at rows into out, packed, and returns the bytes per
+        //value (0: bad field). gatherFloat converts fieldCount fields at rows to doubles, integers included,
+        //field k going to out+k*count. rows out of range, NO_ROW included, give zeros / NaN
+        u32                     resolveRefs(u32 refField, u32 first, u32 count, u32 targetLayer, u32 *rows);
+        u32                     gather(u32 ix, const u32 *rows, u32 count, void *out);
+        bool                    gatherFloat(const u32 *fields, u32 fieldCount, const u32 *rows, u32 count, double *out);
+        //rows matching a condition on the fields, e.g. "depth > 10 and kind == 'river'". numeric fields and
+        //literals with + - * / and comparisons, ftSTR fields compared to strings or each other with == and !=,
+        //combined by and, or, not (&& || !) and parentheses. compiled once and evaluated in batches of rows.
+        //true, false, and, or and not are keywords, fields with these names can't be referenced.
+        //the caller deletes the selection, NULL when the expression is invalid (the error is printed)
+        FastVectorDbSelection*  filter(const char *expr);
+        //the layer's share of FastVectorDb::memoryReport, sections is always 0
+        FastVectorDbMemory      memoryReport();
+    public:
+        //seqlock protected access for images shared between processes,
+        //rows are versioned in chunks of getSeqlockChunkRows() rows,
+        //without a seqlock area updates are plain writes and reads always succeed.
+        //a writer that dies between beginUpdate and endUpdate leaves its chunk odd: later writers and
+        //readers of that chunk spin forever, the image has to be rebuilt or reloaded
+        bool                    hasSeqlock();
+        u32                     getSeqlockChunkRows();
+        u64                     getVersion();
+        void                    beginUpdate(u32 ifeature);
+        u64                     endUpdate(u32 ifeature);
+        void                    updateField(u32 ifeature, u32 ix, double value);
+        void                    updateField(u32 ifeature, u32 ix, int value);
+        u64                     beginRead(u32 ifeature);
+        bool                    endRead(u32 ifeature, u64 seq);
+        bool                    readFeature(u32 ifeature, void *out);
+        u32                     changedSince(u64 version, u32 *chunks, u32 capacity);
     public:
         inline const char* getFieldDefn_p(unsigned ix, size_t *ft, double *vmin, double *vmax)
         {
@@ -263,7 +421,50 @@ namespace wx
     private:
         Impl *impl;
         friend class FastVectorDbFeature;
+        friend struct FastVectorDbFeatureHandle;
         friend class FastVectorDb::Impl; 
+        friend class FastVectorDbJoin;
+    };
+
+    //rows of a layer selected by FastVectorDbLayer::filter, ascending
+    class /*fastdb_api*/ FastVectorDbSelection
+    {
+    public:
+        class Impl;
+    public:
+       ~FastVectorDbSelection();
+        FastVectorDbLayer*      layer();
+        u32                     getCount();
+        const u32*              rows();
+    private:
+        FastVectorDbSelection(Impl *impl);
+        Impl *impl;
+        friend class FastVectorDbLayer::Impl;
+    };
+
+    //a feature by value, with the accessors of FastVectorDbFeature. copies are free and
+    //it stays usable while its database is loaded, owner is NULL for a feature that does not exist
+    //and the accessors of such a handle return 0/NULL and write nothing
+    struct /*fastdb_api*/ FastVectorDbFeatureHandle
+    {
+        FastVectorDbLayer*      owner;
+        u32                     ifeature;
+    public:
+        bool                    valid() const { return owner != NULL; }
+        FastVectorDbLayer*      layer() const { return owner; }
+        void                    fetchGeometry(GeometryReturn *cb) const;
+        chunk_data_t            getGeometryLikeChunk() const;
+        double                  getFieldAsFloat(u32 ix) const;
+        int                     getFieldAsInt(u32 ix) const;
+        const char*             getFieldAsString(u32 ix) const;
+        const uchar_t*          getFieldAsWString(u32 ix) const;
+        FastVectorDbFeatureRef* getFieldAsFeatureRef(u32 ix) const;
+        void*                   setFeatureCookie(void *cookie) const;
+        void*                   getFeatureCookie() const;
+    public:
+        void*                   getAddress() const;
+        void                    setField(u32 ix,double value) const;
+        void                    setField(u32 ix,int    value) const;
     };
     
     class  /*fastdb_api*/ FastVectorDbFeature
@@ -290,6 +491,56 @@ namespace wx
         Impl*  impl;
         friend class FastVectorDbLayer::Impl;
     }; 
+    //inner equi join of two layers on one field each. integer fields (u8, u16, u32, i32) match on their value,
+    //ftSTR and ftWSTR fields on their text. the hash table holds the distinct keys of the smaller layer, string
+    //keys are hashed once per string table entry and rows are then matched on their string ids.
+    //the other layer is probed in chunks by threads threads (0: one per core)
+    class /*fastdb_api*/ FastVectorDbJoin
+    {
+    public:
+        class Impl;
+    public:
+        FastVectorDbJoin();
+       ~FastVectorDbJoin();
+        //false when a field is out of range or the key types don't compare, the previous result is dropped
+        bool                    join(FastVectorDbLayer* left, u32 leftField, FastVectorDbLayer* right, u32 rightField, u32 threads = 0);
+        //matched pairs, ordered by left row then right row
+        u32                     getCount();
+        const u32*              leftRows();
+        const u32*              rightRows();
+        //fields of the left (side 0) or right (side 1) layer at the matched rows, see FastVectorDbLayer::gatherFloat
+        bool                    gatherFloat(u32 side, const u32 *fields, u32 fieldCount, double *out);
+    private:
+        Impl *impl;
+    };
+    //a ring of identical database images in one shared memory segment,
+    //a producer fills a free slot while consumers keep reading the latest published one.
+    //single producer: at most one thread of one process may be between beginWrite and endWrite,
+    //endWrite numbers steps without synchronizing with other producers. any number of consumers
+    class /*fastdb_api*/ FastVectorDbRing
+    {
+    public:
+        class Impl;
+    public:
+       ~FastVectorDbRing();
+        u32                     getSlotCount();
+        u64                     getLatestStep();
+        //NULL when every other slot is still read, after waiting up to timeoutMs for a consumer
+        //to release one (0: don't wait, <0: wait forever)
+        FastVectorDb*           beginWrite(bool copyLatest = false, int timeoutMs = 0);
+        u64                     endWrite(FastVectorDb* slot);
+        void                    abortWrite(FastVectorDb* slot);
+        FastVectorDb*           beginRead(u64* step = NULL);
+        void                    endRead(FastVectorDb* slot);
+        u64                     waitStep(u64 step, int timeoutMs = -1);
+    public:
+        static FastVectorDbRing* create(const char* name, FastVectorDb* layout, u32 slotCount = 2);
+        static FastVectorDbRing* open(const char* name);
+        static bool              unlink(const char* name);
+    private:
+        FastVectorDbRing(Impl *impl);
+        Impl *impl;
+    };
     class /*fastdb_api*/ TileBoxTake
     {
         class Impl;
@@ -312,6 +563,7 @@ namespace wx
         class HandleTileAction
         {
         public:
+            //called once for every box put in the result, possibly from several threads
             virtual bool isTileLoaded(const TileBox* box)=0;
         };
 
@@ -321,6 +573,17 @@ namespace wx
             u32         count;
             TileBox*    tiles[1];
         };
+        //a frame of an incremental take, owned by its cursor and valid until the next frame.
+        //entered/left: boxes added to and removed from the previous frame's result, matched by id
+        struct TakeFrame
+        {
+            const TakeResult*   result;     //NULL when nothing is visible, not passed to freeResult
+            u32                 enteredCount;
+            u32                 leftCount;
+            TileBox**           entered;
+            TileBox**           left;
+        };
+        class TakeCursor;
 
     public:
         TileBoxTake(int maxLevel = 32);
@@ -328,6 +591,17 @@ namespace wx
         void                registerTileBox(const TileBox &item);
         const TakeResult*   take(u32 maxLevel, double xmin, double ymin, double xmax, double ymax,HandleTileAction* action=NULL);
         void                freeResult(const TakeResult* result);
+        //frame-coherent take for one moving viewport, a cursor is used by one thread at a time:
+        //candidates of the previous frame are kept and only the strips the viewport gained are looked up
+        TakeCursor*         createCursor();
+        const TakeFrame*    takeIncremental(TakeCursor* cursor,u32 maxLevel, double xmin, double ymin, double xmax, double ymax,HandleTileAction* action=NULL);
+        void                freeCursor(TakeCursor* cursor);
+        //write the sorted boxes with their index, load publishes them without sorting,
+        //box ids index cookies[count]
+        void                save(WriteStream* stream);
+        bool                load(const void* pdata, size_t size, void** cookies, u32 count);
+        //heap bytes of the registered boxes and of their published index
+        u64                 memoryBytes();
     public:
         inline void registerTileBox(int id, u8 level, double t, double xmin, double ymin, double xmax, double ymax, void *cookie)
         {
@@ -346,7 +620,10 @@ namespace wx
         struct TileDataHandle
         {
             const char* path;
-            TileData*   tileData;
+            //set by loads and cleared by evictions while results are read, NULL: not resident.
+            //a tile read through a result stays valid until freeResult, an evicted one is deleted
+            //once no result pins it
+            std::atomic<TileData*> tileData;
         };
         struct TileDbBox
         {
@@ -363,18 +640,120 @@ namespace wx
             u32         count;
             TileDbBox*  tiles[1];
         };
+        //see TileBoxTake::TakeFrame, the tiles of the result stay pinned until the next frame
+        struct TakeFrame
+        {
+            const TakeResult*   result;
+            u32                 enteredCount;
+            u32                 leftCount;
+            TileDbBox**         entered;
+            TileDbBox**         left;
+        };
+        class TakeCursor;
+        struct CacheStats
+        {
+            u64         hits;           //tiles of a take found resident
+            u64         misses;         //tiles of a take that had to be loaded
+            u64         evictions;
+            u64         loadFailures;
+            u64         bytes;          //resident tile bytes
+            u64         budget;         //0: unlimited
+            u32         count;          //resident tiles
+            u32         pinned;         //resident tiles referenced by outstanding take results
+            u32         queued;         //tiles waiting for a loader thread
+            u64         prefetchRequests;   //tiles queued by the prefetcher
+            u64         prefetchLoads;      //tiles loaded for the prefetcher
+            u64         prefetchHits;       //prefetched tiles later returned by a take
+            u64         prefetchWasted;     //prefetched tiles evicted before any take returned them
+        };
+        struct CacheMemory
+        {
+            FastVectorDbMemory  tiles;      //sum over the resident tiles
+            u32         residentTiles;
+            u64         handles;            //tile handles and their paths
+            u64         index;              //registered boxes and their grid index
+            u64         queue;              //load queue
+            u64         catalog;            //resident bytes of the mapped catalog
+            u64         packs;              //resident bytes of the mapped pack files
+            u64         total;              //all of the above, pack tiles counted once
+        };
     public:
-        FastVectorTileDb(bool mt=false);
+        //mt: load tiles in a pool of loaderThreads threads (0: one per core, at most 8),
+        //take returns the loaded tiles and queues the missing ones by level and distance to the viewport center
+        FastVectorTileDb(bool mt=false, u32 loaderThreads=0);
        ~FastVectorTileDb();
         void registerTile(const char* path,u8 level, double t, double xmin, double ymin, double xmax, double ymax);
+        //take/freeResult may be called from many threads at once, tiles of a result stay resident until freeResult
         const TakeResult*   take(u32 maxLevel, double xmin, double ymin, double xmax, double ymax);
         void                freeResult(const TakeResult* result);
+        //incremental take, loads are requested as by take, see TileBoxTake::takeIncremental
+        TakeCursor*         createCursor();
+        const TakeFrame*    takeIncremental(TakeCursor* cursor,u32 maxLevel, double xmin, double ymin, double xmax, double ymax);
+        void                freeCursor(TakeCursor* cursor);
+        //evict least recently used tiles down to maxTileCache tiles, pinned tiles are kept
         void                shrink(u32 maxTileCache=32);
+        //keep resident tile buffers under bytes, enforced on every take
+        void                setCacheBudget(u64 bytes);
+        CacheStats          getCacheStats();
+        //resident tiles summed in tiles, plus the structures of the cache itself. the tile reports are
+        //approximate while other threads use the tiles, tiles loaded from a pack are resident in packs
+        CacheMemory         memoryReport();
+        //mt only: extrapolate pan and zoom of successive takes lookahead takes ahead and queue up to
+        //maxTiles tiles of the predicted viewport, after every visible tile. maxTiles=0 disables it
+        void                enablePrefetch(u32 maxTiles=16, double lookahead=4);
+        //write the registered tiles (paths, extents, levels, times and the level index) to a catalog file,
+        //openCatalog maps it and registers every tile without sorting, only before any registerTile
+        bool                saveCatalog(const char* path);
+        bool                openCatalog(const char* path);
+        //copy the files of the registered tiles into one pack file, 4 KiB aligned behind an offset directory.
+        //openPack maps a pack, tiles found in it by path, registered before or after, are loaded in place from the mapping
+        bool                writePack(const char* path);
+        bool                openPack(const char* path);
+        //mt only: read tile files through io_uring, up to queueDepth opens and reads in flight, instead of
+        //one blocking loadTileDataInternal per loader thread. false when io_uring is unavailable, the loader
+        //threads keep loading. every tile read goes through loadTileDataInternal, the base one loads the
+        //image the ring read, an override loading custom sources gets the tile but the read is wasted.
+        //a tile whose file can't be read fails to load without loadTileDataInternal
+        bool                enableAsyncIO(u32 queueDepth=64);
     protected:
+        //NULL: the load failed, takes request the tile again after 8 takes, doubling per failure in a row
         virtual TileData*   loadTileDataInternal(TileDataHandle*  loading);
     private:
         Impl* impl;
     };
+
+    //seeded synthetic databases for tests and benchmarks, the same seed and layer specs give the same bytes.
+    //setVertices, setHoles, addField and addRefField apply to the last added layer
+    class /*fastdb_api*/ FastVectorDbGen
+    {
+    public:
+        class Impl;
+    public:
+        FastVectorDbGen(u64 seed = 1);
+       ~FastVectorDbGen();
+        //extent of a database, or of level 0 of a pyramid
+        void setExtent(double minx, double miny, double maxx, double maxy);
+        //points, random walk lines or star shaped polygons, returns the layer index
+        int  addLayer(const char *name, GeometryLikeEnum gt, u32 featureCount, CoordinateFormatEnum cf = cfDefault);
+        //vertices per line or outer ring drawn from [minVertices,maxVertices], uniform or log-uniform (many
+        //small, few large). step is the edge length relative to the extent
+        void setVertices(u32 minVertices, u32 maxVertices, double step = 0.001, bool logUniform = false);
+        //holes per polygon drawn from [0,maxHoles]
+        void setHoles(u32 maxHoles);
+        //numbers are drawn from [vmin,vmax], strings from cardinality distinct values (0: unique per feature).
+        //returns the field index
+        int  addField(const char *name, unsigned ft, double vmin = 0, double vmax = 1.0, u32 cardinality = 0);
+        //refs to features drawn from an earlier layer
+        int  addRefField(const char *name, int targetLayer);
+        void post(WriteStream *stream);
+        bool save(const char *filename);
+        //levels 0..maxLevel of 2^level x 2^level tiles over the extent, every tile with the layer specs over its
+        //own extent, written to dir/level/x/y.fdb by threads threads (0: one per core) and registered in
+        //dir/catalog.fdbc. tiles are seeded by their position, the output does not depend on threads
+        bool savePyramid(const char *dir, u32 maxLevel, u32 threads = 0);
+    private:
+        Impl *impl;
+    };
 #ifndef SWIG
     using WxDatabase = FastVectorDb;
     using WxLayerTable = FastVectorDbLayer;
@@ -383,6 +762,9 @@ namespace wx
     using WxTileDatabase = FastVectorTileDb;
     using WxDatabaseBuild = FastVectorDbBuild;
     using WxLayerTableBuild = FastVectorDbLayerBuild;
+    using WxDatabaseGen = FastVectorDbGen;
+    using WxJoin = FastVectorDbJoin;
+    using WxSelection = FastVectorDbSelection;
 #endif
 }
 #endif
\ No newline at end of file
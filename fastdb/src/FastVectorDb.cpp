@@ -1,5 +1,7 @@
 #include "FastVectorDb_p.h"
 #include "FastVectorDbLayer_p.h"
+#include "FastVectorDbStats_p.h"
+#include "FastVectorDbTrace_p.h"
 #include <stdlib.h>
 #include <sys/stat.h>
 #include <fcntl.h>
@@ -8,7 +10,7 @@
 namespace wx
 {
     FastVectorDb::Impl::Impl(void *pdata, size_t size, fnFreeDbBuffer fnFreeBuffer, void *cookie)
-        : m_pdata(pdata), m_size(size), m_fnFreeBuffer(fnFreeBuffer), m_cookie(cookie)
+        : m_pdata(pdata), m_size(size), m_fnFreeBuffer(fnFreeBuffer), m_cookie(cookie), m_control(NULL)
     {
         u8 *ptr = (u8 *)pdata;
         bool check_mask = strcmp((const char *)ptr, "FASTVectorDB0.1") == 0;
@@ -29,6 +31,44 @@ namespace wx
             m_layers.push_back(layer);
             ptr += lh->total_size;
         }
+        load_sections(ptr - (u8 *)pdata);
+    }
+    void FastVectorDb::Impl::load_sections(size_t offset)
+    {
+        u8 *base = (u8 *)m_pdata;
+        while (true)
+        {
+            offset = align_section_offset(offset);
+            if (offset + sizeof(db_section_header_t) > m_size)
+                break;
+            db_section_header_t *header = (db_section_header_t *)(base + offset);
+            if (header->tag == stEnd || header->size > m_size - offset - sizeof(db_section_header_t))
+                break;
+            u8 *payload = base + offset + sizeof(db_section_header_t);
+            switch (header->tag)
+            {
+            case stSeqlock:
+                if (header->ilayer < m_layers.size() && header->size >= sizeof(seqlock_header_t))
+                {
+                    seqlock_header_t *seqlock = (seqlock_header_t *)payload;
+                    if (seqlock_section_size(seqlock->chunk_count) <= header->size)
+                        m_layers[header->ilayer]->impl->attachSeqlock(seqlock);
+                }
+                break;
+            case stBackLinks:
+                if (header->ilayer < m_layers.size() && ((size_t)payload & 3) == 0)
+                {
+                    m_layers[header->ilayer]->impl->attachBackLinks(payload, header->size);
+                    m_backlink_sections.push_back(make_pair(size_t(payload - base), size_t(payload - base + header->size)));
+                }
+                break;
+            case stControl:
+                if (header->size >= sizeof(control_header_t) && ((size_t)payload & 3) == 0)
+                    m_control = (control_header_t *)payload;
+                break;
+            }
+            offset += sizeof(db_section_header_t) + header->size;
+        }
     }
     FastVectorDb::Impl::~Impl()
     {
@@ -66,6 +106,125 @@ namespace wx
         }
         return m_layers[ref->ilayer]->impl->tryGetFeatureAt(ref->ifeature);
     }
+    FastVectorDbFeatureHandle FastVectorDb::Impl::getFeatureHandle(FastVectorDbFeatureRef* ref)
+    {
+        if (!ref || ref->ilayer >= m_layers.size())
+        {
+            FastVectorDbFeatureHandle handle = {NULL, 0};
+            return handle;
+        }
+        return m_layers[ref->ilayer]->impl->getFeatureHandle(ref->ifeature);
+    }
+
+    FastVectorDbMemory FastVectorDb::Impl::memoryReport()
+    {
+        FastVectorDbMemory report;
+        memset(&report, 0, sizeof(report));
+        for (auto layer : m_layers)
+            layer->impl->memory_report(report);
+        size_t end = layers_end();
+        report.buffer = m_size;
+        report.resident = memory_resident_bytes(m_pdata, m_size);
+        report.headers += 16 + sizeof(u32);
+        report.sections = m_size > end ? m_size - end : 0;
+        report.objects += memory_heap_bytes(sizeof(FastVectorDb)) + memory_heap_bytes(sizeof(Impl)) + memory_vector_bytes(m_layers);
+        report.auxiliary = report.stringTables + report.geometryMap + report.cookieMap + report.featureCache + report.objects;
+        report.total = report.resident + report.auxiliary;
+        return report;
+    }
+
+    bool FastVectorDb::Impl::hasControlHeader()
+    {
+        return m_control != NULL;
+    }
+    u32 FastVectorDb::Impl::getEpoch()
+    {
+        return m_control ? m_control->epoch.load(memory_order_acquire) : 0;
+    }
+    void FastVectorDb::Impl::wake(atomic<u32>* word)
+    {
+        if (m_control->waiters.load(memory_order_seq_cst) > 0)
+            futex_wake_all(word);
+    }
+    //spin a little before sleeping, most handoffs complete within a few microseconds
+    bool FastVectorDb::Impl::wait_word(atomic<u32>* word, u32 expected, int timeoutMs,
+                                       chrono::steady_clock::time_point deadline)
+    {
+        for (int spin = 0; spin < 256; spin++)
+        {
+            if (word->load(memory_order_acquire) != expected)
+                return true;
+            sync_cpu_relax(spin < 64 ? spin : 0);
+        }
+        int remain = -1;
+        if (timeoutMs >= 0)
+        {
+            auto left = chrono::duration_cast<chrono::milliseconds>(deadline - chrono::steady_clock::now()).count();
+            if (left <= 0)
+                return false;
+            remain = (int)left;
+        }
+        m_control->waiters.fetch_add(1, memory_order_seq_cst);
+        futex_wait(word, expected, remain);
+        m_control->waiters.fetch_sub(1, memory_order_seq_cst);
+        return true;
+    }
+    u32 FastVectorDb::Impl::publish()
+    {
+        if (!m_control)
+            return 0;
+        u32 epoch = m_control->epoch.fetch_add(1, memory_order_seq_cst) + 1;
+        wake(&m_control->epoch);
+        return epoch;
+    }
+    u32 FastVectorDb::Impl::wait(u32 epoch, int timeoutMs)
+    {
+        if (!m_control)
+            return 0;
+        auto deadline = chrono::steady_clock::now() + chrono::milliseconds(timeoutMs < 0 ? 0 : timeoutMs);
+        u32 current = m_control->epoch.load(memory_order_acquire);
+        while (current == epoch)
+        {
+            if (!wait_word(&m_control->epoch, epoch, timeoutMs, deadline))
+                break;
+            current = m_control->epoch.load(memory_order_acquire);
+        }
+        return current;
+    }
+    u32 FastVectorDb::Impl::getReadyFlags()
+    {
+        return m_control ? m_control->ready.load(memory_order_acquire) : 0;
+    }
+    u32 FastVectorDb::Impl::setReadyFlags(u32 mask)
+    {
+        if (!m_control)
+            return 0;
+        u32 flags = m_control->ready.fetch_or(mask, memory_order_seq_cst) | mask;
+        wake(&m_control->ready);
+        return flags;
+    }
+    u32 FastVectorDb::Impl::clearReadyFlags(u32 mask)
+    {
+        if (!m_control)
+            return 0;
+        u32 flags = m_control->ready.fetch_and(~mask, memory_order_seq_cst) & ~mask;
+        wake(&m_control->ready);
+        return flags;
+    }
+    u32 FastVectorDb::Impl::waitReadyFlags(u32 mask, int timeoutMs)
+    {
+        if (!m_control)
+            return 0;
+        auto deadline = chrono::steady_clock::now() + chrono::milliseconds(timeoutMs < 0 ? 0 : timeoutMs);
+        u32 current = m_control->ready.load(memory_order_acquire);
+        while ((current & mask) != mask)
+        {
+            if (!wait_word(&m_control->ready, current, timeoutMs, deadline))
+                break;
+            current = m_control->ready.load(memory_order_acquire);
+        }
+        return current;
+    }
 
     ///////////////////////////////////////////////////////
     FastVectorDb::FastVectorDb(Impl *_impl)
@@ -90,9 +249,13 @@ namespace wx
 
     FastVectorDb *FastVectorDb::load(void *pdata, size_t size, fnFreeDbBuffer fnFreeBuffer, void *cookie)
     {
+        trace_span_t span("FastVectorDb::load");
+        span.num("bytes", size);
         FastVectorDb::Impl *impl = new FastVectorDb::Impl(pdata, size, fnFreeBuffer, cookie);
         if(impl->m_mask_check_ok)
         {
+            stat_add(scDbLoads);
+            stat_add(scDbBytesLoaded, size);
             auto db = new FastVectorDb(impl);
             return db;
         }
@@ -107,6 +270,10 @@ namespace wx
     {
         return impl->tryGetFeature(ref);
     }
+    FastVectorDbFeatureHandle FastVectorDb::getFeatureHandle(FastVectorDbFeatureRef* ref)
+    {
+        return impl->getFeatureHandle(ref);
+    }
 
     void free_data_buffer(void* pdata,size_t size,void* pcookie)
     {
@@ -118,6 +285,8 @@ namespace wx
 printf("\nFastVectorDB:A fast vector database for local cache\n\
 Author: wenyongning@njnu.edu.cn\n");
 printf("loading [%s] ...",filename);
+        trace_span_t span("FastVectorDb::load(file)");
+        span.text("path", filename);
         int fd = open(filename, O_RDONLY); // 打开文件获取描述符
         if (fd == -1)
         { 
@@ -133,6 +302,7 @@ printf("loading [%s] ...",filename);
             return NULL;
         }
         size_t size =  fileStat.st_size;
+        span.num("bytes", size);
         void* pdata = malloc(sizeof(u8)*size+64);
         read(fd,pdata,size);
         close(fd);
@@ -152,6 +322,43 @@ printf("loading [%s] ...",filename);
     {
         return impl->buffer();
     }
+    FastVectorDbMemory FastVectorDb::memoryReport()
+    {
+        return impl->memoryReport();
+    }
+
+    bool FastVectorDb::hasControlHeader()
+    {
+        return impl->hasControlHeader();
+    }
+    u32 FastVectorDb::getEpoch()
+    {
+        return impl->getEpoch();
+    }
+    u32 FastVectorDb::publish()
+    {
+        return impl->publish();
+    }
+    u32 FastVectorDb::wait(u32 epoch, int timeoutMs)
+    {
+        return impl->wait(epoch, timeoutMs);
+    }
+    u32 FastVectorDb::getReadyFlags()
+    {
+        return impl->getReadyFlags();
+    }
+    u32 FastVectorDb::setReadyFlags(u32 mask)
+    {
+        return impl->setReadyFlags(mask);
+    }
+    u32 FastVectorDb::clearReadyFlags(u32 mask)
+    {
+        return impl->clearReadyFlags(mask);
+    }
+    u32 FastVectorDb::waitReadyFlags(u32 mask, int timeoutMs)
+    {
+        return impl->waitReadyFlags(mask, timeoutMs);
+    }
 }
 
 extern "C"
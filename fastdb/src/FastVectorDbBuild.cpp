@@ -1,5 +1,8 @@
 #include "FastVectorDbBuild_p.h"
 #include "FastVectorDbLayerBuild_p.h"
+#include "FastVectorDbSync_p.h"
+#include "FastVectorDbStats_p.h"
+#include "FastVectorDbTrace_p.h"
 #include <assert.h>
 #include <string.h>
 #include <stdio.h>
@@ -15,6 +18,9 @@ namespace wx
         m_gt=gtPoint;
         m_ct=cfF32;
         m_string_table_u32 = false;
+        m_seqlock_chunk_rows = 0;
+        m_control_enable = false;
+        m_back_links_enable = false;
         m_aabbox_enable = false;
         m_extent.minEdge={-180.0,-90.0};
         m_extent.maxEdge={180,90};
@@ -22,6 +28,8 @@ namespace wx
 
     FastVectorDbBuild::Impl::~Impl()
     {
+        for (auto layer : m_layers)
+            delete layer;
     }
 
     void FastVectorDbBuild::Impl::begin(const char *cfg)
@@ -37,6 +45,8 @@ namespace wx
         layer->setExtent(m_extent.minEdge.x, m_extent.minEdge.y, m_extent.maxEdge.x, m_extent.maxEdge.y);
         layer->setGeometryType(m_gt, m_ct, m_aabbox_enable);
         layer->setDbIndex((int)m_layers.size());
+        layer->enableSeqlock(m_seqlock_chunk_rows);
+        layer->impl->enableBackLinks(m_back_links_enable);
         printf(
 "\nfastdb is creating layer[%s] with last(default) params:\n\
 geometry type:%s, coord format:%s, aabbox:%s\n\
@@ -62,6 +72,26 @@ you should check and reset them before adding any feature!!\n",
         m_current_layer->enableStringTableU32(b);
     }
 
+    void FastVectorDbBuild::Impl::enableSeqlock(u32 chunkRows)
+    {
+        m_seqlock_chunk_rows = chunkRows;
+        if(!m_current_layer)
+            return;
+        m_current_layer->enableSeqlock(chunkRows);
+    }
+
+    void FastVectorDbBuild::Impl::enableControlHeader(bool b)
+    {
+        m_control_enable = b;
+    }
+
+    void FastVectorDbBuild::Impl::enableBackLinks(bool b)
+    {
+        m_back_links_enable = b;
+        for (auto layer : m_layers)
+            layer->impl->enableBackLinks(b);
+    }
+
     int FastVectorDbBuild::Impl::addField(const char *name, unsigned ft, double vmin, double vmax) 
     {
         if (!m_current_layer)
@@ -128,18 +158,101 @@ you should check and reset them before adding any feature!!\n",
     }
     void FastVectorDbBuild::Impl::createLayerEnd() {
         if(m_current_layer)
+        {
             m_current_layer->impl->post();
+            stat_add(scLayersBuilt);
+        }
         m_current_layer = nullptr;
     }
     void FastVectorDbBuild::Impl::save(WriteStream *stream) 
     {
+        trace_span_t span("FastVectorDbBuild::save");
         const char magic[] = "FASTVectorDB0.1";
         stream->write((void*)magic, 16);
         u32 layer_count = (u32)m_layers.size();
+        span.num("layers", layer_count);
         stream->write((void*)&layer_count, sizeof(layer_count));
+        size_t offset = 16 + sizeof(layer_count);
         for (auto layer : m_layers)
         {   
             layer->impl->write(stream);
+            offset += layer->impl->get_total_size();
+        }
+        for (auto layer : m_layers)
+        {
+            layer->impl->write_sections(stream, offset);
+        }
+        if (m_back_links_enable)
+            write_back_links(stream, offset);
+        if (m_control_enable)
+        {
+            control_header_t control;
+            memset((void*)&control, 0, sizeof(control));
+            write_section_header(stream, offset, stControl, SECTION_NO_LAYER, sizeof(control));
+            stream->write(&control, sizeof(control));
+        }
+        span.num("bytes", offset);
+    }
+    //the u32 bit-fields of a ref promote to int
+    static bool back_link_target_ok(const FastVectorDbFeatureRef& target, const vector<vector<u32>>& offsets)
+    {
+        return target.ilayer < offsets.size() && size_t(target.ifeature) + 1 < offsets[target.ilayer].size();
+    }
+    //CSR of the recorded refs per target layer, a counting sort keeps the source order
+    void FastVectorDbBuild::Impl::write_back_links(WriteStream *stream, size_t& offset)
+    {
+        u32 layer_count = (u32)m_layers.size();
+        vector<vector<u32>> offsets(layer_count);
+        for (u32 i = 0; i < layer_count; i++)
+            offsets[i].assign(m_layers[i]->impl->feature_count() + 1, 0);
+        size_t dangling = 0;
+        for (auto layer : m_layers)
+        {
+            for (auto& link : layer->impl->back_links())
+            {
+                if (!back_link_target_ok(link.target, offsets))
+                    dangling++;
+                else
+                    offsets[link.target.ilayer][link.target.ifeature + 1]++;
+            }
+        }
+        if (dangling)
+        {
+            char text[256];
+            snprintf(text, sizeof(text), "%zu feature refs point at no feature, left out of the back links!", dangling);
+            warning(text);
+        }
+        vector<vector<FastVectorDbBackLink>> links(layer_count);
+        for (u32 i = 0; i < layer_count; i++)
+        {
+            auto& counts = offsets[i];
+            for (size_t k = 1; k < counts.size(); k++)
+                counts[k] += counts[k - 1];
+            links[i].resize(counts.back());
+        }
+        vector<vector<u32>> cursors = offsets;
+        for (auto layer : m_layers)
+        {
+            for (auto& link : layer->impl->back_links())
+            {
+                if (!back_link_target_ok(link.target, offsets))
+                    continue;
+                links[link.target.ilayer][cursors[link.target.ilayer][link.target.ifeature]++] = link.link;
+            }
+        }
+        for (u32 i = 0; i < layer_count; i++)
+        {
+            backlinks_header_t header;
+            header.feature_count = (u32)m_layers[i]->impl->feature_count();
+            header.link_count = (u32)links[i].size();
+            size_t offsets_size = backlinks_offsets_size(header.feature_count);
+            size_t size = sizeof(header) + offsets_size + links[i].size() * sizeof(FastVectorDbBackLink);
+            write_section_header(stream, offset, stBackLinks, i, size);
+            stream->write(&header, sizeof(header));
+            offsets[i].resize(offsets_size / sizeof(u32), 0);
+            stream->write(offsets[i].data(), offsets_size);
+            if (links[i].size())
+                stream->write(links[i].data(), links[i].size() * sizeof(FastVectorDbBackLink));
         }
     }
     void FastVectorDbBuild::Impl::save(const char *stream)
@@ -193,6 +306,21 @@ you should check and reset them before adding any feature!!\n",
         return impl->addField(name, ft, vmin, vmax);
     }
 
+    void FastVectorDbBuild::enableSeqlock(u32 chunkRows)
+    {
+        impl->enableSeqlock(chunkRows);
+    }
+
+    void FastVectorDbBuild::enableControlHeader(bool b)
+    {
+        impl->enableControlHeader(b);
+    }
+
+    void FastVectorDbBuild::enableBackLinks(bool b)
+    {
+        impl->enableBackLinks(b);
+    }
+
     void FastVectorDbBuild::setGeometryType(GeometryLikeEnum gt, CoordinateFormatEnum ct,bool aabboxEnable)
     {
         return impl->setGeometryType(gt, ct,aabboxEnable);
@@ -256,6 +384,20 @@ saving [%s] ...",filename);
 printf("done!\n");
     }
     
+    void write_section_header(WriteStream* stream, size_t& offset, u32 tag, u32 ilayer, u64 size)
+    {
+        static const u8 zeros[8] = {0};
+        size_t aligned = align_section_offset(offset);
+        if (aligned > offset)
+            stream->write((void*)zeros, aligned - offset);
+        db_section_header_t header;
+        header.tag = tag;
+        header.ilayer = ilayer;
+        header.size = size;
+        stream->write(&header, sizeof(header));
+        offset = aligned + sizeof(header) + size;
+    }
+
     void warning(const char* message)
     {
         printf("FastDb WARNING:%s\n",message);
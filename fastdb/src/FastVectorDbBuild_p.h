@@ -68,6 +68,47 @@ namespace wx
     #pragma pack(pop)
 #endif
 
+    //optional sections are appended after the last layer,
+    //every section header starts at an 8 bytes aligned image offset,
+    //readers skip the tags they don't know and stop at a zero tag.
+    enum DbSectionTagEnum
+    {
+        stEnd     = 0,
+        stSeqlock = 0x4B4C5153, //'SQLK'
+        stControl = 0x4C525443, //'CTRL'
+        stBackLinks = 0x4B4E4C42, //'BLNK'
+    };
+    const u32 SECTION_NO_LAYER = 0xFFFFFFFF;
+    struct db_section_header_t
+    {
+        u32 tag;
+        u32 ilayer; //owner layer or SECTION_NO_LAYER
+        u64 size;   //payload bytes after the header
+    };
+    inline size_t align_section_offset(size_t offset)
+    {
+        return (offset + 7) & ~size_t(7);
+    }
+    void write_section_header(WriteStream* stream, size_t& offset, u32 tag, u32 ilayer, u64 size);
+
+    //payload of a stBackLinks section, one per target layer: the header, u32 offsets[feature_count+1]
+    //padded to 8 bytes, then the FastVectorDbBackLink of each target feature in offsets order
+    struct backlinks_header_t
+    {
+        u32 feature_count;
+        u32 link_count;
+    };
+    inline size_t backlinks_offsets_size(u32 featureCount)
+    {
+        return align_section_offset(sizeof(u32) * (size_t(featureCount) + 1));
+    }
+    //a ref recorded by the layer builder
+    struct build_back_link_t
+    {
+        FastVectorDbFeatureRef  target;
+        FastVectorDbBackLink    link;
+    };
+
     class FastVectorDbLayerBuild;
     class FastVectorDbBuild::Impl
     {
@@ -80,6 +121,9 @@ namespace wx
         int  addField(const char *name, unsigned ft, double vmin = 0, double vmax = 1.0);
         void setGeometryType(GeometryLikeEnum gt, CoordinateFormatEnum ct, bool aaboxEnable);
         void setExtent(double minx, double miny, double maxx, double maxy);
+        void enableSeqlock(u32 chunkRows);
+        void enableControlHeader(bool b);
+        void enableBackLinks(bool b);
         void addFeatureBegin();
         void setGeometry(const char *data, size_t size, GeometryLikeFormat fmt);
         void setField(unsigned ix, double value);
@@ -91,6 +135,8 @@ namespace wx
         void save(WriteStream *stream);
         void save(const char *filename);
 
+    private:
+        void write_back_links(WriteStream *stream, size_t& offset);
     private:
         vector<FastVectorDbLayerBuild *> m_layers;
         FastVectorDbLayerBuild *m_current_layer;
@@ -99,6 +145,9 @@ namespace wx
         GeometryLikeEnum m_gt;
         CoordinateFormatEnum m_ct;
         bool m_string_table_u32;
+        u32  m_seqlock_chunk_rows;
+        bool m_control_enable;
+        bool m_back_links_enable;
         string m_cfg;
         FastVectorDbBuild* m_thiz;
     };
@@ -0,0 +1,349 @@
+#include "fastdb-serve.h"
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <errno.h>
+using namespace std;
+
+namespace wx
+{
+    class FastVectorDbClient::Impl
+    {
+    public:
+        Impl(int sock);
+       ~Impl();
+        bool                lookup(const char* name, u32& db, u32& layer);
+        int                 getFieldIndex(u32 db, u32 layer, const char* field);
+        u32                 send(const Query& q);
+        const QueryResult*  receive();
+        void                freeResult(const QueryResult* result);
+    private:
+        bool                write_all(const void* pdata, size_t size);
+        bool                read_all(void* pdata, size_t size);
+        void                drop_connection(const char* why);
+        bool                attach_columns(QueryResult* result, const u8* payload, u64 size);
+        u32                 send_request(serve_request_t& request, const void* payload);
+    private:
+        int                         m_sock;
+        u32                         m_next_id;
+        u32                         m_pending;
+        map<u32, vector<string>>    m_fields;   //(db<<16|layer) -> field names
+        vector<u8>                  m_buffer;
+    };
+
+    FastVectorDbClient::Impl::Impl(int sock)
+        : m_sock(sock), m_next_id(1), m_pending(0)
+    {
+    }
+    FastVectorDbClient::Impl::~Impl()
+    {
+        close(m_sock);
+    }
+
+    bool FastVectorDbClient::Impl::write_all(const void* pdata, size_t size)
+    {
+        const u8* ptr = (const u8*)pdata;
+        while (size > 0)
+        {
+            ssize_t n = ::send(m_sock, ptr, size, MSG_NOSIGNAL);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+            {
+                printf("fastdb client write failed: %s\n", strerror(errno));
+                return false;
+            }
+            ptr += n;
+            size -= n;
+        }
+        return true;
+    }
+    bool FastVectorDbClient::Impl::read_all(void* pdata, size_t size)
+    {
+        u8* ptr = (u8*)pdata;
+        while (size > 0)
+        {
+            ssize_t n = ::recv(m_sock, ptr, size, 0);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+            {
+                printf("fastdb client read failed: %s\n", n == 0 ? "connection closed" : strerror(errno));
+                return false;
+            }
+            ptr += n;
+            size -= n;
+        }
+        return true;
+    }
+
+    //the rest of the stream can't be framed any more, later calls fail
+    void FastVectorDbClient::Impl::drop_connection(const char* why)
+    {
+        printf("fastdb client dropped the connection: %s\n", why);
+        shutdown(m_sock, SHUT_RDWR);
+        m_pending = 0;
+    }
+
+    u32 FastVectorDbClient::Impl::send_request(serve_request_t& request, const void* payload)
+    {
+        request.magic = SERVE_REQUEST_MAGIC;
+        request.id = m_next_id++;
+        if (m_next_id == 0)
+            m_next_id = 1;
+        //one write per request, the server handles whatever batch has arrived
+        m_buffer.resize(sizeof(serve_request_t) + request.payload_size);
+        memcpy(m_buffer.data(), &request, sizeof(serve_request_t));
+        if (request.payload_size)
+            memcpy(m_buffer.data() + sizeof(serve_request_t), payload, request.payload_size);
+        if (!write_all(m_buffer.data(), m_buffer.size()))
+            return 0;
+        m_pending++;
+        return request.id;
+    }
+
+    bool FastVectorDbClient::Impl::lookup(const char* name, u32& db, u32& layer)
+    {
+        if (m_pending > 0)
+        {
+            printf("fastdb client lookup with %u pending replies, receive them first\n", m_pending);
+            return false;
+        }
+        serve_request_t request;
+        memset(&request, 0, sizeof(request));
+        request.op = soLookup;
+        request.payload_size = strlen(name);
+        if (!send_request(request, name))
+            return false;
+        const QueryResult* result = receive();
+        if (!result)
+            return false;
+        bool ok = result->status == ssOk;
+        freeResult(result);
+        if (ok)
+        {
+            //receive() has parsed the lookup payload into m_buffer
+            const u32* info = (const u32*)m_buffer.data();
+            db = info[0];
+            layer = info[1];
+            vector<string>& names = m_fields[(db << 16) | layer];
+            names.clear();
+            const u8* ptr = (const u8*)(info + 4);
+            for (u32 i = 0; i < info[3]; i++)
+            {
+                u32 size = ((const u32*)ptr)[1];
+                names.push_back(string((const char*)ptr + 8, size));
+                ptr += 8 + ((size + 3) & ~3u);
+            }
+        }
+        return ok;
+    }
+
+    int FastVectorDbClient::Impl::getFieldIndex(u32 db, u32 layer, const char* field)
+    {
+        auto it = m_fields.find((db << 16) | layer);
+        if (it == m_fields.end())
+            return -1;
+        for (size_t i = 0; i < it->second.size(); i++)
+        {
+            if (it->second[i] == field)
+                return (int)i;
+        }
+        return -1;
+    }
+
+    u32 FastVectorDbClient::Impl::send(const Query& q)
+    {
+        serve_request_t request;
+        memset(&request, 0, sizeof(request));
+        request.op = soQuery;
+        request.flags = q.flags;
+        request.db = q.db;
+        request.layer = q.layer;
+        request.bbox[0] = q.minx;
+        request.bbox[1] = q.miny;
+        request.bbox[2] = q.maxx;
+        request.bbox[3] = q.maxy;
+        request.filter_field = q.filterField;
+        request.filter_op = q.filterOp;
+        request.filter_value[0] = q.filterValue[0];
+        request.filter_value[1] = q.filterValue[1];
+        request.max_rows = q.maxRows;
+        request.payload_size = q.fieldCount * sizeof(u32);
+        if (!(q.flags & sfFilterText))
+            return send_request(request, q.fields);
+        //text size, text padded to 4, then the fields
+        u32 size = q.filterText ? (u32)strlen(q.filterText) : 0;
+        vector<u8> payload(sizeof(u32) + ((size + 3) & ~3u), 0);
+        memcpy(payload.data(), &size, sizeof(u32));
+        if (size)
+            memcpy(payload.data() + sizeof(u32), q.filterText, size);
+        payload.insert(payload.end(), (const u8*)q.fields, (const u8*)(q.fields + q.fieldCount));
+        request.payload_size = (u32)payload.size();
+        return send_request(request, payload.data());
+    }
+
+    const FastVectorDbClient::QueryResult* FastVectorDbClient::Impl::receive()
+    {
+        if (m_pending == 0)
+            return NULL;
+        serve_reply_t reply;
+        if (!read_all(&reply, sizeof(reply)))
+            return NULL;
+        if (reply.magic != SERVE_REPLY_MAGIC)
+        {
+            drop_connection("invalid reply");
+            return NULL;
+        }
+        //every column takes 8 bytes of the payload at least
+        if (reply.payload_size > SERVE_MAX_REPLY || reply.column_count > reply.payload_size / 8)
+        {
+            drop_connection("reply too large");
+            return NULL;
+        }
+        m_pending--;
+        size_t head = sizeof(QueryResult) + sizeof(QueryColumn) * reply.column_count;
+        head = (head + 7) & ~(size_t)7;
+        QueryResult* result = (QueryResult*)malloc(head + reply.payload_size);
+        if (!result)
+        {
+            drop_connection("out of memory");
+            return NULL;
+        }
+        u8* payload = (u8*)result + head;
+        if (!read_all(payload, reply.payload_size))
+        {
+            free(result);
+            return NULL;
+        }
+        result->id = reply.id;
+        result->status = reply.status;
+        result->count = reply.row_count;
+        result->columnCount = reply.column_count;
+        result->rows = (const u32*)payload;
+        result->columns = (QueryColumn*)(result + 1);
+        if (reply.op == soLookup)
+        {
+            //lookup reply, kept aside for lookup()
+            m_buffer.assign(payload, payload + reply.payload_size);
+            return result;
+        }
+        if (!attach_columns(result, payload, reply.payload_size))
+        {
+            printf("fastdb client received a damaged reply\n");
+            free(result);
+            return NULL;
+        }
+        return result;
+    }
+
+    //point the columns into the payload, false when the rows or a column run past its end
+    bool FastVectorDbClient::Impl::attach_columns(QueryResult* result, const u8* payload, u64 size)
+    {
+        u64 rows = result->count;
+        u64 at = (rows * sizeof(u32) + 7) & ~(u64)7;
+        if (at > size)
+            return false;
+        for (u32 i = 0; i < result->columnCount; i++)
+        {
+            QueryColumn& column = result->columns[i];
+            memset(&column, 0, sizeof(column));
+            if (size - at < 8)
+                return false;
+            column.type = *(const u32*)(payload + at);
+            at += 8;
+            u64 bytes = 0;
+            if (column.type == scF64)
+            {
+                column.values = (const double*)(payload + at);
+                bytes = sizeof(double) * rows;
+            }
+            else if (column.type == scSTR)
+            {
+                if ((rows + 1) * sizeof(u32) > size - at)
+                    return false;
+                column.offsets = (const u32*)(payload + at);
+                column.text = (const char*)(column.offsets + rows + 1);
+                bytes = sizeof(u32) * (rows + 1) + column.offsets[rows];
+                for (u64 r = 0; r < rows; r++)
+                {
+                    if (column.offsets[r] > column.offsets[r + 1])
+                        return false;
+                }
+            }
+            if (bytes > size - at)
+                return false;
+            at += std::min<u64>((bytes + 7) & ~(u64)7, size - at);
+        }
+        return true;
+    }
+
+    void FastVectorDbClient::Impl::freeResult(const QueryResult* result)
+    {
+        free((void*)result);
+    }
+
+    ///////////////////////////////////////////////////////////////////////////////
+    FastVectorDbClient::FastVectorDbClient(Impl* _impl)
+        : impl(_impl)
+    {
+    }
+    FastVectorDbClient::~FastVectorDbClient()
+    {
+        delete impl;
+    }
+    FastVectorDbClient* FastVectorDbClient::connect(const char* path)
+    {
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if (strlen(path) >= sizeof(addr.sun_path))
+        {
+            printf("fastdb client socket path too long: %s\n", path);
+            return nullptr;
+        }
+        strcpy(addr.sun_path, path);
+        int sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (sock == -1)
+            return nullptr;
+        if (::connect(sock, (struct sockaddr*)&addr, sizeof(addr)) == -1)
+        {
+            printf("fastdb client can not connect %s: %s\n", path, strerror(errno));
+            close(sock);
+            return nullptr;
+        }
+        return new FastVectorDbClient(new Impl(sock));
+    }
+    bool FastVectorDbClient::lookup(const char* name, u32& db, u32& layer)
+    {
+        return impl->lookup(name, db, layer);
+    }
+    int FastVectorDbClient::getFieldIndex(u32 db, u32 layer, const char* field)
+    {
+        return impl->getFieldIndex(db, layer, field);
+    }
+    u32 FastVectorDbClient::send(const Query& q)
+    {
+        return impl->send(q);
+    }
+    const FastVectorDbClient::QueryResult* FastVectorDbClient::receive()
+    {
+        return impl->receive();
+    }
+    const FastVectorDbClient::QueryResult* FastVectorDbClient::query(const Query& q)
+    {
+        if (!impl->send(q))
+            return nullptr;
+        return impl->receive();
+    }
+    void FastVectorDbClient::freeResult(const QueryResult* result)
+    {
+        if (!result)
+            return;
+        impl->freeResult(result);
+    }
+}
@@ -0,0 +1,618 @@
+#include "FastVectorDb_p.h"
+#include "FastVectorDbDiff_p.h"
+#include <unordered_map>
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <nmmintrin.h>
+#define FASTDB_CRC32C_SSE42
+#endif
+
+namespace wx
+{
+    static const char SIGNATURE_MAGIC[8] = "FDBSIG1";
+    static const char PATCH_MAGIC[8] = "FDBPAT1";
+    static const char RELOCATE_MAGIC[8] = "FDBREL1";
+
+    //CRC32C (Castagnoli), hardware crc32 instruction when the cpu has SSE4.2
+    static u32 crc32c_table[256];
+    static bool crc32c_init_table()
+    {
+        for (u32 i = 0; i < 256; i++)
+        {
+            u32 c = i;
+            for (int k = 0; k < 8; k++)
+                c = (c & 1) ? (c >> 1) ^ 0x82F63B78 : c >> 1;
+            crc32c_table[i] = c;
+        }
+        return true;
+    }
+    static u32 crc32c_sw(u32 crc, const u8 *p, size_t size)
+    {
+        static bool ready = crc32c_init_table();
+        (void)ready;
+        for (size_t i = 0; i < size; i++)
+            crc = crc32c_table[(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
+        return crc;
+    }
+#ifdef FASTDB_CRC32C_SSE42
+    __attribute__((target("sse4.2")))
+    static u32 crc32c_hw(u32 crc, const u8 *p, size_t size)
+    {
+        u64 c = crc;
+        for (; size >= 8; p += 8, size -= 8)
+        {
+            u64 v;
+            memcpy(&v, p, 8);
+            c = _mm_crc32_u64(c, v);
+        }
+        u32 c32 = (u32)c;
+        for (; size > 0; p++, size--)
+            c32 = _mm_crc32_u8(c32, *p);
+        return c32;
+    }
+#endif
+    u32 crc32c(u32 crc, const void *pdata, size_t size)
+    {
+        crc = ~crc;
+#ifdef FASTDB_CRC32C_SSE42
+        static bool has_sse42 = __builtin_cpu_supports("sse4.2");
+        if (has_sse42)
+            return ~crc32c_hw(crc, (const u8 *)pdata, size);
+#endif
+        return ~crc32c_sw(crc, (const u8 *)pdata, size);
+    }
+
+    class VectorWriteStream : public WriteStream
+    {
+    public:
+        void write(void *pdata, size_t size) override
+        {
+            data.insert(data.end(), (const u8 *)pdata, (const u8 *)pdata + size);
+        }
+        vector<u8> data;
+    };
+
+    static void add_blocks(vector<patch_chunk_t> &chunks, PatchChunkKindEnum kind, u32 ilayer, size_t begin, size_t end)
+    {
+        for (size_t offset = begin; offset < end; offset += DIFF_BLOCK_SIZE)
+        {
+            patch_chunk_t chunk;
+            memset(&chunk, 0, sizeof(chunk));
+            chunk.kind = kind;
+            chunk.ilayer = ilayer;
+            chunk.offset = offset;
+            chunk.size = (u32)min((size_t)DIFF_BLOCK_SIZE, end - offset);
+            chunks.push_back(chunk);
+        }
+    }
+
+    size_t FastVectorDb::Impl::layers_end()
+    {
+        size_t end = 16 + sizeof(u32);
+        for (auto layer : m_layers)
+            end += layer->impl->m_header->total_size;
+        return end;
+    }
+
+    void FastVectorDb::Impl::collect_chunks(u32 chunkRows, vector<patch_chunk_t> &chunks)
+    {
+        const u8 *base = (const u8 *)m_pdata;
+        chunks.clear();
+        //magic and layer count
+        add_blocks(chunks, pkMeta, 0, 0, 16 + sizeof(u32));
+        for (u32 il = 0; il < m_layers.size(); il++)
+        {
+            auto impl = m_layers[il]->impl;
+            size_t layer0 = impl->m_data - base;
+            size_t data0 = impl->m_data_ptr0 - base;
+            size_t table0 = impl->m_table_data_ptr0 - base;
+            u32 count = impl->m_header->feature_count;
+            size_t line = impl->m_table_line_size;
+            size_t table_end = table0 + count * line;
+            size_t layer_end = layer0 + impl->m_header->total_size;
+
+            add_blocks(chunks, pkMeta, il, layer0, data0);
+
+            //geometry stream, chunk boundaries follow the feature boundaries
+            auto gt = impl->m_header->geometry_type;
+            if (gt == gtAny || gt == gtPoint || gt == gtLineString || gt == gtPolygon)
+            {
+                //walked with a local pointer, the layer's own iterator may be in use
+                const u8 *geometry_ptr = impl->m_geometry_ptr0;
+                size_t start = data0;
+                for (u32 row = 0; row < count; row++)
+                {
+                    if (row > 0 && row % chunkRows == 0)
+                    {
+                        size_t at = geometry_ptr - base;
+                        patch_chunk_t chunk = {pkGeometry, (u16)il, row - chunkRows, chunkRows, (u32)(at - start), start, 0, 0};
+                        chunks.push_back(chunk);
+                        start = at;
+                    }
+                    geometry_ptr += impl->get_geometry_like_size(geometry_ptr);
+                }
+                if (count > 0)
+                {
+                    u32 first = (count - 1) / chunkRows * chunkRows;
+                    patch_chunk_t chunk = {pkGeometry, (u16)il, first, count - first, (u32)(table0 - start), start, 0, 0};
+                    chunks.push_back(chunk);
+                }
+            }
+            else
+            {
+                add_blocks(chunks, pkGeometry, il, data0, table0);
+            }
+
+            for (u32 row = 0; row < count; row += chunkRows)
+            {
+                u32 rows = min(chunkRows, count - row);
+                patch_chunk_t chunk = {pkRows, (u16)il, row, rows, (u32)(rows * line), table0 + row * line, 0, 0};
+                chunks.push_back(chunk);
+            }
+
+            add_blocks(chunks, pkStrings, il, table_end, layer_end);
+        }
+        //back links follow the refs of the rows
+        for (auto &section : m_backlink_sections)
+            add_blocks(chunks, pkMeta, 0, section.first, section.second);
+        for (auto &chunk : chunks)
+        {
+            chunk.crc = crc32c(0, base + chunk.offset, chunk.size);
+        }
+    }
+
+    bool FastVectorDb::Impl::signature(WriteStream *stream, u32 chunkRows)
+    {
+        if (chunkRows == 0)
+            return false;
+        vector<patch_chunk_t> chunks;
+        collect_chunks(chunkRows, chunks);
+        signature_header_t header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, SIGNATURE_MAGIC, sizeof(header.magic));
+        header.image_size = m_size;
+        header.chunk_rows = chunkRows;
+        header.chunk_count = chunks.size();
+        stream->write(&header, sizeof(header));
+        stream->write(chunks.data(), chunks.size() * sizeof(patch_chunk_t));
+        return true;
+    }
+
+    bool FastVectorDb::Impl::diff(const void *psignature, size_t size, WriteStream *stream)
+    {
+        const signature_header_t *header = (const signature_header_t *)psignature;
+        if (size < sizeof(signature_header_t) || memcmp(header->magic, SIGNATURE_MAGIC, sizeof(header->magic)) != 0 ||
+            size < sizeof(signature_header_t) + header->chunk_count * sizeof(patch_chunk_t))
+        {
+            printf("fastdb diff: invalid signature\n");
+            return false;
+        }
+        if (header->chunk_rows == 0)
+        {
+            printf("fastdb diff: invalid signature\n");
+            return false;
+        }
+        vector<patch_chunk_t> chunks;
+        collect_chunks(header->chunk_rows, chunks);
+        const patch_chunk_t *theirs = (const patch_chunk_t *)(header + 1);
+        if (header->image_size != m_size || header->chunk_count != chunks.size())
+            return relocate(header, chunks, stream);
+        for (size_t i = 0; i < chunks.size(); i++)
+        {
+            const patch_chunk_t &a = chunks[i];
+            const patch_chunk_t &b = theirs[i];
+            if (a.kind != b.kind || a.ilayer != b.ilayer || a.offset != b.offset || a.size != b.size ||
+                a.first_row != b.first_row || a.row_count != b.row_count)
+                return relocate(header, chunks, stream);
+        }
+        //changed chunks, consecutive ones of the same layer and kind are merged into one op
+        vector<patch_chunk_t> ops;
+        for (size_t i = 0; i < chunks.size(); i++)
+        {
+            const patch_chunk_t &a = chunks[i];
+            const patch_chunk_t &b = theirs[i];
+            if (a.crc == b.crc)
+                continue;
+            if (ops.size())
+            {
+                patch_chunk_t &last = ops.back();
+                if (last.kind == a.kind && last.ilayer == a.ilayer && last.offset + last.size == a.offset)
+                {
+                    last.size += a.size;
+                    last.row_count += a.row_count;
+                    continue;
+                }
+            }
+            ops.push_back(a);
+        }
+        const u8 *base = (const u8 *)m_pdata;
+        patch_header_t patch;
+        memset(&patch, 0, sizeof(patch));
+        memcpy(patch.magic, PATCH_MAGIC, sizeof(patch.magic));
+        patch.image_size = m_size;
+        patch.chunk_rows = header->chunk_rows;
+        patch.op_count = ops.size();
+        stream->write(&patch, sizeof(patch));
+        u8 padding[8] = {0};
+        for (auto &op : ops)
+        {
+            op.crc = crc32c(0, base + op.offset, op.size);
+            stream->write(&op, sizeof(op));
+            stream->write((void *)(base + op.offset), op.size);
+            if (op.size % 8)
+                stream->write(padding, 8 - op.size % 8);
+        }
+        return true;
+    }
+
+    //key of a chunk's content, chunks of the base are found again wherever the new image has moved them
+    static u64 chunk_key(const patch_chunk_t &chunk)
+    {
+        u64 key = ((u64)chunk.crc << 32) | chunk.size;
+        key ^= ((u64)chunk.kind << 56) ^ ((u64)chunk.ilayer << 40) ^ ((u64)chunk.first_row * 0x9E3779B97F4A7C15ull);
+        return key ^ ((u64)chunk.row_count << 20);
+    }
+
+    bool FastVectorDb::Impl::relocate(const signature_header_t *header, const vector<patch_chunk_t> &chunks, WriteStream *stream)
+    {
+        const patch_chunk_t *theirs = (const patch_chunk_t *)(header + 1);
+        unordered_map<u64, u32> known;
+        known.reserve(header->chunk_count);
+        for (u32 i = 0; i < header->chunk_count; i++)
+        {
+            if (theirs[i].offset + theirs[i].size <= header->image_size)
+                known.emplace(chunk_key(theirs[i]), i);
+        }
+        //the whole new image as copies and literals, neighbours of the same sort are merged
+        vector<relocate_op_t> ops;
+        auto emit = [&](size_t offset, u64 source, size_t size) {
+            if (size == 0)
+                return;
+            if (ops.size())
+            {
+                relocate_op_t &last = ops.back();
+                bool literal = source == RELOCATE_LITERAL;
+                if ((last.source == RELOCATE_LITERAL) == literal && last.size + size < (1u << 30) &&
+                    (literal || last.source + last.size == source))
+                {
+                    last.size += size;
+                    return;
+                }
+            }
+            relocate_op_t op = {offset, source, (u32)size, 0};
+            ops.push_back(op);
+        };
+        size_t pos = 0;
+        for (auto &chunk : chunks)
+        {
+            emit(pos, RELOCATE_LITERAL, chunk.offset - pos);
+            auto it = known.find(chunk_key(chunk));
+            const patch_chunk_t *base = it == known.end() ? NULL : theirs + it->second;
+            if (base && base->kind == chunk.kind && base->ilayer == chunk.ilayer && base->first_row == chunk.first_row &&
+                base->row_count == chunk.row_count && base->size == chunk.size && base->crc == chunk.crc)
+                emit(chunk.offset, base->offset, chunk.size);
+            else
+                emit(chunk.offset, RELOCATE_LITERAL, chunk.size);
+            pos = chunk.offset + chunk.size;
+        }
+        emit(pos, RELOCATE_LITERAL, m_size - pos);
+
+        const u8 *image = (const u8 *)m_pdata;
+        relocate_header_t patch;
+        memset(&patch, 0, sizeof(patch));
+        memcpy(patch.magic, RELOCATE_MAGIC, sizeof(patch.magic));
+        patch.image_size = m_size;
+        patch.base_size = header->image_size;
+        patch.chunk_rows = header->chunk_rows;
+        patch.op_count = ops.size();
+        stream->write(&patch, sizeof(patch));
+        u8 padding[8] = {0};
+        for (auto &op : ops)
+        {
+            //a copied range has the same bytes in both images
+            op.crc = crc32c(0, image + op.offset, op.size);
+            stream->write(&op, sizeof(op));
+            if (op.source != RELOCATE_LITERAL)
+                continue;
+            stream->write((void *)(image + op.offset), op.size);
+            if (op.size % 8)
+                stream->write(padding, 8 - op.size % 8);
+        }
+        return true;
+    }
+
+    static void free_patched_buffer(void *pdata, size_t, void *)
+    {
+        free(pdata);
+    }
+
+    FastVectorDb *FastVectorDb::loadPatched(FastVectorDb *base, const void *pdata, size_t size)
+    {
+        if (!base)
+            return NULL;
+        const u8 *image = (const u8 *)base->impl->m_pdata;
+        size_t base_size = base->impl->m_size;
+        const relocate_header_t *header = (const relocate_header_t *)pdata;
+        if (size >= sizeof(patch_header_t) && memcmp(header->magic, PATCH_MAGIC, sizeof(header->magic)) == 0)
+        {
+            //same size: the ops are written to a copy before it is loaded, so they may change the layout
+            if (!base->impl->check_patch(pdata, size, false))
+                return NULL;
+            u8 *copy = (u8 *)malloc(base_size);
+            if (!copy)
+                return NULL;
+            memcpy(copy, image, base_size);
+            const u8 *ptr = (const u8 *)pdata + sizeof(patch_header_t);
+            for (u32 i = 0; i < ((const patch_header_t *)pdata)->op_count; i++)
+            {
+                const patch_chunk_t *op = (const patch_chunk_t *)ptr;
+                ptr += sizeof(patch_chunk_t);
+                memcpy(copy + op->offset, ptr, op->size);
+                ptr += ((size_t)op->size + 7) & ~(size_t)7;
+            }
+            FastVectorDb *db = load(copy, base_size, free_patched_buffer, NULL);
+            if (!db)
+                free(copy);
+            return db;
+        }
+        if (size < sizeof(relocate_header_t) || memcmp(header->magic, RELOCATE_MAGIC, sizeof(header->magic)) != 0)
+        {
+            printf("fastdb patch: invalid patch\n");
+            return NULL;
+        }
+        if (header->base_size != base_size)
+        {
+            printf("fastdb patch: patch does not match the database layout\n");
+            return NULL;
+        }
+        //validate every op before allocating, copies must find the same bytes in the base
+        const u8 *ptr = (const u8 *)(header + 1);
+        const u8 *end = (const u8 *)pdata + size;
+        u64 pos = 0;
+        for (u32 i = 0; i < header->op_count; i++)
+        {
+            if (ptr + sizeof(relocate_op_t) > end)
+                return NULL;
+            const relocate_op_t *op = (const relocate_op_t *)ptr;
+            ptr += sizeof(relocate_op_t);
+            bool ok = op->offset == pos && op->size <= header->image_size - pos;
+            if (ok && op->source == RELOCATE_LITERAL)
+            {
+                ok = op->size <= (size_t)(end - ptr) && crc32c(0, ptr, op->size) == op->crc;
+                ptr += ok ? (op->size + 7) & ~7ull : 0;
+            }
+            else if (ok)
+            {
+                ok = op->source <= base_size && op->size <= base_size - op->source &&
+                     crc32c(0, image + op->source, op->size) == op->crc;
+            }
+            if (!ok)
+            {
+                printf("fastdb patch: corrupted op %u\n", i);
+                return NULL;
+            }
+            pos += op->size;
+        }
+        if (pos != header->image_size || pos < 16 + sizeof(u32))
+        {
+            printf("fastdb patch: incomplete patch\n");
+            return NULL;
+        }
+        u8 *buffer = (u8 *)malloc(header->image_size);
+        if (!buffer)
+            return NULL;
+        ptr = (const u8 *)(header + 1);
+        for (u32 i = 0; i < header->op_count; i++)
+        {
+            const relocate_op_t *op = (const relocate_op_t *)ptr;
+            ptr += sizeof(relocate_op_t);
+            if (op->source == RELOCATE_LITERAL)
+            {
+                memcpy(buffer + op->offset, ptr, op->size);
+                ptr += (op->size + 7) & ~7ull;
+            }
+            else
+            {
+                memcpy(buffer + op->offset, image + op->source, op->size);
+            }
+        }
+        if (strcmp((const char *)buffer, "FASTVectorDB0.1") != 0)
+        {
+            printf("fastdb patch: invalid patch\n");
+            free(buffer);
+            return NULL;
+        }
+        FastVectorDb *db = load(buffer, header->image_size, free_patched_buffer, NULL);
+        if (!db)
+            free(buffer);
+        return db;
+    }
+
+    //the layer objects keep pointers and sizes derived from the file and layer headers and the field
+    //definitions: of these only names, extents and value ranges may change in place, the changed bytes
+    //of the range [offset,offset+size) of the image are checked against that
+    bool FastVectorDb::Impl::patch_keeps_layout(size_t offset, const u8 *bytes, size_t size)
+    {
+        const u8 *image = (const u8 *)m_pdata;
+        for (size_t i = 0; i < size; i++)
+        {
+            size_t pos = offset + i;
+            if (bytes[i] == image[pos])
+                continue;
+            if (pos < 16 + sizeof(u32))
+                return false;
+            for (auto layer : m_layers)
+            {
+                auto impl = layer->impl;
+                size_t layer0 = impl->m_data - image;
+                size_t fields0 = layer0 + sizeof(layer_header_t);
+                size_t data0 = impl->m_data_ptr0 - image;
+                if (pos >= layer0 && pos < fields0)
+                {
+                    size_t at = pos - layer0;
+                    bool name = at < sizeof(impl->m_header->name);
+                    bool extent = at >= offsetof(layer_header_t, minx) && at < offsetof(layer_header_t, offset_table);
+                    if (!name && !extent)
+                        return false;
+                }
+                else if (pos >= fields0 && pos < data0)
+                {
+                    size_t at = (pos - fields0) % sizeof(field_desc_ex_t);
+                    bool name = at < sizeof(impl->m_field_descs->name);
+                    bool range = at >= offsetof(field_desc_ex_t, vmin) && at < offsetof(field_desc_ex_t, size);
+                    if (!name && !range)
+                        return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    //checks every op of a same size patch against this image before anything is written, so a bad
+    //patch leaves it unchanged. in place the layout the layers were opened with has to stay
+    bool FastVectorDb::Impl::check_patch(const void *pdata, size_t size, bool in_place)
+    {
+        const patch_header_t *header = (const patch_header_t *)pdata;
+        if (size >= sizeof(patch_header_t) && memcmp(header->magic, RELOCATE_MAGIC, sizeof(header->magic)) == 0)
+        {
+            printf("fastdb patch: the patch changes the image size, load it with FastVectorDb::loadPatched\n");
+            return false;
+        }
+        if (size < sizeof(patch_header_t) || memcmp(header->magic, PATCH_MAGIC, sizeof(header->magic)) != 0)
+        {
+            printf("fastdb patch: invalid patch\n");
+            return false;
+        }
+        if (header->image_size != m_size)
+        {
+            printf("fastdb patch: patch does not match the database layout\n");
+            return false;
+        }
+        size_t limit = layers_end();
+        const u8 *ptr = (const u8 *)(header + 1);
+        const u8 *end = (const u8 *)pdata + size;
+        for (u32 i = 0; i < header->op_count; i++)
+        {
+            if (sizeof(patch_chunk_t) > (size_t)(end - ptr))
+                return false;
+            const patch_chunk_t *op = (const patch_chunk_t *)ptr;
+            ptr += sizeof(patch_chunk_t);
+            //compared by subtraction, a forged offset or size can't wrap around
+            bool in_image = op->offset <= limit && op->size <= limit - op->offset;
+            for (auto &section : m_backlink_sections)
+                in_image = in_image || (op->offset >= section.first && op->offset <= section.second &&
+                                        op->size <= section.second - op->offset);
+            if (op->size > (size_t)(end - ptr) || !in_image ||
+                crc32c(0, ptr, op->size) != op->crc)
+            {
+                printf("fastdb patch: corrupted op %u\n", i);
+                return false;
+            }
+            if (in_place && !patch_keeps_layout(op->offset, ptr, op->size))
+            {
+                printf("fastdb patch: op %u changes the database layout, load the patch with FastVectorDb::loadPatched\n", i);
+                return false;
+            }
+            if (op->kind == pkRows)
+            {
+                if (op->ilayer >= m_layers.size())
+                    return false;
+                auto impl = m_layers[op->ilayer]->impl;
+                const u8 *row0 = impl->m_table_data_ptr0 + (size_t)op->first_row * impl->m_table_line_size;
+                if ((u64)op->first_row + op->row_count > impl->m_header->feature_count ||
+                    row0 != (const u8 *)m_pdata + op->offset ||
+                    op->size != op->row_count * impl->m_table_line_size)
+                {
+                    printf("fastdb patch: rows op %u does not match the database layout\n", i);
+                    return false;
+                }
+            }
+            ptr += ((size_t)op->size + 7) & ~(size_t)7;
+            if (i + 1 < header->op_count && ptr > end)
+                return false;
+        }
+        return true;
+    }
+
+    bool FastVectorDb::Impl::applyPatch(const void *pdata, size_t size)
+    {
+        if (!check_patch(pdata, size, true))
+            return false;
+        const patch_header_t *header = (const patch_header_t *)pdata;
+        vector<bool> geometry_dirty(m_layers.size(), false);
+        vector<bool> strings_dirty(m_layers.size(), false);
+        u8 *base = (u8 *)m_pdata;
+        const u8 *ptr = (const u8 *)(header + 1);
+        for (u32 i = 0; i < header->op_count; i++)
+        {
+            const patch_chunk_t *op = (const patch_chunk_t *)ptr;
+            ptr += sizeof(patch_chunk_t);
+            if (op->kind == pkRows && m_layers[op->ilayer]->impl->hasSeqlock())
+            {
+                //rows go through the seqlock chunk by chunk, so readers in other processes never see torn rows
+                auto impl = m_layers[op->ilayer]->impl;
+                u32 chunk_rows = impl->getSeqlockChunkRows();
+                size_t line = impl->m_table_line_size;
+                u32 row = op->first_row;
+                u32 row_end = op->first_row + op->row_count;
+                while (row < row_end)
+                {
+                    u32 next = min(row_end, (row / chunk_rows + 1) * chunk_rows);
+                    impl->beginUpdate(row);
+                    memcpy(base + op->offset + (size_t)(row - op->first_row) * line,
+                           ptr + (size_t)(row - op->first_row) * line, (size_t)(next - row) * line);
+                    impl->endUpdate(row);
+                    row = next;
+                }
+            }
+            else
+            {
+                memcpy(base + op->offset, ptr, op->size);
+            }
+            //the ranges written decide what is rebuilt, whatever kind the op claims to be
+            for (size_t il = 0; il < m_layers.size(); il++)
+            {
+                auto impl = m_layers[il]->impl;
+                size_t data0 = impl->m_data_ptr0 - base;
+                size_t table0 = impl->m_table_data_ptr0 - base;
+                size_t strings0 = data0 + impl->m_header->offset_strings;
+                size_t layer_end = impl->m_data - base + impl->m_header->total_size;
+                if (op->offset < table0 && op->offset + op->size > data0)
+                    geometry_dirty[il] = true;
+                if (op->offset < layer_end && op->offset + op->size > strings0)
+                    strings_dirty[il] = true;
+            }
+            ptr += ((size_t)op->size + 7) & ~(size_t)7;
+        }
+        for (size_t i = 0; i < m_layers.size(); i++)
+        {
+            if (geometry_dirty[i])
+                m_layers[i]->impl->refresh_geometry_map();
+            if (strings_dirty[i])
+                m_layers[i]->impl->reload_string_tables();
+        }
+        return true;
+    }
+
+    ///////////////////////////////////////////////////////////////////////////////
+    bool FastVectorDb::signature(WriteStream *stream, u32 chunkRows)
+    {
+        return impl->signature(stream, chunkRows);
+    }
+    bool FastVectorDb::diff(const void *signature, size_t size, WriteStream *patch)
+    {
+        return impl->diff(signature, size, patch);
+    }
+    bool FastVectorDb::diff(FastVectorDb *base, FastVectorDb *target, WriteStream *patch, u32 chunkRows)
+    {
+        if (!base || !target)
+            return false;
+        VectorWriteStream signature;
+        if (!base->impl->signature(&signature, chunkRows))
+            return false;
+        return target->impl->diff(signature.data.data(), signature.data.size(), patch);
+    }
+    bool FastVectorDb::applyPatch(const void *patch, size_t size)
+    {
+        return impl->applyPatch(patch, size);
+    }
+}
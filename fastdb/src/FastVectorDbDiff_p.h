@@ -0,0 +1,76 @@
+#pragma once
+#ifndef __FAST_VECTOR_DB_DIFF_P_H__
+#define __FAST_VECTOR_DB_DIFF_P_H__
+//row level diff/patch between two versions of the same database layout.
+//an image is cut into chunks: layer meta blocks, geometry and table rows per chunk_rows features,
+//string table blocks. a signature lists every chunk with its CRC32C,
+//a patch carries only the chunks whose CRC differs from the signature.
+#include "fastdb.h"
+#include <vector>
+using namespace std;
+namespace wx
+{
+    enum PatchChunkKindEnum
+    {
+        pkMeta = 1,     //layer header and field descriptors
+        pkGeometry,     //geometry stream of rows [first_row,first_row+row_count)
+        pkRows,         //table rows [first_row,first_row+row_count)
+        pkStrings       //string/wstring tables
+    };
+
+    static const u32 DIFF_BLOCK_SIZE = 4096;
+
+    struct patch_chunk_t
+    {
+        u16     kind;       //PatchChunkKindEnum
+        u16     ilayer;
+        u32     first_row;
+        u32     row_count;
+        u32     size;
+        u64     offset;     //image offset
+        u32     crc;        //CRC32C of the chunk bytes
+        u32     reserved;
+    };
+
+    struct signature_header_t
+    {
+        char    magic[8];   //"FDBSIG1"
+        u64     image_size;
+        u32     chunk_rows;
+        u32     chunk_count;
+    };
+    //followed by chunk_count patch_chunk_t
+
+    struct patch_header_t
+    {
+        char    magic[8];   //"FDBPAT1"
+        u64     image_size;
+        u32     chunk_rows;
+        u32     op_count;
+    };
+    //followed by op_count patch_chunk_t, each one followed by its bytes padded to 8
+
+    //a patch that changes the image size, e.g. replaced geometries of another size, can not be applied
+    //in place: it describes the whole new image as copies of base chunks and literal bytes.
+    static const u64 RELOCATE_LITERAL = ~0ull;
+
+    struct relocate_header_t
+    {
+        char    magic[8];   //"FDBREL1"
+        u64     image_size; //new image
+        u64     base_size;
+        u32     chunk_rows;
+        u32     op_count;
+    };
+
+    struct relocate_op_t
+    {
+        u64     offset;     //new image offset, ops are contiguous from 0 to image_size
+        u64     source;     //base image offset, RELOCATE_LITERAL: the bytes follow padded to 8
+        u32     size;
+        u32     crc;        //CRC32C of the bytes
+    };
+
+    u32 crc32c(u32 crc, const void *pdata, size_t size);
+}
+#endif
@@ -0,0 +1,761 @@
+#include "FastVectorDbFilter_p.h"
+#include "FastVectorDbTrace_p.h"
+#include <ctype.h>
+#include <math.h>
+
+namespace wx
+{
+    enum FilterOpEnum
+    {
+        opEq = 0,
+        opNe,
+        opLt,
+        opLe,
+        opGt,
+        opGe,
+        opAdd,
+        opSub,
+        opMul,
+        opDiv
+    };
+
+    //a < b is b > a
+    static int filter_mirror(int op)
+    {
+        switch (op)
+        {
+        case opLt: return opGt;
+        case opLe: return opGe;
+        case opGt: return opLt;
+        case opGe: return opLe;
+        }
+        return op;
+    }
+
+    static double filter_apply(int op, double a, double b)
+    {
+        switch (op)
+        {
+        case opAdd: return a + b;
+        case opSub: return a - b;
+        case opMul: return a * b;
+        case opDiv: return a / b;
+        }
+        return NAN;
+    }
+
+    static bool filter_test(int op, double a, double b)
+    {
+        switch (op)
+        {
+        case opEq: return a == b;
+        case opNe: return a != b;
+        case opLt: return a < b;
+        case opLe: return a <= b;
+        case opGt: return a > b;
+        case opGe: return a >= b;
+        }
+        return false;
+    }
+
+    class filter_constant_t : public filter_number_t
+    {
+    public:
+        filter_constant_t(double value) : m_value(value) {}
+        void eval(u32, u32 count, double *out) override
+        {
+            for (u32 i = 0; i < count; i++)
+                out[i] = m_value;
+        }
+        bool constant(double &value) override
+        {
+            value = m_value;
+            return true;
+        }
+    private:
+        double m_value;
+    };
+
+    //a numeric field, read the way FastVectorDbLayer::getFieldAsFloat / getFieldAsInt do
+    class filter_field_t : public filter_number_t
+    {
+    public:
+        filter_field_t(const u8 *column, size_t stride, FieldTypeEnum ft, double vmin, double vmax)
+            : m_column(column), m_stride(stride), m_ft(ft), m_bias(vmin),
+              m_scale(ft == ftU8n ? (vmax - vmin) / 255.0 : (vmax - vmin) / 65535.0) {}
+        void eval(u32 first, u32 count, double *out) override
+        {
+            const u8 *p = m_column + m_stride * first;
+            switch (m_ft)
+            {
+            case ftU8:
+                load<u8>(p, count, out);
+                break;
+            case ftU16:
+                load<u16>(p, count, out);
+                break;
+            case ftU32:
+                load<u32>(p, count, out);
+                break;
+            case ftI32:
+                load<int>(p, count, out);  //i32 is unsigned in fastdb-config.h
+                break;
+            case ftF32:
+                load<f32>(p, count, out);
+                break;
+            case ftF64:
+                load<f64>(p, count, out);
+                break;
+            case ftU8n:
+                load<u8>(p, count, out);
+                scale(count, out);
+                break;
+            case ftU16n:
+                load<u16>(p, count, out);
+                scale(count, out);
+                break;
+            default:
+                break;
+            }
+        }
+    private:
+        template <class T>
+        void load(const u8 *p, u32 count, double *out)
+        {
+            for (u32 i = 0; i < count; i++, p += m_stride)
+            {
+                T v;
+                memcpy(&v, p, sizeof(v));
+                out[i] = v;
+            }
+        }
+        void scale(u32 count, double *out)
+        {
+            for (u32 i = 0; i < count; i++)
+                out[i] = m_bias + m_scale * out[i];
+        }
+    private:
+        const u8*       m_column;
+        size_t          m_stride;
+        FieldTypeEnum   m_ft;
+        double          m_bias;
+        double          m_scale;
+    };
+
+    class filter_negate_t : public filter_number_t
+    {
+    public:
+        filter_negate_t(unique_ptr<filter_number_t> a) : m_a(std::move(a)) {}
+        void eval(u32 first, u32 count, double *out) override
+        {
+            m_a->eval(first, count, out);
+            for (u32 i = 0; i < count; i++)
+                out[i] = -out[i];
+        }
+    private:
+        unique_ptr<filter_number_t> m_a;
+    };
+
+    class filter_arith_t : public filter_number_t
+    {
+    public:
+        filter_arith_t(int op, unique_ptr<filter_number_t> a, unique_ptr<filter_number_t> b)
+            : m_op(op), m_a(std::move(a)), m_b(std::move(b)), m_tmp(FILTER_BATCH_ROWS) {}
+        void eval(u32 first, u32 count, double *out) override
+        {
+            m_a->eval(first, count, out);
+            m_b->eval(first, count, m_tmp.data());
+            const double *b = m_tmp.data();
+            switch (m_op)
+            {
+            case opAdd:
+                for (u32 i = 0; i < count; i++)
+                    out[i] += b[i];
+                break;
+            case opSub:
+                for (u32 i = 0; i < count; i++)
+                    out[i] -= b[i];
+                break;
+            case opMul:
+                for (u32 i = 0; i < count; i++)
+                    out[i] *= b[i];
+                break;
+            case opDiv:
+                for (u32 i = 0; i < count; i++)
+                    out[i] /= b[i];
+                break;
+            }
+        }
+    private:
+        int                         m_op;
+        unique_ptr<filter_number_t> m_a, m_b;
+        vector<double>              m_tmp;
+    };
+
+    class filter_truth_t : public filter_condition_t
+    {
+    public:
+        filter_truth_t(bool value) : m_value(value) {}
+        void eval(u32, u32 count, u8 *out) override
+        {
+            memset(out, m_value ? 1 : 0, count);
+        }
+    private:
+        bool m_value;
+    };
+
+    //numbers compared to numbers, a constant right side is compared as a scalar
+    class filter_compare_t : public filter_condition_t
+    {
+    public:
+        filter_compare_t(int op, unique_ptr<filter_number_t> a, unique_ptr<filter_number_t> b)
+            : m_op(op), m_a(std::move(a)), m_b(std::move(b)), m_lhs(FILTER_BATCH_ROWS)
+        {
+            m_scalar = m_b->constant(m_value);
+            if (!m_scalar)
+                m_rhs.resize(FILTER_BATCH_ROWS);
+        }
+        void eval(u32 first, u32 count, u8 *out) override
+        {
+            const double *a = m_lhs.data();
+            m_a->eval(first, count, m_lhs.data());
+            if (m_scalar)
+            {
+                double b = m_value;
+                switch (m_op)
+                {
+                case opEq: for (u32 i = 0; i < count; i++) out[i] = a[i] == b; break;
+                case opNe: for (u32 i = 0; i < count; i++) out[i] = a[i] != b; break;
+                case opLt: for (u32 i = 0; i < count; i++) out[i] = a[i] < b; break;
+                case opLe: for (u32 i = 0; i < count; i++) out[i] = a[i] <= b; break;
+                case opGt: for (u32 i = 0; i < count; i++) out[i] = a[i] > b; break;
+                case opGe: for (u32 i = 0; i < count; i++) out[i] = a[i] >= b; break;
+                }
+                return;
+            }
+            const double *b = m_rhs.data();
+            m_b->eval(first, count, m_rhs.data());
+            switch (m_op)
+            {
+            case opEq: for (u32 i = 0; i < count; i++) out[i] = a[i] == b[i]; break;
+            case opNe: for (u32 i = 0; i < count; i++) out[i] = a[i] != b[i]; break;
+            case opLt: for (u32 i = 0; i < count; i++) out[i] = a[i] < b[i]; break;
+            case opLe: for (u32 i = 0; i < count; i++) out[i] = a[i] <= b[i]; break;
+            case opGt: for (u32 i = 0; i < count; i++) out[i] = a[i] > b[i]; break;
+            case opGe: for (u32 i = 0; i < count; i++) out[i] = a[i] >= b[i]; break;
+            }
+        }
+    private:
+        int                         m_op;
+        unique_ptr<filter_number_t> m_a, m_b;
+        bool                        m_scalar;
+        double                      m_value;
+        vector<double>              m_lhs, m_rhs;
+    };
+
+    //string ids compared to the id of a literal or to the ids of another field, the string table
+    //of a layer holds every text once. a literal missing from it has id FASTDB_NO_ROW
+    class filter_string_compare_t : public filter_condition_t
+    {
+    public:
+        filter_string_compare_t(bool equal, const filter_string_t &a, const filter_string_t *b, u32 id)
+            : m_equal(equal), m_a(a.column), m_b(b ? b->column : NULL), m_stride(a.stride), m_ids_u32(a.ids_u32), m_id(id) {}
+        void eval(u32 first, u32 count, u8 *out) override
+        {
+            const u8 *a = m_a + m_stride * first;
+            const u8 *b = m_b ? m_b + m_stride * first : NULL;
+            for (u32 i = 0; i < count; i++, a += m_stride)
+            {
+                u32 other = m_id;
+                if (b)
+                {
+                    other = read_id(b);
+                    b += m_stride;
+                }
+                out[i] = (read_id(a) == other) == m_equal;
+            }
+        }
+    private:
+        inline u32 read_id(const u8 *p)
+        {
+            if (m_ids_u32)
+            {
+                u32 id;
+                memcpy(&id, p, sizeof(id));
+                return id;
+            }
+            u16 id;
+            memcpy(&id, p, sizeof(id));
+            return id;
+        }
+    private:
+        bool        m_equal;
+        const u8*   m_a;
+        const u8*   m_b;
+        size_t      m_stride;
+        bool        m_ids_u32;
+        u32         m_id;
+    };
+
+    //the right side is skipped for a batch the left side decides alone
+    class filter_logic_t : public filter_condition_t
+    {
+    public:
+        filter_logic_t(bool isAnd, unique_ptr<filter_condition_t> a, unique_ptr<filter_condition_t> b)
+            : m_and(isAnd), m_a(std::move(a)), m_b(std::move(b)), m_tmp(FILTER_BATCH_ROWS) {}
+        void eval(u32 first, u32 count, u8 *out) override
+        {
+            m_a->eval(first, count, out);
+            u32 set = 0;
+            for (u32 i = 0; i < count; i++)
+                set += out[i];
+            if (m_and ? set == 0 : set == count)
+                return;
+            u8 *b = m_tmp.data();
+            m_b->eval(first, count, b);
+            if (m_and)
+            {
+                for (u32 i = 0; i < count; i++)
+                    out[i] &= b[i];
+            }
+            else
+            {
+                for (u32 i = 0; i < count; i++)
+                    out[i] |= b[i];
+            }
+        }
+    private:
+        bool                            m_and;
+        unique_ptr<filter_condition_t>  m_a, m_b;
+        vector<u8>                      m_tmp;
+    };
+
+    class filter_not_t : public filter_condition_t
+    {
+    public:
+        filter_not_t(unique_ptr<filter_condition_t> a) : m_a(std::move(a)) {}
+        void eval(u32 first, u32 count, u8 *out) override
+        {
+            m_a->eval(first, count, out);
+            for (u32 i = 0; i < count; i++)
+                out[i] ^= 1;
+        }
+    private:
+        unique_ptr<filter_condition_t> m_a;
+    };
+
+    ///////////////////////////////////////////////////
+    static bool filter_word_char(char c)
+    {
+        return isalnum((unsigned char)c) || c == '_';
+    }
+
+    filter_parser_t::filter_parser_t(FastVectorDbLayer::Impl *layer, const char *expr)
+        : m_layer(layer), m_expr(expr ? expr : ""), m_pos(m_expr), m_failed(false)
+    {
+    }
+
+    unique_ptr<filter_condition_t> filter_parser_t::parse()
+    {
+        skip_spaces();
+        if (!*m_pos)
+        {
+            fail("empty expression");
+            return NULL;
+        }
+        value_t value = parse_or();
+        if (value.type == vtError)
+            return NULL;
+        skip_spaces();
+        if (*m_pos)
+        {
+            fail("unexpected text");
+            return NULL;
+        }
+        if (value.type != vtCondition)
+        {
+            m_pos = m_expr;
+            fail("the expression is not a condition");
+            return NULL;
+        }
+        return std::move(value.condition);
+    }
+
+    filter_parser_t::value_t filter_parser_t::fail(const char *message)
+    {
+        if (!m_failed)
+            printf("FastVectorDbLayer::filter: %s at column %d of \"%s\"\n", message, int(m_pos - m_expr) + 1, m_expr);
+        m_failed = true;
+        return value_t();
+    }
+
+    void filter_parser_t::skip_spaces()
+    {
+        while (isspace((unsigned char)*m_pos))
+            m_pos++;
+    }
+
+    bool filter_parser_t::accept(const char *op)
+    {
+        skip_spaces();
+        size_t len = strlen(op);
+        if (strncmp(m_pos, op, len) != 0)
+            return false;
+        //"!" and "=" are not the start of "!=" or "=="
+        if (len == 1 && (op[0] == '!' || op[0] == '=') && m_pos[1] == '=')
+            return false;
+        m_pos += len;
+        return true;
+    }
+
+    bool filter_parser_t::accept_word(const char *word)
+    {
+        skip_spaces();
+        size_t len = strlen(word);
+        for (size_t i = 0; i < len; i++)
+        {
+            if (tolower((unsigned char)m_pos[i]) != word[i])
+                return false;
+        }
+        if (filter_word_char(m_pos[len]))
+            return false;
+        m_pos += len;
+        return true;
+    }
+
+    filter_parser_t::value_t filter_parser_t::parse_or()
+    {
+        value_t a = parse_and();
+        while (a.type != vtError && (accept_word("or") || accept("||")))
+        {
+            value_t b = parse_and();
+            if (b.type == vtError)
+                return b;
+            if (a.type != vtCondition || b.type != vtCondition)
+                return fail("or needs conditions");
+            a.condition.reset(new filter_logic_t(false, std::move(a.condition), std::move(b.condition)));
+        }
+        return a;
+    }
+
+    filter_parser_t::value_t filter_parser_t::parse_and()
+    {
+        value_t a = parse_not();
+        while (a.type != vtError && (accept_word("and") || accept("&&")))
+        {
+            value_t b = parse_not();
+            if (b.type == vtError)
+                return b;
+            if (a.type != vtCondition || b.type != vtCondition)
+                return fail("and needs conditions");
+            a.condition.reset(new filter_logic_t(true, std::move(a.condition), std::move(b.condition)));
+        }
+        return a;
+    }
+
+    filter_parser_t::value_t filter_parser_t::parse_not()
+    {
+        if (!accept_word("not") && !accept("!"))
+            return parse_compare();
+        value_t a = parse_not();
+        if (a.type == vtError)
+            return a;
+        if (a.type != vtCondition)
+            return fail("not needs a condition");
+        a.condition.reset(new filter_not_t(std::move(a.condition)));
+        return a;
+    }
+
+    filter_parser_t::value_t filter_parser_t::parse_compare()
+    {
+        value_t a = parse_sum();
+        if (a.type == vtError)
+            return a;
+        static const struct
+        {
+            const char *text;
+            int         op;
+        } ops[] = {{"==", opEq}, {"!=", opNe}, {"<>", opNe}, {"<=", opLe}, {">=", opGe}, {"<", opLt}, {">", opGt}, {"=", opEq}};
+        int op = -1;
+        for (auto &candidate : ops)
+        {
+            if (accept(candidate.text))
+            {
+                op = candidate.op;
+                break;
+            }
+        }
+        if (op == -1)
+            return a;
+        value_t b = parse_sum();
+        if (b.type == vtError)
+            return b;
+        if (a.type == vtString && b.type == vtString)
+            return compare_strings(op, a, b);
+        if (a.type != vtNumber || b.type != vtNumber)
+            return fail("only numbers with numbers and strings with strings compare");
+        value_t result;
+        result.type = vtCondition;
+        double va, vb;
+        bool ca = a.number->constant(va), cb = b.number->constant(vb);
+        if (ca && cb)
+            result.condition.reset(new filter_truth_t(filter_test(op, va, vb)));
+        else if (ca)
+            result.condition.reset(new filter_compare_t(filter_mirror(op), std::move(b.number), std::move(a.number)));
+        else
+            result.condition.reset(new filter_compare_t(op, std::move(a.number), std::move(b.number)));
+        return result;
+    }
+
+    filter_parser_t::value_t filter_parser_t::compare_strings(int op, value_t &a, value_t &b)
+    {
+        if (op != opEq && op != opNe)
+            return fail("strings compare with == and != only");
+        value_t result;
+        result.type = vtCondition;
+        if (a.text.literal && b.text.literal)
+        {
+            result.condition.reset(new filter_truth_t((a.text.text == b.text.text) == (op == opEq)));
+            return result;
+        }
+        const filter_string_t &field = a.text.literal ? b.text : a.text;
+        const filter_string_t &other = a.text.literal ? a.text : b.text;
+        if (!other.literal)
+        {
+            result.condition.reset(new filter_string_compare_t(op == opEq, field, &other, 0));
+            return result;
+        }
+        u32 id = FASTDB_NO_ROW;
+        u32 count = m_layer->stringTableSize(false);
+        for (u32 i = 0; i < count; i++)
+        {
+            const char *entry = (const char *)m_layer->stringTableEntry(false, i);
+            if (entry && other.text == entry)
+            {
+                id = i;
+                break;
+            }
+        }
+        result.condition.reset(new filter_string_compare_t(op == opEq, field, NULL, id));
+        return result;
+    }
+
+    filter_parser_t::value_t filter_parser_t::parse_sum()
+    {
+        value_t a = parse_product();
+        while (a.type != vtError)
+        {
+            int op = accept("+") ? opAdd : accept("-") ? opSub : -1;
+            if (op == -1)
+                break;
+            value_t b = parse_product();
+            if (b.type == vtError)
+                return b;
+            if (a.type != vtNumber || b.type != vtNumber)
+                return fail("arithmetic needs numbers");
+            double va, vb;
+            if (a.number->constant(va) && b.number->constant(vb))
+                a.number.reset(new filter_constant_t(filter_apply(op, va, vb)));
+            else
+                a.number.reset(new filter_arith_t(op, std::move(a.number), std::move(b.number)));
+        }
+        return a;
+    }
+
+    filter_parser_t::value_t filter_parser_t::parse_product()
+    {
+        value_t a = parse_unary();
+        while (a.type != vtError)
+        {
+            int op = accept("*") ? opMul : accept("/") ? opDiv : -1;
+            if (op == -1)
+                break;
+            value_t b = parse_unary();
+            if (b.type == vtError)
+                return b;
+            if (a.type != vtNumber || b.type != vtNumber)
+                return fail("arithmetic needs numbers");
+            double va, vb;
+            if (a.number->constant(va) && b.number->constant(vb))
+                a.number.reset(new filter_constant_t(filter_apply(op, va, vb)));
+            else
+                a.number.reset(new filter_arith_t(op, std::move(a.number), std::move(b.number)));
+        }
+        return a;
+    }
+
+    filter_parser_t::value_t filter_parser_t::parse_unary()
+    {
+        if (accept("+"))
+            return parse_unary();
+        if (!accept("-"))
+            return parse_primary();
+        value_t a = parse_unary();
+        if (a.type == vtError)
+            return a;
+        if (a.type != vtNumber)
+            return fail("- needs a number");
+        double v;
+        if (a.number->constant(v))
+            a.number.reset(new filter_constant_t(-v));
+        else
+            a.number.reset(new filter_negate_t(std::move(a.number)));
+        return a;
+    }
+
+    filter_parser_t::value_t filter_parser_t::parse_primary()
+    {
+        skip_spaces();
+        value_t value;
+        char c = *m_pos;
+        if (c == '(')
+        {
+            m_pos++;
+            value = parse_or();
+            if (value.type != vtError && !accept(")"))
+                return fail("expected )");
+            return value;
+        }
+        if (c == '\'' || c == '"')
+        {
+            const char *start = m_pos++;
+            string text;
+            while (*m_pos && *m_pos != c)
+            {
+                if (*m_pos == '\\' && m_pos[1])
+                    m_pos++;
+                text.push_back(*m_pos++);
+            }
+            if (!*m_pos)
+            {
+                m_pos = start;
+                return fail("unterminated string");
+            }
+            m_pos++;
+            value.type = vtString;
+            value.text = filter_string_t{true, text, NULL, 0, false};
+            return value;
+        }
+        if (isdigit((unsigned char)c) || (c == '.' && isdigit((unsigned char)m_pos[1])))
+        {
+            char *end = NULL;
+            double v = strtod(m_pos, &end);
+            m_pos = end;
+            value.type = vtNumber;
+            value.number.reset(new filter_constant_t(v));
+            return value;
+        }
+        if (isalpha((unsigned char)c) || c == '_')
+        {
+            const char *start = m_pos;
+            while (filter_word_char(*m_pos))
+                m_pos++;
+            string name(start, m_pos);
+            if (name == "true" || name == "false")
+            {
+                value.type = vtCondition;
+                value.condition.reset(new filter_truth_t(name == "true"));
+                return value;
+            }
+            const char *end = m_pos;
+            m_pos = start;
+            value = parse_field(name);
+            if (value.type != vtError)
+                m_pos = end;
+            return value;
+        }
+        return fail("expected a field, a number or a string");
+    }
+
+    //names are matched on the 16 bytes of field_desc_ex_t::name
+    filter_parser_t::value_t filter_parser_t::parse_field(const string &name)
+    {
+        value_t value;
+        unsigned count = m_layer->getFieldCount();
+        for (unsigned ix = 0; ix < count; ix++)
+        {
+            FieldTypeEnum ft;
+            double vmin, vmax;
+            const char *field_name = m_layer->getFieldDefn(ix, ft, vmin, vmax);
+            if (name.size() > 16 || strncmp(field_name, name.c_str(), 16) != 0)
+                continue;
+            size_t stride;
+            const u8 *column = m_layer->fieldColumn(ix, stride, ft);
+            switch (ft)
+            {
+            case ftU8:
+            case ftU16:
+            case ftU32:
+            case ftI32:
+            case ftU8n:
+            case ftU16n:
+            case ftF32:
+            case ftF64:
+                value.type = vtNumber;
+                value.number.reset(new filter_field_t(column, stride, ft, vmin, vmax));
+                return value;
+            case ftSTR:
+                value.type = vtString;
+                value.text = filter_string_t{false, string(), column, stride, m_layer->stringIdsU32()};
+                return value;
+            default:
+                return fail("fields of this type can't be filtered");
+            }
+        }
+        return fail("unknown field");
+    }
+
+    ///////////////////////////////////////////////////
+    FastVectorDbSelection *FastVectorDbLayer::Impl::filter(const char *expr)
+    {
+        trace_span_t span("FastVectorDbLayer::filter");
+        span.text("expr", expr);
+        filter_parser_t parser(this, expr);
+        auto condition = parser.parse();
+        if (!condition)
+            return NULL;
+        auto selection = new FastVectorDbSelection::Impl();
+        selection->layer = m_layer;
+        u8 mask[FILTER_BATCH_ROWS];
+        u32 feature_count = m_header->feature_count;
+        for (u32 first = 0; first < feature_count; first += FILTER_BATCH_ROWS)
+        {
+            u32 count = std::min(FILTER_BATCH_ROWS, feature_count - first);
+            condition->eval(first, count, mask);
+            for (u32 i = 0; i < count; i++)
+            {
+                if (mask[i])
+                    selection->rows.push_back(first + i);
+            }
+        }
+        span.num("rows", feature_count);
+        span.num("selected", selection->rows.size());
+        return new FastVectorDbSelection(selection);
+    }
+
+    FastVectorDbSelection *FastVectorDbLayer::filter(const char *expr)
+    {
+        return impl->filter(expr);
+    }
+    ///////////////////////////////////////////////////
+    FastVectorDbSelection::FastVectorDbSelection(Impl *impl)
+        : impl(impl)
+    {
+    }
+    FastVectorDbSelection::~FastVectorDbSelection()
+    {
+        delete impl;
+    }
+    FastVectorDbLayer *FastVectorDbSelection::layer()
+    {
+        return impl->layer;
+    }
+    u32 FastVectorDbSelection::getCount()
+    {
+        return (u32)impl->rows.size();
+    }
+    const u32 *FastVectorDbSelection::rows()
+    {
+        return impl->rows.data();
+    }
+}
@@ -0,0 +1,93 @@
+#pragma once
+#ifndef __FAST_VECTOR_DB_FILTER_P_H__
+#define __FAST_VECTOR_DB_FILTER_P_H__
+//filter expressions of FastVectorDbLayer::filter. the parser checks names and types against the layer's
+//fields and builds a tree of typed nodes, every node evaluates a batch of consecutive rows at once
+//into a buffer of its own, so a row costs a few tight loops instead of a walk down the tree.
+#include "fastdb.h"
+#include "FastVectorDbLayer_p.h"
+#include <vector>
+#include <string>
+#include <memory>
+using namespace std;
+namespace wx
+{
+    static const u32 FILTER_BATCH_ROWS = 1024;
+
+    //numeric expression of rows [first,first+count), count<=FILTER_BATCH_ROWS
+    class filter_number_t
+    {
+    public:
+        virtual ~filter_number_t() {}
+        virtual void eval(u32 first, u32 count, double *out) = 0;
+        virtual bool constant(double &) { return false; }   //true and the value when it never changes
+    };
+
+    //condition of rows [first,first+count), out is 1 where it holds
+    class filter_condition_t
+    {
+    public:
+        virtual ~filter_condition_t() {}
+        virtual void eval(u32 first, u32 count, u8 *out) = 0;
+    };
+
+    //a ftSTR field or a quoted literal
+    struct filter_string_t
+    {
+        bool        literal;
+        string      text;
+        const u8*   column;
+        size_t      stride;
+        bool        ids_u32;
+    };
+
+    class filter_parser_t
+    {
+    public:
+        filter_parser_t(FastVectorDbLayer::Impl *layer, const char *expr);
+        //NULL when the expression is invalid, the error is printed
+        unique_ptr<filter_condition_t> parse();
+    private:
+        enum ValueTypeEnum
+        {
+            vtError = 0,
+            vtNumber,
+            vtCondition,
+            vtString
+        };
+        struct value_t
+        {
+            ValueTypeEnum                   type = vtError;
+            unique_ptr<filter_number_t>     number;
+            unique_ptr<filter_condition_t>  condition;
+            filter_string_t                 text;
+        };
+        value_t     parse_or();
+        value_t     parse_and();
+        value_t     parse_not();
+        value_t     parse_compare();
+        value_t     parse_sum();
+        value_t     parse_product();
+        value_t     parse_unary();
+        value_t     parse_primary();
+        value_t     parse_field(const string &name);
+        value_t     compare_strings(int op, value_t &a, value_t &b);
+        void        skip_spaces();
+        bool        accept(const char *op);
+        bool        accept_word(const char *word);
+        value_t     fail(const char *message);
+    private:
+        FastVectorDbLayer::Impl*    m_layer;
+        const char*                 m_expr;
+        const char*                 m_pos;
+        bool                        m_failed;
+    };
+
+    class FastVectorDbSelection::Impl
+    {
+    public:
+        FastVectorDbLayer*  layer;
+        vector<u32>         rows;
+    };
+}
+#endif
@@ -0,0 +1,211 @@
+#include "FastVectorDb_p.h"
+#include "FastVectorDbLayer_p.h"
+#include "FastVectorDbTrace_p.h"
+#include <math.h>
+
+//rows are read in the order given, usually random: the row GATHER_PREFETCH_DISTANCE ahead is
+//prefetched so that its cache miss overlaps the copies in between
+#if defined(__GNUC__) || defined(__clang__)
+#define gather_prefetch(p) __builtin_prefetch((p), 0, 1)
+#else
+#define gather_prefetch(p) ((void)(p))
+#endif
+
+namespace wx
+{
+    static const u32 GATHER_PREFETCH_DISTANCE = 16;
+
+    static u32 resolve_refs(const u8 *refs, size_t stride, u32 count, u32 targetLayer, u32 *rows)
+    {
+        u32 resolved = 0;
+        for (u32 i = 0; i < count; i++, refs += stride)
+        {
+            FastVectorDbFeatureRef ref;
+            memcpy(&ref, refs, sizeof(ref));
+            bool hit = ref.ilayer == targetLayer;
+            rows[i] = hit ? u32(ref.ifeature) : FASTDB_NO_ROW;
+            resolved += hit;
+        }
+        return resolved;
+    }
+
+    template <size_t size>
+    static void gather_fixed(const u8 *base, size_t line, u32 featureCount, const u32 *rows, u32 count, u8 *out)
+    {
+        for (u32 i = 0; i < count; i++, out += size)
+        {
+            if (i + GATHER_PREFETCH_DISTANCE < count && rows[i + GATHER_PREFETCH_DISTANCE] < featureCount)
+                gather_prefetch(base + line * rows[i + GATHER_PREFETCH_DISTANCE]);
+            u32 row = rows[i];
+            if (row < featureCount)
+                memcpy(out, base + line * row, size);
+            else
+                memset(out, 0, size);
+        }
+    }
+
+    //per field conversion of gatherFloat, value = bias + scale * raw
+    struct gather_column_t
+    {
+        u32     type;
+        u32     offset;
+        double  bias;
+        double  scale;
+    };
+
+    static inline double gather_value(const gather_column_t &column, const u8 *ptr)
+    {
+        switch (column.type)
+        {
+        case ftF32:
+        {
+            f32 v;
+            memcpy(&v, ptr, sizeof(v));
+            return v;
+        }
+        case ftF64:
+        {
+            f64 v;
+            memcpy(&v, ptr, sizeof(v));
+            return v;
+        }
+        case ftU8n:
+            return column.bias + column.scale * *ptr;
+        case ftU16n:
+        {
+            u16 v;
+            memcpy(&v, ptr, sizeof(v));
+            return column.bias + column.scale * v;
+        }
+        case ftU8:
+            return *ptr;
+        case ftU16:
+        {
+            u16 v;
+            memcpy(&v, ptr, sizeof(v));
+            return v;
+        }
+        case ftU32:
+        {
+            u32 v;
+            memcpy(&v, ptr, sizeof(v));
+            return v;
+        }
+        case ftI32:
+        {
+            int v;  //i32 is unsigned in fastdb-config.h
+            memcpy(&v, ptr, sizeof(v));
+            return v;
+        }
+        }
+        return NAN;
+    }
+
+    u32 FastVectorDbLayer::Impl::resolveRefs(u32 refField, u32 first, u32 count, u32 targetLayer, u32 *rows)
+    {
+        if (refField >= m_header->field_count || m_field_descs[refField].type != ftFeatureRef)
+            return 0;
+        trace_span_t span("FastVectorDbLayer::resolveRefs");
+        span.num("count", count);
+        u32 feature_count = m_header->feature_count;
+        u32 valid = first < feature_count ? std::min(count, feature_count - first) : 0;
+        const u8 *refs = m_table_data_ptr0 + m_table_line_size * first + m_field_descs[refField].offset;
+        u32 resolved = resolve_refs(refs, m_table_line_size, valid, targetLayer, rows);
+        for (u32 i = valid; i < count; i++)
+            rows[i] = FASTDB_NO_ROW;
+        return resolved;
+    }
+
+    u32 FastVectorDbLayer::Impl::gather(u32 ix, const u32 *rows, u32 count, void *out)
+    {
+        if (ix >= m_header->field_count)
+            return 0;
+        trace_span_t span("FastVectorDbLayer::gather");
+        span.num("count", count);
+        const field_desc_ex_t &fd = m_field_descs[ix];
+        const u8 *base = m_table_data_ptr0 + fd.offset;
+        u32 feature_count = m_header->feature_count;
+        u8 *pout = (u8 *)out;
+        switch (fd.size)
+        {
+        case 1:
+            gather_fixed<1>(base, m_table_line_size, feature_count, rows, count, pout);
+            break;
+        case 2:
+            gather_fixed<2>(base, m_table_line_size, feature_count, rows, count, pout);
+            break;
+        case 4:
+            gather_fixed<4>(base, m_table_line_size, feature_count, rows, count, pout);
+            break;
+        case 5:
+            gather_fixed<5>(base, m_table_line_size, feature_count, rows, count, pout);
+            break;
+        case 8:
+            gather_fixed<8>(base, m_table_line_size, feature_count, rows, count, pout);
+            break;
+        default:
+            for (u32 i = 0; i < count; i++, pout += fd.size)
+            {
+                if (rows[i] < feature_count)
+                    memcpy(pout, base + m_table_line_size * rows[i], fd.size);
+                else
+                    memset(pout, 0, fd.size);
+            }
+            break;
+        }
+        return fd.size;
+    }
+
+    //one pass over the rows for all fields, each row is fetched once
+    bool FastVectorDbLayer::Impl::gatherFloat(const u32 *fields, u32 fieldCount, const u32 *rows, u32 count, double *out)
+    {
+        vector<gather_column_t> columns(fieldCount);
+        for (u32 k = 0; k < fieldCount; k++)
+        {
+            if (fields[k] >= m_header->field_count)
+                return false;
+            const field_desc_ex_t &fd = m_field_descs[fields[k]];
+            columns[k].type = fd.type;
+            columns[k].offset = fd.offset;
+            columns[k].bias = fd.vmin;
+            columns[k].scale = fd.type == ftU8n ? (fd.vmax - fd.vmin) / 255.0 : (fd.vmax - fd.vmin) / 65535.0;
+        }
+        trace_span_t span("FastVectorDbLayer::gatherFloat");
+        span.num("count", count);
+        span.num("fields", fieldCount);
+        u32 feature_count = m_header->feature_count;
+        for (u32 i = 0; i < count; i++)
+        {
+            if (i + GATHER_PREFETCH_DISTANCE < count && rows[i + GATHER_PREFETCH_DISTANCE] < feature_count)
+                gather_prefetch(m_table_data_ptr0 + m_table_line_size * rows[i + GATHER_PREFETCH_DISTANCE]);
+            u32 row = rows[i];
+            if (row >= feature_count)
+            {
+                for (u32 k = 0; k < fieldCount; k++)
+                    out[size_t(k) * count + i] = NAN;
+                continue;
+            }
+            const u8 *line = m_table_data_ptr0 + m_table_line_size * row;
+            for (u32 k = 0; k < fieldCount; k++)
+                out[size_t(k) * count + i] = gather_value(columns[k], line + columns[k].offset);
+        }
+        return true;
+    }
+
+    u32 FastVectorDbLayer::resolveRefs(u32 refField, u32 first, u32 count, u32 targetLayer, u32 *rows)
+    {
+        return impl->resolveRefs(refField, first, count, targetLayer, rows);
+    }
+    u32 FastVectorDbLayer::gather(u32 ix, const u32 *rows, u32 count, void *out)
+    {
+        return impl->gather(ix, rows, count, out);
+    }
+    bool FastVectorDbLayer::gatherFloat(const u32 *fields, u32 fieldCount, const u32 *rows, u32 count, double *out)
+    {
+        return impl->gatherFloat(fields, fieldCount, rows, count, out);
+    }
+    u32 FastVectorDb::resolveRefs(const void *refs, size_t stride, u32 count, u32 targetLayer, u32 *rows)
+    {
+        return resolve_refs((const u8 *)refs, stride, count, targetLayer, rows);
+    }
+}
@@ -0,0 +1,474 @@
+#include "FastVectorDbGen_p.h"
+#include "FastVectorDbBuild_p.h"
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <wchar.h>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <sys/stat.h>
+
+namespace wx
+{
+    static u64 gen_seed(u64 seed, u64 a, u64 b = 0, u64 c = 0)
+    {
+        gen_rng_t rng(seed ^ (a * 0xD1B54A32D192ED03ull) ^ (b * 0xAEF17502108EF2D9ull) ^ (c * 0xF39CC0605CEDC835ull));
+        return rng.next();
+    }
+
+    class GenWriteStream : public WriteStream
+    {
+    public:
+        GenWriteStream(FILE *f) : fp(f), failed(false) {}
+        void write(void *pdata, size_t size) override
+        {
+            if (fwrite(pdata, 1, size, fp) != size)
+                failed = true;
+        }
+        FILE *fp;
+        bool failed;
+    };
+
+    template <typename T>
+    static void append_wkb(vector<u8> &wkb, T value)
+    {
+        wkb.insert(wkb.end(), (u8 *)&value, (u8 *)&value + sizeof(value));
+    }
+
+    static u32 draw_vertices(gen_rng_t &rng, const gen_layer_t &spec, u32 least)
+    {
+        u32 vmin = std::max(spec.min_vertices, least);
+        u32 vmax = std::max(spec.max_vertices, vmin);
+        if (vmin == vmax)
+            return vmin;
+        if (!spec.log_uniform)
+            return vmin + (u32)rng.below((u64)vmax - vmin + 1);
+        double n = exp(log((double)vmin) + rng.uniform() * (log((double)vmax + 1) - log((double)vmin)));
+        return std::min(std::max((u32)n, vmin), vmax);
+    }
+
+    FastVectorDbGen::Impl::Impl(u64 seed)
+        : m_seed(seed)
+    {
+        m_extent.minEdge = {-180.0, -90.0};
+        m_extent.maxEdge = {180.0, 90.0};
+    }
+
+    void FastVectorDbGen::Impl::setExtent(double minx, double miny, double maxx, double maxy)
+    {
+        m_extent.minEdge = {minx, miny};
+        m_extent.maxEdge = {maxx, maxy};
+    }
+
+    int FastVectorDbGen::Impl::addLayer(const char *name, GeometryLikeEnum gt, u32 featureCount, CoordinateFormatEnum cf)
+    {
+        if (gt != gtPoint && gt != gtLineString && gt != gtPolygon)
+        {
+            printf("fastdb gen: layer %s must have points, lines or polygons\n", name);
+            return -1;
+        }
+        gen_layer_t spec;
+        spec.name = name;
+        spec.gt = gt;
+        spec.cf = cf;
+        spec.feature_count = featureCount;
+        spec.min_vertices = gt == gtPolygon ? 8 : 4;
+        spec.max_vertices = gt == gtPolygon ? 64 : 32;
+        spec.step = 0.001;
+        spec.log_uniform = false;
+        spec.max_holes = 0;
+        m_layers.push_back(spec);
+        return (int)m_layers.size() - 1;
+    }
+
+    void FastVectorDbGen::Impl::setVertices(u32 minVertices, u32 maxVertices, double step, bool logUniform)
+    {
+        if (m_layers.empty())
+            return;
+        auto &spec = m_layers.back();
+        spec.min_vertices = std::max(minVertices, 1u);
+        spec.max_vertices = std::max(maxVertices, spec.min_vertices);
+        spec.step = step;
+        spec.log_uniform = logUniform;
+    }
+
+    void FastVectorDbGen::Impl::setHoles(u32 maxHoles)
+    {
+        if (m_layers.empty())
+            return;
+        m_layers.back().max_holes = maxHoles;
+    }
+
+    int FastVectorDbGen::Impl::addField(const char *name, unsigned ft, double vmin, double vmax, u32 cardinality)
+    {
+        if (m_layers.empty())
+            return -1;
+        //field names are stored in 16 bytes
+        if (strlen(name) > 15)
+        {
+            printf("fastdb gen: field name %s is longer than 15 characters\n", name);
+            return -1;
+        }
+        if (ft < ftU8 || ft > ftWSTR)
+        {
+            printf("fastdb gen: field %s has an unsupported type %u, use addRefField for refs\n", name, ft);
+            return -1;
+        }
+        gen_field_t field;
+        field.name = name;
+        field.ft = ft;
+        field.vmin = vmin;
+        field.vmax = vmax;
+        field.cardinality = cardinality;
+        field.target = -1;
+        auto &fields = m_layers.back().fields;
+        fields.push_back(field);
+        return (int)fields.size() - 1;
+    }
+
+    int FastVectorDbGen::Impl::addRefField(const char *name, int targetLayer)
+    {
+        if (m_layers.empty() || strlen(name) > 15)
+            return -1;
+        //a ref holds a 24 bit feature index
+        if (targetLayer < 0 || targetLayer + 1 >= (int)m_layers.size() ||
+            m_layers[targetLayer].feature_count == 0 || m_layers[targetLayer].feature_count > (1u << 24))
+        {
+            printf("fastdb gen: ref field %s needs an earlier layer of 1 to 2^24 features\n", name);
+            return -1;
+        }
+        gen_field_t field;
+        field.name = name;
+        field.ft = ftFeatureRef;
+        field.vmin = 0;
+        field.vmax = 0;
+        field.cardinality = 0;
+        field.target = targetLayer;
+        auto &fields = m_layers.back().fields;
+        fields.push_back(field);
+        return (int)fields.size() - 1;
+    }
+
+    void FastVectorDbGen::Impl::build(FastVectorDbBuild &build, u64 seed, const aabbox_t &extent)
+    {
+        build.setExtent(extent.minEdge.x, extent.minEdge.y, extent.maxEdge.x, extent.maxEdge.y);
+        for (size_t i = 0; i < m_layers.size(); i++)
+        {
+            auto &spec = m_layers[i];
+            //more than 0xFFFF distinct strings need the u32 string table
+            bool u32_table = false;
+            for (auto &field : spec.fields)
+            {
+                if ((field.ft == ftSTR || field.ft == ftWSTR) &&
+                    (field.cardinality ? field.cardinality : spec.feature_count) > 0xFFFF)
+                    u32_table = true;
+            }
+            build.setGeometryType(spec.gt, spec.cf);
+            build.enableStringTableU32(u32_table);
+            auto layer = build.createLayerBegin(spec.name.c_str());
+            for (auto &field : spec.fields)
+                layer->addField(field.name.c_str(), field.ft, field.vmin, field.vmax);
+            add_features(layer, spec, gen_seed(seed, i + 1), extent);
+            build.createLayerEnd();
+        }
+    }
+
+    void FastVectorDbGen::Impl::add_features(FastVectorDbLayerBuild *layer, const gen_layer_t &spec, u64 seed, const aabbox_t &extent)
+    {
+        const double pi = 3.14159265358979323846;
+        double minx = extent.minEdge.x, miny = extent.minEdge.y;
+        double width = extent.maxEdge.x - minx, height = extent.maxEdge.y - miny;
+        gen_rng_t geometry(gen_seed(seed, 0));
+        vector<gen_rng_t> values;
+        for (size_t i = 0; i < spec.fields.size(); i++)
+            values.push_back(gen_rng_t(gen_seed(seed, i + 1)));
+        vector<point2_t> points;
+        vector<u8> wkb;
+        char text[32];
+        wchar_t wtext[32];
+        for (u32 ifeature = 0; ifeature < spec.feature_count; ifeature++)
+        {
+            layer->addFeatureBegin();
+            if (spec.gt == gtPoint)
+            {
+                point2_t p = {minx + geometry.uniform() * width, miny + geometry.uniform() * height};
+                layer->setGeometry(&p, sizeof(p), ginPoint2);
+            }
+            else if (spec.gt == gtLineString)
+            {
+                //walk with a slowly turning heading, reflected at the extent
+                u32 n = draw_vertices(geometry, spec, 2);
+                double x = geometry.uniform(), y = geometry.uniform();
+                double heading = geometry.uniform() * 2 * pi;
+                points.resize(n);
+                for (u32 k = 0; k < n; k++)
+                {
+                    points[k] = {minx + x * width, miny + y * height};
+                    heading += (geometry.uniform() - 0.5) * 0.8;
+                    double length = spec.step * (0.5 + geometry.uniform());
+                    x += cos(heading) * length;
+                    y += sin(heading) * length;
+                    if (x < 0 || x > 1)
+                    {
+                        x = x < 0 ? -x : 2 - x;
+                        heading = pi - heading;
+                    }
+                    if (y < 0 || y > 1)
+                    {
+                        y = y < 0 ? -y : 2 - y;
+                        heading = -heading;
+                    }
+                    x = std::min(std::max(x, 0.0), 1.0);
+                    y = std::min(std::max(y, 0.0), 1.0);
+                }
+                layer->setGeometry(points.data(), n, ginLineString);
+            }
+            else
+            {
+                //star shaped outer ring with radii in [0.7r,r] around the center, the holes are
+                //disjoint circles inside 0.65r. the outer ring is counterclockwise, the holes clockwise
+                u32 n = draw_vertices(geometry, spec, 3);
+                double r = std::min(spec.step * n / (2 * pi), 0.25);
+                double cx = r + geometry.uniform() * (1 - 2 * r);
+                double cy = r + geometry.uniform() * (1 - 2 * r);
+                u32 holes = (u32)geometry.below((u64)spec.max_holes + 1);
+                wkb.clear();
+                append_wkb<u8>(wkb, 1);
+                append_wkb<u32>(wkb, 3);
+                append_wkb<u32>(wkb, 1 + holes);
+                append_wkb<u32>(wkb, n + 1);
+                size_t first = wkb.size();
+                for (u32 k = 0; k < n; k++)
+                {
+                    double a = 2 * pi * (k + geometry.uniform() * 0.8) / n;
+                    double radius = r * (0.7 + 0.3 * geometry.uniform());
+                    append_wkb<double>(wkb, minx + (cx + cos(a) * radius) * width);
+                    append_wkb<double>(wkb, miny + (cy + sin(a) * radius) * height);
+                }
+                wkb.insert(wkb.end(), wkb.begin() + first, wkb.begin() + first + 2 * sizeof(double));
+                double d = holes > 1 ? 0.35 * r : 0;
+                double hr = holes > 1 ? std::min(0.3 * r, 0.8 * d * sin(pi / holes)) : 0.3 * r;
+                double offset = geometry.uniform() * 2 * pi;
+                u32 hn = std::max(n / 4, 4u);
+                for (u32 h = 0; h < holes; h++)
+                {
+                    double hx = cx + cos(offset + 2 * pi * h / holes) * d;
+                    double hy = cy + sin(offset + 2 * pi * h / holes) * d;
+                    append_wkb<u32>(wkb, hn + 1);
+                    for (u32 k = 0; k <= hn; k++)
+                    {
+                        double a = -2 * pi * (k % hn) / hn;
+                        append_wkb<double>(wkb, minx + (hx + cos(a) * hr) * width);
+                        append_wkb<double>(wkb, miny + (hy + sin(a) * hr) * height);
+                    }
+                }
+                layer->setGeometryWKB(wkb.data(), wkb.size());
+            }
+            for (size_t i = 0; i < spec.fields.size(); i++)
+            {
+                auto &field = spec.fields[i];
+                auto &rng = values[i];
+                if (field.ft == ftFeatureRef)
+                {
+                    FastVectorDbFeatureRef ref;
+                    ref.ilayer = field.target;
+                    ref.ifeature = (u32)rng.below(m_layers[field.target].feature_count);
+                    layer->setField(i, &ref);
+                }
+                else if (field.ft == ftSTR || field.ft == ftWSTR)
+                {
+                    u32 value = field.cardinality ? (u32)rng.below(field.cardinality) : ifeature;
+                    if (field.ft == ftSTR)
+                    {
+                        snprintf(text, sizeof(text), "v%u", value);
+                        layer->setField(i, text);
+                    }
+                    else
+                    {
+                        swprintf(wtext, sizeof(wtext) / sizeof(wtext[0]), L"v%u", value);
+                        layer->setField(i, wtext);
+                    }
+                }
+                else if (field.ft == ftF32 || field.ft == ftF64 || field.ft == ftU8n || field.ft == ftU16n)
+                {
+                    layer->setField(i, field.vmin + rng.uniform() * (field.vmax - field.vmin));
+                }
+                else
+                {
+                    //integers in [vmin,vmax]
+                    double span = floor(field.vmax) - ceil(field.vmin) + 1;
+                    double value = ceil(field.vmin) + floor(rng.uniform() * std::max(span, 1.0));
+                    layer->setField(i, value);
+                }
+            }
+            layer->addFeatureEnd();
+        }
+    }
+
+    void FastVectorDbGen::Impl::post(WriteStream *stream)
+    {
+        FastVectorDbBuild builder;
+        build(builder, m_seed, m_extent);
+        builder.post(stream);
+    }
+
+    bool FastVectorDbGen::Impl::save_file(FastVectorDbBuild &build, const char *filename)
+    {
+        FILE *fp = fopen(filename, "wb");
+        if (!fp)
+        {
+            printf("Can't create %s: %s\n", filename, strerror(errno));
+            return false;
+        }
+        GenWriteStream fws(fp);
+        build.post(&fws);
+        bool ok = !fws.failed;
+        if (fclose(fp) != 0)
+            ok = false;
+        if (!ok)
+        {
+            printf("Can't write %s\n", filename);
+            remove(filename);
+        }
+        return ok;
+    }
+
+    bool FastVectorDbGen::Impl::save(const char *filename)
+    {
+        FastVectorDbBuild builder;
+        build(builder, m_seed, m_extent);
+        return save_file(builder, filename);
+    }
+
+    static bool make_dir(const string &path)
+    {
+        if (mkdir(path.c_str(), 0755) == 0 || errno == EEXIST)
+            return true;
+        printf("Can't create directory %s: %s\n", path.c_str(), strerror(errno));
+        return false;
+    }
+
+    bool FastVectorDbGen::Impl::savePyramid(const char *dir, u32 maxLevel, u32 threads)
+    {
+        if (maxLevel > 15)
+        {
+            printf("fastdb gen: pyramid levels are limited to 15\n");
+            return false;
+        }
+        struct pyramid_tile_t
+        {
+            u32         level, x, y;
+            aabbox_t    extent;
+            string      path;
+        };
+        vector<pyramid_tile_t> tiles;
+        string root = dir;
+        if (!make_dir(root))
+            return false;
+        double width = m_extent.maxEdge.x - m_extent.minEdge.x;
+        double height = m_extent.maxEdge.y - m_extent.minEdge.y;
+        for (u32 level = 0; level <= maxLevel; level++)
+        {
+            u32 n = 1u << level;
+            string level_dir = root + "/" + to_string(level);
+            if (!make_dir(level_dir))
+                return false;
+            for (u32 x = 0; x < n; x++)
+            {
+                string x_dir = level_dir + "/" + to_string(x);
+                if (!make_dir(x_dir))
+                    return false;
+                for (u32 y = 0; y < n; y++)
+                {
+                    pyramid_tile_t tile;
+                    tile.level = level;
+                    tile.x = x;
+                    tile.y = y;
+                    tile.extent.minEdge = {m_extent.minEdge.x + width * x / n, m_extent.minEdge.y + height * y / n};
+                    tile.extent.maxEdge = {m_extent.minEdge.x + width * (x + 1) / n, m_extent.minEdge.y + height * (y + 1) / n};
+                    tile.path = x_dir + "/" + to_string(y) + ".fdb";
+                    tiles.push_back(tile);
+                }
+            }
+        }
+        if (threads == 0)
+            threads = std::max(std::thread::hardware_concurrency(), 1u);
+        threads = std::min<u32>(threads, tiles.size());
+        atomic<size_t> next(0);
+        atomic<bool> failed(false);
+        auto worker = [&]()
+        {
+            for (size_t i = next++; i < tiles.size() && !failed; i = next++)
+            {
+                auto &tile = tiles[i];
+                FastVectorDbBuild builder;
+                build(builder, gen_seed(m_seed, tile.level + 1, tile.x + 1, tile.y + 1), tile.extent);
+                if (!save_file(builder, tile.path.c_str()))
+                    failed = true;
+            }
+        };
+        vector<thread> pool;
+        for (u32 i = 1; i < threads; i++)
+            pool.push_back(thread(worker));
+        worker();
+        for (auto &t : pool)
+            t.join();
+        if (failed)
+            return false;
+
+        FastVectorTileDb catalog;
+        for (auto &tile : tiles)
+        {
+            catalog.registerTile(tile.path.c_str(), tile.level, 0, tile.extent.minEdge.x, tile.extent.minEdge.y,
+                                 tile.extent.maxEdge.x, tile.extent.maxEdge.y);
+        }
+        return catalog.saveCatalog((root + "/catalog.fdbc").c_str());
+    }
+    ///////////////////////////////////////////////////
+    FastVectorDbGen::FastVectorDbGen(u64 seed)
+    {
+        impl = new FastVectorDbGen::Impl(seed);
+    }
+    FastVectorDbGen::~FastVectorDbGen()
+    {
+        delete impl;
+    }
+    void FastVectorDbGen::setExtent(double minx, double miny, double maxx, double maxy)
+    {
+        impl->setExtent(minx, miny, maxx, maxy);
+    }
+    int FastVectorDbGen::addLayer(const char *name, GeometryLikeEnum gt, u32 featureCount, CoordinateFormatEnum cf)
+    {
+        return impl->addLayer(name, gt, featureCount, cf);
+    }
+    void FastVectorDbGen::setVertices(u32 minVertices, u32 maxVertices, double step, bool logUniform)
+    {
+        impl->setVertices(minVertices, maxVertices, step, logUniform);
+    }
+    void FastVectorDbGen::setHoles(u32 maxHoles)
+    {
+        impl->setHoles(maxHoles);
+    }
+    int FastVectorDbGen::addField(const char *name, unsigned ft, double vmin, double vmax, u32 cardinality)
+    {
+        return impl->addField(name, ft, vmin, vmax, cardinality);
+    }
+    int FastVectorDbGen::addRefField(const char *name, int targetLayer)
+    {
+        return impl->addRefField(name, targetLayer);
+    }
+    void FastVectorDbGen::post(WriteStream *stream)
+    {
+        impl->post(stream);
+    }
+    bool FastVectorDbGen::save(const char *filename)
+    {
+        return impl->save(filename);
+    }
+    bool FastVectorDbGen::savePyramid(const char *dir, u32 maxLevel, u32 threads)
+    {
+        return impl->savePyramid(dir, maxLevel, threads);
+    }
+}
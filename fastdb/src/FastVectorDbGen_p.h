@@ -0,0 +1,73 @@
+#pragma once
+#ifndef __FAST_VECTOR_DB_GEN_P_H__
+#define __FAST_VECTOR_DB_GEN_P_H__
+#include "fastdb.h"
+#include "fastdb-geometry-utils.h"
+#include <vector>
+#include <string>
+using namespace std;
+namespace wx
+{
+    //splitmix64, every layer and field draws from its own stream so that
+    //adding a field or a layer leaves the values of the others unchanged
+    struct gen_rng_t
+    {
+        u64 state;
+        gen_rng_t(u64 seed) : state(seed) {}
+        u64 next()
+        {
+            u64 z = (state += 0x9E3779B97F4A7C15ull);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+            return z ^ (z >> 31);
+        }
+        double uniform() { return (next() >> 11) * (1.0 / 9007199254740992.0); } //[0,1)
+        u64 below(u64 n) { return n ? next() % n : 0; }
+    };
+
+    struct gen_field_t
+    {
+        string      name;
+        unsigned    ft;
+        double      vmin, vmax;
+        u32         cardinality;    //strings, 0: unique per feature
+        int         target;         //referenced layer of a ftFeatureRef field, -1 otherwise
+    };
+
+    struct gen_layer_t
+    {
+        string                  name;
+        GeometryLikeEnum        gt;
+        CoordinateFormatEnum    cf;
+        u32                     feature_count;
+        u32                     min_vertices, max_vertices;
+        double                  step;           //edge length relative to the extent
+        bool                    log_uniform;
+        u32                     max_holes;
+        vector<gen_field_t>     fields;
+    };
+
+    class FastVectorDbGen::Impl
+    {
+    public:
+        Impl(u64 seed);
+        void    setExtent(double minx, double miny, double maxx, double maxy);
+        int     addLayer(const char *name, GeometryLikeEnum gt, u32 featureCount, CoordinateFormatEnum cf);
+        void    setVertices(u32 minVertices, u32 maxVertices, double step, bool logUniform);
+        void    setHoles(u32 maxHoles);
+        int     addField(const char *name, unsigned ft, double vmin, double vmax, u32 cardinality);
+        int     addRefField(const char *name, int targetLayer);
+        void    post(WriteStream *stream);
+        bool    save(const char *filename);
+        bool    savePyramid(const char *dir, u32 maxLevel, u32 threads);
+    private:
+        void    build(FastVectorDbBuild &build, u64 seed, const aabbox_t &extent);
+        void    add_features(FastVectorDbLayerBuild *layer, const gen_layer_t &spec, u64 seed, const aabbox_t &extent);
+        static bool save_file(FastVectorDbBuild &build, const char *filename);
+    private:
+        u64                 m_seed;
+        aabbox_t            m_extent;
+        vector<gen_layer_t> m_layers;
+    };
+}
+#endif
@@ -0,0 +1,381 @@
+#include "FastVectorDbJoin_p.h"
+#include "FastVectorDbTrace_p.h"
+#include <unordered_map>
+#include <string_view>
+#include <thread>
+#include <atomic>
+
+namespace wx
+{
+    static inline u64 join_key(const join_column_t &column, u32 row)
+    {
+        const u8 *p = column.data + column.stride * row;
+        switch (column.ft)
+        {
+        case ftU8:
+            return *p;
+        case ftU16:
+        {
+            u16 v;
+            memcpy(&v, p, sizeof(v));
+            return v;
+        }
+        case ftU32:
+        {
+            u32 v;
+            memcpy(&v, p, sizeof(v));
+            return v;
+        }
+        case ftI32:
+        {
+            int v;  //sign extended, negative keys never meet u32 ones
+            memcpy(&v, p, sizeof(v));
+            return u64(i64(v));
+        }
+        default:    //string ids
+        {
+            if (column.ids_u32)
+            {
+                u32 id;
+                memcpy(&id, p, sizeof(id));
+                return id;
+            }
+            u16 id;
+            memcpy(&id, p, sizeof(id));
+            return id;
+        }
+        }
+    }
+
+    static inline u64 join_hash(u64 key)
+    {
+        key = (key ^ (key >> 30)) * 0xBF58476D1CE4E5B9ull;
+        key = (key ^ (key >> 27)) * 0x94D049BB133111EBull;
+        return key ^ (key >> 31);
+    }
+
+    static bool join_is_integer(FieldTypeEnum ft)
+    {
+        return ft == ftU8 || ft == ftU16 || ft == ftU32 || ft == ftI32;
+    }
+
+    //wide strings are compared as their bytes
+    static string_view join_text(bool wide, const void *entry)
+    {
+        if (!entry)
+            return string_view();
+        if (!wide)
+            return string_view((const char *)entry);
+        const uchar_t *p = (const uchar_t *)entry;
+        size_t len = 0;
+        while (p[len])
+            len++;
+        return string_view((const char *)p, len * sizeof(uchar_t));
+    }
+
+    void join_key_table_t::reset(u32 keyCount)
+    {
+        u64 size = 16;
+        while (size < u64(keyCount) * 2)
+            size <<= 1;
+        m_slots.assign(size, slot_t{0, JOIN_NO_GROUP});
+        m_mask = size - 1;
+    }
+
+    u32 join_key_table_t::insert(u64 key, u32 group)
+    {
+        for (u64 i = join_hash(key) & m_mask;; i = (i + 1) & m_mask)
+        {
+            auto &slot = m_slots[i];
+            if (slot.group == JOIN_NO_GROUP)
+            {
+                slot.key = key;
+                slot.group = group;
+                return group;
+            }
+            if (slot.key == key)
+                return slot.group;
+        }
+    }
+
+    u32 join_key_table_t::find(u64 key) const
+    {
+        for (u64 i = join_hash(key) & m_mask;; i = (i + 1) & m_mask)
+        {
+            auto &slot = m_slots[i];
+            if (slot.group == JOIN_NO_GROUP || slot.key == key)
+                return slot.group;
+        }
+    }
+
+    void FastVectorDbJoin::Impl::clear()
+    {
+        m_layers[0] = m_layers[1] = NULL;
+        m_left_rows = vector<u32>();
+        m_right_rows = vector<u32>();
+        m_string_groups = vector<u32>();
+        m_group_offsets = vector<u32>();
+        m_group_rows = vector<u32>();
+    }
+
+    //string keys are grouped by their id, integer keys by the order they are first seen
+    void FastVectorDbJoin::Impl::build_groups(const join_column_t &build, u32 stringCount)
+    {
+        trace_span_t span("FastVectorDbJoin::build");
+        span.num("rows", build.count);
+        vector<u32> row_groups(build.count);
+        u32 group_count = 0;
+        if (m_strings)
+        {
+            group_count = stringCount;
+            for (u32 row = 0; row < build.count; row++)
+            {
+                u64 id = join_key(build, row);
+                row_groups[row] = id < stringCount ? u32(id) : JOIN_NO_GROUP;
+            }
+        }
+        else
+        {
+            m_keys.reset(build.count);
+            for (u32 row = 0; row < build.count; row++)
+            {
+                u32 group = m_keys.insert(join_key(build, row), group_count);
+                if (group == group_count)
+                    group_count++;
+                row_groups[row] = group;
+            }
+        }
+        m_group_offsets.assign(group_count + 1, 0);
+        for (auto group : row_groups)
+        {
+            if (group != JOIN_NO_GROUP)
+                m_group_offsets[group + 1]++;
+        }
+        for (u32 i = 0; i < group_count; i++)
+            m_group_offsets[i + 1] += m_group_offsets[i];
+        m_group_rows.resize(m_group_offsets[group_count]);
+        vector<u32> cursor(m_group_offsets.begin(), m_group_offsets.end() - 1);
+        for (u32 row = 0; row < build.count; row++)
+        {
+            if (row_groups[row] != JOIN_NO_GROUP)
+                m_group_rows[cursor[row_groups[row]]++] = row;
+        }
+    }
+
+    //probe side string id -> build side string id, a layer joined with itself maps ids to themselves
+    void FastVectorDbJoin::Impl::map_strings(const join_column_t &build, FastVectorDbLayer::Impl *buildLayer,
+                                             FastVectorDbLayer::Impl *probeLayer)
+    {
+        bool wide = build.ft == ftWSTR;
+        u32 build_count = buildLayer->stringTableSize(wide);
+        u32 probe_count = probeLayer->stringTableSize(wide);
+        m_string_groups.resize(probe_count);
+        if (buildLayer == probeLayer)
+        {
+            for (u32 id = 0; id < probe_count; id++)
+                m_string_groups[id] = id;
+            return;
+        }
+        unordered_map<string_view, u32> ids;
+        ids.reserve(build_count);
+        for (u32 id = 0; id < build_count; id++)
+            ids.emplace(join_text(wide, buildLayer->stringTableEntry(wide, id)), id);
+        for (u32 id = 0; id < probe_count; id++)
+        {
+            auto it = ids.find(join_text(wide, probeLayer->stringTableEntry(wide, id)));
+            m_string_groups[id] = it == ids.end() ? JOIN_NO_GROUP : it->second;
+        }
+    }
+
+    u32 FastVectorDbJoin::Impl::probe_group(const join_column_t &probe, u32 row) const
+    {
+        u64 key = join_key(probe, row);
+        if (m_strings)
+            return key < m_string_groups.size() ? m_string_groups[key] : JOIN_NO_GROUP;
+        return m_keys.find(key);
+    }
+
+    //(probe row, build row) pairs of rows [first,first+count)
+    void FastVectorDbJoin::Impl::probe_chunk(const join_column_t &probe, u32 first, u32 count, vector<u32> &pairs) const
+    {
+        for (u32 row = first; row < first + count; row++)
+        {
+            u32 group = probe_group(probe, row);
+            if (group == JOIN_NO_GROUP)
+                continue;
+            for (u32 k = m_group_offsets[group]; k < m_group_offsets[group + 1]; k++)
+            {
+                pairs.push_back(row);
+                pairs.push_back(m_group_rows[k]);
+            }
+        }
+    }
+
+    //pairs of a right side probe come by right row, a stable counting sort puts them by left row
+    void FastVectorDbJoin::Impl::order_by_left(u32 leftCount)
+    {
+        vector<u32> offsets(leftCount + 1, 0);
+        for (auto row : m_left_rows)
+            offsets[row + 1]++;
+        for (u32 i = 0; i < leftCount; i++)
+            offsets[i + 1] += offsets[i];
+        vector<u32> left_rows(m_left_rows.size()), right_rows(m_right_rows.size());
+        for (size_t i = 0; i < m_left_rows.size(); i++)
+        {
+            u32 pos = offsets[m_left_rows[i]]++;
+            left_rows[pos] = m_left_rows[i];
+            right_rows[pos] = m_right_rows[i];
+        }
+        m_left_rows.swap(left_rows);
+        m_right_rows.swap(right_rows);
+    }
+
+    bool FastVectorDbJoin::Impl::join(FastVectorDbLayer::Impl *left, u32 leftField, FastVectorDbLayer::Impl *right, u32 rightField, u32 threads)
+    {
+        clear();
+        trace_span_t span("FastVectorDbJoin::join");
+        join_column_t columns[2];
+        FastVectorDbLayer::Impl *layers[2] = {left, right};
+        u32 fields[2] = {leftField, rightField};
+        for (int i = 0; i < 2; i++)
+        {
+            columns[i].data = layers[i]->fieldColumn(fields[i], columns[i].stride, columns[i].ft);
+            if (!columns[i].data)
+            {
+                printf("FastVectorDbJoin: field %u of layer %s is out of range\n", fields[i], layers[i]->name());
+                return false;
+            }
+            columns[i].ids_u32 = layers[i]->stringIdsU32();
+            columns[i].count = layers[i]->getFeatureCount();
+        }
+        bool integers = join_is_integer(columns[0].ft) && join_is_integer(columns[1].ft);
+        bool strings = columns[0].ft == columns[1].ft && (columns[0].ft == ftSTR || columns[0].ft == ftWSTR);
+        if (!integers && !strings)
+        {
+            printf("FastVectorDbJoin: fields %s.%u and %s.%u can't be compared\n", left->name(), leftField, right->name(), rightField);
+            return false;
+        }
+        int b = columns[0].count <= columns[1].count ? 0 : 1;
+        int p = 1 - b;
+        m_strings = strings;
+        if (m_strings)
+            map_strings(columns[b], layers[b], layers[p]);
+        build_groups(columns[b], m_strings ? layers[b]->stringTableSize(columns[b].ft == ftWSTR) : 0);
+
+        u32 probe_count = columns[p].count;
+        u32 chunk_count = (probe_count + JOIN_CHUNK_ROWS - 1) / JOIN_CHUNK_ROWS;
+        if (threads == 0)
+            threads = std::max(std::thread::hardware_concurrency(), 1u);
+        threads = std::max(std::min(threads, chunk_count), 1u);
+        vector<vector<u32>> chunks(chunk_count);
+        atomic<u32> next(0);
+        auto worker = [&]()
+        {
+            trace_span_t span("FastVectorDbJoin::probe");
+            for (u32 i = next++; i < chunk_count; i = next++)
+                probe_chunk(columns[p], i * JOIN_CHUNK_ROWS, std::min(JOIN_CHUNK_ROWS, probe_count - i * JOIN_CHUNK_ROWS), chunks[i]);
+        };
+        vector<thread> pool;
+        for (u32 i = 1; i < threads; i++)
+            pool.push_back(thread(worker));
+        worker();
+        for (auto &t : pool)
+            t.join();
+
+        size_t total = 0;
+        for (auto &chunk : chunks)
+            total += chunk.size() / 2;
+        if (total > 0xFFFFFFFF)
+        {
+            printf("FastVectorDbJoin: %zu matches are more than a join can hold\n", total);
+            clear();
+            return false;
+        }
+        m_left_rows.resize(total);
+        m_right_rows.resize(total);
+        u32 *probe_rows = p == 0 ? m_left_rows.data() : m_right_rows.data();
+        u32 *build_rows = p == 0 ? m_right_rows.data() : m_left_rows.data();
+        size_t k = 0;
+        for (auto &chunk : chunks)
+        {
+            for (size_t i = 0; i < chunk.size(); i += 2, k++)
+            {
+                probe_rows[k] = chunk[i];
+                build_rows[k] = chunk[i + 1];
+            }
+            chunk = vector<u32>();
+        }
+        if (p == 1)
+            order_by_left(columns[0].count);
+        m_layers[0] = left;
+        m_layers[1] = right;
+        span.num("matches", total);
+        span.num("threads", threads);
+        return true;
+    }
+
+    bool FastVectorDbJoin::Impl::gatherFloat(u32 side, const u32 *fields, u32 fieldCount, double *out)
+    {
+        if (side > 1 || !m_layers[side])
+            return false;
+        auto &rows = side == 0 ? m_left_rows : m_right_rows;
+        return m_layers[side]->gatherFloat(fields, fieldCount, rows.data(), (u32)rows.size(), out);
+    }
+
+    const u8 *FastVectorDbLayer::Impl::fieldColumn(u32 ix, size_t &stride, FieldTypeEnum &ft)
+    {
+        if (ix >= m_header->field_count)
+            return NULL;
+        stride = m_table_line_size;
+        ft = (FieldTypeEnum)m_field_descs[ix].type;
+        return m_table_data_ptr0 + m_field_descs[ix].offset;
+    }
+    bool FastVectorDbLayer::Impl::stringIdsU32()
+    {
+        return m_header->string_table_u32;
+    }
+    u32 FastVectorDbLayer::Impl::stringTableSize(bool wide)
+    {
+        shared_lock<shared_mutex> lock(m_string_lock);
+        return wide ? (u32)m_wstring_table.size() : (u32)m_string_table.size();
+    }
+    //NULL past the end, a patch may have shrunk the table since stringTableSize
+    const void *FastVectorDbLayer::Impl::stringTableEntry(bool wide, u32 id)
+    {
+        shared_lock<shared_mutex> lock(m_string_lock);
+        if (id >= (wide ? m_wstring_table.size() : m_string_table.size()))
+            return NULL;
+        return wide ? (const void *)m_wstring_table[id] : (const void *)m_string_table[id];
+    }
+    ///////////////////////////////////////////////////
+    FastVectorDbJoin::FastVectorDbJoin()
+    {
+        impl = new Impl();
+    }
+    FastVectorDbJoin::~FastVectorDbJoin()
+    {
+        delete impl;
+    }
+    bool FastVectorDbJoin::join(FastVectorDbLayer *left, u32 leftField, FastVectorDbLayer *right, u32 rightField, u32 threads)
+    {
+        if (!left || !right)
+            return false;
+        return impl->join(left->impl, leftField, right->impl, rightField, threads);
+    }
+    u32 FastVectorDbJoin::getCount()
+    {
+        return (u32)impl->m_left_rows.size();
+    }
+    const u32 *FastVectorDbJoin::leftRows()
+    {
+        return impl->m_left_rows.data();
+    }
+    const u32 *FastVectorDbJoin::rightRows()
+    {
+        return impl->m_right_rows.data();
+    }
+    bool FastVectorDbJoin::gatherFloat(u32 side, const u32 *fields, u32 fieldCount, double *out)
+    {
+        return impl->gatherFloat(side, fields, fieldCount, out);
+    }
+}
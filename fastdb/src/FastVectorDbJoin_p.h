@@ -0,0 +1,68 @@
+#pragma once
+#ifndef __FAST_VECTOR_DB_JOIN_P_H__
+#define __FAST_VECTOR_DB_JOIN_P_H__
+//hash join of two layers. the build side (the smaller layer) is grouped by key: every distinct key gets a
+//group, the rows of a group are listed in row order (CSR). probe rows map their key to a group through an
+//open addressing table, or for strings through an array from their string id to the build side's id.
+#include "fastdb.h"
+#include "FastVectorDbLayer_p.h"
+#include <vector>
+using namespace std;
+namespace wx
+{
+    static const u32 JOIN_NO_GROUP = 0xFFFFFFFF;
+    static const u32 JOIN_CHUNK_ROWS = 1 << 16;
+
+    //key column of one side
+    struct join_column_t
+    {
+        const u8*       data;
+        size_t          stride;
+        FieldTypeEnum   ft;
+        bool            ids_u32;    //string ids
+        u32             count;
+    };
+
+    //distinct integer keys of the build side, a power of 2 slots, group JOIN_NO_GROUP: empty
+    class join_key_table_t
+    {
+    public:
+        void    reset(u32 keyCount);
+        u32     insert(u64 key, u32 group);  //group of the key, the given one when it is new
+        u32     find(u64 key) const;
+    private:
+        struct slot_t
+        {
+            u64 key;
+            u32 group;
+        };
+        vector<slot_t>  m_slots;
+        u64             m_mask;
+    };
+
+    class FastVectorDbJoin::Impl
+    {
+    public:
+        bool        join(FastVectorDbLayer::Impl* left, u32 leftField, FastVectorDbLayer::Impl* right, u32 rightField, u32 threads);
+        bool        gatherFloat(u32 side, const u32 *fields, u32 fieldCount, double *out);
+    private:
+        void        clear();
+        void        build_groups(const join_column_t& build, u32 stringCount);
+        void        map_strings(const join_column_t& build, FastVectorDbLayer::Impl* buildLayer,
+                                FastVectorDbLayer::Impl* probeLayer);
+        u32         probe_group(const join_column_t& probe, u32 row) const;
+        void        probe_chunk(const join_column_t& probe, u32 first, u32 count, vector<u32>& pairs) const;
+        void        order_by_left(u32 leftCount);
+    public:
+        FastVectorDbLayer::Impl*    m_layers[2] = {NULL, NULL};
+        vector<u32>                 m_left_rows;
+        vector<u32>                 m_right_rows;
+    private:
+        bool                        m_strings = false;
+        join_key_table_t            m_keys;
+        vector<u32>                 m_string_groups;    //probe side string id -> group
+        vector<u32>                 m_group_offsets;    //group_count+1
+        vector<u32>                 m_group_rows;
+    };
+}
+#endif
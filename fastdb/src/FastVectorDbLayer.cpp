@@ -1,6 +1,11 @@
 #include "fastdb.h"
 #include "FastVectorDbLayer_p.h"
 #include "FastVectorDbLayerBuild_p.h"
+#include "FastVectorDbStats_p.h"
+#include "FastVectorDbTrace_p.h"
+#include <sys/mman.h>
+#include <unistd.h>
+#include <cmath>
 namespace wx
 {
     size_t ustring_len(const uchar_t *str)
@@ -10,33 +15,73 @@ namespace wx
             len++;
         return len;
     }
-    FastVectorDbLayer::Impl::Impl(const u8 *pdata, size_t size)
-        :m_data(pdata), m_size(size), m_ifeature(-1)
+    u64 memory_resident_bytes(const void *pdata, size_t size)
     {
-         m_header = (layer_header_t *)m_data;
+        if (size == 0)
+            return 0;
+        static const size_t page = sysconf(_SC_PAGESIZE);
+        uintptr_t begin = (uintptr_t)pdata;
+        uintptr_t end = begin + size;
+        uintptr_t first = begin & ~(uintptr_t)(page - 1);
+        size_t pages = (end - first + page - 1) / page;
+        vector<unsigned char> in_core(pages);
+        if (mincore((void *)first, end - first, in_core.data()) != 0)
+            return size;
+        u64 resident = 0;
+        for (size_t i = 0; i < pages; i++)
+        {
+            if (!(in_core[i] & 1))
+                continue;
+            uintptr_t lo = std::max<uintptr_t>(first + i * page, begin);
+            uintptr_t hi = std::min<uintptr_t>(first + (i + 1) * page, end);
+            resident += hi - lo;
+        }
+        return resident;
+    }
+    FastVectorDbLayer::Impl::Impl(const u8 *pdata, size_t size)
+        :m_data(pdata), m_size(size), m_ifeature(-1), m_geometry_map_ready(false), m_geometry_map_bytes(0), m_cookie_map_bytes(0),
+         m_feature_cache_bytes(0), m_feature_objects(0), m_seqlock(NULL), m_seqlock_chunks(NULL),
+         m_backlink_offsets(NULL), m_backlinks(NULL)
+    {
+        m_header = (layer_header_t *)m_data;
+        trace_span_t span("FastVectorDbLayer::open");
+        span.text("layer", m_header->name);
+        span.num("features", m_header->feature_count);
         m_field_descs = (field_desc_ex_t *)(m_data + sizeof(layer_header_t));
         m_data_ptr0 = m_data + sizeof(layer_header_t) + m_header->field_count * sizeof(field_desc_ex_t);
         auto last_fd = m_field_descs + m_header->field_count - 1;
         m_table_line_size = last_fd->offset + last_fd->size;
         m_table_data_ptr0 = m_data_ptr0 + m_header->offset_table;
         m_geometry_ptr0=m_data_ptr0;
+        reload_string_tables();
+    }
+    void FastVectorDbLayer::Impl::reload_string_tables()
+    {
+        //built aside and swapped in under the lock, lookups never see a half built table
+        vector<const char *> strings;
+        vector<const uchar_t *> wstrings;
         // load string tables
         const u8 *ptr = m_data_ptr0 + m_header->offset_strings;
         u32 count = *(u32 *)ptr;
         ptr += 4;
+        strings.reserve(count);
         for (int i = 0; i < count; i++)
         {
-            m_string_table.push_back((const char *)ptr);
+            strings.push_back((const char *)ptr);
             ptr += strlen((const char *)ptr) + 1;
         }
         ptr = m_data_ptr0 + m_header->offset_wstrings;
         count = *(u32 *)ptr;
         ptr += 4;
+        wstrings.reserve(count);
         for (int i = 0; i < count; i++)
         {
-            m_wstring_table.push_back((const uchar_t *)ptr);
+            wstrings.push_back((const uchar_t *)ptr);
             ptr += (ustring_len((const uchar_t *)ptr) + 1) * sizeof(uchar_t);
         }
+        unique_lock<shared_mutex> lock(m_string_lock);
+        m_string_table.swap(strings);
+        m_wstring_table.swap(wstrings);
     }
     FastVectorDbLayer::Impl::~Impl() {
         if(m_feature_cache.size())
@@ -114,9 +159,14 @@ namespace wx
     size_t FastVectorDbLayer::Impl::get_geometry_like_size(const u8* pdata)
     {
         size_t move_bytes = 0;
-        if(m_header->geometry_type==gtAny)
+        if(m_header->geometry_type==(u16)gtNone)
         {
-            move_bytes=*(u32*)m_geometry_ptr+sizeof(u32); 
+            //no geometry is stored, the table follows directly
+            move_bytes = 0;
+        }
+        else if(m_header->geometry_type==gtAny)
+        {
+            move_bytes=*(u32*)pdata+sizeof(u32); 
         }
         else if (m_header->coord_format == cfF64)
         {
@@ -166,6 +216,7 @@ namespace wx
 
         if (m_ifeature > ((int)m_header->feature_count)-1)
             return false;
+        stat_add(scFeaturesScanned);
     
         if (m_ifeature == 0)
         {
@@ -196,12 +247,17 @@ namespace wx
                 cb->begin(NULL);
                 cb->returnGeomrtryPart(GeometryReturn::gptPoint2, points.data(), 1);
                 cb->end();
+                stat_add(scGeometriesFetched);
+                stat_add(scVerticesDecoded);
+                stat_add(scGeometryBytes, sizeof(coord_type_t));
             }
             else
             {
                 aabbox_t aabbox;
                 aabbox_x16_t aabbox16;
                 double* boxptr=NULL;
+                const u8* start_ptr=geom_ptr;
+                u32 vertices=0;
                 if(impl.m_header->aabbox_enable)
                 {
                     aabbox16=*(aabbox_x16_t*)geom_ptr;
@@ -231,8 +287,12 @@ namespace wx
         points.push_back(p);
     }
     cb->returnGeomrtryPart(partType, points.data(), npoint);
+    vertices += npoint;
                     }
                     cb->end();
+                    stat_add(scGeometriesFetched);
+                    stat_add(scVerticesDecoded, vertices);
+                    stat_add(scGeometryBytes, geom_ptr - start_ptr);
                 }
             }
         }
@@ -259,6 +319,7 @@ namespace wx
             data.size=get_geometry_like_size(m_geometry_ptr); 
             data.pdata = m_geometry_ptr;
         }
+        stat_add(scGeometryBytes, data.size);
         return data;
     }
 
@@ -266,7 +327,13 @@ namespace wx
     chunk_data_t FastVectorDbLayer::Impl::getGeometryLikeChunk_internal(u32 ifeature)
     {
         chunk_data_t data;
-        const u8* geometry_ptr = m_geometry_ptr_map[ifeature];
+        const u8* geometry_ptr = geometry_ptr_at(ifeature);
+        if(!geometry_ptr)
+        {
+            data.pdata=NULL;
+            data.size=0;
+            return data;
+        }
         if(m_header->geometry_type==(u16)gtNone)
         {
             data.pdata=NULL;
@@ -282,13 +349,14 @@ namespace wx
             data.size=get_geometry_like_size(geometry_ptr); 
             data.pdata = geometry_ptr;
         }
+        stat_add(scGeometryBytes, data.size);
         return data;
     }
     void FastVectorDbLayer::Impl::fetchGeometry(GeometryReturn *cb)
     {
-        fetchGeometry_internal(m_geometry_ptr,cb);
+        fetchGeometry_internal(m_geometry_ptr,cb,points);
     }
-    void FastVectorDbLayer::Impl::fetchGeometry_internal(const u8* geometry_data_ptr,GeometryReturn *cb)
+    void FastVectorDbLayer::Impl::fetchGeometry_internal(const u8* geometry_data_ptr,GeometryReturn *cb,vector<point2_t>& scratch)
     {
         // if (m_it < 0 || m_it >= (int)m_header->feature_count)
         //     return;
@@ -298,31 +366,34 @@ namespace wx
         }
         else if (m_header->coord_format == cfF64)
         {
-            return_geometry<point2_t> rg(points,*this, cb, geometry_data_ptr, (wx::GeometryLikeEnum)m_header->geometry_type);
+            return_geometry<point2_t> rg(scratch,*this, cb, geometry_data_ptr, (wx::GeometryLikeEnum)m_header->geometry_type);
         }
         else if (m_header->coord_format == cfF32)
         {
-            return_geometry<point2_f32_t> rg(points,*this, cb, geometry_data_ptr, (wx::GeometryLikeEnum)m_header->geometry_type);
+            return_geometry<point2_f32_t> rg(scratch,*this, cb, geometry_data_ptr, (wx::GeometryLikeEnum)m_header->geometry_type);
         }
         else if (m_header->coord_format == cfTx16)
         {
-            return_geometry<point2_x16_t> rg(points,*this, cb, geometry_data_ptr, (wx::GeometryLikeEnum)m_header->geometry_type);
+            return_geometry<point2_x16_t> rg(scratch,*this, cb, geometry_data_ptr, (wx::GeometryLikeEnum)m_header->geometry_type);
         }
         else if (m_header->coord_format == cfTx24)
         {
-            return_geometry<point2_x24_t> rg(points,*this, cb, geometry_data_ptr, (wx::GeometryLikeEnum)m_header->geometry_type);
+            return_geometry<point2_x24_t> rg(scratch,*this, cb, geometry_data_ptr, (wx::GeometryLikeEnum)m_header->geometry_type);
         }
         else if (m_header->coord_format == cfTx32)
         {
-            return_geometry<point2_x32_t> rg(points,*this, cb, geometry_data_ptr, (wx::GeometryLikeEnum)m_header->geometry_type);
+            return_geometry<point2_x32_t> rg(scratch,*this, cb, geometry_data_ptr, (wx::GeometryLikeEnum)m_header->geometry_type);
         }
     }
 
+    //features and handles of one layer may be read from several threads, each with its own points
     void FastVectorDbLayer::Impl::fetchGeometry_internal(u32 ifeature,GeometryReturn *cb)
     {
-        if(ifeature>=m_geometry_ptr_map.size())
+        static thread_local vector<point2_t> scratch;
+        const u8* geometry_ptr = geometry_ptr_at(ifeature);
+        if(!geometry_ptr)
             return;
-        fetchGeometry_internal(m_geometry_ptr_map[ifeature],cb);
+        fetchGeometry_internal(geometry_ptr,cb,scratch);
     }
 
     double FastVectorDbLayer::Impl::getFieldAsFloat(u32 ix)
@@ -381,13 +452,14 @@ namespace wx
     }
     const char *FastVectorDbLayer::Impl::getFieldAsString_internal(u32 ifeature,u32 ix)
     {
-        if (ix >= m_header->field_count)
+        if (ix >= m_header->field_count||ifeature>=m_header->feature_count)
             return nullptr;
         const field_desc_ex_t *fd = m_field_descs + ix;
         if (fd->type != ftSTR)
             return nullptr;
         const u8 *ptr = m_table_data_ptr0 + m_table_line_size*ifeature+fd->offset;
         u32 id =m_header->string_table_u32?(*(u32 *)ptr):(u32(*(u16*)ptr));
+        shared_lock<shared_mutex> lock(m_string_lock);
         if (id >= m_string_table.size())
             return nullptr;
         return m_string_table[id];
@@ -398,13 +470,14 @@ namespace wx
     }
     const uchar_t *FastVectorDbLayer::Impl::getFieldAsWString_internal(u32 ifeature,u32 ix)
     {
-        if (ix >= m_header->field_count)
+        if (ix >= m_header->field_count||ifeature>=m_header->feature_count)
             return nullptr;
         const field_desc_ex_t *fd = m_field_descs + ix;
         if (fd->type != ftWSTR)
             return nullptr;
         const u8 *ptr = m_table_data_ptr0 +m_table_line_size*ifeature+fd->offset;
         u32 id =m_header->string_table_u32?(*(u32 *)ptr):(u32(*(u16*)ptr));
+        shared_lock<shared_mutex> lock(m_string_lock);
         if (id >= m_wstring_table.size())
             return nullptr;
         return m_wstring_table[id];
@@ -425,6 +498,7 @@ namespace wx
         {
             m_feature_cookie_map.resize(featureCount);
             memset(m_feature_cookie_map.data(),0,sizeof(void*)*featureCount);
+            m_cookie_map_bytes = memory_vector_bytes(m_feature_cookie_map);
         }
 
         void* pre = m_feature_cookie_map[ifeature];
@@ -438,16 +512,13 @@ namespace wx
     }   
     void* FastVectorDbLayer::Impl::getFeatureCookie_internal(u32 ifeature)
     {
-        u32 featureCount = m_header->feature_count;
-        if(m_feature_cookie_map.size()==0)
-        {
-            m_feature_cookie_map.resize(featureCount);
-            memset(m_feature_cookie_map.data(),0,sizeof(void*)*featureCount);
-        }
-        if(ifeature<0||ifeature>m_feature_cookie_map.size()-1)
+        if(ifeature>=m_header->feature_count)
         {
             return (void*)size_t(-1);
         }
+        //readers never build the map, no cookie has been set yet
+        if(m_feature_cookie_map.size()==0)
+            return NULL;
         return m_feature_cookie_map[ifeature];
     }
     void* FastVectorDbLayer::Impl::getFeatureCookie()
@@ -456,7 +527,7 @@ namespace wx
     }
     FastVectorDbFeatureRef* FastVectorDbLayer::Impl::getFieldAsFeatureRef_internal(u32 ifeature,u32 ix)
     {
-        if (ix >= m_header->field_count||m_field_descs[ix].type != ftFeatureRef)
+        if (ix >= m_header->field_count||ifeature>=m_header->feature_count||m_field_descs[ix].type != ftFeatureRef)
             return nullptr;
         auto* p = m_table_data_ptr0 +m_table_line_size*ifeature+m_field_descs[ix].offset;
 
@@ -497,18 +568,11 @@ namespace wx
     {
         if(ix>=m_header->feature_count)
             return nullptr;
+        ensure_geometry_map();
         if(m_feature_cache.size()==0)
-        {   
-            auto last_it = m_ifeature;
-            auto geometry_ptr = m_geometry_ptr;
+        {
             m_feature_cache.resize(m_header->feature_count,NULL);
-            rewind();
-            while(next())
-            {
-                m_geometry_ptr_map.push_back(m_geometry_ptr);
-            }
-            m_geometry_ptr= geometry_ptr;
-            m_ifeature = last_it;
+            m_feature_cache_bytes = memory_vector_bytes(m_feature_cache);
         }
         if(m_feature_cache[ix]==NULL)
         {
@@ -517,13 +581,93 @@ namespace wx
             implx->ifeature = ix;
             m_feature_cache[ix] = new FastVectorDbFeature;
             m_feature_cache[ix]->impl = implx;
+            m_feature_objects.fetch_add(1,memory_order_relaxed);
+            stat_add(scFeatureAllocations);
         }   
         return m_feature_cache[ix];  
     }
 
+    FastVectorDbFeatureHandle FastVectorDbLayer::Impl::getFeatureHandle(u32 ix)
+    {
+        FastVectorDbFeatureHandle handle;
+        handle.owner = ix<m_header->feature_count ? m_layer : NULL;
+        handle.ifeature = ix;
+        return handle;
+    }
+
+    //geometries are variable sized, random access needs the pointer of every feature once.
+    //handles read from many threads, the map is built once under the lock by a walk of its own,
+    //the scan cursor and the scan counters are left alone
+    void    FastVectorDbLayer::Impl::ensure_geometry_map()
+    {
+        if(m_geometry_map_ready.load(memory_order_acquire))
+            return;
+        unique_lock<shared_mutex> lock(m_geometry_map_lock);
+        if(m_geometry_map_ready.load(memory_order_relaxed))
+            return;
+        trace_span_t span("FastVectorDbLayer::offset_map");
+        span.text("layer", m_header->name);
+        span.num("features", m_header->feature_count);
+        build_geometry_map(m_geometry_ptr_map);
+        m_geometry_map_bytes = memory_vector_bytes(m_geometry_ptr_map);
+        m_geometry_map_ready.store(true,memory_order_release);
+    }
+    const u8*   FastVectorDbLayer::Impl::geometry_ptr_at(u32 ifeature)
+    {
+        ensure_geometry_map();
+        shared_lock<shared_mutex> lock(m_geometry_map_lock);
+        return ifeature<m_geometry_ptr_map.size() ? m_geometry_ptr_map[ifeature] : NULL;
+    }
+    void    FastVectorDbLayer::Impl::build_geometry_map(vector<const u8*>& map)
+    {
+        map.clear();
+        map.reserve(m_header->feature_count);
+        const u8* geometry_ptr = m_geometry_ptr0;
+        for(u32 i=0;i<m_header->feature_count;i++)
+        {
+            map.push_back(geometry_ptr);
+            geometry_ptr += get_geometry_like_size(geometry_ptr);
+        }
+    }
+
+    void    FastVectorDbLayer::Impl::memory_report(FastVectorDbMemory& report)
+    {
+        size_t headers = sizeof(layer_header_t) + m_header->field_count * sizeof(field_desc_ex_t);
+        report.buffer += m_size;
+        report.resident += memory_resident_bytes(m_data, m_size);
+        report.headers += headers;
+        report.geometry += m_header->offset_table;
+        report.attributes += m_header->offset_strings - m_header->offset_table;
+        report.strings += m_size - headers - m_header->offset_strings;
+        {
+            shared_lock<shared_mutex> lock(m_string_lock);
+            report.stringTables += memory_vector_bytes(m_string_table) + memory_vector_bytes(m_wstring_table);
+        }
+        //the maps themselves may be growing on other threads, only their counters are read
+        report.geometryMap += m_geometry_map_bytes.load(memory_order_relaxed);
+        report.cookieMap += m_cookie_map_bytes.load(memory_order_relaxed);
+        u64 features = m_feature_objects.load(memory_order_relaxed);
+        report.featureObjects += features;
+        report.featureCache += m_feature_cache_bytes.load(memory_order_relaxed) +
+                               features * (memory_heap_bytes(sizeof(FastVectorDbFeature)) + memory_heap_bytes(sizeof(FastVectorDbFeature::Impl)));
+        report.objects += memory_heap_bytes(sizeof(FastVectorDbLayer)) + memory_heap_bytes(sizeof(Impl)) + memory_vector_bytes(points);
+    }
+
+    void    FastVectorDbLayer::Impl::refresh_geometry_map()
+    {
+        //geometry bytes have been replaced in place, feature sizes inside may have moved.
+        //rebuilt under the lock as the string tables are, so a map built while the bytes were
+        //copied is walked again; a map not built yet is built from the patched bytes on first use
+        unique_lock<shared_mutex> lock(m_geometry_map_lock);
+        if(!m_geometry_map_ready.load(memory_order_relaxed))
+            return;
+        build_geometry_map(m_geometry_ptr_map);
+        m_geometry_map_bytes = memory_vector_bytes(m_geometry_ptr_map);
+    }
+
     size_t  FastVectorDbLayer::Impl::getFieldOffset(unsigned ix)
     {
-        if(ix>=m_header->field_count-1)
+        if(ix>=m_header->field_count)
             return -1;
         return  m_field_descs[ix].offset;
     }
@@ -531,6 +675,117 @@ namespace wx
     {
         return m_table_line_size;
     }
+    void    FastVectorDbLayer::Impl::attachSeqlock(seqlock_header_t* header)
+    {
+        u64 rows = u64(header->chunk_count) << header->chunk_shift;
+        if(rows < m_header->feature_count)
+        {
+            warning("seqlock section does not cover every feature of the layer, ignored!");
+            return;
+        }
+        m_seqlock = header;
+        m_seqlock_chunks = (seqlock_chunk_t*)(header + 1);
+    }
+    void    FastVectorDbLayer::Impl::attachBackLinks(const u8* payload,u64 size)
+    {
+        auto header = (const backlinks_header_t*)payload;
+        if(size < sizeof(backlinks_header_t) || header->feature_count != m_header->feature_count)
+            return;
+        size_t offsets_size = backlinks_offsets_size(header->feature_count);
+        if(size < sizeof(backlinks_header_t) + offsets_size + u64(header->link_count)*sizeof(FastVectorDbBackLink))
+            return;
+        auto offsets = (const u32*)(header + 1);
+        //getBackLinks slices the links with neighbouring offsets
+        bool valid = offsets[0] == 0 && offsets[header->feature_count] == header->link_count;
+        for(u32 i = 0; i < header->feature_count && valid; i++)
+            valid = offsets[i] <= offsets[i + 1];
+        if(!valid)
+        {
+            warning("back-link section does not match its links, ignored!");
+            return;
+        }
+        m_backlink_offsets = offsets;
+        m_backlinks = (const FastVectorDbBackLink*)((const u8*)offsets + offsets_size);
+    }
+    bool    FastVectorDbLayer::Impl::hasBackLinks()
+    {
+        return m_backlink_offsets != NULL;
+    }
+    const FastVectorDbBackLink* FastVectorDbLayer::Impl::getBackLinks(u32 ifeature,u32& count)
+    {
+        if(!m_backlink_offsets || ifeature >= m_header->feature_count)
+        {
+            count = 0;
+            return NULL;
+        }
+        count = m_backlink_offsets[ifeature+1] - m_backlink_offsets[ifeature];
+        return m_backlinks + m_backlink_offsets[ifeature];
+    }
+    bool    FastVectorDbLayer::Impl::hasSeqlock()
+    {
+        return m_seqlock != NULL;
+    }
+    u32     FastVectorDbLayer::Impl::getSeqlockChunkRows()
+    {
+        return m_seqlock ? (1u << m_seqlock->chunk_shift) : 0;
+    }
+    u64     FastVectorDbLayer::Impl::getVersion()
+    {
+        return m_seqlock ? m_seqlock->version.load(memory_order_acquire) : 0;
+    }
+    void    FastVectorDbLayer::Impl::beginUpdate(u32 ifeature)
+    {
+        if(!m_seqlock||ifeature>=m_header->feature_count)
+            return;
+        seqlock_write_begin(seqlock_chunk(ifeature));
+    }
+    u64     FastVectorDbLayer::Impl::endUpdate(u32 ifeature)
+    {
+        if(!m_seqlock||ifeature>=m_header->feature_count)
+            return 0;
+        return seqlock_write_end(m_seqlock, seqlock_chunk(ifeature));
+    }
+    u64     FastVectorDbLayer::Impl::beginRead(u32 ifeature)
+    {
+        if(!m_seqlock||ifeature>=m_header->feature_count)
+            return 0;
+        return seqlock_read_begin(seqlock_chunk(ifeature));
+    }
+    bool    FastVectorDbLayer::Impl::endRead(u32 ifeature,u64 seq)
+    {
+        if(!m_seqlock||ifeature>=m_header->feature_count)
+            return true;
+        return seqlock_read_end(seqlock_chunk(ifeature), seq);
+    }
+    bool    FastVectorDbLayer::Impl::readFeature(u32 ifeature,void* out)
+    {
+        if(ifeature>=m_header->feature_count)
+            return false;
+        const void* src = getFeatureAddress(ifeature);
+        u64 seq;
+        do
+        {
+            seq = beginRead(ifeature);
+            memcpy(out, src, m_table_line_size);
+        } while (!endRead(ifeature, seq));
+        return true;
+    }
+    u32     FastVectorDbLayer::Impl::changedSince(u64 version,u32* chunks,u32 capacity)
+    {
+        if(!m_seqlock)
+            return 0;
+        u32 count = 0;
+        for(u32 i=0;i<m_seqlock->chunk_count;i++)
+        {
+            if(m_seqlock_chunks[i].version.load(memory_order_acquire) > version)
+            {
+                if(count<capacity)
+                    chunks[count] = i;
+                count++;
+            }
+        }
+        return count;
+    }
     ///////////////////////////////////////////
 
     FastVectorDbLayer::FastVectorDbLayer(Impl *_impl) : impl(_impl) {}
@@ -623,6 +878,19 @@ namespace wx
     {
         return impl->tryGetFeatureAt(ix);
     }
+    FastVectorDbFeatureHandle FastVectorDbLayer::getFeatureHandle(u32 ix)
+    {
+        return impl->getFeatureHandle(ix);
+    }
+    FastVectorDbMemory  FastVectorDbLayer::memoryReport()
+    {
+        FastVectorDbMemory report;
+        memset(&report, 0, sizeof(report));
+        impl->memory_report(report);
+        report.auxiliary = report.stringTables + report.geometryMap + report.cookieMap + report.featureCache + report.objects;
+        report.total = report.resident + report.auxiliary;
+        return report;
+    }
     size_t  FastVectorDbLayer::getFieldOffset(unsigned ix)
     {
         return  impl->getFieldOffset(ix);
@@ -632,6 +900,63 @@ namespace wx
         return impl->getFeatureByteSize();
     }
 
+    bool    FastVectorDbLayer::hasSeqlock()
+    {
+        return impl->hasSeqlock();
+    }
+    u32     FastVectorDbLayer::getSeqlockChunkRows()
+    {
+        return impl->getSeqlockChunkRows();
+    }
+    u64     FastVectorDbLayer::getVersion()
+    {
+        return impl->getVersion();
+    }
+    void    FastVectorDbLayer::beginUpdate(u32 ifeature)
+    {
+        impl->beginUpdate(ifeature);
+    }
+    u64     FastVectorDbLayer::endUpdate(u32 ifeature)
+    {
+        return impl->endUpdate(ifeature);
+    }
+    void    FastVectorDbLayer::updateField(u32 ifeature, u32 ix, double value)
+    {
+        impl->beginUpdate(ifeature);
+        impl->setField_internal(ifeature, ix, value);
+        impl->endUpdate(ifeature);
+    }
+    void    FastVectorDbLayer::updateField(u32 ifeature, u32 ix, int value)
+    {
+        impl->beginUpdate(ifeature);
+        impl->setField_internal(ifeature, ix, value);
+        impl->endUpdate(ifeature);
+    }
+    u64     FastVectorDbLayer::beginRead(u32 ifeature)
+    {
+        return impl->beginRead(ifeature);
+    }
+    bool    FastVectorDbLayer::endRead(u32 ifeature, u64 seq)
+    {
+        return impl->endRead(ifeature, seq);
+    }
+    bool    FastVectorDbLayer::readFeature(u32 ifeature, void *out)
+    {
+        return impl->readFeature(ifeature, out);
+    }
+    u32     FastVectorDbLayer::changedSince(u64 version, u32 *chunks, u32 capacity)
+    {
+        return impl->changedSince(version, chunks, capacity);
+    }
+    bool    FastVectorDbLayer::hasBackLinks()
+    {
+        return impl->hasBackLinks();
+    }
+    const FastVectorDbBackLink* FastVectorDbLayer::getBackLinks(u32 ifeature, u32 &count)
+    {
+        return impl->getBackLinks(ifeature, count);
+    }
+
     FastVectorDbFeature::~FastVectorDbFeature()
     {
         delete impl;
@@ -691,4 +1016,78 @@ namespace wx
         impl->layer->impl->setField_internal(impl->ifeature,ix,value);
     }
 
+    //an invalid handle reads as a feature past the end of its layer
+    void FastVectorDbFeatureHandle::fetchGeometry(GeometryReturn *cb) const
+    {
+        if(owner)
+            owner->impl->fetchGeometry_internal(ifeature,cb);
+    }
+    chunk_data_t FastVectorDbFeatureHandle::getGeometryLikeChunk() const
+    {
+        if(!owner)
+        {
+            chunk_data_t data = {0, NULL};
+            return data;
+        }
+        return owner->impl->getGeometryLikeChunk_internal(ifeature);
+    }
+    double FastVectorDbFeatureHandle::getFieldAsFloat(u32 ix) const
+    {
+        if(!owner)
+            return 0;
+        return owner->impl->getFieldAsFloat_internal(ifeature,ix);
+    }
+    int FastVectorDbFeatureHandle::getFieldAsInt(u32 ix) const
+    {
+        if(!owner)
+            return 0;
+        return owner->impl->getFieldAsInt_internal(ifeature,ix);
+    }
+    const char* FastVectorDbFeatureHandle::getFieldAsString(u32 ix) const
+    {
+        if(!owner)
+            return nullptr;
+        return owner->impl->getFieldAsString_internal(ifeature,ix);
+    }
+    const uchar_t* FastVectorDbFeatureHandle::getFieldAsWString(u32 ix) const
+    {
+        if(!owner)
+            return nullptr;
+        return owner->impl->getFieldAsWString_internal(ifeature,ix);
+    }
+    FastVectorDbFeatureRef* FastVectorDbFeatureHandle::getFieldAsFeatureRef(u32 ix) const
+    {
+        if(!owner)
+            return nullptr;
+        return owner->impl->getFieldAsFeatureRef_internal(ifeature,ix);
+    }
+    void* FastVectorDbFeatureHandle::setFeatureCookie(void *cookie) const
+    {
+        if(!owner)
+            return (void*)size_t(-1);
+        return owner->impl->setFeatureCookie_internal(ifeature,cookie);
+    }
+    void* FastVectorDbFeatureHandle::getFeatureCookie() const
+    {
+        if(!owner)
+            return (void*)size_t(-1);
+        return owner->impl->getFeatureCookie_internal(ifeature);
+    }
+    void* FastVectorDbFeatureHandle::getAddress() const
+    {
+        if(!owner)
+            return NULL;
+        return owner->impl->getFeatureAddress(ifeature);
+    }
+    void FastVectorDbFeatureHandle::setField(u32 ix,double value) const
+    {
+        if(owner)
+            owner->impl->setField_internal(ifeature,ix,value);
+    }
+    void FastVectorDbFeatureHandle::setField(u32 ix,int    value) const
+    {
+        if(owner)
+            owner->impl->setField_internal(ifeature,ix,value);
+    }
+
 }
@@ -1,7 +1,11 @@
 #include "FastVectorDbLayerBuild_p.h"
 #include "fastdb.h"
 #include "fastdb-geometry-utils.h"
+#include "FastVectorDbSync_p.h"
+#include "FastVectorDbStats_p.h"
+#include "FastVectorDbTrace_p.h"
 #include "gaiageo.h"
+#include <algorithm>
 namespace wx
 {
     FastVectorDbLayerBuild::Impl::Impl(FastVectorDbBuild* db,const char *name)
@@ -18,6 +22,9 @@ namespace wx
         m_extent_done = false;
         m_string_table_u32=false;
         m_aabbox_enable=false;
+        m_seqlock_enable=false;
+        m_seqlock_chunk_shift=0;
+        m_back_links_enable=false;
         m_tcx=1;
         m_tcy=1;
     }
@@ -86,7 +93,7 @@ namespace wx
     int FastVectorDbLayerBuild::Impl::addField(const char *name, unsigned ft, double vmin, double vmax)
     {
         field_desc_ex_t fd;
-        memset(fd.name, 0, 16);
+        memset(&fd, 0, sizeof(fd));//padding too, the descriptors are written as is
         memcpy(fd.name, name, strlen(name));
         fd.type = ft;
         fd.vmin = vmin;
@@ -123,6 +130,14 @@ namespace wx
         m_tcy = (maxy-miny)/0xFFFF;
     }
 
+    void FastVectorDbLayerBuild::Impl::enableSeqlock(u32 chunkRows)
+    {
+        m_seqlock_enable = chunkRows>0;
+        m_seqlock_chunk_shift = 0;
+        while((1u<<m_seqlock_chunk_shift)<chunkRows&&m_seqlock_chunk_shift<31)
+            m_seqlock_chunk_shift++;
+    }
+
     void FastVectorDbLayerBuild::Impl::addFeatureBegin()
     {
         if (!m_extent_done && ((m_coord_format!=cfF64 && m_coord_format!=cfF32) || m_aabbox_enable))
@@ -134,6 +149,7 @@ namespace wx
         m_current_line_buffer.resize(m_table_line_size);
         memset(m_current_line_buffer.data(), 0, m_table_line_size);
         m_current_geom_buffer.clear();
+        m_current_refs.clear();
     }
 
     template <class valT>
@@ -302,6 +318,9 @@ namespace wx
 
     void FastVectorDbLayerBuild::Impl::setGeometry(const char *data, size_t size, GeometryLikeFormat fmt)
     {
+        trace_span_t span("FastVectorDbLayerBuild::setGeometry");
+        span.num("format", fmt);
+        span.num("size", size);
         m_current_geom_buffer.clear();
         if(m_geometry_type == gtNone)
         {
@@ -522,6 +541,12 @@ string table:%s\n",
             return;
         
         memcpy(m_current_line_buffer.data() + fdx.offset, ref, sizeof(FastVectorDbFeatureRef));
+        if (m_back_links_enable && find(m_current_refs.begin(), m_current_refs.end(), (u16)ix) == m_current_refs.end())
+            m_current_refs.push_back((u16)ix);
+    }
+    void   FastVectorDbLayerBuild::Impl::enableBackLinks(bool b)
+    {
+        m_back_links_enable = b;
     }
     
     FastVectorDbFeatureRef* FastVectorDbLayerBuild::Impl::createFeatureRef(u32 ix)
@@ -541,9 +566,22 @@ string table:%s\n",
     
     void FastVectorDbLayerBuild::Impl::addFeatureEnd()
     {
+        //the last value set wins, fields are recorded in index order
+        sort(m_current_refs.begin(), m_current_refs.end());
+        for (auto ix : m_current_refs)
+        {
+            build_back_link_t link;
+            memcpy(&link.target, m_current_line_buffer.data() + m_field_descs[ix].offset, sizeof(FastVectorDbFeatureRef));
+            link.link.ilayer = (u16)m_index_in_db;
+            link.link.ifield = ix;
+            link.link.ifeature = (u32)m_feature_count;
+            m_back_links.push_back(link);
+        }
         m_table_buffer.insert(m_table_buffer.end(), m_current_line_buffer.begin(), m_current_line_buffer.end());
         m_geometries_buffer.insert(m_geometries_buffer.end(), m_current_geom_buffer.begin(), m_current_geom_buffer.end());
         m_feature_count++;
+        stat_add(scFeaturesBuilt);
+        stat_add(scGeometryBytesBuilt, m_current_geom_buffer.size());
         if(m_feature_count%100==0)
         {
             printf(".");
@@ -617,6 +655,21 @@ string table:%s\n",
         }
     }
 
+    void FastVectorDbLayerBuild::Impl::write_sections(WriteStream *stream, size_t& offset)
+    {
+        if (m_seqlock_enable)
+        {
+            u32 chunk_count = (u32)((m_feature_count + (size_t(1) << m_seqlock_chunk_shift) - 1) >> m_seqlock_chunk_shift);
+            size_t size = seqlock_section_size(chunk_count);
+            write_section_header(stream, offset, stSeqlock, m_index_in_db, size);
+            vector<u8> payload(size, 0);
+            seqlock_header_t *header = (seqlock_header_t *)payload.data();
+            header->chunk_shift = m_seqlock_chunk_shift;
+            header->chunk_count = chunk_count;
+            stream->write(payload.data(), payload.size());
+        }
+    }
+
         FastVectorDbLayerBuild::FastVectorDbLayerBuild(FastVectorDbBuild* db,const char* name)
         {
             impl = new FastVectorDbLayerBuild::Impl(db,name);
@@ -645,6 +698,10 @@ string table:%s\n",
         {
             impl->setExtent(minx,miny,maxx,maxy);
         }
+        void   FastVectorDbLayerBuild::enableSeqlock(u32 chunkRows)
+        {
+            impl->enableSeqlock(chunkRows);
+        }
         void   FastVectorDbLayerBuild::setDbIndex(int ix)
         {
             impl->setDbIndex(ix);
@@ -50,6 +50,7 @@ namespace wx{
         void   setGeometryType(GeometryLikeEnum gt,CoordinateFormatEnum ct,bool aabboxEnabled);
         void   enableStringTableU32(bool b);
         void   setExtent(double minx,double miny,double maxx,double maxy);
+        void   enableSeqlock(u32 chunkRows);
         void   addFeatureBegin();
         void   setGeometry(const char* data,size_t size,GeometryLikeFormat fmt);
         void   setField(unsigned ix,double value);
@@ -63,6 +64,10 @@ namespace wx{
         void   post();
         size_t get_total_size();
         void   write(WriteStream* stream);
+        void   write_sections(WriteStream* stream,size_t& offset);
+        void   enableBackLinks(bool b);
+        size_t feature_count() { return m_feature_count; }
+        const vector<build_back_link_t>& back_links() { return m_back_links; }
     public:
         template<class point2_tt>
         inline void convert_coord_format(const point2_tt& p,point2_t& out){
@@ -118,7 +123,12 @@ namespace wx{
         double m_maxx;
         double m_maxy;
         u32    m_index_in_db;
+        u32    m_seqlock_chunk_shift;
+        bool   m_seqlock_enable;
         vector<FastVectorDbFeatureRef*> m_created_feature_refs;
+        bool   m_back_links_enable;
+        vector<u16>     m_current_refs;     //ref fields set on the current feature
+        vector<build_back_link_t> m_back_links;
 
         template <class coord_type>
         friend bool build_geometry_buffer_from_buffer(vector<u8> &buffer, FastVectorDbLayerBuild::Impl &build, const char *data, size_t size, GeometryLikeFormat inputFormat, GeometryLikeEnum declType);
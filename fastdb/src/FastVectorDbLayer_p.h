@@ -4,12 +4,29 @@
 #include "fastdb.h"
 #include "FastVectorDbBuild_p.h"
 #include "FastVectorDbLayerBuild_p.h"
+#include "FastVectorDbSync_p.h"
 #include <vector>
+#include <algorithm>
+#include <mutex>
+#include <shared_mutex>
+#include <atomic>
 using namespace std;
 
 namespace wx
 {
     class FastVectorDb;
+    //bytes of the image range in memory now (mincore), size when it can't be told
+    u64  memory_resident_bytes(const void* pdata,size_t size);
+    //malloc chunk of a heap block: 8 bytes of header, 16 byte granularity, 32 bytes at least
+    inline u64 memory_heap_bytes(size_t size)
+    {
+        return size ? std::max<u64>(32,(size+8+15)&~u64(15)) : 0;
+    }
+    template<class T>
+    inline u64 memory_vector_bytes(const vector<T>& v)
+    {
+        return memory_heap_bytes(v.capacity()*sizeof(T));
+    }
     class FastVectorDbLayer::Impl
     {
     public:
@@ -35,9 +52,11 @@ namespace wx
         void*           getFeatureCookie();
         bool            next();
         FastVectorDbFeature*  tryGetFeatureAt(u32 ifeature);
+        FastVectorDbFeatureHandle getFeatureHandle(u32 ifeature);
+        void            memory_report(FastVectorDbMemory& report);
     public:
         void            fetchGeometry_internal(u32 ifeature,GeometryReturn* cb);
-        void            fetchGeometry_internal(const u8* geometry_data_ptr,GeometryReturn* cb);
+        void            fetchGeometry_internal(const u8* geometry_data_ptr,GeometryReturn* cb,vector<point2_t>& scratch);
         void*           setFeatureCookie_internal(u32 ifeature,void* cookie);
         void*           getFeatureCookie_internal(u32 ifeature);
         double          getFieldAsFloat_internal(u32 ifeature,u32 ix);
@@ -54,8 +73,40 @@ namespace wx
 
         size_t          getFieldOffset(unsigned ix);
         size_t          getFeatureByteSize();
+    public:
+        void            attachSeqlock(seqlock_header_t* header);
+        bool            hasSeqlock();
+        u32             getSeqlockChunkRows();
+        u64             getVersion();
+        void            beginUpdate(u32 ifeature);
+        u64             endUpdate(u32 ifeature);
+        u64             beginRead(u32 ifeature);
+        bool            endRead(u32 ifeature,u64 seq);
+        bool            readFeature(u32 ifeature,void* out);
+        u32             changedSince(u64 version,u32* chunks,u32 capacity);
+        void            attachBackLinks(const u8* payload,u64 size);
+        bool            hasBackLinks();
+        const FastVectorDbBackLink* getBackLinks(u32 ifeature,u32& count);
+        u32             resolveRefs(u32 refField,u32 first,u32 count,u32 targetLayer,u32* rows);
+        u32             gather(u32 ix,const u32* rows,u32 count,void* out);
+        bool            gatherFloat(const u32* fields,u32 fieldCount,const u32* rows,u32 count,double* out);
+        //key columns of FastVectorDbJoin: field ix of feature i is at column+i*stride, NULL: bad field
+        const u8*       fieldColumn(u32 ix,size_t& stride,FieldTypeEnum& ft);
+        bool            stringIdsU32();
+        u32             stringTableSize(bool wide);
+        const void*     stringTableEntry(bool wide,u32 id);
+        FastVectorDbSelection* filter(const char* expr);
     private:
+        inline seqlock_chunk_t* seqlock_chunk(u32 ifeature)
+        {
+            return m_seqlock_chunks + (ifeature >> m_seqlock->chunk_shift);
+        }
         void            move_next_geometry_ptr();
+        void            reload_string_tables();
+        void            refresh_geometry_map();
+        void            ensure_geometry_map();
+        void            build_geometry_map(vector<const u8*>& map);
+        const u8*       geometry_ptr_at(u32 ifeature);
         size_t          get_geometry_like_size(const u8* pdata);
     public:
         inline void convert_coord_format(const point2_t& p,point2_t& out){
@@ -102,10 +153,22 @@ namespace wx
         const u8*               m_geometry_ptr;
         vector<const char *>    m_string_table;
         vector<const uchar_t *> m_wstring_table;
+        shared_mutex            m_string_lock;  //a patch reloads the tables while other threads look strings up
         vector<void*>           m_feature_cookie_map;
         vector<point2_t>        points;//a variant for return temp points
         vector<FastVectorDbFeature*>    m_feature_cache;
         vector<const u8*>       m_geometry_ptr_map;
+        atomic<bool>            m_geometry_map_ready;
+        shared_mutex            m_geometry_map_lock;    //a patch rebuilds the map while handles read it
+        //sizes of the lazily built maps above, memory_report reads them while other threads fill the maps
+        atomic<u64>             m_geometry_map_bytes;
+        atomic<u64>             m_cookie_map_bytes;
+        atomic<u64>             m_feature_cache_bytes;
+        atomic<u64>             m_feature_objects;
+        seqlock_header_t*       m_seqlock;
+        seqlock_chunk_t*        m_seqlock_chunks;
+        const u32*              m_backlink_offsets;     //feature_count+1, NULL without a back-link section
+        const FastVectorDbBackLink* m_backlinks;
         friend class FastVectorDbFeature;
         friend class FastVectorDb::Impl;
     };
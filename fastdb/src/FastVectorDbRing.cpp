@@ -0,0 +1,376 @@
+#include "FastVectorDbRing_p.h"
+#include <chrono>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+
+namespace wx
+{
+    static const char RING_MAGIC[16] = "FASTDBRing0.1";
+
+    FastVectorDbRing::Impl::Impl()
+        : m_base(NULL), m_size(0), m_header(NULL)
+    {
+    }
+    FastVectorDbRing::Impl::~Impl()
+    {
+        for (auto slot : m_slots)
+        {
+            delete slot;
+        }
+        if (m_base)
+        {
+            munmap(m_base, m_size);
+        }
+    }
+
+    string FastVectorDbRing::Impl::shm_name(const char *name)
+    {
+        string shm = name;
+        if (shm.empty() || shm[0] != '/')
+            shm = "/" + shm;
+        return shm;
+    }
+
+    bool FastVectorDbRing::Impl::map(int fd, size_t size)
+    {
+        void *pdata = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (pdata == MAP_FAILED)
+        {
+            printf("Error mapping ring: %s\n", strerror(errno));
+            return false;
+        }
+        m_base = (u8 *)pdata;
+        m_size = size;
+        m_header = (ring_header_t *)m_base;
+        return true;
+    }
+
+    bool FastVectorDbRing::Impl::attach_slots()
+    {
+        for (u32 i = 0; i < m_header->slot_count; i++)
+        {
+            auto db = FastVectorDb::load(image_at(i), m_header->image_size, NULL, NULL);
+            if (!db)
+                return false;
+            m_slots.push_back(db);
+        }
+        return true;
+    }
+
+    bool FastVectorDbRing::Impl::create(const char *name, FastVectorDb *layout, u32 slotCount)
+    {
+        if (!layout || slotCount < 2)
+            return false;
+        chunk_data_t image = layout->buffer();
+        size_t page = (size_t)sysconf(_SC_PAGESIZE);
+        size_t slot_offset = sizeof(ring_header_t) + sizeof(ring_slot_t) * slotCount;
+        slot_offset = (slot_offset + page - 1) / page * page;
+        size_t slot_size = ((size_t)image.size + page - 1) / page * page;
+        size_t total_size = slot_offset + slot_size * slotCount;
+
+        string shm = shm_name(name);
+        int fd = shm_open(shm.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+        if (fd == -1)
+        {
+            printf("Error creating ring %s: %s\n", shm.c_str(), strerror(errno));
+            return false;
+        }
+        if (ftruncate(fd, total_size) == -1 || !map(fd, total_size))
+        {
+            close(fd);
+            shm_unlink(shm.c_str());
+            return false;
+        }
+        close(fd);
+
+        memset((void *)m_header, 0, slot_offset);
+        memcpy(m_header->magic, RING_MAGIC, sizeof(RING_MAGIC));
+        m_header->slot_count = slotCount;
+        m_header->image_size = image.size;
+        m_header->slot_size = slot_size;
+        m_header->slot_offset = slot_offset;
+        m_header->total_size = total_size;
+        //the layout is parsed once here, steady state exchanges only flip slot states
+        for (u32 i = 0; i < slotCount; i++)
+        {
+            memcpy(image_at(i), image.pdata, image.size);
+        }
+        if (!attach_slots())
+        {
+            shm_unlink(shm.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    //the slot table and every image must lie inside the mapping before any slot is touched,
+    //sizes are compared by subtraction so that a forged header can't wrap them around
+    bool FastVectorDbRing::Impl::valid_header()
+    {
+        const ring_header_t *header = m_header;
+        if (memcmp(header->magic, RING_MAGIC, sizeof(RING_MAGIC)) != 0 || header->total_size > m_size)
+            return false;
+        if (header->slot_count < 2 || header->slot_offset > m_size || header->slot_offset < sizeof(ring_header_t) ||
+            header->slot_count > (header->slot_offset - sizeof(ring_header_t)) / sizeof(ring_slot_t))
+            return false;
+        if (header->image_size > header->slot_size ||
+            header->slot_size > (m_size - header->slot_offset) / header->slot_count)
+            return false;
+        return true;
+    }
+
+    bool FastVectorDbRing::Impl::open(const char *name)
+    {
+        string shm = shm_name(name);
+        int fd = shm_open(shm.c_str(), O_RDWR, 0600);
+        if (fd == -1)
+        {
+            printf("Error opening ring %s: %s\n", shm.c_str(), strerror(errno));
+            return false;
+        }
+        struct stat fileStat;
+        if (fstat(fd, &fileStat) == -1 || (size_t)fileStat.st_size < sizeof(ring_header_t) || !map(fd, fileStat.st_size))
+        {
+            close(fd);
+            return false;
+        }
+        close(fd);
+        if (!valid_header())
+        {
+            printf("Error opening ring %s: invalid ring header\n", shm.c_str());
+            return false;
+        }
+        return attach_slots();
+    }
+
+    u32 FastVectorDbRing::Impl::getSlotCount()
+    {
+        return m_header->slot_count;
+    }
+    u64 FastVectorDbRing::Impl::getLatestStep()
+    {
+        return m_header->latest_step.load(memory_order_acquire);
+    }
+    int FastVectorDbRing::Impl::slot_index(FastVectorDb *slot)
+    {
+        for (size_t i = 0; i < m_slots.size(); i++)
+        {
+            if (m_slots[i] == slot)
+                return (int)i;
+        }
+        return -1;
+    }
+
+    //wakes a producer waiting in beginWrite
+    void FastVectorDbRing::Impl::release_slot()
+    {
+        m_header->release_seq.fetch_add(1, memory_order_seq_cst);
+        if (m_header->writers.load(memory_order_seq_cst) > 0)
+            futex_wake_all(&m_header->release_seq);
+    }
+
+    FastVectorDb *FastVectorDbRing::Impl::beginWrite(bool copyLatest, int timeoutMs)
+    {
+        auto deadline = chrono::steady_clock::now() + chrono::milliseconds(timeoutMs < 0 ? 0 : timeoutMs);
+        while (true)
+        {
+            u32 seq = m_header->release_seq.load(memory_order_seq_cst);
+            FastVectorDb *db = try_begin_write(copyLatest);
+            if (db || timeoutMs == 0)
+                return db;
+            int remain = -1;
+            if (timeoutMs > 0)
+            {
+                auto left = chrono::duration_cast<chrono::milliseconds>(deadline - chrono::steady_clock::now()).count();
+                if (left <= 0)
+                    return NULL;
+                remain = (int)left;
+            }
+            m_header->writers.fetch_add(1, memory_order_seq_cst);
+            futex_wait(&m_header->release_seq, seq, remain);
+            m_header->writers.fetch_sub(1, memory_order_seq_cst);
+        }
+    }
+
+    FastVectorDb *FastVectorDbRing::Impl::try_begin_write(bool copyLatest)
+    {
+        u32 count = m_header->slot_count;
+        u64 latest_step = m_header->latest_step.load(memory_order_acquire);
+        u32 latest = m_header->latest_slot.load(memory_order_acquire);
+        for (u32 i = 1; i <= count; i++)
+        {
+            u32 ix = (latest + i) % count;
+            if (latest_step > 0 && ix == latest)
+                continue; //the latest image always stays readable
+            ring_slot_t *slot = slot_at(ix);
+            u32 state = slot->state.load(memory_order_acquire);
+            if (state == rsWriting ||
+                !slot->state.compare_exchange_strong(state, rsWriting, memory_order_seq_cst))
+                continue;
+            //pairs with the readers increment in beginRead, one of both sides backs off
+            if (slot->readers.load(memory_order_seq_cst) != 0)
+            {
+                slot->state.store(state, memory_order_release);
+                continue;
+            }
+            if (copyLatest && latest_step > 0)
+            {
+                memcpy(image_at(ix), image_at(latest), m_header->image_size);
+            }
+            return m_slots[ix];
+        }
+        return NULL;
+    }
+
+    u64 FastVectorDbRing::Impl::endWrite(FastVectorDb *db)
+    {
+        int ix = slot_index(db);
+        if (ix < 0)
+            return 0;
+        ring_slot_t *slot = slot_at(ix);
+        if (slot->state.load(memory_order_acquire) != rsWriting)
+            return 0;
+        u64 step = m_header->latest_step.load(memory_order_acquire) + 1;
+        slot->step.store(step, memory_order_relaxed);
+        slot->state.store(rsPublished, memory_order_release);
+        m_header->latest_slot.store(ix, memory_order_seq_cst);
+        m_header->latest_step.store(step, memory_order_seq_cst);
+        m_header->publish_seq.fetch_add(1, memory_order_seq_cst);
+        if (m_header->waiters.load(memory_order_seq_cst) > 0)
+            futex_wake_all(&m_header->publish_seq);
+        //the previous latest slot is writable once its readers are gone
+        release_slot();
+        return step;
+    }
+
+    void FastVectorDbRing::Impl::abortWrite(FastVectorDb *db)
+    {
+        int ix = slot_index(db);
+        if (ix < 0)
+            return;
+        u32 state = rsWriting;
+        if (slot_at(ix)->state.compare_exchange_strong(state, rsFree, memory_order_release))
+            release_slot();
+    }
+
+    FastVectorDb *FastVectorDbRing::Impl::beginRead(u64 *step)
+    {
+        while (m_header->latest_step.load(memory_order_acquire) > 0)
+        {
+            u32 ix = m_header->latest_slot.load(memory_order_acquire);
+            ring_slot_t *slot = slot_at(ix);
+            slot->readers.fetch_add(1, memory_order_seq_cst);
+            if (slot->state.load(memory_order_seq_cst) == rsPublished)
+            {
+                if (step)
+                    *step = slot->step.load(memory_order_relaxed);
+                return m_slots[ix];
+            }
+            //the producer grabbed the slot in between, retry with the new latest one
+            if (slot->readers.fetch_sub(1, memory_order_seq_cst) == 1)
+                release_slot();
+        }
+        return NULL;
+    }
+
+    void FastVectorDbRing::Impl::endRead(FastVectorDb *db)
+    {
+        int ix = slot_index(db);
+        if (ix < 0)
+            return;
+        if (slot_at(ix)->readers.fetch_sub(1, memory_order_seq_cst) == 1)
+            release_slot();
+    }
+
+    u64 FastVectorDbRing::Impl::waitStep(u64 step, int timeoutMs)
+    {
+        auto deadline = chrono::steady_clock::now() + chrono::milliseconds(timeoutMs < 0 ? 0 : timeoutMs);
+        while (true)
+        {
+            u32 seq = m_header->publish_seq.load(memory_order_seq_cst);
+            u64 latest = m_header->latest_step.load(memory_order_acquire);
+            if (latest > step)
+                return latest;
+            int remain = -1;
+            if (timeoutMs >= 0)
+            {
+                auto left = chrono::duration_cast<chrono::milliseconds>(deadline - chrono::steady_clock::now()).count();
+                if (left <= 0)
+                    return latest;
+                remain = (int)left;
+            }
+            m_header->waiters.fetch_add(1, memory_order_seq_cst);
+            futex_wait(&m_header->publish_seq, seq, remain);
+            m_header->waiters.fetch_sub(1, memory_order_seq_cst);
+        }
+    }
+
+    ///////////////////////////////////////////////////////
+    FastVectorDbRing::FastVectorDbRing(Impl *_impl)
+        : impl(_impl)
+    {
+    }
+    FastVectorDbRing::~FastVectorDbRing()
+    {
+        delete impl;
+    }
+    FastVectorDbRing *FastVectorDbRing::create(const char *name, FastVectorDb *layout, u32 slotCount)
+    {
+        auto impl = new FastVectorDbRing::Impl();
+        if (!impl->create(name, layout, slotCount))
+        {
+            delete impl;
+            return nullptr;
+        }
+        return new FastVectorDbRing(impl);
+    }
+    FastVectorDbRing *FastVectorDbRing::open(const char *name)
+    {
+        auto impl = new FastVectorDbRing::Impl();
+        if (!impl->open(name))
+        {
+            delete impl;
+            return nullptr;
+        }
+        return new FastVectorDbRing(impl);
+    }
+    bool FastVectorDbRing::unlink(const char *name)
+    {
+        return shm_unlink(Impl::shm_name(name).c_str()) == 0;
+    }
+    u32 FastVectorDbRing::getSlotCount()
+    {
+        return impl->getSlotCount();
+    }
+    u64 FastVectorDbRing::getLatestStep()
+    {
+        return impl->getLatestStep();
+    }
+    FastVectorDb *FastVectorDbRing::beginWrite(bool copyLatest, int timeoutMs)
+    {
+        return impl->beginWrite(copyLatest, timeoutMs);
+    }
+    u64 FastVectorDbRing::endWrite(FastVectorDb *slot)
+    {
+        return impl->endWrite(slot);
+    }
+    void FastVectorDbRing::abortWrite(FastVectorDb *slot)
+    {
+        impl->abortWrite(slot);
+    }
+    FastVectorDb *FastVectorDbRing::beginRead(u64 *step)
+    {
+        return impl->beginRead(step);
+    }
+    void FastVectorDbRing::endRead(FastVectorDb *slot)
+    {
+        impl->endRead(slot);
+    }
+    u64 FastVectorDbRing::waitStep(u64 step, int timeoutMs)
+    {
+        return impl->waitStep(step, timeoutMs);
+    }
+}
@@ -0,0 +1,84 @@
+#pragma once
+#ifndef __FAST_VECTOR_DB_RING_P_H__
+#define __FAST_VECTOR_DB_RING_P_H__
+#include "fastdb.h"
+#include "FastVectorDbSync_p.h"
+#include <vector>
+#include <string>
+using namespace std;
+namespace wx
+{
+    enum RingSlotStateEnum
+    {
+        rsFree = 0,
+        rsWriting,
+        rsPublished
+    };
+
+    struct ring_slot_t
+    {
+        atomic<u32> state;      //RingSlotStateEnum
+        atomic<u32> readers;    //consumers currently reading the slot
+        atomic<u64> step;       //step number of the published image
+    };
+
+    //lives at the beginning of the shared memory segment,
+    //followed by slot_count ring_slot_t and the page aligned images.
+    struct ring_header_t
+    {
+        char        magic[16];
+        u32         slot_count;
+        u32         reserved;
+        u64         image_size;
+        u64         slot_size;      //page aligned image_size
+        u64         slot_offset;    //offset of the first image
+        u64         total_size;
+        atomic<u64> latest_step;    //0 when nothing has been published
+        atomic<u32> latest_slot;
+        atomic<u32> publish_seq;    //futex word, bumped by every endWrite
+        atomic<u32> waiters;
+        atomic<u32> release_seq;    //futex word, bumped whenever a slot may have become writable
+        atomic<u32> writers;        //producers sleeping on release_seq
+        u32         padding[3];
+    };
+
+    class FastVectorDbRing::Impl
+    {
+    public:
+        Impl();
+       ~Impl();
+        bool            create(const char* name, FastVectorDb* layout, u32 slotCount);
+        bool            open(const char* name);
+        u32             getSlotCount();
+        u64             getLatestStep();
+        FastVectorDb*   beginWrite(bool copyLatest, int timeoutMs);
+        u64             endWrite(FastVectorDb* slot);
+        void            abortWrite(FastVectorDb* slot);
+        FastVectorDb*   beginRead(u64* step);
+        void            endRead(FastVectorDb* slot);
+        u64             waitStep(u64 step, int timeoutMs);
+    public:
+        static string   shm_name(const char* name);
+    private:
+        bool            map(int fd, size_t size);
+        bool            attach_slots();
+        bool            valid_header();
+        int             slot_index(FastVectorDb* slot);
+        FastVectorDb*   try_begin_write(bool copyLatest);
+        void            release_slot();
+        inline ring_slot_t* slot_at(u32 ix)
+        {
+            return ((ring_slot_t*)(m_header + 1)) + ix;
+        }
+        inline u8* image_at(u32 ix)
+        {
+            return m_base + m_header->slot_offset + m_header->slot_size * ix;
+        }
+    private:
+        u8*                     m_base;
+        size_t                  m_size;
+        ring_header_t*          m_header;
+        vector<FastVectorDb*>   m_slots;
+    };
+}
+#endif
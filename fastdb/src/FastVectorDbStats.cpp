@@ -0,0 +1,101 @@
+#include "FastVectorDbStats_p.h"
+#include <mutex>
+#include <vector>
+#include <algorithm>
+
+namespace wx
+{
+    struct stat_registry_t
+    {
+        mutex                   lock;
+        vector<stat_block_t *>  blocks;         //of the live threads
+        u64                     retired[scCount];   //counted by exited threads
+        u64                     baseline[scCount];  //totals at the last resetStats
+        atomic<i64>             gauges[scCount];
+    };
+
+    //never destroyed, threads may exit after the static destructors have run
+    static stat_registry_t &stat_registry()
+    {
+        static stat_registry_t *registry = new stat_registry_t();
+        return *registry;
+    }
+
+    //folds the block of an exiting thread into the retired totals
+    struct stat_thread_t
+    {
+        ~stat_thread_t()
+        {
+            stat_block_t *block = t_stat_block;
+            if (!block)
+                return;
+            auto &registry = stat_registry();
+            registry.lock.lock();
+            for (int i = 0; i < scCount; i++)
+                registry.retired[i] += block->values[i].load(memory_order_relaxed);
+            registry.blocks.erase(std::find(registry.blocks.begin(), registry.blocks.end(), block));
+            registry.lock.unlock();
+            t_stat_block = NULL;
+            delete block;
+        }
+    };
+
+    thread_local stat_block_t *t_stat_block = NULL;
+    static thread_local stat_thread_t t_stat_thread;
+
+    stat_block_t *stat_block_attach()
+    {
+        auto block = new stat_block_t();
+        for (int i = 0; i < scCount; i++)
+            block->values[i].store(0, memory_order_relaxed);
+        auto &registry = stat_registry();
+        registry.lock.lock();
+        registry.blocks.push_back(block);
+        registry.lock.unlock();
+        //touching the thread_local registers its destructor for this thread
+        (void)&t_stat_thread;
+        t_stat_block = block;
+        return block;
+    }
+
+    void stat_gauge_add(StatCounterEnum gauge, i64 delta)
+    {
+#ifndef FASTDB_NO_STATS
+        stat_registry().gauges[gauge].fetch_add(delta, memory_order_relaxed);
+#endif
+    }
+
+    static void stat_totals(stat_registry_t &registry, u64 *totals)
+    {
+        for (int i = 0; i < scCount; i++)
+            totals[i] = registry.retired[i];
+        for (auto block : registry.blocks)
+        {
+            for (int i = 0; i < scCount; i++)
+                totals[i] += block->values[i].load(memory_order_relaxed);
+        }
+    }
+
+    FastVectorDbStats FastVectorDb::getStats()
+    {
+        FastVectorDbStats stats;
+        u64 *values = (u64 *)&stats;
+        auto &registry = stat_registry();
+        registry.lock.lock();
+        stat_totals(registry, values);
+        for (int i = 0; i < scCount; i++)
+            values[i] -= registry.baseline[i];
+        registry.lock.unlock();
+        values[scTileQueueDepth] = (u64)std::max<i64>(registry.gauges[scTileQueueDepth].load(memory_order_relaxed), 0);
+        return stats;
+    }
+
+    //counters are owned by their threads, a reset moves the baseline instead of clearing them
+    void FastVectorDb::resetStats()
+    {
+        auto &registry = stat_registry();
+        registry.lock.lock();
+        stat_totals(registry, registry.baseline);
+        registry.lock.unlock();
+    }
+}
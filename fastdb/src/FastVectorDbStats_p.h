@@ -0,0 +1,59 @@
+#pragma once
+#ifndef __FAST_VECTOR_DB_STATS_P_H__
+#define __FAST_VECTOR_DB_STATS_P_H__
+//process wide runtime counters behind FastVectorDb::getStats.
+//every thread counts into its own block with relaxed stores, no lock prefix and no shared
+//cache line on the hot paths, getStats sums the live blocks and those of exited threads.
+#include "fastdb.h"
+#include <atomic>
+using namespace std;
+namespace wx
+{
+    //same order as the fields of FastVectorDbStats
+    enum StatCounterEnum
+    {
+        scDbLoads,
+        scDbBytesLoaded,
+        scFeaturesScanned,
+        scGeometriesFetched,
+        scVerticesDecoded,
+        scGeometryBytes,
+        scFeatureAllocations,
+        scTileHits,
+        scTileMisses,
+        scTileLoads,
+        scTileLoadFailures,
+        scTileBytesLoaded,
+        scTileEvictions,
+        scTileQueueDepth,       //gauge, see stat_gauge_add
+        scFeaturesBuilt,
+        scLayersBuilt,
+        scGeometryBytesBuilt,
+        scCount
+    };
+    static_assert(sizeof(FastVectorDbStats) == sizeof(u64) * scCount, "StatCounterEnum must match FastVectorDbStats");
+
+    //written by its thread only, read by getStats
+    struct stat_block_t
+    {
+        atomic<u64> values[scCount];
+    };
+
+    extern thread_local stat_block_t *t_stat_block;
+    stat_block_t *stat_block_attach();
+
+    inline void stat_add(StatCounterEnum counter, u64 n = 1)
+    {
+#ifndef FASTDB_NO_STATS
+        stat_block_t *block = t_stat_block;
+        if (!block)
+            block = stat_block_attach();
+        auto &value = block->values[counter];
+        value.store(value.load(memory_order_relaxed) + n, memory_order_relaxed);
+#endif
+    }
+
+    //gauges go up and down from any thread, they are shared atomics updated off the hot paths
+    void stat_gauge_add(StatCounterEnum gauge, i64 delta);
+}
+#endif
@@ -0,0 +1,52 @@
+#include "FastVectorDbSync_p.h"
+#include <chrono>
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <time.h>
+#include <errno.h>
+#include <limits.h>
+#endif
+namespace wx
+{
+#ifdef __linux__
+    //the words live in memory shared between processes,
+    //so the shared (non FUTEX_PRIVATE_FLAG) operations are required.
+    void futex_wait(atomic<u32>* word, u32 expected, int timeoutMs)
+    {
+        struct timespec ts;
+        struct timespec* pts = NULL;
+        if (timeoutMs >= 0)
+        {
+            ts.tv_sec = timeoutMs / 1000;
+            ts.tv_nsec = (timeoutMs % 1000) * 1000000L;
+            pts = &ts;
+        }
+        syscall(SYS_futex, (u32*)word, FUTEX_WAIT, expected, pts, NULL, 0);
+    }
+    void futex_wake_all(atomic<u32>* word)
+    {
+        syscall(SYS_futex, (u32*)word, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+    }
+#else
+    //no portable cross process futex, fall back to a short sleep polling
+    void futex_wait(atomic<u32>* word, u32 expected, int timeoutMs)
+    {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+        int spin = 0;
+        while (word->load(memory_order_acquire) == expected)
+        {
+            if (timeoutMs >= 0 && std::chrono::steady_clock::now() >= deadline)
+                return;
+            if (spin < 128)
+                sync_cpu_relax(spin++);
+            else
+                std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+    }
+    void futex_wake_all(atomic<u32>* word)
+    {
+    }
+#endif
+}
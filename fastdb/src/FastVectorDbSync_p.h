@@ -0,0 +1,107 @@
+#pragma once
+#ifndef __FAST_VECTOR_DB_SYNC_P_H__
+#define __FAST_VECTOR_DB_SYNC_P_H__
+//synchronization areas living inside a database image,
+//they are shared by every process mapping the same image,
+//so only lock-free atomics are allowed here.
+#include "fastdb.h"
+#include <atomic>
+#include <thread>
+using namespace std;
+namespace wx
+{
+    static_assert(sizeof(atomic<u64>) == sizeof(u64), "atomic<u64> must be layout compatible with u64");
+    static_assert(sizeof(atomic<u32>) == sizeof(u32), "atomic<u32> must be layout compatible with u32");
+
+    //payload of a stSeqlock section, one per layer
+    struct seqlock_header_t
+    {
+        u32         chunk_shift;    //rows per chunk = 1<<chunk_shift
+        u32         chunk_count;
+        atomic<u64> version;        //bumped by every committed update of the layer
+    };
+    //followed by chunk_count chunks
+    struct seqlock_chunk_t
+    {
+        atomic<u64> seq;            //odd while a writer is inside the chunk
+        atomic<u64> version;        //layer version of the last committed update
+    };
+
+    //payload of a stControl section, one per database,
+    //epoch and ready are futex words so they must stay 4 bytes aligned.
+    struct control_header_t
+    {
+        atomic<u32> epoch;          //bumped by every publish
+        atomic<u32> ready;          //user defined ready flags
+        atomic<u32> waiters;        //sleeping waiters, lets publishers skip the wake syscall
+        u32         reserved[13];   //pad to a cache line
+    };
+
+    //block until *word != expected, a spurious or timeout return is possible,
+    //callers re-check their condition. timeoutMs<0 waits forever.
+    void futex_wait(atomic<u32>* word, u32 expected, int timeoutMs);
+    void futex_wake_all(atomic<u32>* word);
+
+    inline size_t seqlock_section_size(u32 chunkCount)
+    {
+        return sizeof(seqlock_header_t) + sizeof(seqlock_chunk_t) * chunkCount;
+    }
+
+    inline void sync_cpu_relax(int spin)
+    {
+        if (spin < 64)
+        {
+#if defined(__x86_64__) || defined(__i386__)
+            __builtin_ia32_pause();
+#endif
+        }
+        else
+        {
+            std::this_thread::yield();
+        }
+    }
+
+    inline u64 seqlock_write_begin(seqlock_chunk_t *chunk)
+    {
+        int spin = 0;
+        u64 seq = chunk->seq.load(memory_order_relaxed);
+        while (true)
+        {
+            if ((seq & 1) == 0 &&
+                chunk->seq.compare_exchange_weak(seq, seq + 1, memory_order_acquire, memory_order_relaxed))
+                break;
+            sync_cpu_relax(spin++);
+            seq = chunk->seq.load(memory_order_relaxed);
+        }
+        //row stores must not become visible before the odd sequence
+        atomic_thread_fence(memory_order_release);
+        return seq + 1;
+    }
+
+    inline u64 seqlock_write_end(seqlock_header_t *header, seqlock_chunk_t *chunk)
+    {
+        u64 version = header->version.fetch_add(1, memory_order_relaxed) + 1;
+        chunk->version.store(version, memory_order_relaxed);
+        chunk->seq.fetch_add(1, memory_order_release);
+        return version;
+    }
+
+    inline u64 seqlock_read_begin(const seqlock_chunk_t *chunk)
+    {
+        int spin = 0;
+        u64 seq = chunk->seq.load(memory_order_acquire);
+        while (seq & 1)
+        {
+            sync_cpu_relax(spin++);
+            seq = chunk->seq.load(memory_order_acquire);
+        }
+        return seq;
+    }
+
+    inline bool seqlock_read_end(const seqlock_chunk_t *chunk, u64 seq)
+    {
+        atomic_thread_fence(memory_order_acquire);
+        return chunk->seq.load(memory_order_relaxed) == seq;
+    }
+}
+#endif
@@ -0,0 +1,266 @@
+#include "FastVectorDbTrace_p.h"
+#include <mutex>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <algorithm>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <errno.h>
+
+namespace wx
+{
+    //events and capacity change under the registry mutex only, when the ring enters a new session
+    struct trace_ring_t
+    {
+        trace_event_t*  events;
+        u32             capacity;
+        u32             tid;
+        bool            owned;          //a live thread writes it, guarded by the registry mutex
+        atomic<u32>     generation;     //session of the events in the ring
+        atomic<u64>     head;           //events written in that session
+    };
+
+    struct trace_registry_t
+    {
+        mutex                   lock;
+        vector<trace_ring_t*>   rings;  //rings of exited threads are freed by the next postTrace or enableTrace
+        atomic<u32>             generation;
+        u32                     capacity;
+        u64                     origin; //ns of the first enableTrace, trace timestamps start there
+    };
+
+    atomic<bool> g_trace_enabled(false);
+
+    //never destroyed, threads may exit after the static destructors have run
+    static trace_registry_t &trace_registry()
+    {
+        static trace_registry_t *registry = new trace_registry_t();
+        return *registry;
+    }
+
+    static thread_local trace_ring_t* t_trace_ring = NULL;
+
+    struct trace_thread_t
+    {
+        ~trace_thread_t()
+        {
+            if(!t_trace_ring)
+                return;
+            auto &registry = trace_registry();
+            registry.lock.lock();
+            t_trace_ring->owned = false;
+            registry.lock.unlock();
+            t_trace_ring = NULL;
+        }
+    };
+    static thread_local trace_thread_t t_trace_thread;
+
+    u64 trace_now()
+    {
+        return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    //rings of exited threads, the registry mutex must be held
+    static void trace_free_rings(trace_registry_t& registry)
+    {
+        auto end = remove_if(registry.rings.begin(),registry.rings.end(),[](trace_ring_t* ring){
+            if(ring->owned)
+                return false;
+            delete[] ring->events;
+            delete ring;
+            return true;
+        });
+        registry.rings.erase(end,registry.rings.end());
+    }
+
+    //the events are allocated when the ring enters its first session
+    static trace_ring_t* trace_attach()
+    {
+        auto &registry = trace_registry();
+        auto ring = new trace_ring_t();
+        ring->capacity = 0;
+        ring->events = NULL;
+        ring->owned = true;
+        ring->tid = (u32)syscall(SYS_gettid);
+        ring->generation.store(registry.generation.load(memory_order_acquire)-1,memory_order_relaxed);
+        ring->head.store(0,memory_order_relaxed);
+        registry.lock.lock();
+        registry.rings.push_back(ring);
+        registry.lock.unlock();
+        (void)&t_trace_thread;
+        t_trace_ring = ring;
+        return ring;
+    }
+
+    //once per session and thread: postTrace does not read the ring until its generation is current,
+    //the events are resized to the capacity of the session
+    static void trace_enter_session(trace_ring_t* ring)
+    {
+        auto &registry = trace_registry();
+        lock_guard<mutex> lock(registry.lock);
+        if(ring->capacity!=registry.capacity)
+        {
+            delete[] ring->events;
+            ring->capacity = registry.capacity;
+            ring->events = new trace_event_t[ring->capacity];
+        }
+        ring->head.store(0,memory_order_relaxed);
+        ring->generation.store(registry.generation.load(memory_order_relaxed),memory_order_release);
+    }
+
+    void trace_commit(const trace_event_t& event)
+    {
+        auto ring = t_trace_ring;
+        if(!ring)
+            ring = trace_attach();
+        u32 generation = trace_registry().generation.load(memory_order_acquire);
+        if(ring->generation.load(memory_order_relaxed)!=generation)
+            trace_enter_session(ring);
+        u64 head = ring->head.load(memory_order_relaxed);
+        ring->events[head%ring->capacity] = event;
+        ring->head.store(head+1,memory_order_release);
+    }
+
+    static void json_string(string& out,const char* text)
+    {
+        out.push_back('"');
+        for(const char* p=text;*p;p++)
+        {
+            unsigned char c = *p;
+            if(c=='"'||c=='\\')
+            {
+                out.push_back('\\');
+                out.push_back(c);
+            }
+            else if(c<0x20)
+            {
+                char escaped[8];
+                snprintf(escaped,sizeof(escaped),"\\u%04x",c);
+                out.append(escaped);
+            }
+            else
+            {
+                out.push_back(c);
+            }
+        }
+        out.push_back('"');
+    }
+
+    void FastVectorDb::enableTrace(u32 eventsPerThread)
+    {
+        auto &registry = trace_registry();
+        registry.lock.lock();
+        if(registry.origin==0)
+            registry.origin = trace_now();
+        registry.capacity = eventsPerThread<16 ? 16 : eventsPerThread;
+        registry.generation.fetch_add(1,memory_order_release);
+        //rings of exited threads only hold events of older sessions now
+        trace_free_rings(registry);
+        registry.lock.unlock();
+        g_trace_enabled.store(true,memory_order_relaxed);
+    }
+
+    void FastVectorDb::disableTrace()
+    {
+        g_trace_enabled.store(false,memory_order_relaxed);
+    }
+
+    //complete ("X") events of the current session, the oldest ones of a ring that wrapped are gone
+    void FastVectorDb::postTrace(WriteStream* stream)
+    {
+        auto &registry = trace_registry();
+        vector<trace_event_t> events;
+        string out = "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+        bool first = true;
+        int pid = getpid();
+        registry.lock.lock();
+        u32 generation = registry.generation.load(memory_order_acquire);
+        for(auto ring:registry.rings)
+        {
+            if(ring->generation.load(memory_order_acquire)!=generation)
+                continue;
+            u64 head = ring->head.load(memory_order_acquire);
+            u64 begin = head>ring->capacity ? head-ring->capacity : 0;
+            events.clear();
+            for(u64 i=begin;i<head;i++)
+                events.push_back(ring->events[i%ring->capacity]);
+            //slots the writer reused while they were copied are dropped
+            u64 after = ring->head.load(memory_order_acquire);
+            u64 valid = after>ring->capacity ? after-ring->capacity : 0;
+            if(ring->generation.load(memory_order_acquire)!=generation)
+                continue;
+            for(u64 i=std::max(begin,valid);i<head;i++)
+            {
+                auto& event = events[i-begin];
+                char number[160];
+                if(!first)
+                    out.push_back(',');
+                first = false;
+                out.append("{\"name\":");
+                json_string(out,event.name);
+                snprintf(number,sizeof(number),",\"ph\":\"X\",\"pid\":%d,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,\"args\":{",
+                         pid,ring->tid,(event.begin-registry.origin)/1000.0,(event.end-event.begin)/1000.0);
+                out.append(number);
+                bool first_arg = true;
+                if(event.text_key)
+                {
+                    json_string(out,event.text_key);
+                    out.push_back(':');
+                    json_string(out,event.text);
+                    first_arg = false;
+                }
+                for(int k=0;k<2&&event.num_key[k];k++)
+                {
+                    if(!first_arg)
+                        out.push_back(',');
+                    first_arg = false;
+                    json_string(out,event.num_key[k]);
+                    snprintf(number,sizeof(number),":%llu",event.num[k]);
+                    out.append(number);
+                }
+                out.append("}}");
+            }
+            if(out.size()>(1<<20))
+            {
+                stream->write((void*)out.data(),out.size());
+                out.clear();
+            }
+        }
+        //the events of exited threads are in out, their rings go
+        trace_free_rings(registry);
+        registry.lock.unlock();
+        out.append("]}\n");
+        stream->write((void*)out.data(),out.size());
+    }
+
+    bool FastVectorDb::saveTrace(const char* path)
+    {
+        class TraceWriteStream : public WriteStream
+        {
+        public:
+            TraceWriteStream(FILE *f) : fp(f), failed(false) {}
+            void write(void *pdata, size_t size) override
+            {
+                if (fwrite(pdata, 1, size, fp) != size)
+                    failed = true;
+            }
+            FILE *fp;
+            bool failed;
+        };
+        FILE* fp = fopen(path,"wb");
+        if(!fp)
+        {
+            printf("Can't create trace %s: %s\n",path,strerror(errno));
+            return false;
+        }
+        TraceWriteStream stream(fp);
+        postTrace(&stream);
+        bool ok = !stream.failed;
+        if(fclose(fp)!=0)
+            ok = false;
+        if(!ok)
+            printf("Can't write trace %s\n",path);
+        return ok;
+    }
+}
@@ -0,0 +1,90 @@
+#pragma once
+#ifndef __FAST_VECTOR_DB_TRACE_P_H__
+#define __FAST_VECTOR_DB_TRACE_P_H__
+//scoped trace spans behind FastVectorDb::enableTrace.
+//a finished span is copied into the ring of its thread, the owner is the only writer and
+//publishes it by bumping the head, postTrace reads the rings without stopping the writers.
+#include "fastdb.h"
+#include <atomic>
+using namespace std;
+namespace wx
+{
+    const u32 TRACE_TEXT_SIZE = 48;
+
+    struct trace_event_t
+    {
+        const char* name;           //static strings only
+        u64         begin;          //ns, steady clock
+        u64         end;
+        const char* text_key;       //optional string argument, copied into text
+        char        text[TRACE_TEXT_SIZE];
+        const char* num_key[2];     //optional numeric arguments
+        u64         num[2];
+    };
+
+    extern atomic<bool> g_trace_enabled;
+    u64  trace_now();
+    void trace_commit(const trace_event_t& event);
+    inline u64 trace_begin()
+    {
+        return g_trace_enabled.load(memory_order_relaxed) ? trace_now() : 0;
+    }
+
+    class trace_span_t
+    {
+    public:
+        trace_span_t(const char* name)
+            :m_active(g_trace_enabled.load(memory_order_relaxed))
+        {
+            if(!m_active)
+                return;
+            m_event.name = name;
+            m_event.text_key = NULL;
+            m_event.num_key[0] = m_event.num_key[1] = NULL;
+            m_event.begin = trace_now();
+        }
+        //span of an asynchronous operation begun at trace_begin() on any thread, 0: not traced
+        trace_span_t(const char* name,u64 begin)
+            :m_active(begin!=0)
+        {
+            if(!m_active)
+                return;
+            m_event.name = name;
+            m_event.text_key = NULL;
+            m_event.num_key[0] = m_event.num_key[1] = NULL;
+            m_event.begin = begin;
+        }
+       ~trace_span_t()
+        {
+            if(!m_active)
+                return;
+            m_event.end = trace_now();
+            trace_commit(m_event);
+        }
+        //long texts keep their tail, the end of a path is what tells tiles apart
+        void text(const char* key,const char* value)
+        {
+            if(!m_active||!value)
+                return;
+            size_t len = strlen(value);
+            if(len>=TRACE_TEXT_SIZE)
+                value += len-(TRACE_TEXT_SIZE-1);
+            m_event.text_key = key;
+            strncpy(m_event.text,value,TRACE_TEXT_SIZE-1);
+            m_event.text[TRACE_TEXT_SIZE-1] = '\0';
+        }
+        //up to two numbers per span
+        void num(const char* key,u64 value)
+        {
+            if(!m_active)
+                return;
+            int i = m_event.num_key[0] ? 1 : 0;
+            m_event.num_key[i] = key;
+            m_event.num[i] = value;
+        }
+    private:
+        bool            m_active;
+        trace_event_t   m_event;
+    };
+}
+#endif
@@ -0,0 +1,265 @@
+//memfd + SCM_RIGHTS transport:
+//an image is written (or copied) into an anonymous memfd, sealed,
+//and its descriptor is passed over a unix domain socket,
+//the receiver maps it with FastVectorDb::load_fd without any copy or shm name to unlink.
+#include "FastVectorDb_p.h"
+#include "FastVectorDbBuild_p.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+
+namespace wx
+{
+    static const char FD_MESSAGE_MAGIC[8] = "FDBFD01";
+    struct fd_message_t
+    {
+        char magic[8];
+        u64  size;
+    };
+
+    static int create_memfd(const char *name)
+    {
+#ifdef __linux__
+        int fd = memfd_create(name ? name : "fastdb", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+        if (fd == -1)
+            printf("Error creating memfd: %s\n", strerror(errno));
+        return fd;
+#else
+        printf("Error creating memfd: not supported on this platform\n");
+        return -1;
+#endif
+    }
+
+    static bool seal_memfd(int fd)
+    {
+#ifdef __linux__
+        if (fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL) == -1)
+        {
+            printf("Error sealing memfd: %s\n", strerror(errno));
+            return false;
+        }
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    class FdWriteStream : public WriteStream
+    {
+    public:
+        FdWriteStream(int _fd) : fd(_fd), failed(false) {}
+        void write(void *pdata, size_t size) override
+        {
+            const u8 *ptr = (const u8 *)pdata;
+            while (size > 0 && !failed)
+            {
+                ssize_t n = ::write(fd, ptr, size);
+                if (n < 0 && errno == EINTR)
+                    continue;
+                if (n <= 0)
+                {
+                    printf("Error writing memfd: %s\n", strerror(errno));
+                    failed = true;
+                    break;
+                }
+                ptr += n;
+                size -= n;
+            }
+        }
+    public:
+        int  fd;
+        bool failed;
+    };
+
+    int FastVectorDbBuild::postMemfd(const char *name, bool seal)
+    {
+        int fd = create_memfd(name);
+        if (fd == -1)
+            return -1;
+        FdWriteStream stream(fd);
+        post(&stream);
+        if (stream.failed || (seal && !seal_memfd(fd)))
+        {
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    int FastVectorDb::toMemfd(const char *name, bool seal)
+    {
+        int fd = create_memfd(name);
+        if (fd == -1)
+            return -1;
+        chunk_data_t data = buffer();
+        FdWriteStream stream(fd);
+        stream.write((void *)data.pdata, data.size);
+        if (stream.failed || (seal && !seal_memfd(fd)))
+        {
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    static void free_mapped_buffer(void *pdata, size_t size, void *)
+    {
+        munmap(pdata, size);
+    }
+
+    FastVectorDb *FastVectorDb::load_fd(int fd, bool shared)
+    {
+        struct stat fileStat;
+        if (fstat(fd, &fileStat) == -1)
+        {
+            printf("Error getting file status: %s\n", strerror(errno));
+            return NULL;
+        }
+        size_t size = fileStat.st_size;
+        if (size == 0)
+            return NULL;
+#ifdef __linux__
+        //a writable shared mapping of a write sealed memfd is refused by the kernel
+        int seals = fcntl(fd, F_GET_SEALS);
+        if (shared && seals != -1 && (seals & F_SEAL_WRITE))
+        {
+            printf("Error mapping file: sealed memfds can only be loaded with shared=false\n");
+            return NULL;
+        }
+#endif
+        void *pdata = mmap(NULL, size, PROT_READ | PROT_WRITE, shared ? MAP_SHARED : MAP_PRIVATE, fd, 0);
+        if (pdata == MAP_FAILED)
+        {
+            printf("Error mapping file: %s\n", strerror(errno));
+            return NULL;
+        }
+        auto db = load(pdata, size, free_mapped_buffer, NULL);
+        if (!db)
+        {
+            munmap(pdata, size);
+        }
+        return db;
+    }
+
+    bool FastVectorDb::sendFd(int sock, int fd)
+    {
+        struct stat fileStat;
+        if (fstat(fd, &fileStat) == -1)
+            return false;
+        fd_message_t message;
+        memcpy(message.magic, FD_MESSAGE_MAGIC, sizeof(message.magic));
+        message.size = fileStat.st_size;
+
+        struct iovec iov;
+        iov.iov_base = &message;
+        iov.iov_len = sizeof(message);
+        union
+        {
+            char buf[CMSG_SPACE(sizeof(int))];
+            struct cmsghdr align;
+        } control;
+        memset(&control, 0, sizeof(control));
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control.buf;
+        msg.msg_controllen = sizeof(control.buf);
+        struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+        memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+
+        ssize_t n;
+        do
+        {
+            n = sendmsg(sock, &msg, 0);
+        } while (n < 0 && errno == EINTR);
+        if (n != (ssize_t)sizeof(message))
+        {
+            printf("Error sending fd: %s\n", strerror(errno));
+            return false;
+        }
+        return true;
+    }
+
+    int FastVectorDb::recvFd(int sock)
+    {
+        fd_message_t message;
+        struct iovec iov;
+        iov.iov_base = &message;
+        iov.iov_len = sizeof(message);
+        union
+        {
+            char buf[CMSG_SPACE(sizeof(int))];
+            struct cmsghdr align;
+        } control;
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control.buf;
+        msg.msg_controllen = sizeof(control.buf);
+
+        ssize_t n;
+        int flags = 0;
+#ifdef MSG_CMSG_CLOEXEC
+        flags |= MSG_CMSG_CLOEXEC;
+#endif
+        do
+        {
+            n = recvmsg(sock, &msg, flags);
+        } while (n < 0 && errno == EINTR);
+        if (n < 0)
+        {
+            printf("Error receiving fd: %s\n", strerror(errno));
+            return -1;
+        }
+        int fd = -1;
+        for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg))
+        {
+            if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS && fd == -1)
+                memcpy(&fd, CMSG_DATA(cmsg), sizeof(int));
+        }
+        if (fd == -1)
+            return -1;
+        //a truncated control message may have dropped descriptors or carried more than one
+        if (msg.msg_flags & (MSG_CTRUNC | MSG_TRUNC))
+        {
+            printf("Error receiving fd: truncated message\n");
+            close(fd);
+            return -1;
+        }
+        if (n != (ssize_t)sizeof(message) || memcmp(message.magic, FD_MESSAGE_MAGIC, sizeof(message.magic)) != 0)
+        {
+            printf("Error receiving fd: unexpected message\n");
+            close(fd);
+            return -1;
+        }
+#ifdef __linux__
+        //the sender keeps its descriptor: unless it can neither shrink nor write the file, pages of the
+        //receiver's mapping may vanish (SIGBUS) or change under its readers
+        int seals = fcntl(fd, F_GET_SEALS);
+        if (seals == -1 || (seals & (F_SEAL_SHRINK | F_SEAL_WRITE)) != (F_SEAL_SHRINK | F_SEAL_WRITE))
+        {
+            printf("Error receiving fd: the memfd is not sealed against shrinking and writing\n");
+            close(fd);
+            return -1;
+        }
+#endif
+        //the announced size has to match what would be mapped
+        struct stat fileStat;
+        if (fstat(fd, &fileStat) == -1 || (u64)fileStat.st_size != message.size)
+        {
+            printf("Error receiving fd: size mismatch\n");
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+}
@@ -3,7 +3,10 @@
 #define __FAST_VECTOR_DB_P_H__
 #include "fastdb.h"
 #include "FastVectorDbLayer_p.h"
+#include "FastVectorDbSync_p.h"
+#include "FastVectorDbDiff_p.h"
 #include <vector>
+#include <chrono>
 using namespace std;
 namespace wx{
     class FastVectorDb::Impl{
@@ -13,7 +16,30 @@ namespace wx{
         unsigned              getLayerCount();
         FastVectorDbLayer*    getLayer(unsigned ix);
         FastVectorDbFeature*  tryGetFeature(FastVectorDbFeatureRef* ref);
+        FastVectorDbFeatureHandle getFeatureHandle(FastVectorDbFeatureRef* ref);
         chunk_data_t          buffer();
+        bool                  hasControlHeader();
+        u32                   getEpoch();
+        u32                   publish();
+        u32                   wait(u32 epoch,int timeoutMs);
+        u32                   getReadyFlags();
+        u32                   setReadyFlags(u32 mask);
+        u32                   clearReadyFlags(u32 mask);
+        u32                   waitReadyFlags(u32 mask,int timeoutMs);
+        bool                  signature(WriteStream* stream,u32 chunkRows);
+        bool                  diff(const void* signature,size_t size,WriteStream* stream);
+        bool                  applyPatch(const void* patch,size_t size);
+        FastVectorDbMemory    memoryReport();
+    private:
+        size_t                layers_end();
+        void                  collect_chunks(u32 chunkRows,vector<patch_chunk_t>& chunks);
+        bool                  relocate(const signature_header_t* header,const vector<patch_chunk_t>& chunks,WriteStream* stream);
+        bool                  patch_keeps_layout(size_t offset,const u8* bytes,size_t size);
+        bool                  check_patch(const void* pdata,size_t size,bool in_place);
+        void                  load_sections(size_t offset);
+        void                  wake(atomic<u32>* word);
+        bool                  wait_word(atomic<u32>* word,u32 expected,int timeoutMs,
+                                        chrono::steady_clock::time_point deadline);
     private:
         vector<FastVectorDbLayer*> m_layers;
         void*   m_pdata;
@@ -21,6 +47,8 @@ namespace wx{
         fnFreeDbBuffer m_fnFreeBuffer;
         void* m_cookie;
         bool    m_mask_check_ok;
+        control_header_t* m_control;
+        vector<pair<size_t,size_t>> m_backlink_sections;   //image ranges of the back-link payloads, patched as metadata
         friend class FastVectorDb;
     };
 }
@@ -1,78 +1,171 @@
 #include "FastVectorTileDb_p.h"
+#include "FastVectorDbStats_p.h"
+#include "FastVectorDbTrace_p.h"
+#include "FastVectorDbLayer_p.h"
 #include <algorithm>
+#include <cmath>
 namespace wx
 {
+    void free_data_buffer(void *pdata, size_t size, void *pcookie);
 
-    FastVectorTileDb::Impl::Impl(FastVectorTileDb *host,bool mt)
-        : m_host(host),m_mt(mt)
+    //a queued tile no take asked for again within LOAD_CANCEL_MS is dropped from the queue
+    const u32 LOAD_CANCEL_MS = 250;
+    //a failed tile is requested again after LOAD_RETRY_FRAMES takes, doubled per failure in a row
+    const u32 LOAD_RETRY_FRAMES = 8;
+    const u32 LOAD_RETRY_MAX_SHIFT = 10;
+
+    FastVectorTileDb::Impl::Impl(FastVectorTileDb *host,bool mt,u32 loaderThreads)
+        : m_catalog_handles(NULL),m_catalog(NULL),m_catalog_size(0),m_catalog_count(0),m_lru_head(NULL),m_lru_tail(NULL),m_cache_budget(0),m_host(host),m_last_frame(0),m_mt(mt),m_uring(NULL),m_uring_thread(NULL)
     {
+        memset(&m_stats,0,sizeof(m_stats));
+        memset(&m_motion,0,sizeof(m_motion));
+        m_prefetch_tiles = 0;
+        m_prefetch_lookahead = 0;
         m_tile_box_take = new TileBoxTake(32);
         m_thread_runing=mt;
         if(mt)
-            m_thread = new std::thread(FastVectorTileDb::Impl::_load_in_thread,this);
-        else
-            m_thread = nullptr;
+        {
+            if(loaderThreads==0)
+                loaderThreads = std::min(std::max(std::thread::hardware_concurrency(),1u),8u);
+            for(u32 i=0;i<loaderThreads;i++)
+                m_threads.push_back(new std::thread(FastVectorTileDb::Impl::_load_in_thread,this));
+        }
     }
     FastVectorTileDb::Impl::~Impl()
     {
+        m_mutex_load.lock();
         m_thread_runing=false;
-        if(m_thread)
+        m_mutex_load.unlock();
+        m_load_cond.notify_all();
+        for(auto thread:m_threads)
+        {
+            thread->join();
+            delete thread;
+        }
+        if(m_uring_thread)
         {
-            m_thread->join();
-            delete m_thread;
+            m_uring_thread->join();
+            delete m_uring_thread;
         }
-        for (auto &tile : m_tiles_loaded)
+        close_uring();
+        stat_gauge_add(scTileQueueDepth,-(i64)m_load_queue.size());
+        for(auto& retired:m_retired)
+            delete retired.tileData;
+        //every handle is registered in m_tile_handles, loaded or not
+        for (auto &tile : m_tile_handles)
         {
-            delete tile;
+            if(tile<m_catalog_handles||tile>=m_catalog_handles+m_catalog_count)
+                delete tile;
         }
+        delete[] m_catalog_handles;
         delete m_tile_box_take;
+        close_catalog();
+        close_packs();
 
     }
 
     void FastVectorTileDb::Impl::registerTile(const char *path, u8 level, double t, double xmin, double ymin, double xmax, double ymax)
     {
-        u32 id = m_tile_handles.size();
         TileDbHandle_ext *loading = new TileDbHandle_ext(path);
+        loading->level = level;
+        loading->cx = (xmin+xmax)/2;
+        loading->cy = (ymin+ymax)/2;
+        m_mutex_load.lock();
+        int id = m_tile_handles.size();
         m_tile_handles.push_back(loading);
+        resolve_pack(loading);
+        m_mutex_load.unlock();
 
         m_tile_box_take->registerTileBox(id, level, t, xmin, ymin, xmax, ymax, loading);
     }
 
+    //TileBoxTake asks once for every box it puts in the result, the pin is released in freeResult
     bool FastVectorTileDb::Impl::isTileLoaded(const TileBoxTake::TileBox* box)
     {
-        return ((TileDbBox*)box)->handle->tileData!=NULL;
+        auto loading = (TileDbHandle_ext *)((TileDbBox*)box)->handle;
+        loading->pins++;
+        return loading->resident;
+    }
+    //finer levels first, then the tiles closest to the viewport center
+    bool FastVectorTileDb::Impl::load_priority_less(const TileDbHandle_ext* a,const TileDbHandle_ext* b)
+    {
+        if(a->prefetch!=b->prefetch)
+            return a->prefetch;
+        if(a->level!=b->level)
+            return a->level<b->level;
+        return a->distance>b->distance;
     }
     int FastVectorTileDb::Impl::load_in_thread()
     {
-        while (m_thread_runing)
+        unique_lock<mutex> lock(m_mutex_load);
+        while (true)
         {
-            TileDbHandle_ext *loading = NULL;
-            m_mutex_load.lock();
-            if(m_tiles_loading.size()>0)
+            m_load_cond.wait(lock,[this]{ return !m_thread_runing||m_uring||!m_load_queue.empty(); });
+            if(!m_thread_runing)
+                break;
+            if(m_uring)
             {
-                loading = *m_tiles_loading.begin();
+                //the wakeup may have been meant for the ring thread
+                m_load_cond.notify_all();
+                break;
             }
-            m_mutex_load.unlock();
+            pop_heap(m_load_queue.begin(),m_load_queue.end(),load_priority_less);
+            TileDbHandle_ext *loading = m_load_queue.back();
+            m_load_queue.pop_back();
+            stat_gauge_add(scTileQueueDepth,-1);
+            loading->loadState = tlsLoading;
+            lock.unlock();
 
-            if(loading)
-            {
-                printf("threading load>>");
-                auto db = this->m_host->loadTileDataInternal(loading);
-                if(db)
-                {
-                    loading->tileData=db;
-                    m_mutex_load.lock();
-                    m_tiles_loading.erase(m_tiles_loading.begin());
-                    m_tiles_loaded.push_back(loading);
-                    m_mutex_load.unlock();
-                }
-            }
-            else
+            auto db = load_tile(loading);
+
+            lock.lock();
+            load_finished(loading,db);
+        }
+        return 0;
+    }
+    //m_mutex_load must be held
+    void FastVectorTileDb::Impl::load_finished(TileDbHandle_ext* loading,TileData* db)
+    {
+        if(db)
+        {
+            loading->tileData=db;
+            loading->loadState = tlsIdle;
+            loading->failures = 0;
+            if(loading->prefetch)
             {
-                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                loading->prefetched = true;
+                m_stats.prefetchLoads++;
             }
+            cache_insert(loading);
+            stat_add(scTileLoads);
+            stat_add(scTileBytesLoaded,loading->bytes);
         }
-        return 0;
+        else
+        {
+            load_failed(loading);
+        }
+    }
+    //m_mutex_load must be held
+    void FastVectorTileDb::Impl::load_failed(TileDbHandle_ext* loading)
+    {
+        loading->loadState = tlsFailed;
+        loading->retryFrame = m_last_frame+(LOAD_RETRY_FRAMES<<std::min(loading->failures,LOAD_RETRY_MAX_SHIFT));
+        loading->failures++;
+        m_stats.loadFailures++;
+        stat_add(scTileLoadFailures);
+    }
+    bool FastVectorTileDb::Impl::retry_due(const TileDbHandle_ext* loading,u32 frame)
+    {
+        return loading->loadState!=tlsFailed||(int)(frame-loading->retryFrame)>=0;
+    }
+
+    //every tile load goes through the host, subclasses may load from their own sources
+    FastVectorTileDb::TileData* FastVectorTileDb::Impl::load_tile(TileDbHandle_ext* loading)
+    {
+        trace_span_t span("FastVectorTileDb::loadTile");
+        span.text("path",loading->path);
+        span.num("level",loading->level);
+        return m_host->loadTileDataInternal(loading);
     }
 
      int FastVectorTileDb::Impl::_load_in_thread(Impl *pThis)
@@ -81,10 +174,216 @@ namespace wx
         return pThis->load_in_thread();
      }
 
+    //queue the tiles of the current take and cancel the queued ones that fell out of view,
+    //tiles already taken by a loader thread finish loading. m_mutex_load must be held
+    size_t FastVectorTileDb::Impl::request_loads(const vector<TileDbHandle_ext*>& tiles,double x,double y,u32 frame,chrono::steady_clock::time_point now)
+    {
+        size_t added = 0;
+        for(auto loading:tiles)
+        {
+            loading->requestTime = now;
+            loading->distance = std::hypot(loading->cx-x,loading->cy-y);
+            loading->prefetch = false;
+            if(loading->loadState==tlsIdle||(loading->loadState==tlsFailed&&retry_due(loading,frame)))
+            {
+                loading->loadState = tlsQueued;
+                m_load_queue.push_back(loading);
+                m_stats.misses++;
+                stat_add(scTileMisses);
+                added++;
+            }
+        }
+        //takers with other viewports interleave their takes, a request is dropped by its age instead of
+        //by the number of takes since, so busy takers don't cancel the requests of a slower one
+        auto cancel = now-chrono::milliseconds(LOAD_CANCEL_MS);
+        auto end = remove_if(m_load_queue.begin(),m_load_queue.end(),[cancel](TileDbHandle_ext* loading){
+            if(loading->requestTime>cancel)
+                return false;
+            loading->loadState = tlsIdle;
+            return true;
+        });
+        stat_gauge_add(scTileQueueDepth,(i64)added-(m_load_queue.end()-end));
+        m_load_queue.erase(end,m_load_queue.end());
+        make_heap(m_load_queue.begin(),m_load_queue.end(),load_priority_less);
+        return added;
+    }
+
+    void FastVectorTileDb::Impl::cache_insert(TileDbHandle_ext* tile)
+    {
+        tile->bytes = tile->tileData.load()->buffer().size;
+        tile->lruPrev = NULL;
+        tile->lruNext = m_lru_head;
+        if(m_lru_head)
+            m_lru_head->lruPrev = tile;
+        else
+            m_lru_tail = tile;
+        m_lru_head = tile;
+        tile->cached = true;
+        m_stats.bytes += tile->bytes;
+        m_stats.count++;
+        tile->resident = true;
+    }
+    void FastVectorTileDb::Impl::cache_unlink(TileDbHandle_ext* tile)
+    {
+        if(tile->lruPrev)
+            tile->lruPrev->lruNext = tile->lruNext;
+        else
+            m_lru_head = tile->lruNext;
+        if(tile->lruNext)
+            tile->lruNext->lruPrev = tile->lruPrev;
+        else
+            m_lru_tail = tile->lruPrev;
+        tile->lruPrev = tile->lruNext = NULL;
+        tile->cached = false;
+        m_stats.bytes -= tile->bytes;
+        m_stats.count--;
+    }
+    void FastVectorTileDb::Impl::cache_touch(TileDbHandle_ext* tile)
+    {
+        if(!tile->cached||tile==m_lru_head)
+            return;
+        cache_unlink(tile);
+        cache_insert(tile);
+    }
+    //walk from the least recently used end, pinned tiles stay resident
+    void FastVectorTileDb::Impl::cache_evict(u64 maxBytes,u32 maxCount)
+    {
+        release_retired();
+        TileDbHandle_ext* tile = m_lru_tail;
+        while(tile && (m_stats.bytes>maxBytes || m_stats.count>maxCount))
+        {
+            TileDbHandle_ext* prev = tile->lruPrev;
+            if(tile->pins==0)
+            {
+                //a taker pinning the tile now either sees resident cleared or is seen here
+                tile->resident = false;
+                if(tile->pins==0)
+                {
+                    //a taker pinning the tile right after the check above may still read tileData
+                    //and gets the tile or NULL, the tile is deleted once nothing pins the handle
+                    cache_unlink(tile);
+                    m_retired.push_back({tile,tile->tileData.exchange(NULL)});
+                    m_stats.evictions++;
+                    stat_add(scTileEvictions);
+                    if(tile->prefetched)
+                    {
+                        tile->prefetched = false;
+                        m_stats.prefetchWasted++;
+                    }
+                }
+                else
+                {
+                    tile->resident = true;
+                }
+            }
+            tile = prev;
+        }
+    }
+
+    //m_mutex_load must be held. tileData was cleared before it was retired, a taker pinning the handle
+    //later reads NULL or a newer tile, so an unpinned handle has no reader of the retired one left
+    void FastVectorTileDb::Impl::release_retired()
+    {
+        auto end = remove_if(m_retired.begin(),m_retired.end(),[](const retired_tile_t& retired){
+            if(retired.handle->pins>0)
+                return false;
+            delete retired.tileData;
+            return true;
+        });
+        m_retired.erase(end,m_retired.end());
+    }
+
+    //m_mutex_load must be held, false when the viewport does not move enough to prefetch
+    bool FastVectorTileDb::Impl::predict_viewport(double xmin,double ymin,double xmax,double ymax,double box[4])
+    {
+        const double alpha = 0.5;
+        double cx = (xmin+xmax)/2, cy = (ymin+ymax)/2;
+        double w = xmax-xmin, h = ymax-ymin;
+        tile_motion_t& m = m_motion;
+        if(!(w>0&&h>0))
+            return false;
+        //a jump is not a motion, start over
+        if(!m.valid||std::hypot(cx-m.cx,cy-m.cy)>4*std::max(w,h))
+        {
+            m.valid = true;
+            m.vx = m.vy = m.logZoom = 0;
+        }
+        else
+        {
+            m.vx = alpha*(cx-m.cx)+(1-alpha)*m.vx;
+            m.vy = alpha*(cy-m.cy)+(1-alpha)*m.vy;
+            m.logZoom = alpha*log(w/m.w)+(1-alpha)*m.logZoom;
+        }
+        m.cx = cx;
+        m.cy = cy;
+        m.w = w;
+        m.h = h;
+        double dx = m.vx*m_prefetch_lookahead, dy = m.vy*m_prefetch_lookahead;
+        double zoom = exp(m.logZoom*m_prefetch_lookahead);
+        if(std::hypot(dx,dy)<0.05*std::max(w,h)&&fabs(zoom-1)<0.05)
+            return false;
+        box[0] = cx+dx-w*zoom/2;
+        box[1] = cy+dy-h*zoom/2;
+        box[2] = cx+dx+w*zoom/2;
+        box[3] = cy+dy+h*zoom/2;
+        return true;
+    }
+    //queue the missing tiles of the predicted viewport closest to its center,
+    //at most m_prefetch_tiles prefetches wait in the queue. m_mutex_load must be held
+    size_t FastVectorTileDb::Impl::request_prefetch(const TakeResult* predicted,double x,double y,chrono::steady_clock::time_point now)
+    {
+        size_t queued = 0;
+        for(auto loading:m_load_queue)
+        {
+            if(loading->prefetch)
+                queued++;
+        }
+        vector<TileDbHandle_ext*> candidates;
+        for(u32 i=0;i<predicted->count;i++)
+        {
+            auto loading = (TileDbHandle_ext *)predicted->tiles[i]->handle;
+            if(loading->loadState==tlsQueued&&loading->prefetch)
+                loading->requestTime = now;
+            else if(loading->loadState==tlsIdle&&loading->tileData==NULL)
+            {
+                loading->distance = std::hypot(loading->cx-x,loading->cy-y);
+                candidates.push_back(loading);
+            }
+        }
+        if(queued>=m_prefetch_tiles)
+            return 0;
+        size_t n = std::min(candidates.size(),m_prefetch_tiles-queued);
+        partial_sort(candidates.begin(),candidates.begin()+n,candidates.end(),[](const TileDbHandle_ext* a,const TileDbHandle_ext* b){
+            return a->distance<b->distance;
+        });
+        for(size_t i=0;i<n;i++)
+        {
+            auto loading = candidates[i];
+            loading->requestTime = now;
+            loading->prefetch = true;
+            loading->loadState = tlsQueued;
+            m_load_queue.push_back(loading);
+            push_heap(m_load_queue.begin(),m_load_queue.end(),load_priority_less);
+            m_stats.prefetchRequests++;
+            stat_gauge_add(scTileQueueDepth,1);
+        }
+        return n;
+    }
+
     const FastVectorTileDb::TakeResult *FastVectorTileDb::Impl::take(u32 maxLevel, double xmin, double ymin, double xmax, double ymax)
     {
-        m_mutex_take.lock();
         auto rawResult = m_tile_box_take->take(maxLevel, xmin, ymin, xmax, ymax,this);
+        handle_result(rawResult,maxLevel,xmin,ymin,xmax,ymax);
+        return (TakeResult *)rawResult;
+    }
+    //count hits, load or queue the missing tiles of a take, then prefetch and enforce the budget
+    void FastVectorTileDb::Impl::handle_result(const TileBoxTake::TakeResult* rawResult,u32 maxLevel, double xmin, double ymin, double xmax, double ymax)
+    {
+        u32 frame = ++m_last_frame;
+        auto now = chrono::steady_clock::now();
+        vector<TileDbHandle_ext*> requests;
+        size_t added = 0;
+        m_mutex_load.lock();
         if(rawResult)
         {
             for (int i = 0; i < rawResult->count; i++)
@@ -93,66 +392,195 @@ namespace wx
                 auto loading = (TileDbHandle_ext *)tile->handle;
                 if (loading->tileData == NULL)
                 {
-                    if(!m_mt)
+                    if(m_mt)
+                    {
+                        requests.push_back(loading);
+                    }
+                    else if(loading->loadState!=tlsLoading&&retry_due(loading,frame))
                     {
-                        loading->tileData = m_host->loadTileDataInternal(loading);
-                        m_tiles_loaded.push_back(loading);
+                        //without loader threads the taker loads, a tile another taker is loading is skipped
+                        m_stats.misses++;
+                        stat_add(scTileMisses);
+                        loading->loadState = tlsLoading;
+                        requests.push_back(loading);
                     }
-                    else
+                }
+                else
+                {
+                    m_stats.hits++;
+                    stat_add(scTileHits);
+                    if(loading->prefetched)
                     {
-                        m_mutex_load.lock();
-                        if(m_tiles_loading.find(loading) == m_tiles_loading.end())
-                        {
-                            m_tiles_loading.insert(loading);
-                        }
-                        else
-                        {
-                            printf("tile already loading %s\n",loading->_path.c_str());
-                        }
-                        m_mutex_load.unlock();
+                        loading->prefetched = false;
+                        m_stats.prefetchHits++;
                     }
-                    
+                    cache_touch(loading);
                 }
-                loading->lastFrameCounter = m_last_frame;
+                loading->lastFrameCounter = frame;
             }
-            return (TakeResult *)rawResult;
         }
-        else
+        if(m_mt)
+        {
+            added = request_loads(requests,(xmin+xmax)/2,(ymin+ymax)/2,frame,now);
+        }
+        else if(!requests.empty())
+        {
+            //loads run outside the lock as on the loader threads, other takers and the cache go on meanwhile
+            m_mutex_load.unlock();
+            vector<TileData*> loaded;
+            for(auto loading:requests)
+                loaded.push_back(load_tile(loading));
+            m_mutex_load.lock();
+            for(size_t i=0;i<requests.size();i++)
+                load_finished(requests[i],loaded[i]);
+        }
+        double predicted[4];
+        bool prefetch = m_mt&&m_prefetch_tiles&&predict_viewport(xmin,ymin,xmax,ymax,predicted);
+        if(m_cache_budget)
+            cache_evict(m_cache_budget,UINT32_MAX);
+        m_mutex_load.unlock();
+        if(prefetch)
+        {
+            //tiles the predicted viewport shows once everything is loaded, nothing is pinned
+            auto next = m_tile_box_take->take(maxLevel,predicted[0],predicted[1],predicted[2],predicted[3]);
+            if(next)
+            {
+                m_mutex_load.lock();
+                added += request_prefetch((const TakeResult*)next,(predicted[0]+predicted[2])/2,(predicted[1]+predicted[3])/2,now);
+                m_mutex_load.unlock();
+                m_tile_box_take->freeResult(next);
+            }
+        }
+        if(added==1)
+            m_load_cond.notify_one();
+        else if(added>1)
+            m_load_cond.notify_all();
+    }
+    const FastVectorTileDb::TakeFrame *FastVectorTileDb::Impl::take_incremental(TakeCursor* cursor,u32 maxLevel, double xmin, double ymin, double xmax, double ymax)
+    {
+        auto boxFrame = m_tile_box_take->takeIncremental(cursor->boxes,maxLevel,xmin,ymin,xmax,ymax,this);
+        handle_result(boxFrame->result,maxLevel,xmin,ymin,xmax,ymax);
+        //every box of the new result was pinned, the previous result is released
+        for(auto loading:cursor->pinned)
+            loading->pins--;
+        cursor->pinned.clear();
+        if(boxFrame->result)
         {
-            m_mutex_take.unlock();
-            return nullptr;
+            for(u32 i=0;i<boxFrame->result->count;i++)
+                cursor->pinned.push_back((TileDbHandle_ext *)boxFrame->result->tiles[i]->cookie);
         }
+        return (const TakeFrame*)boxFrame;
+    }
+    FastVectorTileDb::TakeCursor *FastVectorTileDb::Impl::create_cursor()
+    {
+        auto cursor = new TakeCursor();
+        cursor->boxes = m_tile_box_take->createCursor();
+        return cursor;
+    }
+    void FastVectorTileDb::Impl::free_cursor(TakeCursor* cursor)
+    {
+        for(auto loading:cursor->pinned)
+            loading->pins--;
+        m_tile_box_take->freeCursor(cursor->boxes);
+        delete cursor;
     }
     void FastVectorTileDb::Impl::freeResult(const TakeResult *result)
     {
+        if(!result)
+            return;
+        for (u32 i = 0; i < result->count; i++)
+            ((TileDbHandle_ext *)result->tiles[i]->handle)->pins--;
         m_tile_box_take->freeResult((TileBoxTake::TakeResult *)result);
-        if(result)
-            m_mutex_take.unlock();
     }
     void FastVectorTileDb::Impl::shrink(u32 maxTileCache)
     {
-        m_mutex_take.lock();
         m_mutex_load.lock();
-        stable_sort<>(m_tiles_loaded.begin(), m_tiles_loaded.end(),
-            [](wx::TileDbHandle_ext* a,wx::TileDbHandle_ext* b)
-            {
-                return a->lastFrameCounter < b->lastFrameCounter;
-            }
-        );
+        cache_evict(UINT64_MAX,maxTileCache);
+        m_mutex_load.unlock();
+    }
+    void FastVectorTileDb::Impl::setCacheBudget(u64 bytes)
+    {
+        m_mutex_load.lock();
+        m_cache_budget = bytes;
+        if(m_cache_budget)
+            cache_evict(m_cache_budget,UINT32_MAX);
+        m_mutex_load.unlock();
+    }
+    void FastVectorTileDb::Impl::enablePrefetch(u32 maxTiles,double lookahead)
+    {
+        if(!m_mt&&maxTiles)
+            printf("tile prefetch needs loader threads, FastVectorTileDb(mt=true)\n");
+        m_mutex_load.lock();
+        m_prefetch_tiles = maxTiles;
+        m_prefetch_lookahead = lookahead;
+        m_motion.valid = false;
+        m_mutex_load.unlock();
+    }
+    FastVectorTileDb::CacheStats FastVectorTileDb::Impl::getCacheStats()
+    {
+        m_mutex_load.lock();
+        CacheStats stats = m_stats;
+        stats.budget = m_cache_budget;
+        stats.queued = m_load_queue.size();
+        stats.pinned = 0;
+        for(auto tile = m_lru_head;tile;tile = tile->lruNext)
+        {
+            if(tile->pins>0)
+                stats.pinned++;
+        }
+        m_mutex_load.unlock();
+        return stats;
+    }
 
-        while (m_tiles_loaded.size() > maxTileCache)
+    FastVectorTileDb::CacheMemory FastVectorTileDb::Impl::memoryReport()
+    {
+        CacheMemory report;
+        memset(&report,0,sizeof(report));
+        u64 pack_resident = 0;
+        m_mutex_load.lock();
+        for(auto tile = m_lru_head;tile;tile = tile->lruNext)
+        {
+            if(!tile->tileData)
+                continue;
+            auto tile_report = tile->tileData.load()->memoryReport();
+            //every member of FastVectorDbMemory is a u64
+            auto* sum = (u64*)&report.tiles;
+            auto* add = (const u64*)&tile_report;
+            for(size_t i=0;i<sizeof(FastVectorDbMemory)/sizeof(u64);i++)
+                sum[i] += add[i];
+            if(tile->pack)
+                pack_resident += tile_report.resident;
+            report.residentTiles++;
+        }
+        report.handles = memory_vector_bytes(m_tile_handles);
+        if(m_catalog_handles)
+            report.handles += memory_heap_bytes(m_catalog_count*sizeof(TileDbHandle_ext)+sizeof(size_t));
+        for(auto tile:m_tile_handles)
         {
-            m_tiles_loaded.back()->shrink();
-            m_tiles_loaded.pop_back();
+            bool in_catalog = tile>=m_catalog_handles&&tile<m_catalog_handles+m_catalog_count;
+            if(!in_catalog)
+                report.handles += memory_heap_bytes(sizeof(TileDbHandle_ext));
+            //a path outside the string's own buffer is a heap block of capacity()+1 bytes
+            const char* chars = tile->_path.data();
+            bool heap = chars<(const char*)&tile->_path||chars>=(const char*)(&tile->_path+1);
+            if(!in_catalog&&heap)
+                report.handles += memory_heap_bytes(tile->_path.capacity()+1);
         }
+        report.queue = memory_vector_bytes(m_load_queue);
+        if(m_catalog)
+            report.catalog = memory_resident_bytes(m_catalog,m_catalog_size);
+        for(auto& pack:m_packs)
+            report.packs += memory_resident_bytes(pack.first,pack.second);
         m_mutex_load.unlock();
-        m_mutex_take.unlock();
+        report.index = m_tile_box_take->memoryBytes();
+        report.total = report.tiles.total-pack_resident+report.handles+report.index+report.queue+report.catalog+report.packs;
+        return report;
     }
 
     ///////////////////////////////////////////////////////////////
-    FastVectorTileDb::FastVectorTileDb(bool mt)
+    FastVectorTileDb::FastVectorTileDb(bool mt,u32 loaderThreads)
     {
-        impl = new Impl(this,mt);
+        impl = new Impl(this,mt,loaderThreads);
     }
     FastVectorTileDb::~FastVectorTileDb()
     {
@@ -174,10 +602,72 @@ namespace wx
     {
         impl->shrink(maxTileCache);
     }
+    void FastVectorTileDb::setCacheBudget(u64 bytes)
+    {
+        impl->setCacheBudget(bytes);
+    }
+    FastVectorTileDb::CacheStats FastVectorTileDb::getCacheStats()
+    {
+        return impl->getCacheStats();
+    }
+    FastVectorTileDb::CacheMemory FastVectorTileDb::memoryReport()
+    {
+        return impl->memoryReport();
+    }
+    void FastVectorTileDb::enablePrefetch(u32 maxTiles,double lookahead)
+    {
+        impl->enablePrefetch(maxTiles,lookahead);
+    }
+    bool FastVectorTileDb::saveCatalog(const char* path)
+    {
+        return impl->saveCatalog(path);
+    }
+    bool FastVectorTileDb::openCatalog(const char* path)
+    {
+        return impl->openCatalog(path);
+    }
+    bool FastVectorTileDb::writePack(const char* path)
+    {
+        return impl->writePack(path);
+    }
+    bool FastVectorTileDb::openPack(const char* path)
+    {
+        return impl->openPack(path);
+    }
+    FastVectorTileDb::TakeCursor *FastVectorTileDb::createCursor()
+    {
+        return impl->create_cursor();
+    }
+    const FastVectorTileDb::TakeFrame *FastVectorTileDb::takeIncremental(TakeCursor* cursor,u32 maxLevel, double xmin, double ymin, double xmax, double ymax)
+    {
+        return impl->take_incremental(cursor,maxLevel,xmin,ymin,xmax,ymax);
+    }
+    void FastVectorTileDb::freeCursor(TakeCursor* cursor)
+    {
+        if(cursor)
+            impl->free_cursor(cursor);
+    }
+    bool FastVectorTileDb::enableAsyncIO(u32 queueDepth)
+    {
+        return impl->enableAsyncIO(queueDepth);
+    }
 
     FastVectorTileDb::TileData *FastVectorTileDb::loadTileDataInternal(TileDataHandle *loading)
     {
+        auto packed = (TileDbHandle_ext *)loading;
+        auto pack = packed->pack.load(memory_order_acquire);
+        if(pack)
+            return Impl::load_from_pack(packed,pack);
         auto path = loading->path;
+        if(packed->ioBuffer)
+        {
+            auto buffer = packed->ioBuffer;
+            packed->ioBuffer = NULL;
+            auto db = FastVectorDb::load(buffer,packed->ioSize,free_data_buffer,0);
+            if(!db)
+                printf("Can't load tile db %s\n",path);
+            return db;
+        }
         auto db = FastVectorDb::load(path);
         if(!db)
         {
@@ -0,0 +1,189 @@
+#include "FastVectorTileDb_p.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+
+namespace wx
+{
+    class CatalogWriteStream : public WriteStream
+    {
+    public:
+        CatalogWriteStream(FILE *f) : fp(f), failed(false) {}
+        void write(void *pdata, size_t size) override
+        {
+            if (fwrite(pdata, 1, size, fp) != size)
+                failed = true;
+        }
+        FILE *fp;
+        bool failed;
+    };
+
+    bool FastVectorTileDb::Impl::saveCatalog(const char *path)
+    {
+        vector<tile_catalog_record_t> records;
+        string paths;
+        m_mutex_load.lock();
+        records.resize(m_tile_handles.size());
+        for (size_t i = 0; i < m_tile_handles.size(); i++)
+        {
+            auto tile = m_tile_handles[i];
+            auto &record = records[i];
+            memset(&record, 0, sizeof(record));
+            record.path_offset = paths.size();
+            record.level = tile->level;
+            record.cx = tile->cx;
+            record.cy = tile->cy;
+            paths.append(tile->path);
+            paths.push_back('\0');
+        }
+        m_mutex_load.unlock();
+        paths.resize((paths.size() + 7) & ~(size_t)7, '\0');
+
+        //written aside and renamed over path, a reader never maps a partial catalog
+        string tmpPath = string(path) + ".tmp";
+        FILE *fp = fopen(tmpPath.c_str(), "wb");
+        if (!fp)
+        {
+            printf("Can't create tile catalog %s: %s\n", tmpPath.c_str(), strerror(errno));
+            return false;
+        }
+        tile_catalog_header_t header;
+        memset(&header, 0, sizeof(header));
+        strcpy(header.magic, "FDBCAT1");
+        header.tile_count = records.size();
+        header.paths_offset = sizeof(header) + sizeof(tile_catalog_record_t) * records.size();
+        header.paths_size = paths.size();
+        header.boxes_offset = header.paths_offset + header.paths_size;
+        CatalogWriteStream fws(fp);
+        fws.write(&header, sizeof(header));
+        fws.write(records.data(), sizeof(tile_catalog_record_t) * records.size());
+        fws.write((void *)paths.data(), paths.size());
+        m_tile_box_take->save(&fws);
+        //the box section runs to the end of the file
+        long end = ftell(fp);
+        header.boxes_size = end - header.boxes_offset;
+        fseek(fp, 0, SEEK_SET);
+        fws.write(&header, sizeof(header));
+        bool ok = !fws.failed && fflush(fp) == 0 && fsync(fileno(fp)) == 0;
+        if (fclose(fp) != 0)
+            ok = false;
+        if (!ok)
+        {
+            printf("Can't write tile catalog %s\n", tmpPath.c_str());
+            unlink(tmpPath.c_str());
+            return false;
+        }
+        if (rename(tmpPath.c_str(), path) != 0)
+        {
+            printf("Can't rename tile catalog %s to %s: %s\n", tmpPath.c_str(), path, strerror(errno));
+            unlink(tmpPath.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    bool FastVectorTileDb::Impl::openCatalog(const char *path)
+    {
+        m_mutex_load.lock();
+        bool empty = m_tile_handles.empty() && m_catalog == NULL;
+        m_mutex_load.unlock();
+        if (!empty)
+        {
+            printf("open tile catalog %s before registering tiles\n", path);
+            return false;
+        }
+        int fd = open(path, O_RDONLY | O_CLOEXEC);
+        if (fd == -1)
+        {
+            printf("Can't open tile catalog %s: %s\n", path, strerror(errno));
+            return false;
+        }
+        struct stat fileStat;
+        if (fstat(fd, &fileStat) == -1 || (size_t)fileStat.st_size < sizeof(tile_catalog_header_t))
+        {
+            printf("Invalid tile catalog %s\n", path);
+            close(fd);
+            return false;
+        }
+        size_t size = fileStat.st_size;
+        void *pdata = mmap(NULL, size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+        close(fd);
+        if (pdata == MAP_FAILED)
+        {
+            printf("Error mapping tile catalog %s: %s\n", path, strerror(errno));
+            return false;
+        }
+        m_catalog = pdata;
+        m_catalog_size = size;
+
+        const u8 *base = (const u8 *)pdata;
+        auto header = (const tile_catalog_header_t *)base;
+        size_t records_end = sizeof(tile_catalog_header_t) + sizeof(tile_catalog_record_t) * (size_t)header->tile_count;
+        //sizes are compared with what is left behind their offsets, forged ones can't wrap around
+        if (strcmp(header->magic, "FDBCAT1") != 0 || header->paths_offset != records_end ||
+            header->paths_offset > size || header->paths_size > size - header->paths_offset ||
+            header->boxes_offset > size || header->boxes_size > size - header->boxes_offset ||
+            header->boxes_offset < header->paths_offset + header->paths_size)
+        {
+            printf("Invalid tile catalog %s\n", path);
+            close_catalog();
+            return false;
+        }
+        u32 count = header->tile_count;
+        auto records = (const tile_catalog_record_t *)(header + 1);
+        const char *paths = (const char *)base + header->paths_offset;
+        //the pool ends with a NUL, every path offset inside it is terminated
+        if (count && (header->paths_size == 0 || paths[header->paths_size - 1] != '\0'))
+        {
+            printf("Invalid tile catalog %s\n", path);
+            close_catalog();
+            return false;
+        }
+        auto handles = new TileDbHandle_ext[count];
+        vector<void *> cookies(count);
+        for (u32 i = 0; i < count; i++)
+        {
+            if (records[i].path_offset >= header->paths_size)
+            {
+                printf("Invalid tile catalog %s\n", path);
+                delete[] handles;
+                close_catalog();
+                return false;
+            }
+            auto &tile = handles[i];
+            tile.path = paths + records[i].path_offset;
+            tile.level = records[i].level;
+            tile.cx = records[i].cx;
+            tile.cy = records[i].cy;
+            cookies[i] = &tile;
+        }
+        if (!m_tile_box_take->load(base + header->boxes_offset, header->boxes_size, cookies.data(), count))
+        {
+            printf("Invalid tile catalog %s\n", path);
+            delete[] handles;
+            close_catalog();
+            return false;
+        }
+        m_mutex_load.lock();
+        m_catalog_handles = handles;
+        m_catalog_count = count;
+        m_tile_handles.reserve(count);
+        for (u32 i = 0; i < count; i++)
+        {
+            m_tile_handles.push_back(handles + i);
+            resolve_pack(handles + i);
+        }
+        m_mutex_load.unlock();
+        return true;
+    }
+
+    void FastVectorTileDb::Impl::close_catalog()
+    {
+        if (m_catalog)
+            munmap(m_catalog, m_catalog_size);
+        m_catalog = NULL;
+        m_catalog_size = 0;
+    }
+}
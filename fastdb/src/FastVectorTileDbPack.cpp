@@ -0,0 +1,203 @@
+#include "FastVectorTileDb_p.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+
+namespace wx
+{
+    static bool read_tile_file(const char *path, vector<u8> &buffer)
+    {
+        FILE *fp = fopen(path, "rb");
+        if (!fp)
+            return false;
+        fseek(fp, 0, SEEK_END);
+        long size = ftell(fp);
+        fseek(fp, 0, SEEK_SET);
+        buffer.resize(size > 0 ? size : 0);
+        bool ok = size > 0 && fread(buffer.data(), 1, size, fp) == (size_t)size;
+        fclose(fp);
+        return ok;
+    }
+
+    bool FastVectorTileDb::Impl::writePack(const char *path)
+    {
+        vector<string> paths;
+        m_mutex_load.lock();
+        for (auto tile : m_tile_handles)
+            paths.push_back(tile->path);
+        m_mutex_load.unlock();
+
+        //written aside and renamed over path like the catalog, a pack mapped by openPack keeps its pages
+        string tmpPath = string(path) + ".tmp";
+        FILE *fp = fopen(tmpPath.c_str(), "wb");
+        if (!fp)
+        {
+            printf("Can't create tile pack %s: %s\n", tmpPath.c_str(), strerror(errno));
+            return false;
+        }
+        vector<u8> zeros(TILE_PACK_ALIGN, 0);
+        vector<tile_pack_entry_t> entries(paths.size());
+        string pool;
+        vector<u8> buffer;
+        u64 offset = TILE_PACK_ALIGN;
+        bool ok = fwrite(zeros.data(), 1, TILE_PACK_ALIGN, fp) == TILE_PACK_ALIGN;
+        for (size_t i = 0; i < paths.size() && ok; i++)
+        {
+            if (!read_tile_file(paths[i].c_str(), buffer))
+            {
+                printf("Can't read tile %s\n", paths[i].c_str());
+                ok = false;
+                break;
+            }
+            auto &entry = entries[i];
+            memset(&entry, 0, sizeof(entry));
+            entry.offset = offset;
+            entry.size = buffer.size();
+            entry.path_offset = pool.size();
+            pool.append(paths[i]);
+            pool.push_back('\0');
+            size_t padding = (TILE_PACK_ALIGN - buffer.size() % TILE_PACK_ALIGN) % TILE_PACK_ALIGN;
+            ok = fwrite(buffer.data(), 1, buffer.size(), fp) == buffer.size() &&
+                 fwrite(zeros.data(), 1, padding, fp) == padding;
+            offset += buffer.size() + padding;
+        }
+        if (ok)
+        {
+            tile_pack_header_t header;
+            memset(&header, 0, sizeof(header));
+            strcpy(header.magic, "FDBPAK1");
+            header.tile_count = entries.size();
+            header.directory_offset = offset;
+            header.paths_offset = offset + sizeof(tile_pack_entry_t) * entries.size();
+            header.paths_size = pool.size();
+            ok = fwrite(entries.data(), sizeof(tile_pack_entry_t), entries.size(), fp) == entries.size() &&
+                 fwrite(pool.data(), 1, pool.size(), fp) == pool.size() &&
+                 fseek(fp, 0, SEEK_SET) == 0 &&
+                 fwrite(&header, 1, sizeof(header), fp) == sizeof(header);
+        }
+        ok = ok && fflush(fp) == 0 && fsync(fileno(fp)) == 0;
+        if (fclose(fp) != 0)
+            ok = false;
+        if (!ok)
+        {
+            printf("Can't write tile pack %s\n", tmpPath.c_str());
+            unlink(tmpPath.c_str());
+            return false;
+        }
+        if (rename(tmpPath.c_str(), path) != 0)
+        {
+            printf("Can't rename tile pack %s to %s: %s\n", tmpPath.c_str(), path, strerror(errno));
+            unlink(tmpPath.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    bool FastVectorTileDb::Impl::openPack(const char *path)
+    {
+        int fd = open(path, O_RDONLY | O_CLOEXEC);
+        if (fd == -1)
+        {
+            printf("Can't open tile pack %s: %s\n", path, strerror(errno));
+            return false;
+        }
+        struct stat fileStat;
+        if (fstat(fd, &fileStat) == -1 || (size_t)fileStat.st_size < TILE_PACK_ALIGN)
+        {
+            printf("Invalid tile pack %s\n", path);
+            close(fd);
+            return false;
+        }
+        size_t size = fileStat.st_size;
+        //private writable mapping: a tile modified in memory never reaches the file
+        void *pdata = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (pdata == MAP_FAILED)
+        {
+            printf("Error mapping tile pack %s: %s\n", path, strerror(errno));
+            return false;
+        }
+        u8 *base = (u8 *)pdata;
+        auto header = (const tile_pack_header_t *)base;
+        const tile_pack_entry_t *entries = (const tile_pack_entry_t *)(base + header->directory_offset);
+        const char *pool = (const char *)base + header->paths_offset;
+        //sizes are compared with what is left behind their offsets, forged ones can't wrap around
+        if (strcmp(header->magic, "FDBPAK1") != 0 || header->directory_offset > size ||
+            header->tile_count > (size - header->directory_offset) / sizeof(tile_pack_entry_t) ||
+            header->paths_offset != header->directory_offset + sizeof(tile_pack_entry_t) * (u64)header->tile_count ||
+            header->paths_size > size - header->paths_offset ||
+            (header->paths_size && pool[header->paths_size - 1] != '\0'))
+        {
+            printf("Invalid tile pack %s\n", path);
+            munmap(pdata, size);
+            return false;
+        }
+        for (u32 i = 0; i < header->tile_count; i++)
+        {
+            auto &entry = entries[i];
+            if (entry.path_offset >= header->paths_size || entry.offset % TILE_PACK_ALIGN ||
+                entry.offset > header->directory_offset || entry.size > header->directory_offset - entry.offset)
+            {
+                printf("Invalid tile pack %s\n", path);
+                munmap(pdata, size);
+                return false;
+            }
+        }
+        u32 found = 0, missing = 0;
+        m_mutex_load.lock();
+        m_packs.push_back(make_pair(pdata, size));
+        //tiles registered later are resolved by registerTile
+        for (u32 i = 0; i < header->tile_count; i++)
+        {
+            m_pack_refs.push_back({base + entries[i].offset, (size_t)entries[i].size});
+            m_pack_directory[string_view(pool + entries[i].path_offset)] = &m_pack_refs.back();
+        }
+        for (auto tile : m_tile_handles)
+        {
+            //a resident tile keeps its buffer, the pack is used from its next load
+            resolve_pack(tile);
+            if (tile->pack)
+                found++;
+            else
+                missing++;
+        }
+        m_mutex_load.unlock();
+        if (missing)
+            printf("tile pack %s: %u tiles found, %u registered tiles are not in it\n", path, found, missing);
+        return true;
+    }
+
+    //m_mutex_load must be held
+    void FastVectorTileDb::Impl::resolve_pack(TileDbHandle_ext *tile)
+    {
+        auto it = m_pack_directory.find(string_view(tile->path));
+        if (it != m_pack_directory.end())
+            tile->pack.store(it->second, memory_order_release);
+    }
+
+    //drop the pages of an evicted tile, they are faulted in again from the pack on the next load
+    static void free_pack_buffer(void *pdata, size_t size, void *)
+    {
+        size = (size + TILE_PACK_ALIGN - 1) & ~(size_t)(TILE_PACK_ALIGN - 1);
+        madvise(pdata, size, MADV_DONTNEED);
+    }
+
+    FastVectorTileDb::TileData *FastVectorTileDb::Impl::load_from_pack(TileDbHandle_ext *tile, const tile_pack_ref_t *pack)
+    {
+        auto db = FastVectorDb::load(pack->data, pack->size, free_pack_buffer, NULL);
+        if (!db)
+            printf("Can't load tile db %s from its pack\n", tile->path);
+        return db;
+    }
+
+    void FastVectorTileDb::Impl::close_packs()
+    {
+        m_pack_directory.clear();
+        m_pack_refs.clear();
+        for (auto &pack : m_packs)
+            munmap(pack.first, pack.second);
+        m_packs.clear();
+    }
+}
@@ -0,0 +1,395 @@
+#include "FastVectorTileDb_p.h"
+#include "FastVectorDbStats_p.h"
+#include "FastVectorDbTrace_p.h"
+#include <algorithm>
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+
+namespace wx
+{
+    //one tile file in flight: openat and statx together, then reads until the file is in memory
+    struct tile_read_t
+    {
+        TileDbHandle_ext*   tile;
+        int                 fd;
+        int                 error;      //errno of the first failed operation
+        u32                 pending;    //operations submitted and not completed
+        struct statx        st;
+        u8*                 buffer;
+        size_t              size;
+        size_t              done;
+        u64                 trace_begin;    //submission time when tracing
+    };
+    //operation of a completion, kept in the low bits of user_data
+    enum TileReadOpEnum
+    {
+        troOpen = 0,
+        troStat,
+        troRead
+    };
+    const u32 TILE_READ_CHUNK = 1u << 30;
+
+    //minimal io_uring on the raw syscalls, used by the ring thread only
+    class tile_uring_t
+    {
+    public:
+        tile_uring_t();
+       ~tile_uring_t();
+        bool    init(u32 depth);
+        void    start(TileDbHandle_ext* tile);
+        //submit the prepared operations and wait for at least one completion, finished reads are appended
+        void    wait(vector<tile_read_t*>& finished);
+        u32     in_flight() const { return m_in_flight; }
+        u32     depth() const { return m_depth; }
+    private:
+        io_uring_sqe*   get_sqe(tile_read_t* read,u32 op);
+        void            submit_read(tile_read_t* read);
+        void            complete(tile_read_t* read,u32 op,int res,vector<tile_read_t*>& finished);
+        void            finish(tile_read_t* read,vector<tile_read_t*>& finished);
+    private:
+        int             m_fd;
+        u32             m_depth;
+        u32             m_in_flight;    //tile reads, not operations
+        u32             m_sq_local_tail;    //prepared up to here, published in wait
+        void*           m_sq_ring;
+        size_t          m_sq_ring_size;
+        void*           m_cq_ring;
+        size_t          m_cq_ring_size;
+        io_uring_sqe*   m_sqes;
+        size_t          m_sqes_size;
+        u32*            m_sq_head;
+        u32*            m_sq_tail;
+        u32*            m_sq_mask;
+        u32*            m_sq_array;
+        u32*            m_cq_head;
+        u32*            m_cq_tail;
+        u32*            m_cq_mask;
+        io_uring_cqe*   m_cqes;
+    };
+
+    tile_uring_t::tile_uring_t()
+        : m_fd(-1),m_depth(0),m_in_flight(0),m_sq_local_tail(0),m_sq_ring(MAP_FAILED),m_sq_ring_size(0),
+          m_cq_ring(MAP_FAILED),m_cq_ring_size(0),m_sqes((io_uring_sqe*)MAP_FAILED),m_sqes_size(0)
+    {
+    }
+    tile_uring_t::~tile_uring_t()
+    {
+        if(m_sqes!=MAP_FAILED)
+            munmap(m_sqes,m_sqes_size);
+        if(m_cq_ring!=MAP_FAILED&&m_cq_ring!=m_sq_ring)
+            munmap(m_cq_ring,m_cq_ring_size);
+        if(m_sq_ring!=MAP_FAILED)
+            munmap(m_sq_ring,m_sq_ring_size);
+        if(m_fd!=-1)
+            close(m_fd);
+    }
+    bool tile_uring_t::init(u32 depth)
+    {
+        //a tile read has at most two operations submitted at once
+        io_uring_params params;
+        memset(&params,0,sizeof(params));
+        m_fd = syscall(__NR_io_uring_setup,depth*2,&params);
+        if(m_fd<0)
+        {
+            printf("io_uring is unavailable: %s\n",strerror(errno));
+            m_fd = -1;
+            return false;
+        }
+        size_t probe_size = sizeof(io_uring_probe)+256*sizeof(io_uring_probe_op);
+        auto probe = (io_uring_probe*)calloc(1,probe_size);
+        bool supported = syscall(__NR_io_uring_register,m_fd,IORING_REGISTER_PROBE,probe,256)>=0;
+        for(u32 op:{IORING_OP_OPENAT,IORING_OP_STATX,IORING_OP_READ})
+            supported = supported && op<=probe->last_op && (probe->ops[op].flags&IO_URING_OP_SUPPORTED);
+        free(probe);
+        if(!supported)
+        {
+            printf("io_uring can't open, stat and read files on this kernel\n");
+            return false;
+        }
+        m_sq_ring_size = params.sq_off.array+params.sq_entries*sizeof(u32);
+        m_cq_ring_size = params.cq_off.cqes+params.cq_entries*sizeof(io_uring_cqe);
+        if(params.features&IORING_FEAT_SINGLE_MMAP)
+            m_sq_ring_size = m_cq_ring_size = std::max(m_sq_ring_size,m_cq_ring_size);
+        m_sq_ring = mmap(NULL,m_sq_ring_size,PROT_READ|PROT_WRITE,MAP_SHARED|MAP_POPULATE,m_fd,IORING_OFF_SQ_RING);
+        if(m_sq_ring!=MAP_FAILED)
+        {
+            if(params.features&IORING_FEAT_SINGLE_MMAP)
+                m_cq_ring = m_sq_ring;
+            else
+                m_cq_ring = mmap(NULL,m_cq_ring_size,PROT_READ|PROT_WRITE,MAP_SHARED|MAP_POPULATE,m_fd,IORING_OFF_CQ_RING);
+        }
+        m_sqes_size = params.sq_entries*sizeof(io_uring_sqe);
+        if(m_cq_ring!=MAP_FAILED)
+            m_sqes = (io_uring_sqe*)mmap(NULL,m_sqes_size,PROT_READ|PROT_WRITE,MAP_SHARED|MAP_POPULATE,m_fd,IORING_OFF_SQES);
+        if(m_sqes==MAP_FAILED)
+        {
+            printf("Error mapping io_uring: %s\n",strerror(errno));
+            return false;
+        }
+        u8* sq = (u8*)m_sq_ring;
+        u8* cq = (u8*)m_cq_ring;
+        m_sq_head = (u32*)(sq+params.sq_off.head);
+        m_sq_tail = (u32*)(sq+params.sq_off.tail);
+        m_sq_mask = (u32*)(sq+params.sq_off.ring_mask);
+        m_sq_array = (u32*)(sq+params.sq_off.array);
+        m_cq_head = (u32*)(cq+params.cq_off.head);
+        m_cq_tail = (u32*)(cq+params.cq_off.tail);
+        m_cq_mask = (u32*)(cq+params.cq_off.ring_mask);
+        m_cqes = (io_uring_cqe*)(cq+params.cq_off.cqes);
+        m_sq_local_tail = *m_sq_tail;
+        m_depth = depth;
+        return true;
+    }
+    io_uring_sqe* tile_uring_t::get_sqe(tile_read_t* read,u32 op)
+    {
+        u32 index = m_sq_local_tail++ & *m_sq_mask;
+        io_uring_sqe* sqe = &m_sqes[index];
+        memset(sqe,0,sizeof(*sqe));
+        sqe->user_data = (u64)read|op;
+        m_sq_array[index] = index;
+        read->pending++;
+        return sqe;
+    }
+    void tile_uring_t::start(TileDbHandle_ext* tile)
+    {
+        auto read = new tile_read_t;
+        memset(read,0,sizeof(*read));
+        read->tile = tile;
+        read->fd = -1;
+        read->trace_begin = trace_begin();
+        auto sqe = get_sqe(read,troOpen);
+        sqe->opcode = IORING_OP_OPENAT;
+        sqe->fd = AT_FDCWD;
+        sqe->addr = (u64)tile->path;
+        sqe->open_flags = O_RDONLY|O_CLOEXEC;
+        sqe = get_sqe(read,troStat);
+        sqe->opcode = IORING_OP_STATX;
+        sqe->fd = AT_FDCWD;
+        sqe->addr = (u64)tile->path;
+        sqe->len = STATX_SIZE;
+        sqe->off = (u64)&read->st;
+        m_in_flight++;
+    }
+    void tile_uring_t::submit_read(tile_read_t* read)
+    {
+        auto sqe = get_sqe(read,troRead);
+        sqe->opcode = IORING_OP_READ;
+        sqe->fd = read->fd;
+        sqe->addr = (u64)(read->buffer+read->done);
+        sqe->len = (u32)std::min<size_t>(read->size-read->done,TILE_READ_CHUNK);
+        sqe->off = read->done;
+    }
+    void tile_uring_t::finish(tile_read_t* read,vector<tile_read_t*>& finished)
+    {
+        if(read->fd!=-1)
+            close(read->fd);
+        read->fd = -1;
+        if(read->error&&read->buffer)
+        {
+            free(read->buffer);
+            read->buffer = NULL;
+        }
+        m_in_flight--;
+        finished.push_back(read);
+    }
+    void tile_uring_t::complete(tile_read_t* read,u32 op,int res,vector<tile_read_t*>& finished)
+    {
+        read->pending--;
+        if(op==troRead)
+        {
+            if(res==-EINTR||res==-EAGAIN)
+                submit_read(read);
+            else if(res<=0)
+            {
+                //a file shorter than its statx size is as broken as a failed read
+                read->error = res<0?-res:EIO;
+                finish(read,finished);
+            }
+            else
+            {
+                read->done += res;
+                if(read->done<read->size)
+                    submit_read(read);
+                else
+                    finish(read,finished);
+            }
+            return;
+        }
+        if(res<0&&!read->error)
+            read->error = -res;
+        if(op==troOpen&&res>=0)
+            read->fd = res;
+        if(read->pending)
+            return;
+        //open and statx are both done
+        read->size = read->st.stx_size;
+        if(!read->error&&read->size==0)
+            read->error = EINVAL;
+        if(read->error)
+        {
+            finish(read,finished);
+            return;
+        }
+        read->buffer = (u8*)malloc(read->size+64);
+        if(!read->buffer)
+        {
+            read->error = ENOMEM;
+            finish(read,finished);
+            return;
+        }
+        submit_read(read);
+    }
+    void tile_uring_t::wait(vector<tile_read_t*>& finished)
+    {
+        __atomic_store_n(m_sq_tail,m_sq_local_tail,__ATOMIC_RELEASE);
+        int ret;
+        do
+        {
+            //counted from the kernel's head, entries an earlier enter left unconsumed are submitted again
+            u32 submit = m_sq_local_tail-__atomic_load_n(m_sq_head,__ATOMIC_ACQUIRE);
+            ret = syscall(__NR_io_uring_enter,m_fd,submit,1,IORING_ENTER_GETEVENTS,NULL,0);
+        } while(ret<0&&errno==EINTR);
+        if(ret<0)
+        {
+            //nothing was submitted: take back the entries the kernel has not consumed and fail their reads
+            int error = errno==EAGAIN||errno==EBUSY?EIO:errno;
+            printf("io_uring_enter failed: %s\n",strerror(errno));
+            u32 sq_head = __atomic_load_n(m_sq_head,__ATOMIC_ACQUIRE);
+            u32 sq_tail = m_sq_local_tail;
+            __atomic_store_n(m_sq_tail,sq_head,__ATOMIC_RELEASE);
+            m_sq_local_tail = sq_head;
+            for(u32 i=sq_head;i!=sq_tail;i++)
+            {
+                u64 data = m_sqes[m_sq_array[i & *m_sq_mask]].user_data;
+                complete((tile_read_t*)(data&~(u64)3),(u32)(data&3),-error,finished);
+            }
+        }
+        u32 head = *m_cq_head;
+        u32 tail = __atomic_load_n(m_cq_tail,__ATOMIC_ACQUIRE);
+        while(head!=tail)
+        {
+            io_uring_cqe* cqe = &m_cqes[head & *m_cq_mask];
+            u64 data = cqe->user_data;
+            int res = cqe->res;
+            head++;
+            complete((tile_read_t*)(data&~(u64)3),(u32)(data&3),res,finished);
+        }
+        __atomic_store_n(m_cq_head,head,__ATOMIC_RELEASE);
+    }
+
+    bool FastVectorTileDb::Impl::enableAsyncIO(u32 queueDepth)
+    {
+        if(!m_mt)
+        {
+            printf("async tile io needs loader threads, FastVectorTileDb(mt=true)\n");
+            return false;
+        }
+        if(m_uring)
+            return true;
+        auto ring = new tile_uring_t();
+        if(!ring->init(std::max(queueDepth,1u)))
+        {
+            delete ring;
+            return false;
+        }
+        m_mutex_load.lock();
+        m_uring = ring;
+        m_mutex_load.unlock();
+        m_uring_thread = new std::thread([this]{ load_in_uring(); });
+        //the loader threads exit, the ring thread takes over the queue
+        m_load_cond.notify_all();
+        return true;
+    }
+
+    //keep up to the queue depth of the most urgent tiles in flight,
+    //packed tiles are already mapped and load in place
+    int FastVectorTileDb::Impl::load_in_uring()
+    {
+        vector<tile_read_t*> finished;
+        vector<TileData*> loaded;
+        unique_lock<mutex> lock(m_mutex_load);
+        while(m_thread_runing)
+        {
+            while(m_uring->in_flight()<m_uring->depth()&&!m_load_queue.empty())
+            {
+                pop_heap(m_load_queue.begin(),m_load_queue.end(),load_priority_less);
+                TileDbHandle_ext *loading = m_load_queue.back();
+                m_load_queue.pop_back();
+                stat_gauge_add(scTileQueueDepth,-1);
+                loading->loadState = tlsLoading;
+                if(loading->pack)
+                {
+                    lock.unlock();
+                    auto db = load_tile(loading);
+                    lock.lock();
+                    load_finished(loading,db);
+                }
+                else
+                {
+                    m_uring->start(loading);
+                }
+            }
+            if(m_uring->in_flight()==0)
+            {
+                m_load_cond.wait(lock,[this]{ return !m_thread_runing||!m_load_queue.empty(); });
+                continue;
+            }
+            //new requests wait for the next completion
+            lock.unlock();
+            m_uring->wait(finished);
+            for(auto read:finished)
+            {
+                trace_span_t span("FastVectorTileDb::readTile",read->trace_begin);
+                span.text("path",read->tile->path);
+                span.num("bytes",read->size);
+                if(read->error)
+                {
+                    //the load fails as a blocking one would, the tile is requested again after the retry delay
+                    printf("Can't read tile %s: %s\n",read->tile->path,strerror(read->error));
+                    loaded.push_back(NULL);
+                    continue;
+                }
+                //the host loads the image, an override that ignores it loads the tile its own way
+                auto tile = read->tile;
+                tile->ioBuffer = read->buffer;
+                tile->ioSize = read->size;
+                loaded.push_back(load_tile(tile));
+                if(tile->ioBuffer)
+                    free(tile->ioBuffer);
+                tile->ioBuffer = NULL;
+            }
+            lock.lock();
+            for(size_t i=0;i<finished.size();i++)
+            {
+                load_finished(finished[i]->tile,loaded[i]);
+                delete finished[i];
+            }
+            finished.clear();
+            loaded.clear();
+        }
+        lock.unlock();
+        //closing: the kernel still writes into the buffers in flight, wait for them
+        while(m_uring->in_flight())
+        {
+            m_uring->wait(finished);
+            for(auto read:finished)
+            {
+                free(read->buffer);
+                delete read;
+            }
+            finished.clear();
+        }
+        return 0;
+    }
+
+    void FastVectorTileDb::Impl::close_uring()
+    {
+        delete m_uring;
+        m_uring = NULL;
+    }
+}
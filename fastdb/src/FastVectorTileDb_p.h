@@ -2,62 +2,234 @@
 #include "fastdb.h"
 #include <vector>
 #include <string>
-#include <set>
 #include <mutex>
 #include <thread>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <unordered_map>
+#include <string_view>
 using namespace std;
 namespace wx{
+    enum TileLoadStateEnum
+    {
+        tlsIdle = 0,    //not loaded or loaded, not in the queue
+        tlsQueued,      //waiting in the load queue
+        tlsLoading,     //taken by a loader thread, or loaded by a taker without loader threads
+        tlsFailed       //loadTileDataInternal failed, requested again after retryFrame
+    };
+    //image of a tile inside a mapped pack file, lives as long as the pack
+    struct tile_pack_ref_t
+    {
+        void*   data;
+        size_t  size;
+    };
     struct TileDbHandle_ext:public FastVectorTileDb::TileDataHandle
     {
         string _path;
         u32    lastFrameCounter;
+        u8     level;
+        double cx,cy;           //center of the tile box
+        u32    loadState;       //TileLoadStateEnum, guarded by m_mutex_load
+        chrono::steady_clock::time_point requestTime;   //last take that requested the tile
+        double distance;        //distance to the viewport center of that take
+        u32    failures;        //loads failed in a row
+        u32    retryFrame;      //first take that may request a failed tile again
+        //cache state, guarded by m_mutex_load
+        TileDbHandle_ext* lruPrev;
+        TileDbHandle_ext* lruNext;
+        size_t bytes;           //buffer size of the resident tile
+        bool   cached;          //linked in the lru list
+        bool   prefetch;        //queued by the prefetcher only
+        bool   prefetched;      //loaded by the prefetcher, not taken yet
+        //lock-free for takers: a tile is pinned before resident is read,
+        //the evictor clears resident before it checks pins (see cache_evict)
+        atomic<u32>  pins;      //outstanding take results referencing the tile
+        atomic<bool> resident;  //tileData may be used
+        //set by openPack while loader threads may read it, NULL: load from path
+        atomic<const tile_pack_ref_t*> pack;
+        //image read by the io_uring thread for loadTileDataInternal, which takes it over
+        u8*    ioBuffer;
+        size_t ioSize;
         TileDbHandle_ext(const char* pth)
         {
+            init();
             _path =pth;
             path = _path.c_str();
-            lastFrameCounter = 0;
-            tileData = NULL;
         }
-        ~TileDbHandle_ext()
+        //catalog handles borrow their path from the mapped catalog
+        TileDbHandle_ext()
         {
-            if(tileData)
-                delete tileData;
+            init();
+            path = NULL;
         }
-        void shrink()
+        void init()
         {
-            if(tileData)
-                delete tileData;
+            lastFrameCounter = 0;
+            level = 0;
+            cx = cy = 0;
+            loadState = tlsIdle;
+            requestTime = chrono::steady_clock::time_point();
+            distance = 0;
+            failures = 0;
+            retryFrame = 0;
+            lruPrev = lruNext = NULL;
+            bytes = 0;
+            pins = 0;
+            resident = false;
+            cached = false;
+            prefetch = false;
+            prefetched = false;
+            pack = NULL;
+            ioBuffer = NULL;
+            ioSize = 0;
             tileData = NULL;
         }
+        ~TileDbHandle_ext()
+        {
+            delete tileData.load();
+        }
+    };
+    //an evicted tile a taker may still read, deleted once its handle is not pinned
+    struct retired_tile_t
+    {
+        TileDbHandle_ext*           handle;
+        FastVectorTileDb::TileData* tileData;
+    };
+    //catalog file: header, tile_catalog_record_t per tile id, path pool, TileBoxTake::save section
+    struct tile_catalog_header_t
+    {
+        char    magic[8];       //"FDBCAT1"
+        u32     tile_count;
+        u32     reserved;
+        u64     paths_offset;
+        u64     paths_size;
+        u64     boxes_offset;
+        u64     boxes_size;
     };
+    struct tile_catalog_record_t
+    {
+        u32     path_offset;    //in the path pool, NUL terminated
+        u8      level;
+        u8      reserved[3];
+        double  cx,cy;
+    };
+    //pack file: header padded to TILE_PACK_ALIGN, tile images each aligned to TILE_PACK_ALIGN,
+    //then tile_pack_entry_t per tile and the path pool
+    static const u64 TILE_PACK_ALIGN = 4096;
+    struct tile_pack_header_t
+    {
+        char    magic[8];       //"FDBPAK1"
+        u32     tile_count;
+        u32     reserved;
+        u64     directory_offset;
+        u64     paths_offset;
+        u64     paths_size;
+    };
+    struct tile_pack_entry_t
+    {
+        u64     offset;
+        u64     size;
+        u32     path_offset;    //in the path pool, NUL terminated
+        u32     reserved;
+    };
+    //viewport motion estimated from successive takes
+    struct tile_motion_t
+    {
+        bool   valid;
+        double cx,cy,w,h;       //last viewport
+        double vx,vy;           //smoothed center velocity per take
+        double logZoom;         //smoothed log of the size ratio per take
+    };
+    //cursor of an incremental take, the tiles of its last result are pinned
+    class FastVectorTileDb::TakeCursor
+    {
+    public:
+        TileBoxTake::TakeCursor*    boxes;
+        vector<TileDbHandle_ext*>   pinned;
+    };
+    class tile_uring_t;
     class FastVectorTileDb::Impl:public TileBoxTake::HandleTileAction
     {
     public:
-        Impl(FastVectorTileDb* host,bool mt);
+        Impl(FastVectorTileDb* host,bool mt,u32 loaderThreads);
        ~Impl();
         void registerTile(const char* path,u8 level, double t, double xmin, double ymin, double xmax, double ymax);
         const TakeResult*   take(u32 maxLevel, double xmin, double ymin, double xmax, double ymax);
         void                freeResult(const TakeResult* result);
+        TakeCursor*         create_cursor();
+        const TakeFrame*    take_incremental(TakeCursor* cursor,u32 maxLevel, double xmin, double ymin, double xmax, double ymax);
+        void                free_cursor(TakeCursor* cursor);
         void                shrink(u32 maxTileCache);
+        void                setCacheBudget(u64 bytes);
+        CacheStats          getCacheStats();
+        CacheMemory         memoryReport();
+        void                enablePrefetch(u32 maxTiles,double lookahead);
+        bool                saveCatalog(const char* path);
+        bool                openCatalog(const char* path);
+        bool                writePack(const char* path);
+        bool                openPack(const char* path);
+        static TileData*    load_from_pack(TileDbHandle_ext* tile,const tile_pack_ref_t* pack);
+        bool                enableAsyncIO(u32 queueDepth);
         virtual bool        isTileLoaded(const TileBoxTake::TileBox* box);
 
     public:
         static int          _load_in_thread(Impl *pThis);
         int                 load_in_thread();
+        int                 load_in_uring();
     private:
-        vector<TileDbHandle_ext*>      m_tile_handles;
-        vector<TileDbHandle_ext*>      m_tiles_loaded;
-        set<TileDbHandle_ext*>      m_tiles_loading;
+        void                load_finished(TileDbHandle_ext* loading,TileData* db);
+        void                load_failed(TileDbHandle_ext* loading);
+        static bool         retry_due(const TileDbHandle_ext* loading,u32 frame);
+        TileData*           load_tile(TileDbHandle_ext* loading);
+        void                handle_result(const TileBoxTake::TakeResult* rawResult,u32 maxLevel, double xmin, double ymin, double xmax, double ymax);
+        size_t              request_loads(const vector<TileDbHandle_ext*>& tiles,double x,double y,u32 frame,chrono::steady_clock::time_point now);
+        static bool         load_priority_less(const TileDbHandle_ext* a,const TileDbHandle_ext* b);
+        bool                predict_viewport(double xmin,double ymin,double xmax,double ymax,double box[4]);
+        size_t              request_prefetch(const TakeResult* predicted,double x,double y,chrono::steady_clock::time_point now);
+        //lru list of resident tiles, most recently used at the head, m_mutex_load must be held
+        void                cache_insert(TileDbHandle_ext* tile);
+        void                cache_unlink(TileDbHandle_ext* tile);
+        void                cache_touch(TileDbHandle_ext* tile);
+        void                cache_evict(u64 maxBytes,u32 maxCount);
+        void                release_retired();
+        void                close_catalog();
+        void                resolve_pack(TileDbHandle_ext* tile);
+        void                close_packs();
+        void                close_uring();
+    private:
+        vector<TileDbHandle_ext*>      m_tile_handles;  //indexed by tile id
+        TileDbHandle_ext*              m_catalog_handles;   //one allocation for the tiles of a catalog
+        void*                          m_catalog;           //mapped catalog, owns the paths of m_catalog_handles
+        size_t                         m_catalog_size;
+        u32                            m_catalog_count;
+        vector<pair<void*,size_t>>     m_packs;             //mapped pack files
+        deque<tile_pack_ref_t>         m_pack_refs;         //tiles of every pack, never moved
+        unordered_map<string_view,const tile_pack_ref_t*> m_pack_directory;  //path -> image in the last pack holding it
+        vector<TileDbHandle_ext*>      m_load_queue;  //heap ordered by load_priority_less
+
+        vector<retired_tile_t>     m_retired;     //guarded by m_mutex_load
+
+        TileDbHandle_ext*          m_lru_head;
+        TileDbHandle_ext*          m_lru_tail;
+        u64                        m_cache_budget; //0: unlimited
+        CacheStats                 m_stats;
+        u32                        m_prefetch_tiles;   //0: prefetch disabled
+        double                     m_prefetch_lookahead;
+        tile_motion_t              m_motion;
 
         FastVectorTileDb*          m_host;
-        u32                        m_last_frame;
-        mutex                      m_mutex_take;
+        atomic<u32>                m_last_frame;
         mutex                      m_mutex_load;
         TileBoxTake*               m_tile_box_take;
         u32                        m_max_level;
         bool                       m_mt;
         bool                       m_thread_runing;
-        std::thread*               m_thread;
+        condition_variable         m_load_cond;
+        vector<std::thread*>       m_threads;
+        tile_uring_t*              m_uring;        //async tile reads, the loader threads exit once it is set
+        std::thread*               m_uring_thread;
     };
 
 }
\ No newline at end of file
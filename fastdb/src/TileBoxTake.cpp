@@ -1,182 +1,696 @@
 #include "TileBoxTake_p.hpp"
-#include "clipper2/clipper.h"
+#include "FastVectorDbTrace_p.h"
+#include "FastVectorDbLayer_p.h"
 #include <algorithm>
+#include <math.h>
 #include <assert.h>
-using namespace Clipper2Lib;
-const long long MAX_SCALE_INT64 = 0xFFFFFFFFFFL;
+const double MAX_SCALE_INT64 = (double)0xFFFFFFFFFFL;
 namespace wx
 {
-    TileBoxTake::Impl::Impl(int maxLevel)
-    :m_dirty(true)
+    const u32 MAX_COVERAGE_CELLS = 1024;    //per axis, finer edge grids fall back to a uniform raster
+    const u32 MAX_INDEX_CELLS = 4096;       //per axis
+    void tile_coverage_t::reset(vector<long long>& xs,vector<long long>& ys)
     {
-        for(int i=0;i<maxLevel;i++)
+        m_xs.swap(xs);
+        m_ys.swap(ys);
+        for(auto edges:{&m_xs,&m_ys})
         {
-            m_levels.push_back(new tile_box_level_t());
+            if(edges->size()>MAX_COVERAGE_CELLS+1)
+            {
+                //conservative: a box only covers the raster cells it fully contains
+                long long lo = edges->front(),hi = edges->back();
+                edges->resize(MAX_COVERAGE_CELLS+1);
+                for(u32 i=0;i<=MAX_COVERAGE_CELLS;i++)
+                    (*edges)[i] = lo+(long long)((double)(hi-lo)*i/MAX_COVERAGE_CELLS);
+            }
         }
+        u32 cols = m_xs.size()-1;
+        u32 rows = m_ys.size()-1;
+        m_words = (cols+63)/64;
+        m_bits.assign((size_t)m_words*rows,0);
+        m_cells = (u64)cols*rows;
+        m_covered = 0;
     }
-    TileBoxTake::Impl::~Impl()
+    bool tile_coverage_t::row_covered(u32 row,u32 c0,u32 c1) const
+    {
+        const u64* bits = m_bits.data()+(size_t)row*m_words;
+        for(u32 c=c0;c<c1;)
+        {
+            u32 w = c>>6, b = c&63;
+            u32 n = std::min(64-b,c1-c);
+            u64 mask = (n==64?~0ull:((1ull<<n)-1))<<b;
+            if((bits[w]&mask)!=mask)
+                return false;
+            c += n;
+        }
+        return true;
+    }
+    u32 tile_coverage_t::cover_row(u32 row,u32 c0,u32 c1)
     {
-        for(auto i:m_levels)
+        u64* bits = m_bits.data()+(size_t)row*m_words;
+        u32 added = 0;
+        for(u32 c=c0;c<c1;)
         {
-            delete i;
+            u32 w = c>>6, b = c&63;
+            u32 n = std::min(64-b,c1-c);
+            u64 mask = (n==64?~0ull:((1ull<<n)-1))<<b;
+            added += __builtin_popcountll(mask&~bits[w]);
+            bits[w] |= mask;
+            c += n;
         }
-        
+        return added;
+    }
+    //true when every cell touched by the rectangle is covered
+    bool tile_coverage_t::is_covered(long long minx,long long miny,long long maxx,long long maxy) const
+    {
+        u32 c0 = std::max<long>(upper_bound(m_xs.begin(),m_xs.end(),minx)-m_xs.begin()-1,0);
+        u32 c1 = lower_bound(m_xs.begin(),m_xs.end(),maxx)-m_xs.begin();
+        u32 r0 = std::max<long>(upper_bound(m_ys.begin(),m_ys.end(),miny)-m_ys.begin()-1,0);
+        u32 r1 = lower_bound(m_ys.begin(),m_ys.end(),maxy)-m_ys.begin();
+        for(u32 r=r0;r<r1;r++)
+        {
+            if(!row_covered(r,c0,c1))
+                return false;
+        }
+        return true;
+    }
+    //marks the cells fully inside the rectangle
+    void tile_coverage_t::cover(long long minx,long long miny,long long maxx,long long maxy)
+    {
+        u32 c0 = lower_bound(m_xs.begin(),m_xs.end(),minx)-m_xs.begin();
+        u32 c1 = upper_bound(m_xs.begin(),m_xs.end(),maxx)-m_xs.begin();
+        u32 r0 = lower_bound(m_ys.begin(),m_ys.end(),miny)-m_ys.begin();
+        u32 r1 = upper_bound(m_ys.begin(),m_ys.end(),maxy)-m_ys.begin();
+        if(c1==0||r1==0)
+            return;
+        c1--;
+        r1--;
+        for(u32 r=r0;r<r1;r++)
+            m_covered += cover_row(r,c0,c1);
+    }
+
+    ///////////////////////////////////////////////////////////////////////////////
+    TileBoxTake::Impl::Impl(int maxLevel)
+    :m_dirty(true),m_levels_in_registry(false)
+    {
+        m_levels.resize(maxLevel);
+    }
+    TileBoxTake::Impl::~Impl()
+    {
     }
     void TileBoxTake::Impl::registerTileBox(const TileBox &item)
     {
         u8 ix = item.level;
         assert(ix<m_levels.size());
-        m_levels[ix]->push_back(item);
+        lock_guard<mutex> lock(m_mutex);
+        if(m_levels_in_registry)
+            restore_levels();
+        m_levels[ix].push_back(item);
+        m_dirty = true;
+    }
+    //m_mutex must be held
+    void TileBoxTake::Impl::restore_levels()
+    {
+        auto registry = atomic_load(&m_registry);
+        m_levels = registry->levels;
+        m_levels_in_registry = false;
     }
-    
 
-    template<typename box_like_t>
-    PathsD make_path_from_box_like(box_like_t& box,double e=0.0)
+    //registrations are published as a new registry on the next take,
+    //takers running on the previous one keep it alive
+    TileBoxTake::Impl::tile_registry_ptr TileBoxTake::Impl::snapshot()
     {
-        auto path = PathD {
-            PointD(box.minx-e,box.miny-e),
-            PointD(box.minx-e,box.maxy+e),
-            PointD(box.maxx+e,box.maxy+e),
-            PointD(box.maxx-e,box.miny-e)
-        };
-        PathsD paths{path};
-        return paths;
+        if(!m_dirty)
+            return atomic_load(&m_registry);
+        lock_guard<mutex> lock(m_mutex);
+        if(!m_dirty)
+            return atomic_load(&m_registry);
+        auto registry = make_shared<tile_registry_t>();
+        registry->levels = m_levels;
+        registry->indices.resize(m_levels.size());
+        auto& extent = registry->extent;
+        extent.minEdge = point2_t::make(1e300,1e300);
+        extent.maxEdge = point2_t::make(-1e300,-1e300);
+        for(size_t i=0;i<registry->levels.size();i++)
+        {
+            auto& level = registry->levels[i];
+            sort_level_with_time_and_area(level);
+            build_level_index(level,registry->indices[i]);
+            for(auto& bx:level)
+            {
+                extent.minEdge.x = std::min(extent.minEdge.x,bx.minx);
+                extent.minEdge.y = std::min(extent.minEdge.y,bx.miny);
+                extent.maxEdge.x = std::max(extent.maxEdge.x,bx.maxx);
+                extent.maxEdge.y = std::max(extent.maxEdge.y,bx.maxy);
+            }
+        }
+        if(extent.minEdge.x>extent.maxEdge.x)
+            extent = aabbox_t::make(0,0,1,1);
+        double d = std::max(extent.width(),extent.height())/8;
+        extent.minEdge.x-=d;
+        extent.maxEdge.x+=d;
+        extent.minEdge.y-=d;
+        extent.maxEdge.y+=d;
+        registry->scale_to_int64 = MAX_SCALE_INT64/(max(max(extent.width(),extent.height()),1e-300));
+
+        tile_registry_ptr published = registry;
+        atomic_store(&m_registry,published);
+        m_dirty = false;
+        return published;
     }
+    
+
     template<typename box_like_t1,typename box_like_t2>
     bool is_box_like_intersect(box_like_t1& t1,box_like_t2& t2)
     {
         return t1.minx<t2.maxx && t1.maxx>t2.minx && t1.miny<t2.maxy && t1.maxy>t2.miny;
     }
-    template<typename box_like_t>
-    bool is_box_like_in_polygon(box_like_t& box,PathsD& polygon)
+
+    //newest first, then the smallest
+    void TileBoxTake::Impl::sort_level_with_time_and_area(tile_box_level_t& level)
+    {
+        stable_sort(level.begin(),level.end(),[](const TileBox& a, const TileBox& b){
+            if(a.t!=b.t)
+                return a.t>b.t;
+            return a.area<b.area;
+        });
+    }
+
+    void TileBoxTake::Impl::build_level_index(tile_box_level_t& level,tile_level_index_t& index)
     {
-        // 创建 Clipper 对象
-        ClipperD clipper;
-        
-        // 添加矩形作为被裁剪的主体 (Subject)
-        clipper.AddSubject(make_path_from_box_like(box));
-        // 添加多边形作为裁剪框 (Clip)
-        clipper.AddClip(polygon);
+        index.offsets.clear();
+        index.items.clear();
+        index.nx = index.ny = 0;
+        if(level.empty())
+            return;
+        double minx=1e300,miny=1e300,maxx=-1e300,maxy=-1e300,size=0;
+        for(auto& bx:level)
+        {
+            minx = std::min(minx,bx.minx);
+            miny = std::min(miny,bx.miny);
+            maxx = std::max(maxx,bx.maxx);
+            maxy = std::max(maxy,bx.maxy);
+            size += std::max(bx.maxx-bx.minx,bx.maxy-bx.miny);
+        }
+        //about one box per cell, never much smaller than the boxes themselves
+        double cell = std::max(sqrt((maxx-minx)*(maxy-miny)/level.size()),size/level.size());
+        cell = std::max(cell,std::max(maxx-minx,maxy-miny)/MAX_INDEX_CELLS);
+        if(!(cell>0))
+            cell = 1;
+        index.minx = minx;
+        index.miny = miny;
+        index.cell = cell;
+        index.nx = std::min<u32>((u32)((maxx-minx)/cell)+1,MAX_INDEX_CELLS);
+        index.ny = std::min<u32>((u32)((maxy-miny)/cell)+1,MAX_INDEX_CELLS);
+        auto cell_range = [&](const TileBox& bx,u32& x0,u32& y0,u32& x1,u32& y1){
+            x0 = std::min<u32>((u32)((bx.minx-minx)/cell),index.nx-1);
+            y0 = std::min<u32>((u32)((bx.miny-miny)/cell),index.ny-1);
+            x1 = std::min<u32>((u32)((bx.maxx-minx)/cell),index.nx-1);
+            y1 = std::min<u32>((u32)((bx.maxy-miny)/cell),index.ny-1);
+        };
+        index.offsets.assign((size_t)index.nx*index.ny+1,0);
+        u32 x0,y0,x1,y1;
+        for(auto& bx:level)
+        {
+            cell_range(bx,x0,y0,x1,y1);
+            for(u32 y=y0;y<=y1;y++)
+                for(u32 x=x0;x<=x1;x++)
+                    index.offsets[y*index.nx+x+1]++;
+        }
+        for(size_t i=1;i<index.offsets.size();i++)
+            index.offsets[i] += index.offsets[i-1];
+        index.items.resize(index.offsets.back());
+        vector<u32> fill(index.offsets.begin(),index.offsets.end()-1);
+        for(u32 i=0;i<level.size();i++)
+        {
+            cell_range(level[i],x0,y0,x1,y1);
+            for(u32 y=y0;y<=y1;y++)
+                for(u32 x=x0;x<=x1;x++)
+                    index.items[fill[y*index.nx+x]++] = i;
+        }
+    }
+
+    //indices of the boxes whose cells meet the rectangle, sorted and unique (level order)
+    void TileBoxTake::Impl::query_level_index(const tile_level_index_t& index,double minx,double miny,double maxx,double maxy,vector<u32>& result)
+    {
+        result.clear();
+        if(index.nx==0)
+            return;
+        double ix0 = floor((minx-index.minx)/index.cell), iy0 = floor((miny-index.miny)/index.cell);
+        double ix1 = floor((maxx-index.minx)/index.cell), iy1 = floor((maxy-index.miny)/index.cell);
+        if(ix1<0||iy1<0||ix0>=index.nx||iy0>=index.ny)
+            return;
+        u32 x0 = (u32)std::max(ix0,0.0), y0 = (u32)std::max(iy0,0.0);
+        u32 x1 = (u32)std::min(ix1,(double)index.nx-1), y1 = (u32)std::min(iy1,(double)index.ny-1);
+        for(u32 y=y0;y<=y1;y++)
+        {
+            for(u32 x=x0;x<=x1;x++)
+            {
+                u32 c = y*index.nx+x;
+                result.insert(result.end(),index.items.begin()+index.offsets[c],index.items.begin()+index.offsets[c+1]);
+            }
+        }
+        sort(result.begin(),result.end());
+        result.erase(unique(result.begin(),result.end()),result.end());
+    }
 
-        // 执行差集操作：计算 Rect - Poly
-        PathsD solution;
-        clipper.Execute(ClipType::Difference, FillRule::NonZero, solution);
+    //a result is allocated behind a header holding its registry snapshot
+    static const size_t TAKE_RESULT_HEADER = (sizeof(shared_ptr<tile_registry_t>)+15)&~(size_t)15;
 
-        // 如果结果为空，说明矩形完全在多边形内
-        return solution.empty();
+    //false when the query misses every tile
+    bool TileBoxTake::Impl::clip_query(const tile_registry_t& registry,u32 maxLevel,double xmin,double ymin,double xmax,double ymax,tile_box_filter& filter)
+    {
+        if(maxLevel+1>registry.levels.size())
+           return false;
+        //parts of the query outside every tile can never be covered
+        auto& extent = registry.extent;
+        filter = tile_box_filter::make(maxLevel,
+            std::max(xmin,extent.minEdge.x),std::max(ymin,extent.minEdge.y),
+            std::min(xmax,extent.maxEdge.x),std::min(ymax,extent.maxEdge.y));
+        return filter.minx<filter.maxx&&filter.miny<filter.maxy;
     }
 
-    void TileBoxTake::Impl::sort_level_with_time_and_area(tile_box_level_t& level)
+    //boxes of a level intersecting the filter whose index cells meet the rectangle, sorted
+    void TileBoxTake::Impl::gather_candidates(const tile_registry_t& registry,const tile_box_filter& filter,u32 level,
+                                              double minx,double miny,double maxx,double maxy,vector<u32>& result)
     {
-        sort(level.begin(),level.end(),[](const TileBox& a, const TileBox& b){
-            return (a.t>b.t)||a.area<b.area;
-        });
+        auto& boxes = registry.levels[level];
+        query_level_index(registry.indices[level],minx,miny,maxx,maxy,result);
+        result.erase(remove_if(result.begin(),result.end(),[&](u32 ix){ return !is_box_like_intersect(filter,boxes[ix]); }),result.end());
     }
 
-    struct tile_box_filter{
-        u32    maxLevel;
-        double minx;
-        double miny;
-        double maxx;
-        double maxy;
-        static tile_box_filter make(u32 maxLevel,double minx,double miny,double maxx,double maxy){
-            tile_box_filter f;
-            f.maxLevel = maxLevel;
-            f.minx = minx;
-            f.miny = miny;
-            f.maxx = maxx;
-            f.maxy = maxy;
-            return f;
+    //the cell edges of the coverage from sorted unclipped box edges: clipping maps them to lo or hi
+    static void clip_edges(const vector<long long>& edges,long long lo,long long hi,vector<long long>& result)
+    {
+        result.clear();
+        result.push_back(lo);
+        for(auto it = upper_bound(edges.begin(),edges.end(),lo);it!=edges.end()&&*it<hi;++it)
+        {
+            if(*it!=result.back())
+                result.push_back(*it);
         }
-    };
+        if(hi>result.back())
+            result.push_back(hi);
+    }
+    //edges minus removed plus added, all sorted multisets
+    static void update_edges(vector<long long>& edges,vector<long long>& removed,vector<long long>& added,vector<long long>& scratch)
+    {
+        sort(removed.begin(),removed.end());
+        sort(added.begin(),added.end());
+        scratch.clear();
+        set_difference(edges.begin(),edges.end(),removed.begin(),removed.end(),back_inserter(scratch));
+        edges.clear();
+        merge(scratch.begin(),scratch.end(),added.begin(),added.end(),back_inserter(edges));
+        removed.clear();
+        added.clear();
+    }
 
-    const TileBoxTake::TakeResult *TileBoxTake::Impl::take(u32 maxLevel, double xmin, double ymin, double xmax, double ymax,HandleTileAction* action)
+    //finer levels first, every box not hidden by the loaded boxes before it goes to the result,
+    //returned coarse to fine
+    bool TileBoxTake::Impl::walk_levels(tile_registry_t& registry,const tile_box_filter& filter,const vector<vector<u32>>& candidates,
+                                        HandleTileAction* action,vector<TileBox*>& box_result,
+                                        const vector<long long>* xedges,const vector<long long>* yedges)
     {
-        const double e = 0.0000001;
-        if(m_dirty)//resort the levels when dirty
+        auto& levels = registry.levels;
+        u32 maxLevel = filter.maxLevel;
+        vector<long long> xs,ys;
+        if(xedges&&yedges)
         {
-            for(auto& level:m_levels) 
-                sort_level_with_time_and_area(*level); 
-            
-            m_extent = aabbox_t::make(1e10,1e10,-1e10,-1e10);
-
-            for(auto& level:m_levels) 
+            clip_edges(*xedges,registry.to_int64_x(filter.minx),registry.to_int64_x(filter.maxx),xs);
+            clip_edges(*yedges,registry.to_int64_y(filter.miny),registry.to_int64_y(filter.maxy),ys);
+        }
+        else
+        {
+            xs = {registry.to_int64_x(filter.minx),registry.to_int64_x(filter.maxx)};
+            ys = {registry.to_int64_y(filter.miny),registry.to_int64_y(filter.maxy)};
+            for(int i=maxLevel;i>=0;i--)
+            {
+                auto& level = levels[i];
+                for(u32 ix:candidates[i])
                 {
-                    for(auto& bx:*level)
-                    {
-                        m_extent.minEdge.x = std::min(m_extent.minEdge.x,bx.minx);
-                        m_extent.minEdge.y = std::min(m_extent.minEdge.y,bx.miny);
-                        m_extent.maxEdge.x = std::max(m_extent.maxEdge.x,bx.maxx);
-                        m_extent.maxEdge.y = std::max(m_extent.maxEdge.y,bx.maxy);
-                    }
+                    auto& box = level[ix];
+                    xs.push_back(registry.to_int64_x(std::max(box.minx,filter.minx)));
+                    xs.push_back(registry.to_int64_x(std::min(box.maxx,filter.maxx)));
+                    ys.push_back(registry.to_int64_y(std::max(box.miny,filter.miny)));
+                    ys.push_back(registry.to_int64_y(std::min(box.maxy,filter.maxy)));
                 }
-            double d = m_extent.width()/8;
-            m_extent.minEdge.x-=d;
-            m_extent.maxEdge.x+=d;
-            m_extent.minEdge.y-=d;
-            m_extent.maxEdge.y+=d;
-
-            m_scale_to_int64 = MAX_SCALE_INT64/(max(m_extent.width(),m_extent.height()));
-
-            m_dirty=false;
+            }
+            sort(xs.begin(),xs.end());
+            xs.erase(unique(xs.begin(),xs.end()),xs.end());
+            sort(ys.begin(),ys.end());
+            ys.erase(unique(ys.begin(),ys.end()),ys.end());
         }
-        if(maxLevel>m_levels.size()-1)
-           return nullptr;
-        auto filter_box = tile_box_filter::make(maxLevel,xmin,ymin,xmax,ymax);
-        vector<TileBox*>    box_result;
-        PathsD             polygon_result; 
+        if(xs.size()<2||ys.size()<2)
+            return false;
+        tile_coverage_t coverage;
+        coverage.reset(xs,ys);
+
         bool done = false;
         for(int i=maxLevel;i>=0&&!done;i--)
         {
-            auto& level = *m_levels[i];
-            for(auto& box:level)
+            auto& level = levels[i];
+            for(u32 ix:candidates[i])
             {
-                if(is_box_like_intersect(filter_box,box))
+                auto& box = level[ix];
+                //only the visible part of the box matters
+                long long minx = registry.to_int64_x(std::max(box.minx,filter.minx));
+                long long miny = registry.to_int64_y(std::max(box.miny,filter.miny));
+                long long maxx = registry.to_int64_x(std::min(box.maxx,filter.maxx));
+                long long maxy = registry.to_int64_y(std::min(box.maxy,filter.maxy));
+                if(coverage.is_covered(minx,miny,maxx,maxy))
+                    continue;
+                //the action is asked exactly once for every box of the result
+                box_result.push_back(&box);
+                if(action&&!action->isTileLoaded(&box))
+                    continue;
+                coverage.cover(minx,miny,maxx,maxy);
+                if(coverage.is_full())
                 {
-                    if(!is_box_like_in_polygon(box,polygon_result))
-                    {
-                        box_result.push_back(&box);
-                        if(action&&!action->isTileLoaded(&box))
-                            continue;
-                        ClipperD clipper;
-                        // 添加矩形作为被裁剪的主体 (Subject)
-                        clipper.AddSubject(make_path_from_box_like(box,e));
-                        PathsD result2;
-                        // 添加多边形作为裁剪框 (Clip)
-                        clipper.AddClip(polygon_result);
-                        if(clipper.Execute(ClipType::Union,FillRule::NonZero,result2))
-                        {
-                            polygon_result = result2;
-                            if(is_box_like_in_polygon(filter_box,polygon_result))
-                            {
-                                done = true;
-                                break;
-                            }
-                        }
+                    done = true;
+                    break;
+                }
+            }
+        }
+        reverse(box_result.begin(),box_result.end());
+        return !box_result.empty();
+    }
 
+    const TileBoxTake::TakeResult *TileBoxTake::Impl::take(u32 maxLevel, double xmin, double ymin, double xmax, double ymax,HandleTileAction* action)
+    {
+        auto registry = snapshot();
+        tile_box_filter filter_box;
+        if(!clip_query(*registry,maxLevel,xmin,ymin,xmax,ymax,filter_box))
+            return nullptr;
+        vector<vector<u32>> candidates(maxLevel+1);
+        for(int i=maxLevel;i>=0;i--)
+            gather_candidates(*registry,filter_box,i,filter_box.minx,filter_box.miny,filter_box.maxx,filter_box.maxy,candidates[i]);
+        vector<TileBox*>    box_result;
+        if(!walk_levels(*registry,filter_box,candidates,action,box_result))
+            return nullptr;
+        size_t n = sizeof(TileBox*)*(box_result.size()+10);
+        u8* block = (u8*)malloc(TAKE_RESULT_HEADER + sizeof(TakeResult) + n);
+        new (block) tile_registry_ptr(registry);
+        TakeResult *result = (TakeResult*)(block + TAKE_RESULT_HEADER);
+        memcpy(result->tiles,box_result.data(),sizeof(TileBox*)*box_result.size());
+        result->count=box_result.size();
+        return result;
+    }
+
+    const TileBoxTake::TakeFrame *TileBoxTake::Impl::take_incremental(TakeCursor* cursor,u32 maxLevel, double xmin, double ymin, double xmax, double ymax,HandleTileAction* action)
+    {
+        auto& c = *cursor;
+        c.prev_registry.swap(c.registry);
+        c.registry = snapshot();
+        auto& registry = *c.registry;
+        auto& boxes = c.boxes;
+        boxes.clear();
+        tile_box_filter filter;
+        if(clip_query(registry,maxLevel,xmin,ymin,xmax,ymax,filter))
+        {
+            auto& old = c.filter;
+            bool coherent = c.valid&&c.registry==c.prev_registry&&old.maxLevel==maxLevel&&
+                old.minx<=filter.maxx&&old.maxx>=filter.minx&&old.miny<=filter.maxy&&old.maxy>=filter.miny;
+            auto push_edges = [&](const TileBox& box,vector<long long>& xs,vector<long long>& ys){
+                xs.push_back(registry.to_int64_x(box.minx));
+                xs.push_back(registry.to_int64_x(box.maxx));
+                ys.push_back(registry.to_int64_y(box.miny));
+                ys.push_back(registry.to_int64_y(box.maxy));
+            };
+            if(!coherent)
+            {
+                c.candidates.resize(maxLevel+1);
+                c.xedges.clear();
+                c.yedges.clear();
+                for(int i=maxLevel;i>=0;i--)
+                {
+                    gather_candidates(registry,filter,i,filter.minx,filter.miny,filter.maxx,filter.maxy,c.candidates[i]);
+                    for(u32 ix:c.candidates[i])
+                        push_edges(registry.levels[i][ix],c.xedges,c.yedges);
+                }
+                sort(c.xedges.begin(),c.xedges.end());
+                sort(c.yedges.begin(),c.yedges.end());
+            }
+            else
+            {
+                //the strips of the new rectangle outside the old one
+                double strips[4][4];
+                u32 strip_count = 0;
+                auto add_strip = [&](double x0,double y0,double x1,double y1){
+                    if(x0<x1&&y0<y1)
+                    {
+                        double* s = strips[strip_count++];
+                        s[0] = x0; s[1] = y0; s[2] = x1; s[3] = y1;
+                    }
+                };
+                double mx0 = std::max(filter.minx,old.minx), mx1 = std::min(filter.maxx,old.maxx);
+                add_strip(filter.minx,filter.miny,old.minx,filter.maxy);
+                add_strip(old.maxx,filter.miny,filter.maxx,filter.maxy);
+                add_strip(mx0,filter.miny,mx1,old.miny);
+                add_strip(mx0,old.maxy,mx1,filter.maxy);
+                for(int i=maxLevel;i>=0;i--)
+                {
+                    auto& kept = c.candidates[i];
+                    auto& level = registry.levels[i];
+                    kept.erase(remove_if(kept.begin(),kept.end(),[&](u32 ix){
+                        if(is_box_like_intersect(filter,level[ix]))
+                            return false;
+                        push_edges(level[ix],c.removed_x,c.removed_y);
+                        return true;
+                    }),kept.end());
+                    if(strip_count==0)
+                        continue;
+                    c.merged.clear();
+                    for(u32 k=0;k<strip_count;k++)
+                    {
+                        gather_candidates(registry,filter,i,strips[k][0],strips[k][1],strips[k][2],strips[k][3],c.found);
+                        c.merged.insert(c.merged.end(),c.found.begin(),c.found.end());
                     }
+                    //neighbouring strips share index cells
+                    sort(c.merged.begin(),c.merged.end());
+                    c.merged.erase(unique(c.merged.begin(),c.merged.end()),c.merged.end());
+                    c.found.clear();
+                    set_difference(c.merged.begin(),c.merged.end(),kept.begin(),kept.end(),back_inserter(c.found));
+                    if(c.found.empty())
+                        continue;
+                    for(u32 ix:c.found)
+                        push_edges(level[ix],c.added_x,c.added_y);
+                    c.merged.clear();
+                    set_union(kept.begin(),kept.end(),c.found.begin(),c.found.end(),back_inserter(c.merged));
+                    kept.swap(c.merged);
                 }
+                update_edges(c.xedges,c.removed_x,c.added_x,c.scratch);
+                update_edges(c.yedges,c.removed_y,c.added_y,c.scratch);
             }
+            c.filter = filter;
+            c.valid = true;
+            walk_levels(registry,filter,c.candidates,action,boxes,&c.xedges,&c.yedges);
         }
-        if(box_result.size() > 0)
+        else
         {
-            reverse(box_result.begin(),box_result.end());
-            size_t n = sizeof(TileBox*)*(box_result.size()+10);
-            TakeResult *result = (TakeResult*)malloc(sizeof(TakeResult) + n);
-            memcpy(result->tiles,box_result.data(),sizeof(TakeResult)+sizeof(TileBox*)*box_result.size());
-            result->count=box_result.size();
-            return result;
+            c.valid = false;
         }
-        else
+        //diff against the previous result by box id
+        c.ids.clear();
+        for(auto box:boxes)
+            c.ids.push_back(make_pair(box->id,box));
+        sort(c.ids.begin(),c.ids.end());
+        c.entered.clear();
+        c.left.clear();
+        size_t a = 0,b = 0;
+        while(a<c.prev_ids.size()||b<c.ids.size())
         {
-            return nullptr;
+            if(b==c.ids.size()||(a<c.prev_ids.size()&&c.prev_ids[a].first<c.ids[b].first))
+                c.left.push_back(c.prev_ids[a++].second);
+            else if(a==c.prev_ids.size()||c.ids[b].first<c.prev_ids[a].first)
+                c.entered.push_back(c.ids[b++].second);
+            else
+            {
+                a++;
+                b++;
+            }
+        }
+        c.prev_ids.swap(c.ids);
+
+        size_t size = sizeof(TakeResult)+sizeof(TileBox*)*boxes.size();
+        if(size>c.capacity)
+        {
+            free(c.block);
+            c.capacity = std::max(size,c.capacity*2);
+            c.block = (u8*)malloc(c.capacity);
         }
+        auto result = (TakeResult*)c.block;
+        result->count = boxes.size();
+        memcpy(result->tiles,boxes.data(),sizeof(TileBox*)*boxes.size());
+        c.frame.result = boxes.empty()?NULL:result;
+        c.frame.enteredCount = c.entered.size();
+        c.frame.leftCount = c.left.size();
+        c.frame.entered = c.entered.data();
+        c.frame.left = c.left.data();
+        return &c.frame;
     }
 
     void TileBoxTake::Impl::freeResult(const TakeResult *result)
     {
-        free((void*)result);
+        u8* block = (u8*)result - TAKE_RESULT_HEADER;
+        ((tile_registry_ptr*)block)->~tile_registry_ptr();
+        free(block);
+    }
+    static void write_padded(WriteStream* stream,const void* pdata,size_t size)
+    {
+        static const u8 zeros[8] = {0};
+        if(size)
+            stream->write((void*)pdata,size);
+        if(size&7)
+            stream->write((void*)zeros,8-(size&7));
+    }
+    void TileBoxTake::Impl::save(WriteStream* stream)
+    {
+        auto registry = snapshot();
+        tile_boxes_header_t header;
+        memset(&header,0,sizeof(header));
+        strcpy(header.magic,"FDBBOX1");
+        header.level_count = registry->levels.size();
+        header.box_size = sizeof(TileBox);
+        header.extent[0] = registry->extent.minEdge.x;
+        header.extent[1] = registry->extent.minEdge.y;
+        header.extent[2] = registry->extent.maxEdge.x;
+        header.extent[3] = registry->extent.maxEdge.y;
+        header.scale_to_int64 = registry->scale_to_int64;
+        stream->write(&header,sizeof(header));
+        for(size_t i=0;i<registry->levels.size();i++)
+        {
+            auto& level = registry->levels[i];
+            auto& index = registry->indices[i];
+            tile_boxes_level_t lh;
+            memset(&lh,0,sizeof(lh));
+            lh.box_count = level.size();
+            lh.nx = index.nx;
+            lh.ny = index.ny;
+            lh.item_count = index.items.size();
+            lh.minx = index.minx;
+            lh.miny = index.miny;
+            lh.cell = index.cell;
+            stream->write(&lh,sizeof(lh));
+            write_padded(stream,level.data(),sizeof(TileBox)*level.size());
+            write_padded(stream,index.offsets.data(),sizeof(u32)*index.offsets.size());
+            write_padded(stream,index.items.data(),sizeof(u32)*index.items.size());
+        }
+    }
+    //publish a saved registry as is, box ids index cookies
+    bool TileBoxTake::Impl::load(const void* pdata,size_t size,void** cookies,u32 count)
+    {
+        const u8* ptr = (const u8*)pdata;
+        const u8* end = ptr+size;
+        auto header = (const tile_boxes_header_t*)ptr;
+        if(size<sizeof(tile_boxes_header_t)||strcmp(header->magic,"FDBBOX1")!=0||header->box_size!=sizeof(TileBox)
+            ||header->level_count!=m_levels.size())
+        {
+            printf("invalid tile box index\n");
+            return false;
+        }
+        ptr += sizeof(tile_boxes_header_t);
+        auto registry = make_shared<tile_registry_t>();
+        registry->levels.resize(header->level_count);
+        registry->indices.resize(header->level_count);
+        registry->extent = aabbox_t::make(header->extent[0],header->extent[1],header->extent[2],header->extent[3]);
+        registry->scale_to_int64 = header->scale_to_int64;
+        auto padded = [](size_t n){ return (n+7)&~(size_t)7; };
+        for(u32 i=0;i<header->level_count;i++)
+        {
+            if(sizeof(tile_boxes_level_t)>(size_t)(end-ptr))
+                return false;
+            auto lh = (const tile_boxes_level_t*)ptr;
+            ptr += sizeof(tile_boxes_level_t);
+            //query_level_index addresses cells with u32 and divides by the cell size
+            if(lh->box_count&&((u64)lh->nx*lh->ny>=UINT32_MAX||!(lh->cell>0)))
+            {
+                printf("invalid tile box index grid\n");
+                return false;
+            }
+            size_t offset_count = lh->box_count?(size_t)lh->nx*lh->ny+1:0;
+            size_t need = padded(sizeof(TileBox)*lh->box_count)+padded(sizeof(u32)*offset_count)+padded(sizeof(u32)*lh->item_count);
+            if(need>(size_t)(end-ptr))
+            {
+                printf("truncated tile box index\n");
+                return false;
+            }
+            auto boxes = (const TileBox*)ptr;
+            auto& level = registry->levels[i];
+            level.assign(boxes,boxes+lh->box_count);
+            for(auto& bx:level)
+            {
+                if((u32)bx.id>=count)
+                {
+                    printf("tile box id %d out of range\n",bx.id);
+                    return false;
+                }
+                bx.cookie = cookies[bx.id];
+            }
+            ptr += padded(sizeof(TileBox)*lh->box_count);
+            auto& index = registry->indices[i];
+            index.minx = lh->minx;
+            index.miny = lh->miny;
+            index.cell = lh->cell;
+            index.nx = offset_count?lh->nx:0;
+            index.ny = offset_count?lh->ny:0;
+            index.offsets.assign((const u32*)ptr,(const u32*)ptr+offset_count);
+            ptr += padded(sizeof(u32)*offset_count);
+            index.items.assign((const u32*)ptr,(const u32*)ptr+lh->item_count);
+            ptr += padded(sizeof(u32)*lh->item_count);
+            //cells slice items in order, every item is a box of the level
+            bool valid = !offset_count||(index.offsets[0]==0&&index.offsets.back()==lh->item_count);
+            for(size_t c=1;c<offset_count&&valid;c++)
+                valid = index.offsets[c-1]<=index.offsets[c];
+            for(size_t k=0;k<index.items.size()&&valid;k++)
+                valid = index.items[k]<lh->box_count;
+            if(!valid)
+            {
+                printf("invalid tile box index cells\n");
+                return false;
+            }
+        }
+        lock_guard<mutex> lock(m_mutex);
+        bool empty = !m_levels_in_registry;
+        for(size_t i=0;i<m_levels.size()&&empty;i++)
+            empty = m_levels[i].empty();
+        if(!empty)
+        {
+            //merged with the boxes registered before by the next take
+            if(m_levels_in_registry)
+                restore_levels();
+            for(size_t i=0;i<m_levels.size();i++)
+                m_levels[i].insert(m_levels[i].end(),registry->levels[i].begin(),registry->levels[i].end());
+            m_dirty = true;
+            return true;
+        }
+        //m_levels is only filled again when more boxes are registered
+        tile_registry_ptr published = registry;
+        atomic_store(&m_registry,published);
+        m_levels_in_registry = true;
+        m_dirty = false;
+        return true;
+    }
+
+    //registries still held by outstanding take results are not counted
+    u64 TileBoxTake::Impl::memory_bytes()
+    {
+        lock_guard<mutex> lock(m_mutex);
+        u64 bytes = memory_vector_bytes(m_levels);
+        for(auto& level:m_levels)
+            bytes += memory_vector_bytes(level);
+        auto registry = atomic_load(&m_registry);
+        if(registry)
+        {
+            bytes += memory_heap_bytes(sizeof(tile_registry_t)+16);
+            bytes += memory_vector_bytes(registry->levels)+memory_vector_bytes(registry->indices);
+            for(auto& level:registry->levels)
+                bytes += memory_vector_bytes(level);
+            for(auto& index:registry->indices)
+                bytes += memory_vector_bytes(index.offsets)+memory_vector_bytes(index.items);
+        }
+        return bytes;
     }
+
     ///////////////////////////////////////////////////////////////////////////////
     TileBoxTake::TileBoxTake(int maxLevel)
     {
@@ -192,7 +706,11 @@ namespace wx
     }
     const TileBoxTake::TakeResult *TileBoxTake::take(u32 maxLevel, double xmin, double ymin, double xmax, double ymax,HandleTileAction* action)
     {
-        return impl->take(maxLevel, xmin, ymin, xmax, ymax,action);
+        trace_span_t span("TileBoxTake::take");
+        auto result = impl->take(maxLevel, xmin, ymin, xmax, ymax,action);
+        span.num("level", maxLevel);
+        span.num("tiles", result ? result->count : 0);
+        return result;
     }
     void TileBoxTake::freeResult(const TakeResult *result)
     {
@@ -200,5 +718,33 @@ namespace wx
             return;
         impl->freeResult(result);
     }
+    TileBoxTake::TakeCursor *TileBoxTake::createCursor()
+    {
+        return new TakeCursor();
+    }
+    const TileBoxTake::TakeFrame *TileBoxTake::takeIncremental(TakeCursor* cursor,u32 maxLevel, double xmin, double ymin, double xmax, double ymax,HandleTileAction* action)
+    {
+        trace_span_t span("TileBoxTake::takeIncremental");
+        auto frame = impl->take_incremental(cursor,maxLevel,xmin,ymin,xmax,ymax,action);
+        span.num("entered", frame ? frame->enteredCount : 0);
+        span.num("left", frame ? frame->leftCount : 0);
+        return frame;
+    }
+    void TileBoxTake::freeCursor(TakeCursor* cursor)
+    {
+        delete cursor;
+    }
+    void TileBoxTake::save(WriteStream* stream)
+    {
+        impl->save(stream);
+    }
+    bool TileBoxTake::load(const void* pdata,size_t size,void** cookies,u32 count)
+    {
+        return impl->load(pdata,size,cookies,count);
+    }
+    u64 TileBoxTake::memoryBytes()
+    {
+        return impl->memory_bytes();
+    }
 
 }
\ No newline at end of file
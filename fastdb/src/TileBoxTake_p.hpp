@@ -1,24 +1,148 @@
 #include "fastdb.h"
 #include "fastdb-geometry-utils.h"
 #include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
 using namespace std;
 
 namespace wx{
+    //uniform grid over the boxes of one level, cells list box indices (CSR)
+    struct tile_level_index_t
+    {
+        double      minx,miny;
+        double      cell;
+        u32         nx,ny;
+        vector<u32> offsets;    //nx*ny+1
+        vector<u32> items;
+    };
+
+    //coverage of the query rectangle on the grid made by the box edges,
+    //coordinates are snapped to integers so that shared tile edges match exactly
+    class tile_coverage_t
+    {
+    public:
+        void        reset(vector<long long>& xs,vector<long long>& ys);
+        bool        is_covered(long long minx,long long miny,long long maxx,long long maxy) const;
+        void        cover(long long minx,long long miny,long long maxx,long long maxy);
+        bool        is_full() const { return m_covered==m_cells; }
+    private:
+        bool        row_covered(u32 row,u32 c0,u32 c1) const;
+        u32         cover_row(u32 row,u32 c0,u32 c1);
+    private:
+        vector<long long>   m_xs,m_ys;  //sorted cell edges
+        vector<u64>         m_bits;
+        u32                 m_words;    //words per row
+        u64                 m_cells;
+        u64                 m_covered;
+    };
+
+    //registry published to takers, never modified once published.
+    //a take keeps its snapshot alive until freeResult
+    struct tile_registry_t
+    {
+        vector<vector<TileBoxTake::TileBox>>  levels;
+        vector<tile_level_index_t>          indices;
+        aabbox_t                            extent;
+        double                              scale_to_int64;
+        long long to_int64_x(double x) const { return (long long)((x-extent.minEdge.x)*scale_to_int64); }
+        long long to_int64_y(double y) const { return (long long)((y-extent.minEdge.y)*scale_to_int64); }
+    };
+
+    //saved registry: tile_boxes_header_t, then per level tile_boxes_level_t, its boxes,
+    //index offsets and items, each array padded to 8 bytes. cookies are not saved
+    struct tile_boxes_header_t
+    {
+        char    magic[8];       //"FDBBOX1"
+        u32     level_count;
+        u32     box_size;       //sizeof(TileBox) of the writer
+        double  extent[4];
+        double  scale_to_int64;
+    };
+    struct tile_boxes_level_t
+    {
+        u32     box_count;
+        u32     nx,ny;
+        u32     item_count;
+        double  minx,miny,cell;
+    };
+
+    //query rectangle already clipped to the registry extent
+    struct tile_box_filter
+    {
+        u32    maxLevel;
+        double minx;
+        double miny;
+        double maxx;
+        double maxy;
+        static tile_box_filter make(u32 maxLevel,double minx,double miny,double maxx,double maxy){
+            tile_box_filter f;
+            f.maxLevel = maxLevel;
+            f.minx = minx;
+            f.miny = miny;
+            f.maxx = maxx;
+            f.maxy = maxy;
+            return f;
+        }
+    };
+
+    //state kept between the frames of an incremental take
+    class TileBoxTake::TakeCursor
+    {
+    public:
+        shared_ptr<tile_registry_t>     registry;       //of the current frame
+        shared_ptr<tile_registry_t>     prev_registry;  //keeps the boxes of left alive
+        bool                            valid;          //filter and candidates describe the last frame
+        tile_box_filter                 filter;
+        vector<vector<u32>>             candidates;     //per level, sorted, intersecting filter
+        vector<TileBox*>                boxes;          //current result
+        vector<pair<int,TileBox*>>      prev_ids;       //previous result sorted by id
+        vector<pair<int,TileBox*>>      ids;
+        vector<TileBox*>                entered;
+        vector<TileBox*>                left;
+        vector<long long>               xedges,yedges;  //sorted box edges of the candidates, unclipped
+        vector<long long>               removed_x,removed_y,added_x,added_y;
+        vector<long long>               scratch;
+        vector<u32>                     found;
+        vector<u32>                     merged;
+        u8*                             block;          //TakeResult of the current frame, reused
+        size_t                          capacity;
+        TakeFrame                       frame;
+        TakeCursor():valid(false),block(NULL),capacity(0){ memset(&frame,0,sizeof(frame)); }
+       ~TakeCursor(){ free(block); }
+    };
+
     class TileBoxTake::Impl
     {
         using tile_box_level_t      = vector<TileBox>;
+        using tile_registry_ptr     = shared_ptr<tile_registry_t>;
     public:
        Impl(int maxLevel);
       ~Impl();
         void                registerTileBox(const TileBox &item);
         const TakeResult*   take(u32 maxLevel, double xmin, double ymin, double xmax, double ymax,HandleTileAction* action);
         void                freeResult(const TakeResult* result);
+        const TakeFrame*    take_incremental(TakeCursor* cursor,u32 maxLevel, double xmin, double ymin, double xmax, double ymax,HandleTileAction* action);
+        void                save(WriteStream* stream);
+        bool                load(const void* pdata,size_t size,void** cookies,u32 count);
+        u64                 memory_bytes();
     private:
-        void sort_level_with_time_and_area(tile_box_level_t& level);
+        tile_registry_ptr   snapshot();
+        void                restore_levels();
+        static void sort_level_with_time_and_area(tile_box_level_t& level);
+        static void build_level_index(tile_box_level_t& level,tile_level_index_t& index);
+        static bool clip_query(const tile_registry_t& registry,u32 maxLevel,double xmin,double ymin,double xmax,double ymax,tile_box_filter& filter);
+        static bool walk_levels(tile_registry_t& registry,const tile_box_filter& filter,const vector<vector<u32>>& candidates,
+                                HandleTileAction* action,vector<TileBox*>& box_result,
+                                const vector<long long>* xedges=NULL,const vector<long long>* yedges=NULL);
+        static void gather_candidates(const tile_registry_t& registry,const tile_box_filter& filter,u32 level,
+                                      double minx,double miny,double maxx,double maxy,vector<u32>& result);
+        static void query_level_index(const tile_level_index_t& index,double minx,double miny,double maxx,double maxy,vector<u32>& result);
     private:
-        vector<tile_box_level_t*>   m_levels;
-        bool                        m_dirty;
-        aabbox_t                    m_extent;
-        long long                   m_scale_to_int64;
+        vector<tile_box_level_t>    m_levels;       //registered boxes, guarded by m_mutex
+        mutex                       m_mutex;
+        atomic<bool>                m_dirty;
+        bool                        m_levels_in_registry;   //m_levels left empty, the boxes are in m_registry
+        tile_registry_ptr           m_registry;     //accessed with atomic_load/atomic_store
     };
-}
\ No newline at end of file
+}
@@ -3,7 +3,19 @@
     #define SWIG_FILE_WITH_INIT
     #include "fastdb.h"
     #include "fastdb-geometry-utils.h"
+    #include <string>
     using namespace wx;
+    // collects what a WriteStream receives, returned to python as bytes
+    class BytesWriteStream : public wx::WriteStream {
+    public:
+        std::string data;
+        void write(void *pdata, size_t size) override {
+            data.append((const char *)pdata, size);
+        }
+        PyObject *to_bytes() {
+            return PyBytes_FromStringAndSize(data.data(), data.size());
+        }
+    };
 %}
 
 %include "typemaps.i"
@@ -74,6 +86,24 @@
 %ignore wx::FastVectorDbFeature::FastVectorDbFeature();
 %ignore wx::FastVectorDbFeature::~FastVectorDbFeature();
 %ignore wx::FastVectorDb::load(void *pdata, size_t size, fnFreeDbBuffer fnFreeBuffer, void *cookie);
+%ignore wx::FastVectorDbLayer::readFeature(u32 ifeature, void *out);
+%ignore wx::FastVectorDbLayer::changedSince(u64 version, u32 *chunks, u32 capacity);
+%ignore wx::FastVectorDb::signature;
+%ignore wx::FastVectorDb::diff;
+%ignore wx::FastVectorDb::applyPatch;
+%ignore wx::FastVectorDb::loadPatched;
+%newobject wx::FastVectorDb::load_patched;
+%ignore wx::FastVectorDb::postTrace;
+%ignore wx::FastVectorDbLayer::getBackLinks;
+%ignore wx::FastVectorDbLayer::resolveRefs;
+%ignore wx::FastVectorDbLayer::gather;
+%ignore wx::FastVectorDbLayer::gatherFloat;
+%ignore wx::FastVectorDb::resolveRefs;
+%ignore wx::FastVectorDbJoin::leftRows;
+%ignore wx::FastVectorDbJoin::rightRows;
+%ignore wx::FastVectorDbJoin::gatherFloat;
+%ignore wx::FastVectorDbSelection::rows;
+%ignore wx::FastVectorDbRing::beginRead;
 %nodefaultctor FastVectorDbLayerBuild;
 %nodefaultdtor FastVectorDbLayerBuild;
 %nodefaultctor FastVectorDbFeature;
@@ -85,8 +115,16 @@
 %rename(WxDatabase)         wx::FastVectorDb;
 %rename(WxFeature)          wx::FastVectorDbFeature;
 %rename(WxFeatureRef)       wx::FastVectorDbFeatureRef;
+%rename(WxFeatureHandle)    wx::FastVectorDbFeatureHandle;
+%rename(WxBackLink)         wx::FastVectorDbBackLink;
 %rename(WxDatabaseBuild)    wx::FastVectorDbBuild;
 %rename(WxLayerTableBuild)  wx::FastVectorDbLayerBuild;
+%rename(WxDatabaseRing)     wx::FastVectorDbRing;
+%rename(WxDatabaseGen)      wx::FastVectorDbGen;
+%rename(WxStats)            wx::FastVectorDbStats;
+%rename(WxMemory)           wx::FastVectorDbMemory;
+%rename(WxJoin)             wx::FastVectorDbJoin;
+%rename(WxSelection)        wx::FastVectorDbSelection;
 //make the name just python like
 %rename(add_field)         addField;
 %rename(set_geometry_type) setGeometryType;
@@ -117,11 +155,106 @@
 %rename(set_feature_cookie)     setFeatureCookie;   
 %rename(get_feature_cookie)     getFeatureCookie;   
 %rename(tryGetFeature)          tryGetFeatureAt;
+%rename(get_feature_handle)     getFeatureHandle;
 %rename(get_layer_count)        getLayerCount;
 %rename(get_layer)              getLayer;
 %rename(get_address)            getAddress;
 %rename(get_field_offset)       getFieldOffset;
 %rename(get_feature_byte_size)  getFeatureByteSize;;
+%rename(enable_seqlock)         enableSeqlock;
+%rename(has_seqlock)            hasSeqlock;
+%rename(get_seqlock_chunk_rows) getSeqlockChunkRows;
+%rename(get_version)            getVersion;
+%rename(begin_update)           beginUpdate;
+%rename(end_update)             endUpdate;
+%rename(update_field)           updateField;
+%rename(begin_read)             beginRead;
+%rename(end_read)               endRead;
+%rename(enable_control_header)  enableControlHeader;
+%rename(has_control_header)     hasControlHeader;
+%rename(get_epoch)              getEpoch;
+%rename(get_ready_flags)        getReadyFlags;
+%rename(set_ready_flags)        setReadyFlags;
+%rename(clear_ready_flags)      clearReadyFlags;
+%rename(wait_ready_flags)       waitReadyFlags;
+%rename(enable_back_links)      enableBackLinks;
+%rename(has_back_links)         hasBackLinks;
+
+// blocking waits release the GIL, so other python threads keep running while sleeping on the futex
+%exception wx::FastVectorDb::wait {
+    Py_BEGIN_ALLOW_THREADS
+    $action
+    Py_END_ALLOW_THREADS
+}
+%exception wx::FastVectorDb::waitReadyFlags {
+    Py_BEGIN_ALLOW_THREADS
+    $action
+    Py_END_ALLOW_THREADS
+}
+// seqlock writers and readers spin while another writer holds the chunk, which may be
+// a python thread of this process inside Layer.update
+%exception wx::FastVectorDbLayer::beginUpdate {
+    Py_BEGIN_ALLOW_THREADS
+    $action
+    Py_END_ALLOW_THREADS
+}
+%exception wx::FastVectorDbLayer::beginRead {
+    Py_BEGIN_ALLOW_THREADS
+    $action
+    Py_END_ALLOW_THREADS
+}
+%exception wx::FastVectorDbRing::waitStep {
+    Py_BEGIN_ALLOW_THREADS
+    $action
+    Py_END_ALLOW_THREADS
+}
+%exception wx::FastVectorDbRing::beginWrite {
+    Py_BEGIN_ALLOW_THREADS
+    $action
+    Py_END_ALLOW_THREADS
+}
+
+%newobject wx::FastVectorDbRing::create;
+%newobject wx::FastVectorDbRing::open;
+%rename(get_slot_count)         getSlotCount;
+%rename(get_latest_step)        getLatestStep;
+%rename(begin_write)            beginWrite;
+%rename(end_write)              endWrite;
+%rename(abort_write)            abortWrite;
+%rename(wait_step)              waitStep;
+%newobject wx::FastVectorDb::load_fd;
+%rename(post_memfd)             postMemfd;
+%rename(to_memfd)               toMemfd;
+%rename(send_fd)                sendFd;
+%rename(recv_fd)                recvFd;
+%exception wx::FastVectorDb::recvFd {
+    Py_BEGIN_ALLOW_THREADS
+    $action
+    Py_END_ALLOW_THREADS
+}
+%rename(add_layer)              addLayer;
+%rename(set_vertices)           setVertices;
+%rename(set_holes)              setHoles;
+%rename(add_ref_field)          addRefField;
+%rename(save_pyramid)           savePyramid;
+%rename(get_stats)              getStats;
+%rename(reset_stats)            resetStats;
+%rename(enable_trace)           enableTrace;
+%rename(disable_trace)          disableTrace;
+%rename(save_trace)             saveTrace;
+%rename(memory_report)          memoryReport;
+%rename(get_count)              getCount;
+%newobject wx::FastVectorDbLayer::filter;
+%exception wx::FastVectorDbJoin::join {
+    Py_BEGIN_ALLOW_THREADS
+    $action
+    Py_END_ALLOW_THREADS
+}
+%exception wx::FastVectorDbGen::savePyramid {
+    Py_BEGIN_ALLOW_THREADS
+    $action
+    Py_END_ALLOW_THREADS
+}
 
 %extend wx::chunk_data_t {
     PyObject *as_array(PyObject* npType) {
@@ -185,6 +318,226 @@
     }
 }
 
+%extend wx::FastVectorDbLayer {
+    // consistent copy of a feature row, retried while a writer is inside its chunk
+    PyObject *read_feature(unsigned int ifeature) {
+        size_t size = $self->getFeatureByteSize();
+        PyObject *bytes = PyBytes_FromStringAndSize(NULL, size);
+        if (!bytes)
+            return NULL;
+        char *out = PyBytes_AsString(bytes);
+        bool ok;
+        Py_BEGIN_ALLOW_THREADS
+        ok = $self->readFeature(ifeature, out);
+        Py_END_ALLOW_THREADS
+        if (!ok) {
+            Py_DECREF(bytes);
+            PyErr_SetString(PyExc_IndexError, "feature index out of range");
+            return NULL;
+        }
+        return bytes;
+    }
+
+    // indices of the seqlock chunks committed after the given layer version
+    PyObject *changed_since(unsigned long long version) {
+        u32 count = $self->changedSince(version, NULL, 0);
+        npy_intp dims[1] = {(npy_intp)count};
+        PyObject *array = PyArray_SimpleNew(1, dims, NPY_UINT32);
+        if (!array)
+            return NULL;
+        if (count)
+            $self->changedSince(version, (u32 *)PyArray_DATA((PyArrayObject *)array), count);
+        return array;
+    }
+
+    // features referencing ifeature as rows of (layer, feature, field)
+    PyObject *back_links(unsigned int ifeature) {
+        u32 count = 0;
+        const wx::FastVectorDbBackLink *links = $self->getBackLinks(ifeature, count);
+        npy_intp dims[2] = {(npy_intp)count, 3};
+        PyObject *array = PyArray_SimpleNew(2, dims, NPY_UINT32);
+        if (!array)
+            return NULL;
+        u32 *out = (u32 *)PyArray_DATA((PyArrayObject *)array);
+        for (u32 i = 0; i < count; i++) {
+            out[i * 3] = links[i].ilayer;
+            out[i * 3 + 1] = links[i].ifeature;
+            out[i * 3 + 2] = links[i].ifield;
+        }
+        return array;
+    }
+
+    // rows of layer targetLayer referenced by refField of features [first, first+count), NO_ROW elsewhere
+    PyObject *resolve_refs(unsigned int refField, unsigned int targetLayer, unsigned int first = 0, unsigned int count = 0xFFFFFFFF) {
+        u32 feature_count = $self->getFeatureCount();
+        if (first > feature_count)
+            first = feature_count;
+        if (count > feature_count - first)
+            count = feature_count - first;
+        npy_intp dims[1] = {(npy_intp)count};
+        PyObject *array = PyArray_SimpleNew(1, dims, NPY_UINT32);
+        if (!array)
+            return NULL;
+        if (count && !$self->resolveRefs(refField, first, count, targetLayer, (u32 *)PyArray_DATA((PyArrayObject *)array))) {
+            FieldTypeEnum ft;
+            double vmin, vmax;
+            if (!$self->getFieldDefn(refField, ft, vmin, vmax) || ft != ftFeatureRef) {
+                Py_DECREF(array);
+                PyErr_SetString(PyExc_ValueError, "not a feature ref field");
+                return NULL;
+            }
+        }
+        return array;
+    }
+
+    // raw values of field ix at rows, (n, size) uint8 for strings ids and refs
+    PyObject *gather(unsigned int ix, PyObject *rows) {
+        FieldTypeEnum ft;
+        double vmin, vmax;
+        if (!$self->getFieldDefn(ix, ft, vmin, vmax)) {
+            PyErr_SetString(PyExc_IndexError, "field index out of range");
+            return NULL;
+        }
+        PyArrayObject *rows_array = (PyArrayObject *)PyArray_FROMANY(rows, NPY_UINT32, 1, 1, NPY_ARRAY_IN_ARRAY | NPY_ARRAY_FORCECAST);
+        if (!rows_array)
+            return NULL;
+        int typenum = -1;
+        switch (ft) {
+        case ftU8: case ftU8n: typenum = NPY_UINT8; break;
+        case ftU16: case ftU16n: typenum = NPY_UINT16; break;
+        case ftU32: typenum = NPY_UINT32; break;
+        case ftI32: typenum = NPY_INT32; break;
+        case ftF32: typenum = NPY_FLOAT32; break;
+        case ftF64: typenum = NPY_FLOAT64; break;
+        default: break;
+        }
+        u32 size = $self->gather(ix, NULL, 0, NULL);
+        npy_intp dims[2] = {PyArray_DIM(rows_array, 0), (npy_intp)size};
+        PyObject *array = typenum == -1 ? PyArray_SimpleNew(2, dims, NPY_UINT8) : PyArray_SimpleNew(1, dims, typenum);
+        if (array)
+            $self->gather(ix, (const u32 *)PyArray_DATA(rows_array), (u32)dims[0], PyArray_DATA((PyArrayObject *)array));
+        Py_DECREF(rows_array);
+        return array;
+    }
+
+    // fields at rows as float64, one row of the result per field, NaN at NO_ROW
+    PyObject *gather_float(PyObject *fields, PyObject *rows) {
+        PyArrayObject *fields_array = (PyArrayObject *)PyArray_FROMANY(fields, NPY_UINT32, 1, 1, NPY_ARRAY_IN_ARRAY | NPY_ARRAY_FORCECAST);
+        if (!fields_array)
+            return NULL;
+        PyArrayObject *rows_array = (PyArrayObject *)PyArray_FROMANY(rows, NPY_UINT32, 1, 1, NPY_ARRAY_IN_ARRAY | NPY_ARRAY_FORCECAST);
+        if (!rows_array) {
+            Py_DECREF(fields_array);
+            return NULL;
+        }
+        npy_intp dims[2] = {PyArray_DIM(fields_array, 0), PyArray_DIM(rows_array, 0)};
+        PyObject *array = PyArray_SimpleNew(2, dims, NPY_FLOAT64);
+        if (array && !$self->gatherFloat((const u32 *)PyArray_DATA(fields_array), (u32)dims[0],
+                                         (const u32 *)PyArray_DATA(rows_array), (u32)dims[1],
+                                         (double *)PyArray_DATA((PyArrayObject *)array))) {
+            Py_DECREF(array);
+            array = NULL;
+            PyErr_SetString(PyExc_IndexError, "field index out of range");
+        }
+        Py_DECREF(rows_array);
+        Py_DECREF(fields_array);
+        return array;
+    }
+}
+
+%extend wx::FastVectorDbSelection {
+    // selected rows as an array, copied
+    PyObject *selected_rows() {
+        npy_intp dims[1] = {(npy_intp)$self->getCount()};
+        PyObject *array = PyArray_SimpleNew(1, dims, NPY_UINT32);
+        if (array && dims[0])
+            memcpy(PyArray_DATA((PyArrayObject *)array), $self->rows(), dims[0] * sizeof(u32));
+        return array;
+    }
+}
+
+%extend wx::FastVectorDbJoin {
+    // matched rows as arrays, copied so that they outlive the next join
+    PyObject *left_rows() {
+        npy_intp dims[1] = {(npy_intp)$self->getCount()};
+        PyObject *array = PyArray_SimpleNew(1, dims, NPY_UINT32);
+        if (array && dims[0])
+            memcpy(PyArray_DATA((PyArrayObject *)array), $self->leftRows(), dims[0] * sizeof(u32));
+        return array;
+    }
+    PyObject *right_rows() {
+        npy_intp dims[1] = {(npy_intp)$self->getCount()};
+        PyObject *array = PyArray_SimpleNew(1, dims, NPY_UINT32);
+        if (array && dims[0])
+            memcpy(PyArray_DATA((PyArrayObject *)array), $self->rightRows(), dims[0] * sizeof(u32));
+        return array;
+    }
+    // fields of side 0 (left) or 1 (right) at the matched rows, one row of the result per field
+    PyObject *gather_float(unsigned int side, PyObject *fields) {
+        PyArrayObject *fields_array = (PyArrayObject *)PyArray_FROMANY(fields, NPY_UINT32, 1, 1, NPY_ARRAY_IN_ARRAY | NPY_ARRAY_FORCECAST);
+        if (!fields_array)
+            return NULL;
+        npy_intp dims[2] = {PyArray_DIM(fields_array, 0), (npy_intp)$self->getCount()};
+        PyObject *array = PyArray_SimpleNew(2, dims, NPY_FLOAT64);
+        if (array && !$self->gatherFloat(side, (const u32 *)PyArray_DATA(fields_array), (u32)dims[0],
+                                         (double *)PyArray_DATA((PyArrayObject *)array))) {
+            Py_DECREF(array);
+            array = NULL;
+            PyErr_SetString(PyExc_IndexError, "bad side or field index");
+        }
+        Py_DECREF(fields_array);
+        return array;
+    }
+}
+
+%extend wx::FastVectorDbRing {
+    // (slot, step) of the latest published slot, (None, 0) if nothing is published
+    PyObject *begin_read() {
+        u64 step = 0;
+        wx::FastVectorDb *slot = $self->beginRead(&step);
+        PyObject *py_slot = slot ? SWIG_NewPointerObj(SWIG_as_voidptr(slot), SWIGTYPE_p_wx__FastVectorDb, 0) : (Py_INCREF(Py_None), Py_None);
+        return Py_BuildValue("(NK)", py_slot, (unsigned long long)step);
+    }
+}
+
+%extend wx::FastVectorDb {
+    // row level diff/patch, signatures and patches travel as bytes
+    PyObject *signature_bytes(unsigned int chunkRows = 64) {
+        BytesWriteStream stream;
+        if (!$self->signature(&stream, chunkRows)) {
+            PyErr_SetString(PyExc_ValueError, "chunkRows must be positive");
+            return NULL;
+        }
+        return stream.to_bytes();
+    }
+    // patch from the signed version to this one, None when the signature is invalid
+    PyObject *diff_bytes(void *pdata, size_t size) {
+        BytesWriteStream stream;
+        if (!$self->diff(pdata, size, &stream))
+            Py_RETURN_NONE;
+        return stream.to_bytes();
+    }
+    static PyObject *diff_between(wx::FastVectorDb *base, wx::FastVectorDb *target, unsigned int chunkRows = 64) {
+        BytesWriteStream stream;
+        if (!wx::FastVectorDb::diff(base, target, &stream, chunkRows))
+            Py_RETURN_NONE;
+        return stream.to_bytes();
+    }
+    bool apply_patch(void *pdata, size_t size) {
+        return $self->applyPatch(pdata, size);
+    }
+    // new database from base and a patch of either kind, None when they do not match
+    static wx::FastVectorDb *load_patched(wx::FastVectorDb *base, void *pdata, size_t size) {
+        return wx::FastVectorDb::loadPatched(base, pdata, size);
+    }
+    // Chrome trace JSON of the current trace session
+    static PyObject *trace_bytes() {
+        BytesWriteStream stream;
+        wx::FastVectorDb::postTrace(&stream);
+        return stream.to_bytes();
+    }
+}
+
 %pythoncode %{
     import numpy as np
 %}
@@ -251,6 +604,8 @@
 %apply  unsigned int    {u32};
 %apply           short  {i16};
 %apply  unsigned short  {u16};
+%apply  unsigned long long {u64};
+%apply           long long {i64};
 %apply  float           {f32};
 %apply  double          {f64};
 %apply  unsigned short  {uchar_t};
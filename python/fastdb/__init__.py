@@ -3,4 +3,7 @@ from .type import (
     F32, F64, STR, WSTR, REF, BYTES
 )
 from .pipe import FeaturePipe
-from .block import Block, BlockScale
\ No newline at end of file
+from .block import Block, BlockScale
+from .block.ring import BlockRing
+from .serve import ServeClient, ServeLayer, ServeResult
+from .stats import get_stats, reset_stats, memory_report
@@ -1,3 +1,5 @@
+import os
+import socket
 import tempfile
 import warnings
 from pathlib import Path
@@ -17,6 +19,7 @@ class BlockScale:
     pipe_type: Type[FeaturePipe]
     feature_capacity: int
     name: str = ''
+    seqlock_rows: int = 0   # rows per seqlock chunk, 0 means no cross-process update protection
 
 class LayerBuilder(Generic[T]):
     def __init__(self, pipe_type: Type[T], block: 'Block'):
@@ -59,9 +62,11 @@ class Block:
         return isinstance(self._origin, core.WxDatabase)
     
     @staticmethod
-    def create() -> 'Block':
+    def create(control: bool = False, back_links: bool = False) -> 'Block':
         block = Block()
         block._origin = core.WxDatabaseBuild()
+        block._origin.enable_control_header(control)
+        block._origin.enable_back_links(back_links)
         
         # Create default name layer
         nl: core.WxLayerTableBuild = block._origin.create_layer_begin('_name_')
@@ -72,10 +77,11 @@ class Block:
         return block
     
     @staticmethod
-    def truncate(scales: List[BlockScale]) -> 'Block':
+    def truncate(scales: List[BlockScale], control: bool = False) -> 'Block':
         # Create block with dynamic scales
         block = Block()
         block._origin = core.WxDatabaseBuild()
+        block._origin.enable_control_header(control)
         
         # Check if all scales are valid
         for scale in scales:
@@ -83,6 +89,8 @@ class Block:
                 raise TypeError('pipe_type must be a subclass of FeaturePipe.')
             if scale.feature_capacity <= 0:
                 raise ValueError('feature_capacity must be positive.')
+            if scale.seqlock_rows < 0:
+                raise ValueError('seqlock_rows must not be negative.')
         
         # Populate layers
         db: core.WxDatabaseBuild = block._origin
@@ -93,6 +101,8 @@ class Block:
             layer_name = scale.name if scale.name else scale.pipe_type.__name__
             for _ in range (0, scale.feature_capacity):
                 block.push(empty_pipe, layer_name)
+            if scale.seqlock_rows:
+                block._layer_map[layer_name]._origin.enable_seqlock(scale.seqlock_rows)
             
             # # Define layer
             # layer: core.WxLayerTableBuild = db.create_layer_begin(layer_name)
@@ -157,17 +167,27 @@ class Block:
             except FileNotFoundError:
                 raise FileNotFoundError(f"Block '{name}' not found in shared memory.")
         
+        block._find_name_layer()
+        return block
+    
+    @staticmethod
+    def _view(origin: core.WxDatabase) -> 'Block':
+        """Create a Block over a database owned elsewhere (e.g. a slot of a BlockRing)."""
+        block = Block()
+        block._origin = origin
+        block._find_name_layer()
+        return block
+    
+    def _find_name_layer(self):
         # Try to find name layer
         # For most of the time, name layer should alaways indexed at 0 if exists
         # But we still iterate through all layers to be safe, and the performance impact is negligible
-        layer_count = block._origin.get_layer_count()
+        layer_count = self._origin.get_layer_count()
         for i in range (layer_count):
-            o_layer: core.WxLayerTable = block._origin.get_layer(i)
+            o_layer: core.WxLayerTable = self._origin.get_layer(i)
             if o_layer.name() == '_name_':
-                block._name_layer = o_layer
+                self._name_layer = o_layer
                 break
-        
-        return block
 
     def push(self, pipe: T, layer_name: str = '', *, name: str = '', is_ref=False) -> Any:
         """Push the given feature pipe to the block database."""
@@ -254,16 +274,16 @@ class Block:
             raise RuntimeError('Block has no name layer, cannot get feature by name.')
         
         # Search name layer for the given name
-        of: core.WxFeature | None = None
+        of: core.WxFeatureHandle | None = None
         nl = self._name_layer
         nl.rewind()
         while nl.next():
             n = nl.get_field_as_string(0)
             if n == name:
                 ref = nl.get_field_as_ref(1)
-                of = self._origin.tryGetFeature(ref)
+                of = self._origin.get_feature_handle(ref)
                 break
-        if not of:
+        if of is None or not of.valid():
             return None
         
         # Create pipe
@@ -271,6 +291,46 @@ class Block:
         pipe.map_from(self._origin, of.layer(), of)
         return pipe
 
+    # Notification ############################################################################
+    # Only available for fixed blocks created with control=True, the waits release the GIL
+    
+    def _fixed_origin(self) -> core.WxDatabase:
+        if not self.fixed:
+            raise RuntimeError('Block still in build mode, not supporting notification.')
+        if not self._origin.has_control_header():
+            raise RuntimeError('Block has no control header, create it with control=True.')
+        return self._origin
+    
+    @property
+    def epoch(self) -> int:
+        """Current epoch, increased by every publish."""
+        return self._fixed_origin().get_epoch()
+    
+    def publish(self) -> int:
+        """Increase the epoch and wake all waiting processes, return the new epoch."""
+        return self._fixed_origin().publish()
+    
+    def wait(self, epoch: int, timeout: float | None = None) -> int:
+        """Block until the epoch differs from the given one or timeout (seconds), return the current epoch."""
+        timeout_ms = -1 if timeout is None else int(timeout * 1000)
+        return self._fixed_origin().wait(epoch, timeout_ms)
+    
+    @property
+    def ready_flags(self) -> int:
+        return self._fixed_origin().get_ready_flags()
+    
+    def set_ready(self, mask: int) -> int:
+        """Set the given ready flags and wake all waiting processes."""
+        return self._fixed_origin().set_ready_flags(mask)
+    
+    def clear_ready(self, mask: int) -> int:
+        return self._fixed_origin().clear_ready_flags(mask)
+    
+    def wait_ready(self, mask: int, timeout: float | None = None) -> int:
+        """Block until all the given ready flags are set or timeout (seconds), return the current flags."""
+        timeout_ms = -1 if timeout is None else int(timeout * 1000)
+        return self._fixed_origin().wait_ready_flags(mask, timeout_ms)
+
     def close(self):
         """Close the block and release resources."""
         if self._shm:
@@ -316,7 +376,80 @@ class Block:
             chunk: core.chunk_data_t = self._origin.buffer()
             with open(path, 'wb') as f:
                 f.write(chunk.to_bytes())
-        
+
+    # Row level synchronization ##################################################################
+    # A signature is a few bytes per 64 rows, the patch against it only carries the changed chunks
+
+    def signature(self, chunk_rows: int = 64) -> bytes:
+        """Signature of the current content, keep it to diff the next version against."""
+        return self._fixed_origin_for('signature').signature_bytes(chunk_rows)
+
+    def diff(self, base: 'Block | bytes') -> bytes | None:
+        """
+        Patch turning base (a block or its signature) into this block.
+        When the image size changed the patch rebuilds the block from moved chunks and new bytes.
+        Return None when the signature is invalid.
+        """
+        origin = self._fixed_origin_for('diff')
+        if isinstance(base, Block):
+            return core.WxDatabase.diff_between(base._fixed_origin_for('diff'), origin)
+        return origin.diff_bytes(base)
+
+    def apply_patch(self, patch: bytes):
+        """
+        Apply a patch in place, rows of seqlock protected layers are updated through the seqlock.
+        A patch changing the image size loads a new database instead, layers taken before are stale.
+        """
+        origin = self._fixed_origin_for('patch')
+        if origin.apply_patch(patch):
+            return
+        patched = core.WxDatabase.load_patched(origin, patch)
+        if patched is None:
+            raise ValueError('Patch does not match this block.')
+        self._origin = patched
+        self._layer_map.clear()
+
+    def _fixed_origin_for(self, action: str) -> core.WxDatabase:
+        if not self.fixed:
+            raise RuntimeError(f'Block still in build mode, not supporting {action}.')
+        return self._origin
+
+    # Handoff over unix sockets ##################################################################
+    # The image travels as a sealed memfd, the receiver maps it copy-on-write without any copy
+
+    def to_memfd(self, name: str = 'fastdb', seal: bool = True) -> int:
+        """Write the block into a new (sealed) memfd, the caller owns the returned descriptor."""
+        if self._origin is None:
+            raise RuntimeError('Block is empty, cannot create memfd.')
+        fd = self._origin.post_memfd(name, seal) if isinstance(self._origin, core.WxDatabaseBuild) \
+            else self._origin.to_memfd(name, seal)
+        if fd < 0:
+            raise OSError('Failed to create memfd for block.')
+        return fd
+
+    def send(self, sock: socket.socket):
+        """Send the block to the peer of a connected unix domain socket."""
+        fd = self.to_memfd()
+        try:
+            if not core.WxDatabase.send_fd(sock.fileno(), fd):
+                raise OSError('Failed to send block over socket.')
+        finally:
+            os.close(fd)
+
+    @staticmethod
+    def recv(sock: socket.socket, shared: bool = False) -> 'Block':
+        """Receive a block sent with Block.send, the GIL is released while waiting."""
+        fd = core.WxDatabase.recv_fd(sock.fileno())
+        if fd < 0:
+            raise OSError('Failed to receive block from socket.')
+        try:
+            origin = core.WxDatabase.load_fd(fd, shared)
+        finally:
+            os.close(fd) # the mapping keeps the memfd alive
+        if origin is None:
+            raise RuntimeError('Received an invalid block image.')
+        return Block._view(origin)
+
     def __len__(self):
         """Return the number of layers in the block."""
         if self._origin is None:
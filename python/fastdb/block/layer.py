@@ -179,13 +179,13 @@ class Layer(Generic[T]):
             raise IndexError(f'Feature index {index} out of range [0, {self._origin.get_feature_count()}].')
         # Get pipe
         pipe = self._pipe_type()
-        pipe.map_from(self._db, self._origin, self._origin.tryGetFeature(index))
+        pipe.map_from(self._db, self._origin, self._origin.get_feature_handle(index))
         return pipe
     
     def __iter__(self) -> Generator[T, None, None]:
         for i in range(self._origin.get_feature_count()):
             pipe = self._pipe_type()
-            pipe.map_from(self._db, self._origin, self._origin.tryGetFeature(i))
+            pipe.map_from(self._db, self._origin, self._origin.get_feature_handle(i))
             yield pipe
     
     @property
@@ -197,4 +197,134 @@ class Layer(Generic[T]):
         return self._origin.row()
     
     def rewind(self):
-        self._origin.rewind()
\ No newline at end of file
+        self._origin.rewind()
+    
+    # Seqlock synchronization ##############################################################
+    # Only available for fixed layers built with a seqlock area (see BlockScale.seqlock_rows)
+    
+    @property
+    def version(self) -> int:
+        """Layer version, increased by every committed update."""
+        return self._origin.get_version()
+    
+    @contextmanager
+    def update(self, index: int) -> Generator[T, None, None]:
+        """
+        Context manager to update a feature so that readers in other processes
+        never observe a half-written record.
+        The GIL is released while waiting for the chunk, so other threads may hold it meanwhile.
+        A process that dies inside the block leaves the chunk locked: later updates and
+        snapshots of its rows never return until the image is rebuilt.
+        """
+        if not self.fixed:
+            raise RuntimeError('Layer is still in build mode, not supporting update operation.')
+        pipe = self[index]
+        self._origin.begin_update(index)
+        try:
+            yield pipe
+        finally:
+            self._origin.end_update(index)
+    
+    def snapshot(self, index: int) -> bytes:
+        """Return a consistent copy of the raw row bytes of the feature at the given index."""
+        if not self.fixed:
+            raise RuntimeError('Layer is still in build mode, not supporting snapshot operation.')
+        return self._origin.read_feature(index)
+    
+    def changed_since(self, version: int) -> np.ndarray:
+        """Return indices of the rows whose chunk has been updated after the given version."""
+        chunks = self._origin.changed_since(version)
+        rows_per_chunk = self._origin.get_seqlock_chunk_rows()
+        if rows_per_chunk == 0 or len(chunks) == 0:
+            return np.empty(0, dtype=np.uint32)
+        rows = (chunks[:, None].astype(np.int64) * rows_per_chunk + np.arange(rows_per_chunk)).ravel()
+        return rows[rows < self._origin.get_feature_count()].astype(np.uint32)
+    
+    # Back links ############################################################################
+    # Only available for fixed layers of blocks created with back_links=True
+    
+    def back_links(self, index: int) -> np.ndarray:
+        """Return the (layer, feature, field) rows of the features referencing the feature at the given index."""
+        if not self.fixed:
+            raise RuntimeError('Layer is still in build mode, not supporting back_links operation.')
+        if not self._origin.has_back_links():
+            raise RuntimeError('Layer has no back links, create the block with back_links=True.')
+        return self._origin.back_links(index)
+    
+    # Bulk ref following ####################################################################
+    # Only available for fixed layers
+    
+    NO_ROW = 0xFFFFFFFF
+    
+    def _field_index(self, name: str) -> int:
+        for idx, (field_name, _) in enumerate(get_all_defns(self._pipe_type)):
+            if field_name == name:
+                return idx
+        raise KeyError(f'Field {name} not found in layer {self.name}.')
+    
+    def follow(self, ref_field: str, target: 'Layer', first: int = 0, count: int | None = None) -> np.ndarray:
+        """
+        Return the rows of the target layer referenced by ref_field of the features [first, first + count),
+        NO_ROW where a ref points at another layer.
+        """
+        if not self.fixed or not target.fixed:
+            raise RuntimeError('Layer is still in build mode, not supporting follow operation.')
+        target_index = -1
+        for i in range(self._db.get_layer_count()):
+            if self._db.get_layer(i).name() == target.name:
+                target_index = i
+                break
+        if target_index == -1:
+            raise ValueError(f'Layer {target.name} is not a layer of this block.')
+        return self._origin.resolve_refs(self._field_index(ref_field), target_index, first, 0xFFFFFFFF if count is None else count)
+    
+    def gather(self, fields: list[str], rows: np.ndarray) -> dict[str, np.ndarray]:
+        """Return the given numeric fields at rows as float64 columns, NaN at NO_ROW rows."""
+        if not self.fixed:
+            raise RuntimeError('Layer is still in build mode, not supporting gather operation.')
+        values = self._origin.gather_float([self._field_index(name) for name in fields], rows)
+        return {name: values[k] for k, name in enumerate(fields)}
+    
+    def filter(self, expr: str) -> np.ndarray:
+        """
+        Return the rows matching a condition on the layer's fields, e.g. "depth > 10 and kind == 'river'",
+        compiled and evaluated natively. The rows can be passed to gather.
+        true, false, and, or and not are keywords: fields with these names can't be referenced.
+        """
+        if not self.fixed:
+            raise RuntimeError('Layer is still in build mode, not supporting filter operation.')
+        selection = self._origin.filter(expr)
+        if selection is None:
+            raise ValueError(f'Invalid filter expression: {expr}')
+        return selection.selected_rows()
+    
+    # Joins #################################################################################
+    # Only available for fixed layers
+    
+    def join(
+        self,
+        other: 'Layer',
+        on: str,
+        other_on: str | None = None,
+        columns: list[str] = [],
+        other_columns: list[str] = [],
+        threads: int = 0
+    ) -> dict[str, np.ndarray]:
+        """
+        Inner join with another layer on matching integer or string fields.
+        Return the matched rows of both layers under 'rows' and 'other_rows', ordered by row of this layer,
+        and the given numeric fields at those rows as float64 columns, named 'layer.field' for the other layer.
+        """
+        if not self.fixed or not other.fixed:
+            raise RuntimeError('Layer is still in build mode, not supporting join operation.')
+        joined = core.WxJoin()
+        if not joined.join(self._origin, self._field_index(on), other._origin, other._field_index(other_on or on), threads):
+            raise ValueError(f'Fields {self.name}.{on} and {other.name}.{other_on or on} can not be joined.')
+        result = {'rows': joined.left_rows(), 'other_rows': joined.right_rows()}
+        if columns:
+            values = joined.gather_float(0, [self._field_index(name) for name in columns])
+            result.update({name: values[k] for k, name in enumerate(columns)})
+        if other_columns:
+            values = joined.gather_float(1, [other._field_index(name) for name in other_columns])
+            result.update({f'{other.name}.{name}': values[k] for k, name in enumerate(other_columns)})
+        return result
@@ -0,0 +1,86 @@
+from contextlib import contextmanager
+from typing import Generator, Tuple
+
+from .. import core
+from . import Block
+
+class BlockRing:
+    """
+    N preallocated shared-memory slots with the same schema.
+
+    The producer fills a free slot for step k while consumers keep reading
+    the latest published step zero-copy, no allocation or schema parsing
+    happens after the ring has been created or opened.
+    """
+    def __init__(self, origin: core.WxDatabaseRing, name: str):
+        self._origin = origin
+        self._name = name
+
+    @staticmethod
+    def create(name: str, layout: Block, slots: int = 2) -> 'BlockRing':
+        """Create a ring in shared memory with every slot initialized from the given fixed-scale block."""
+        if layout._origin is None:
+            raise RuntimeError('Layout block is empty, cannot create ring.')
+        if not layout.fixed:
+            layout._combine()
+        origin = core.WxDatabaseRing.create(name, layout._origin, slots)
+        if origin is None:
+            raise RuntimeError(f'Failed to create block ring "{name}".')
+        return BlockRing(origin, name)
+
+    @staticmethod
+    def open(name: str) -> 'BlockRing':
+        origin = core.WxDatabaseRing.open(name)
+        if origin is None:
+            raise FileNotFoundError(f"Block ring '{name}' not found in shared memory.")
+        return BlockRing(origin, name)
+
+    @staticmethod
+    def unlink(name: str) -> bool:
+        return core.WxDatabaseRing.unlink(name)
+
+    @property
+    def slot_count(self) -> int:
+        return self._origin.get_slot_count()
+
+    @property
+    def latest_step(self) -> int:
+        return self._origin.get_latest_step()
+
+    @contextmanager
+    def write(self, copy_latest: bool = False, timeout: float | None = None) -> Generator[Block, None, None]:
+        """
+        Context manager yielding a free slot as a Block, it is published as the next step on exit.
+        The slot is given back without publishing when the body raises.
+        """
+        # Sleeps on the ring's futex while every other slot is still read by a consumer
+        timeout_ms = -1 if timeout is None else int(timeout * 1000)
+        slot = self._origin.begin_write(copy_latest, timeout_ms)
+        if slot is None:
+            raise TimeoutError('No free slot in block ring.')
+        try:
+            yield Block._view(slot)
+        except BaseException:
+            self._origin.abort_write(slot)
+            raise
+        self._origin.end_write(slot)
+
+    @contextmanager
+    def read(self) -> Generator[Tuple[int, Block | None], None, None]:
+        """Context manager yielding (step, block) of the latest published slot, (0, None) if nothing is published."""
+        slot, step = self._origin.begin_read()
+        if slot is None:
+            yield 0, None
+            return
+        try:
+            yield step, Block._view(slot)
+        finally:
+            self._origin.end_read(slot)
+
+    def wait(self, step: int, timeout: float | None = None) -> int:
+        """Block until a step newer than the given one is published or timeout (seconds), return the latest step."""
+        timeout_ms = -1 if timeout is None else int(timeout * 1000)
+        return self._origin.wait_step(step, timeout_ms)
+
+    def close(self):
+        self._origin = None
@@ -12,7 +12,7 @@ T = TypeVar('T', bound='FeaturePipe')
 class FeaturePipe(BasePipe):
     def __init__(self, **kwargs):
         self._cache: Dict[str, any] = {}
-        self._origin: core.WxFeature | None = None
+        self._origin: core.WxFeature | core.WxFeatureHandle | None = None
         self._db: core.WxDatabase | core.WxDatabaseBuild | None = None
         self._layer: core.WxLayerTable | core.WxLayerTableBuild | None = None
         
@@ -29,7 +29,7 @@ class FeaturePipe(BasePipe):
         self,
         db: core.WxDatabase | core.WxDatabaseBuild,
         layer: core.WxLayerTable | core.WxLayerTableBuild,
-        origin: core.WxFeature | None = None
+        origin: core.WxFeature | core.WxFeatureHandle | None = None
     ):
         self._db = db
         self._layer = layer
@@ -73,8 +73,12 @@ class FeaturePipe(BasePipe):
             # Get referenced feature
             ref = self._origin.get_field_as_ref(fid)
             
-            # Return as Feature object
-            feature = self._db.tryGetFeature(ref)
+            # Return as Feature object, None when the ref points at no feature
+            if ref is None:
+                return None
+            feature = self._db.get_feature_handle(ref)
+            if not feature.valid():
+                return None
             ref_pipe_type = self.__class__.__annotations__[name]
             pipe = ref_pipe_type()
             pipe.map_from(self._db, feature.layer(), feature)
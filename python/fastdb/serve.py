@@ -0,0 +1,172 @@
+import socket
+import struct
+import numpy as np
+from dataclasses import dataclass, field
+from typing import Dict, List, Sequence, Tuple
+
+# Pure python client of fastdb-serve, mirrors fastdb/include/fastdb-serve.h
+
+_REQUEST_MAGIC = 0x51424446
+_REPLY_MAGIC = 0x52424446
+_REQUEST = struct.Struct('<IIHHHH4dII2dII')
+_REPLY = struct.Struct('<IIiIIIQ')
+
+_OP_LOOKUP = 1
+_OP_QUERY = 2
+_FLAG_BBOX = 1
+_FLAG_FILTER = 2
+_FLAG_FILTER_TEXT = 4
+_COLUMN_F64 = 1
+_COLUMN_STR = 2
+
+_FILTER_OPS = {'==': 1, '!=': 2, '<': 3, '<=': 4, '>': 5, '>=': 6, 'between': 7}
+_STATUS = {-1: 'bad request', -2: 'layer not found', -3: 'field not found or not supported', -4: 'layer has no geometry index'}
+
+@dataclass
+class ServeLayer:
+    db: int
+    layer: int
+    feature_count: int
+    fields: List[Tuple[str, int]] = field(default_factory=list)    # (name, OriginFieldType value)
+
+    def field_index(self, name: str) -> int:
+        for i, (n, _) in enumerate(self.fields):
+            if n == name:
+                return i
+        raise KeyError(f'Field "{name}" not found in layer.')
+
+@dataclass
+class ServeResult:
+    id: int
+    rows: np.ndarray                                        # uint32 row ids
+    columns: Dict[str, np.ndarray | List[str]] = field(default_factory=dict)
+
+class ServeClient:
+    """
+    Client of a fastdb-serve daemon.
+
+    Queries can be pipelined with send()/receive(), replies come back in request order.
+    """
+    def __init__(self, path: str):
+        self._sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        self._sock.connect(path)
+        self._next_id = 1
+        self._pending: List[Tuple[int, List[str]]] = []
+
+    def __enter__(self) -> 'ServeClient':
+        return self
+
+    def __exit__(self, *args):
+        self.close()
+
+    def close(self):
+        if self._sock:
+            self._sock.close()
+            self._sock = None
+
+    def _send(self, op: int, flags: int = 0, db: int = 0, layer: int = 0,
+              bbox: Sequence[float] = (0, 0, 0, 0), filter_field: int = 0, filter_op: int = 0,
+              filter_value: Sequence[float] = (0, 0), max_rows: int = 0, payload: bytes = b'',
+              names: List[str] | None = None) -> int:
+        rid = self._next_id
+        self._next_id = (self._next_id + 1) & 0xFFFFFFFF or 1
+        header = _REQUEST.pack(_REQUEST_MAGIC, rid, op, flags, db, layer, *bbox,
+                               filter_field, filter_op, *filter_value, max_rows, len(payload))
+        self._sock.sendall(header + payload)
+        self._pending.append((rid, names or []))
+        return rid
+
+    def _recv_exact(self, size: int) -> bytes:
+        buf = bytearray(size)
+        view = memoryview(buf)
+        got = 0
+        while got < size:
+            n = self._sock.recv_into(view[got:], size - got)
+            if n == 0:
+                raise ConnectionError('fastdb-serve closed the connection.')
+            got += n
+        return bytes(buf)
+
+    def _receive(self) -> Tuple[Tuple, bytes, List[str]]:
+        if not self._pending:
+            raise RuntimeError('No pending request.')
+        magic, rid, status, row_count, column_count, op, size = _REPLY.unpack(self._recv_exact(_REPLY.size))
+        if magic != _REPLY_MAGIC:
+            raise ConnectionError('Invalid reply from fastdb-serve.')
+        _, names = self._pending.pop(0)
+        payload = self._recv_exact(size) if size else b''
+        if status != 0:
+            raise RuntimeError(f'fastdb-serve request {rid} failed: {_STATUS.get(status, status)}')
+        return (rid, row_count, column_count, op), payload, names
+
+    def lookup(self, name: str) -> ServeLayer:
+        """Resolve 'layer' or 'database/layer' to the indices used by queries."""
+        if self._pending:
+            raise RuntimeError('Receive all pending replies before a lookup.')
+        self._send(_OP_LOOKUP, payload=name.encode('utf-8'))
+        _, payload, _ = self._receive()
+        db, layer, feature_count, field_count = struct.unpack_from('<4I', payload, 0)
+        info = ServeLayer(db, layer, feature_count)
+        offset = 16
+        for _ in range(field_count):
+            ft, size = struct.unpack_from('<2I', payload, offset)
+            info.fields.append((payload[offset + 8: offset + 8 + size].decode('utf-8'), ft))
+            offset += 8 + ((size + 3) & ~3)
+        return info
+
+    def send(self, layer: ServeLayer, bbox: Sequence[float] | None = None,
+             where: Tuple | None = None, fields: Sequence[str] = (), max_rows: int = 0) -> int:
+        """
+        Queue a query without waiting for the reply, return the request id.
+        where: (field, op, value) or (field, 'between', low, high), op in == != < <= > >= between.
+        A str value compares a string field, byte order of the utf8 text, 'between' is not supported then.
+        """
+        flags = 0
+        filter_field, filter_op, filter_value = 0, 0, (0.0, 0.0)
+        text = b''
+        if bbox is not None:
+            flags |= _FLAG_BBOX
+        if where is not None:
+            flags |= _FLAG_FILTER
+            filter_field = layer.field_index(where[0])
+            filter_op = _FILTER_OPS[where[1]]
+            if isinstance(where[2], str):
+                flags |= _FLAG_FILTER_TEXT
+                encoded = where[2].encode('utf-8')
+                text = struct.pack('<I', len(encoded)) + encoded + b'\0' * (-len(encoded) % 4)
+            else:
+                filter_value = (float(where[2]), float(where[3]) if len(where) > 3 else 0.0)
+        indices = [layer.field_index(f) for f in fields]
+        return self._send(_OP_QUERY, flags, layer.db, layer.layer, tuple(bbox) if bbox is not None else (0, 0, 0, 0),
+                          filter_field, filter_op, filter_value, max_rows,
+                          text + struct.pack(f'<{len(indices)}I', *indices), list(fields))
+
+    def receive(self) -> ServeResult:
+        """Receive the reply of the oldest pending query."""
+        (rid, row_count, column_count, _), payload, names = self._receive()
+        rows = np.frombuffer(payload, dtype=np.uint32, count=row_count)
+        result = ServeResult(rid, rows)
+        offset = (row_count * 4 + 7) & ~7
+        for i in range(column_count):
+            ctype = struct.unpack_from('<I', payload, offset)[0]
+            offset += 8
+            if ctype == _COLUMN_F64:
+                result.columns[names[i]] = np.frombuffer(payload, dtype=np.float64, count=row_count, offset=offset)
+                offset += row_count * 8
+            else:
+                offsets = np.frombuffer(payload, dtype=np.uint32, count=row_count + 1, offset=offset)
+                text = offset + (row_count + 1) * 4
+                result.columns[names[i]] = [payload[text + offsets[r]: text + offsets[r + 1]].decode('utf-8')
+                                            for r in range(row_count)]
+                offset += ((row_count + 1) * 4 + int(offsets[-1]) + 7) & ~7
+        return result
+
+    def query(self, layer: ServeLayer, **kwargs) -> ServeResult:
+        self.send(layer, **kwargs)
+        return self.receive()
+
+    def query_many(self, queries: List[Tuple[ServeLayer, dict]]) -> List[ServeResult]:
+        """Pipeline a batch of queries, one round trip for the whole batch."""
+        for layer, kwargs in queries:
+            self.send(layer, **kwargs)
+        return [self.receive() for _ in queries]
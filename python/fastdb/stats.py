@@ -0,0 +1,58 @@
+from . import core
+
+# FastVectorDbStats fields, in the order of fastdb/include/fastdb.h
+_FIELDS = (
+    ('db_loads', 'dbLoads'),
+    ('db_bytes_loaded', 'dbBytesLoaded'),
+    ('features_scanned', 'featuresScanned'),
+    ('geometries_fetched', 'geometriesFetched'),
+    ('vertices_decoded', 'verticesDecoded'),
+    ('geometry_bytes', 'geometryBytes'),
+    ('feature_allocations', 'featureAllocations'),
+    ('tile_hits', 'tileHits'),
+    ('tile_misses', 'tileMisses'),
+    ('tile_loads', 'tileLoads'),
+    ('tile_load_failures', 'tileLoadFailures'),
+    ('tile_bytes_loaded', 'tileBytesLoaded'),
+    ('tile_evictions', 'tileEvictions'),
+    ('tile_queue_depth', 'tileQueueDepth'),
+    ('features_built', 'featuresBuilt'),
+    ('layers_built', 'layersBuilt'),
+    ('geometry_bytes_built', 'geometryBytesBuilt'),
+)
+
+
+def get_stats() -> dict:
+    """Process wide counters of the native library since start or the last reset_stats."""
+    stats = core.WxDatabase.get_stats()
+    return {name: int(getattr(stats, member)) for name, member in _FIELDS}
+
+
+def reset_stats():
+    core.WxDatabase.reset_stats()
+
+
+# FastVectorDbMemory fields, in the order of fastdb/include/fastdb.h
+_MEMORY_FIELDS = (
+    ('buffer', 'buffer'),
+    ('resident', 'resident'),
+    ('headers', 'headers'),
+    ('geometry', 'geometry'),
+    ('attributes', 'attributes'),
+    ('strings', 'strings'),
+    ('sections', 'sections'),
+    ('string_tables', 'stringTables'),
+    ('geometry_map', 'geometryMap'),
+    ('cookie_map', 'cookieMap'),
+    ('feature_cache', 'featureCache'),
+    ('feature_objects', 'featureObjects'),
+    ('objects', 'objects'),
+    ('auxiliary', 'auxiliary'),
+    ('total', 'total'),
+)
+
+
+def memory_report(target) -> dict:
+    """Bytes held by a WxDatabase or WxLayerTable, by image section and auxiliary structure."""
+    report = target.memory_report()
+    return {name: int(getattr(report, member)) for name, member in _MEMORY_FIELDS}